@@ -63,6 +63,11 @@ public:
         const Crypto::Hash &transactionHash)
     {
     }
+
+    // Unlocked transfers of the subscription are locked again after a blockchain detach
+    virtual void onTransfersLocked(ITransfersSubscription *object)
+    {
+    }
 };
 
 class ITransfersSubscription : public IObservable <ITransfersObserver>
@@ -228,14 +228,19 @@ bool BlockchainExplorerDataBuilder::fillTransactionDetails(const Transaction &tr
         transactionDetails.mixin = mixin;
     }
 
-    Crypto::Hash paymentId {};
-    if (getPaymentId(transaction, paymentId)) {
-        transactionDetails.paymentId = paymentId;
+    // the details list every field, the payment id is taken from the same parse
+    std::vector<TransactionExtraField> txExtraFields;
+    parseTransactionExtra(transaction.extra, txExtraFields);
+
+    TransactionExtraInfo extraInfo;
+    getTransactionExtraInfo(txExtraFields, extraInfo);
+    if (extraInfo.hasPaymentId) {
+        transactionDetails.paymentId = extraInfo.paymentId;
     } else {
         transactionDetails.paymentId = boost::value_initialized<Crypto::Hash>();
     }
 
-    fillTxExtra(transaction.extra, transactionDetails.extra);
+    fillTxExtra(transaction.extra, txExtraFields, transactionDetails.extra);
 
     transactionDetails.signatures.reserve(transaction.signatures.size());
 
@@ -327,16 +332,16 @@ bool BlockchainExplorerDataBuilder::fillTransactionDetails(const Transaction &tr
 bool BlockchainExplorerDataBuilder::getPaymentId(const Transaction &transaction,
                                                  Crypto::Hash &paymentId)
 {
-    std::vector<TransactionExtraField> txExtraFields;
-    parseTransactionExtra(transaction.extra, txExtraFields);
+    TransactionExtraInfo extraInfo;
+    parseTransactionExtra(transaction.extra, extraInfo);
 
-    TransactionExtraNonce extraNonce;
-
-    if (!findTransactionExtraFieldByType(txExtraFields, extraNonce)) {
+    if (!extraInfo.hasPaymentId) {
         return false;
     }
 
-    return getPaymentIdFromTransactionExtraNonce(extraNonce.nonce, paymentId);
+    paymentId = extraInfo.paymentId;
+
+    return true;
 }
 
 bool BlockchainExplorerDataBuilder::getMixin(const Transaction &transaction, uint64_t &mixin)
@@ -357,14 +362,13 @@ bool BlockchainExplorerDataBuilder::getMixin(const Transaction &transaction, uin
     return true;
 }
 
-bool BlockchainExplorerDataBuilder::fillTxExtra(const std::vector<uint8_t> &rawExtra,
-                                                TransactionExtraDetails &extraDetails)
+bool BlockchainExplorerDataBuilder::fillTxExtra(
+    const std::vector<uint8_t> &rawExtra,
+    const std::vector<TransactionExtraField> &txExtraFields,
+    TransactionExtraDetails &extraDetails)
 {
     extraDetails.raw = rawExtra;
 
-    std::vector<TransactionExtraField> txExtraFields;
-    parseTransactionExtra(rawExtra, txExtraFields);
-
     for (const TransactionExtraField &field : txExtraFields) {
         if (typeid(TransactionExtraPadding) == field.type()) {
             extraDetails.padding.push_back(
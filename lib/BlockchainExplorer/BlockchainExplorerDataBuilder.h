@@ -21,6 +21,7 @@
 
 #include <BlockchainExplorer/BlockchainExplorerData.h>
 #include <CryptoNoteCore/ICore.h>
+#include <CryptoNoteCore/TransactionExtra.h>
 #include <CryptoNoteProtocol/ICryptoNoteProtocolQuery.h>
 
 namespace CryptoNote {
@@ -47,6 +48,7 @@ public:
 private:
     static bool getMixin(const Transaction &transaction, uint64_t &mixin);
     static bool fillTxExtra(const std::vector<uint8_t> &rawExtra,
+                            const std::vector<TransactionExtraField> &txExtraFields,
                             TransactionExtraDetails &extraDetails);
     static size_t median(std::vector<size_t> &v);
 
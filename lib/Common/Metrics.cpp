@@ -0,0 +1,276 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <Common/Metrics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Metrics {
+
+namespace {
+
+const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+unsigned highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+}
+
+std::string escape(const std::string &text, bool quotes)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c == '"' && quotes) {
+            escaped += "\\\"";
+        } else {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+void writeLabels(std::ostream &stream, const Labels &labels, const std::string &quantile = std::string())
+{
+    if (labels.empty() && quantile.empty()) {
+        return;
+    }
+
+    stream << '{';
+    bool first = true;
+    for (const auto &label : labels) {
+        stream << (first ? "" : ",") << label.first << "=\"" << escape(label.second, true) << '"';
+        first = false;
+    }
+
+    if (!quantile.empty()) {
+        stream << (first ? "" : ",") << "quantile=\"" << quantile << '"';
+    }
+
+    stream << '}';
+}
+
+double toSeconds(std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+Histogram::Histogram()
+    : m_count(0),
+      m_sum(0)
+{
+    for (auto &bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(std::chrono::nanoseconds duration)
+{
+    uint64_t value = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Histogram::sum() const
+{
+    return std::chrono::nanoseconds(m_sum.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds Histogram::quantile(double fraction) const
+{
+    // the buckets are read once, a record() in between must not move the rank past them
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        return std::chrono::nanoseconds::zero();
+    }
+
+    auto rank = static_cast<uint64_t>(std::ceil(fraction * total));
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(bucketValue(i));
+        }
+    }
+
+    return std::chrono::nanoseconds(bucketValue(BUCKET_COUNT - 1));
+}
+
+size_t Histogram::bucketIndex(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+
+    unsigned exponent = highestBit(value);
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+
+    unsigned shift = exponent - SUB_BUCKET_BITS;
+    size_t subBucket = static_cast<size_t>(value >> shift) & (SUB_BUCKET_COUNT - 1);
+    return (shift + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+// the highest value of the bucket
+uint64_t Histogram::bucketValue(size_t index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    unsigned shift = static_cast<unsigned>(index / SUB_BUCKET_COUNT) - 1;
+    uint64_t subBucket = index % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + subBucket + 1) << shift) - 1;
+}
+
+Counter &Registry::counter(const std::string &name, const std::string &help, const Labels &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = family(name, help, Type::COUNTER).counters[labels];
+    if (!metric) {
+        metric.reset(new Counter());
+    }
+
+    return *metric;
+}
+
+Gauge &Registry::gauge(const std::string &name, const std::string &help, const Labels &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = family(name, help, Type::GAUGE).gauges[labels];
+    if (!metric) {
+        metric.reset(new Gauge());
+    }
+
+    return *metric;
+}
+
+Histogram &Registry::histogram(const std::string &name, const std::string &help, const Labels &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = family(name, help, Type::HISTOGRAM).histograms[labels];
+    if (!metric) {
+        metric.reset(new Histogram());
+    }
+
+    return *metric;
+}
+
+std::string Registry::format() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream stream;
+    stream << std::setprecision(9);
+    for (const auto &entry : m_families) {
+        const std::string &name = entry.first;
+        const Family &family = entry.second;
+        stream << "# HELP " << name << ' ' << escape(family.help, false) << '\n';
+        switch (family.type) {
+        case Type::COUNTER:
+            stream << "# TYPE " << name << " counter\n";
+            for (const auto &metric : family.counters) {
+                stream << name;
+                writeLabels(stream, metric.first);
+                stream << ' ' << metric.second->value() << '\n';
+            }
+            break;
+        case Type::GAUGE:
+            stream << "# TYPE " << name << " gauge\n";
+            for (const auto &metric : family.gauges) {
+                stream << name;
+                writeLabels(stream, metric.first);
+                stream << ' ' << metric.second->value() << '\n';
+            }
+            break;
+        case Type::HISTOGRAM:
+            stream << "# TYPE " << name << " summary\n";
+            for (const auto &metric : family.histograms) {
+                for (double quantile : QUANTILES) {
+                    std::ostringstream quantileText;
+                    quantileText << quantile;
+                    stream << name;
+                    writeLabels(stream, metric.first, quantileText.str());
+                    stream << ' ' << toSeconds(metric.second->quantile(quantile)) << '\n';
+                }
+
+                stream << name << "_sum";
+                writeLabels(stream, metric.first);
+                stream << ' ' << toSeconds(metric.second->sum()) << '\n';
+                stream << name << "_count";
+                writeLabels(stream, metric.first);
+                stream << ' ' << metric.second->count() << '\n';
+            }
+            break;
+        }
+    }
+
+    return stream.str();
+}
+
+Registry::Family &Registry::family(const std::string &name, const std::string &help, Type type)
+{
+    auto it = m_families.find(name);
+    if (it == m_families.end()) {
+        it = m_families.emplace(name, Family()).first;
+        it->second.type = type;
+        it->second.help = help;
+    } else if (it->second.type != type) {
+        throw std::invalid_argument("Metric " + name + " already has another type");
+    }
+
+    return it->second;
+}
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+} // namespace Metrics
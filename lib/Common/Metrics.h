@@ -0,0 +1,196 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Metrics {
+
+typedef std::map<std::string, std::string> Labels;
+
+class Counter
+{
+public:
+    Counter() : m_value(0) { }
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    void add(uint64_t value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+class Gauge
+{
+public:
+    Gauge() : m_value(0) { }
+    Gauge(const Gauge &) = delete;
+    Gauge &operator=(const Gauge &) = delete;
+
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+/*
+ * Durations in log-linear buckets the way HDR histograms keep them: every power of two of
+ * nanoseconds is split into 16 buckets, so a quantile is off by less than 1/16 of its value.
+ * Recording is a few relaxed atomic increments, reading doesn't stop the writers.
+ */
+class Histogram
+{
+public:
+    Histogram();
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void record(std::chrono::nanoseconds duration);
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    std::chrono::nanoseconds sum() const;
+    // the duration the given fraction of the recorded ones doesn't exceed
+    std::chrono::nanoseconds quantile(double fraction) const;
+
+private:
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const unsigned SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    // durations from 2^MAX_EXPONENT ns, about 18 minutes, share the last bucket
+    static const unsigned MAX_EXPONENT = 40;
+    static const size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketValue(size_t index);
+
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+};
+
+// Records the time from its construction to its destruction.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram &histogram)
+        : m_histogram(histogram),
+          m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() { m_histogram.record(std::chrono::steady_clock::now() - m_start); }
+
+private:
+    Histogram &m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+ * A drop-in for Mutex that records how long every lock() waited. An uncontended lock is taken by
+ * try_lock and recorded as zero without reading the clock.
+ */
+template<typename Mutex>
+class TimedMutex
+{
+public:
+    explicit TimedMutex(Histogram &waits) : m_waits(waits) { }
+    TimedMutex(const TimedMutex &) = delete;
+    TimedMutex &operator=(const TimedMutex &) = delete;
+
+    void lock()
+    {
+        if (m_mutex.try_lock()) {
+            m_waits.record(std::chrono::nanoseconds::zero());
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        m_waits.record(std::chrono::steady_clock::now() - start);
+    }
+
+    bool try_lock() { return m_mutex.try_lock(); }
+    void unlock() { m_mutex.unlock(); }
+
+private:
+    Mutex m_mutex;
+    Histogram &m_waits;
+};
+
+/*
+ * Owns the metrics of the process by name and labels. Looking a metric up takes a lock, so hot
+ * paths keep the returned reference, which stays valid for the life of the process. Metrics are
+ * written in the Prometheus text format, histograms as summaries in seconds.
+ */
+class Registry
+{
+public:
+    Registry() = default;
+    Registry(const Registry &) = delete;
+    Registry &operator=(const Registry &) = delete;
+
+    // throw std::invalid_argument if the name is taken by a metric of another type
+    Counter &counter(const std::string &name, const std::string &help, const Labels &labels = Labels());
+    Gauge &gauge(const std::string &name, const std::string &help, const Labels &labels = Labels());
+    Histogram &histogram(const std::string &name,
+                         const std::string &help,
+                         const Labels &labels = Labels());
+
+    std::string format() const;
+
+private:
+    enum class Type
+    {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Family
+    {
+        Type type;
+        std::string help;
+        std::map<Labels, std::unique_ptr<Counter>> counters;
+        std::map<Labels, std::unique_ptr<Gauge>> gauges;
+        std::map<Labels, std::unique_ptr<Histogram>> histograms;
+    };
+
+    Family &family(const std::string &name, const std::string &help, Type type);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family> m_families;
+};
+
+Registry &registry();
+
+} // namespace Metrics
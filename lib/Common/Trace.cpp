@@ -0,0 +1,158 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <Common/Trace.h>
+
+#include <atomic>
+#include <Common/JsonValue.h>
+#include <Common/StringTools.h>
+
+namespace Tracing {
+
+namespace {
+
+// a few hundred blocks' worth of spans
+const size_t RECORDER_CAPACITY = 1 << 15;
+
+std::atomic<bool> enabled(false);
+
+// small ids in the order the threads record their first span, the trace viewers show them
+uint32_t currentThread()
+{
+    static std::atomic<uint32_t> nextThread(1);
+    thread_local uint32_t thread = nextThread.fetch_add(1);
+    return thread;
+}
+
+double toMicroseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+Recorder::Recorder(size_t capacity)
+    : m_capacity(capacity),
+      m_next(0)
+{
+}
+
+void Recorder::record(Event &&event)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() < m_capacity) {
+        m_events.push_back(std::move(event));
+    } else {
+        m_events[m_next] = std::move(event);
+    }
+
+    m_next = (m_next + 1) % m_capacity;
+}
+
+std::vector<Event> Recorder::events() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() < m_capacity) {
+        return m_events;
+    }
+
+    std::vector<Event> events;
+    events.reserve(m_events.size());
+    events.insert(events.end(), m_events.begin() + m_next, m_events.end());
+    events.insert(events.end(), m_events.begin(), m_events.begin() + m_next);
+
+    return events;
+}
+
+std::string Recorder::toChromeTrace() const
+{
+    Common::JsonValue traceEvents(Common::JsonValue::ARRAY);
+    for (const Event &event : events()) {
+        Common::JsonValue traceEvent(Common::JsonValue::OBJECT);
+        traceEvent.insert("name", std::string(event.name));
+        traceEvent.insert("ph", std::string("X"));
+        traceEvent.insert("pid", Common::JsonValue::Integer(1));
+        traceEvent.insert("tid", Common::JsonValue::Integer(event.thread));
+        traceEvent.insert("ts", toMicroseconds(event.start.time_since_epoch()));
+        traceEvent.insert("dur", toMicroseconds(event.duration));
+        if (event.hasId) {
+            Common::JsonValue args(Common::JsonValue::OBJECT);
+            args.insert("id", Common::podToHex(event.id));
+            traceEvent.insert("args", std::move(args));
+        }
+
+        traceEvents.pushBack(std::move(traceEvent));
+    }
+
+    Common::JsonValue trace(Common::JsonValue::OBJECT);
+    trace.insert("traceEvents", std::move(traceEvents));
+    trace.insert("displayTimeUnit", std::string("ms"));
+
+    return trace.toString();
+}
+
+Recorder &recorder()
+{
+    static Recorder instance(RECORDER_CAPACITY);
+    return instance;
+}
+
+void setEnabled(bool value)
+{
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+Span::Span(const char *name)
+    : m_active(isEnabled()),
+      m_name(name),
+      m_hasId(false)
+{
+    if (m_active) {
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+Span::Span(const char *name, const Crypto::Hash &id)
+    : m_active(isEnabled()),
+      m_name(name),
+      m_hasId(false)
+{
+    if (m_active) {
+        m_id = id;
+        m_hasId = true;
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+Span::~Span()
+{
+    if (!m_active) {
+        return;
+    }
+
+    auto duration = std::chrono::steady_clock::now() - m_start;
+    recorder().record({ m_name, m_id, m_hasId, currentThread(), m_start, duration });
+}
+
+} // namespace Tracing
@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <CryptoTypes.h>
+
+namespace Tracing {
+
+struct Event
+{
+    // a string literal, spans don't copy it
+    const char *name;
+    // the block or transaction the span worked on, kept raw until the trace is written out
+    Crypto::Hash id;
+    bool hasId;
+    uint32_t thread;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds duration;
+};
+
+/*
+ * Keeps the latest events of the process, the oldest ones are overwritten when it's full. The
+ * events can be written in the Chrome trace event format, which chrome://tracing and Perfetto
+ * show as a timeline with the nested spans of every thread.
+ */
+class Recorder
+{
+public:
+    explicit Recorder(size_t capacity);
+    Recorder(const Recorder &) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+
+    void record(Event &&event);
+    // oldest first
+    std::vector<Event> events() const;
+    std::string toChromeTrace() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events;
+    size_t m_capacity;
+    size_t m_next;
+};
+
+Recorder &recorder();
+
+// Tracing is off by default, spans created while it's off cost a flag check and record nothing.
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// Records the time from its construction to its destruction to recorder().
+class Span
+{
+public:
+    explicit Span(const char *name);
+    Span(const char *name, const Crypto::Hash &id);
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+    ~Span();
+
+private:
+    bool m_active;
+    const char *m_name;
+    Crypto::Hash m_id;
+    bool m_hasId;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace Tracing
@@ -28,10 +28,12 @@
 #include <numeric>
 #include <boost/foreach.hpp>
 #include <Common/Math.h>
+#include <Common/Metrics.h>
 #include <Common/int-util.h>
 #include <Common/ShuffleGenerator.h>
 #include <Common/StdInputStream.h>
 #include <Common/StdOutputStream.h>
+#include <Common/Trace.h>
 #include <CryptoNoteCore/Blockchain.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/TransactionExtra.h>
@@ -45,6 +47,16 @@ using namespace Societatis;
 
 namespace {
 
+// the signatures of a few blocks' worth of transactions, enough to cover a
+// reorg plus the pool
+const size_t VERIFIED_SIGNATURES_CACHE_SIZE = 1 << 16;
+
+// alternative blocks below this depth can't be extended any more, see
+// Checkpoints::is_alternative_block_allowed()
+const uint32_t ALTERNATIVE_BLOCKS_KEEP_DEPTH =
+    CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+const size_t ALTERNATIVE_BLOCKS_MAX_COUNT = 1000;
+
 std::string appendPath(const std::string &path, const std::string &fileName)
 {
     std::string result = path;
@@ -57,6 +69,30 @@ std::string appendPath(const std::string &path, const std::string &fileName)
     return result;
 }
 
+std::chrono::nanoseconds elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+}
+
+Metrics::Histogram &blockStageMetric(const std::string &stage)
+{
+    return Metrics::registry().histogram(
+        "block_validation_seconds",
+        "Time spent in the stages of pushing a block to the main chain",
+        { { "stage", stage } }
+    );
+}
+
+Metrics::Counter &ringSignatureMetric(const std::string &result)
+{
+    return Metrics::registry().counter(
+        "ring_signature_checks_total",
+        "Ring signatures checked, cached ones were verified before",
+        { { "result", result } }
+    );
+}
+
 } // namespace
 
 namespace std {
@@ -366,6 +402,12 @@ Blockchain::Blockchain(
     : logger(logger, "Blockchain"),
       m_currency(currency),
       m_tx_pool(tx_pool),
+      m_blockchain_lock(Metrics::registry().histogram(
+          "lock_wait_seconds",
+          "Time spent waiting for a lock",
+          { { "lock", "blockchain" } }
+      )),
+      m_verifiedSignatures(VERIFIED_SIGNATURES_CACHE_SIZE),
       m_current_block_cumul_sz_limit(0),
       m_upgradeDetectorV2(currency, m_blocks, BLOCK_MAJOR_VERSION_2, logger),
       m_upgradeDetectorV3(currency, m_blocks, BLOCK_MAJOR_VERSION_3, logger),
@@ -497,6 +539,13 @@ bool Blockchain::init(const std::string &config_folder, bool load_existing)
         return false;
     }
 
+    if (!m_compactBlocks.open(
+            appendPath(config_folder, m_currency.compactBlocksFileName()),
+            appendPath(config_folder, m_currency.compactBlockIndexesFileName()), 1024)
+        ) {
+        return false;
+    }
+
     if (load_existing && !m_blocks.empty()) {
         logger(INFO, BRIGHT_WHITE) << "Loading blockchain...";
         BlockCacheSerializer loader(*this, getBlockHash(m_blocks.back().bl), logger.getLogger());
@@ -515,6 +564,8 @@ bool Blockchain::init(const std::string &config_folder, bool load_existing)
         m_blocks.clear();
     }
 
+    rebuildCompactBlocks();
+
     if (m_blocks.empty()) {
         logger(INFO, BRIGHT_WHITE) << "Blockchain not loaded, generating genesis block.";
         block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -634,6 +685,44 @@ bool Blockchain::init(const std::string &config_folder, bool load_existing)
     return true;
 }
 
+void Blockchain::rebuildCompactBlocks()
+{
+    // the table is derived from m_blocks, so it's only trusted as far as it agrees with them
+    if (m_compactBlocks.size() > m_blocks.size()
+        || (!m_compactBlocks.empty()
+            && m_compactBlocks.back().hash
+               != getBlockHash(m_blocks[m_compactBlocks.size() - 1].bl))) {
+        m_compactBlocks.clear();
+    }
+
+    if (m_compactBlocks.size() == m_blocks.size()) {
+        return;
+    }
+
+    logger(INFO, BRIGHT_WHITE)
+        << "Building compact blocks from height " << m_compactBlocks.size()
+        << " of " << m_blocks.size();
+    for (auto b = static_cast<uint32_t>(m_compactBlocks.size()); b < m_blocks.size(); ++b) {
+        const BlockEntry &block = m_blocks[b];
+        pushCompactBlock(block, getBlockHash(block.bl));
+    }
+}
+
+void Blockchain::pushCompactBlock(const BlockEntry &block, const Crypto::Hash &blockHash)
+{
+    CompactBlockEntry entry;
+    entry.hash = blockHash;
+    entry.timestamp = block.bl.timestamp;
+
+    CompactTransactionsWriter writer(entry.transactions, block.transactions.size());
+    writer.write(getObjectHash(block.bl.baseTransaction), block.transactions[0].tx);
+    for (size_t i = 1; i < block.transactions.size(); ++i) {
+        writer.write(block.bl.transactionHashes[i - 1], block.transactions[i].tx);
+    }
+
+    m_compactBlocks.push_back(entry);
+}
+
 void Blockchain::rebuildCache()
 {
     std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
@@ -713,6 +802,7 @@ bool Blockchain::resetAndSetGenesisBlock(const Block &b)
 {
     std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     m_blocks.clear();
+    m_compactBlocks.clear();
     m_blockIndex.clear();
     m_transactionMap.clear();
 
@@ -831,6 +921,7 @@ bool Blockchain::getBlockHeight(const Crypto::Hash &blockId, uint32_t &blockHeig
 difficulty_type Blockchain::getDifficultyForNextBlock(uint64_t nextBlockTime)
 {
     std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    Tracing::Span span("getDifficultyForNextBlock");
     std::vector<uint64_t> timestamps;
     std::vector<difficulty_type> cumulative_difficulties;
     uint8_t BlockMajorVersion=getBlockMajorVersionForHeight(static_cast<uint32_t>(m_blocks.size()));
@@ -1075,26 +1166,31 @@ uint8_t Blockchain::getBlockMajorVersionForHeight(uint32_t height) const
 }
 
 bool Blockchain::rollback_blockchain_switching(
-    std::list<Block> &original_chain,
+    std::list<BlockEntry> &original_chain,
+    const std::unordered_set<Crypto::Hash> &original_transactions,
     size_t rollback_height)
 {
     std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    // remove failed subchain
+    // remove failed subchain, the transactions it shares with the original
+    // chain are restored along with that chain
+    std::vector<Transaction> poolTransactions;
     for (size_t i = m_blocks.size() - 1; i >= rollback_height; i--) {
-        popBlock();
+        const BlockEntry &block = m_blocks.back();
+        for (size_t j = 1; j < block.transactions.size(); ++j) {
+            if (original_transactions.count(block.bl.transactionHashes[j - 1]) == 0) {
+                poolTransactions.push_back(block.transactions[j].tx);
+            }
+        }
+
+        disconnectLastBlock();
     }
 
-    // return back original chain
-    for (auto &bl : original_chain) {
-        block_verification_context bvc =
-        boost::value_initialized<block_verification_context>();
-        bool r = pushBlock(bl, bvc);
-        if (!(r && bvc.m_added_to_main_chain)) {
-            logger(ERROR, BRIGHT_RED)
-                << "PANIC!!! failed to add (again) block while "
-                << "chain switching during the rollback!";
-            return false;
-        }
+    saveTransactions(poolTransactions);
+
+    // return back original chain, its blocks were valid at these heights so
+    // they are reconnected without verifying them again
+    for (auto &block : original_chain) {
+        reconnectBlock(block);
     }
 
     logger(INFO, BRIGHT_WHITE) << "Rollback success.";
@@ -1102,6 +1198,48 @@ bool Blockchain::rollback_blockchain_switching(
     return true;
 }
 
+bool Blockchain::takeBlockTransactions(
+    const Block &block,
+    std::unordered_map<Crypto::Hash, Transaction> &detachedTransactions,
+    std::vector<Transaction> &transactions)
+{
+    transactions.resize(block.transactionHashes.size());
+    std::vector<bool> fromPool(block.transactionHashes.size(), false);
+    for (size_t i = 0; i < block.transactionHashes.size(); ++i) {
+        const Crypto::Hash &transactionHash = block.transactionHashes[i];
+        auto detached = detachedTransactions.find(transactionHash);
+        if (detached != detachedTransactions.end()) {
+            transactions[i] = std::move(detached->second);
+            detachedTransactions.erase(detached);
+            continue;
+        }
+
+        size_t transactionSize;
+        uint64_t fee;
+        if (m_tx_pool.take_tx(transactionHash, transactions[i], transactionSize, fee)) {
+            fromPool[i] = true;
+            continue;
+        }
+
+        // put back what was taken so far
+        std::vector<Transaction> poolTransactions;
+        for (size_t j = 0; j < i; ++j) {
+            if (fromPool[j]) {
+                poolTransactions.push_back(std::move(transactions[j]));
+            } else {
+                detachedTransactions.emplace(block.transactionHashes[j], std::move(transactions[j]));
+            }
+        }
+
+        saveTransactions(poolTransactions);
+        transactions.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
 bool Blockchain::switch_to_alternative_blockchain(
     std::list<blocks_ext_by_hash::iterator> &alt_chain,
     bool discard_disconnected_chain)
@@ -1236,22 +1374,50 @@ bool Blockchain::switch_to_alternative_blockchain(
         }
     }
 
-    // disconnecting old chain
-    std::list<Block> disconnected_chain;
+    // disconnecting old chain, its entries are kept to undo the switch
+    // without verifying them again
+    std::list<BlockEntry> disconnected_chain;
+    std::unordered_map<Crypto::Hash, Transaction> detachedTransactions;
+    std::unordered_set<Crypto::Hash> disconnectedTransactionHashes;
     for (size_t i = m_blocks.size() - 1; i >= split_height; i--) {
-        Block b = m_blocks[i].bl;
-        popBlock();
-        disconnected_chain.push_front(b);
+        disconnected_chain.push_front(m_blocks.back());
+        const BlockEntry &entry = disconnected_chain.front();
+        for (size_t j = 1; j < entry.transactions.size(); ++j) {
+            const Crypto::Hash &transactionHash = entry.bl.transactionHashes[j - 1];
+            detachedTransactions.emplace(transactionHash, entry.transactions[j].tx);
+            disconnectedTransactionHashes.insert(transactionHash);
+        }
+
+        disconnectLastBlock();
     }
 
     // connecting new alternative chain
     for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
         auto ch_ent = *alt_ch_iter;
         block_verification_context bvc = boost::value_initialized<block_verification_context>();
-        bool r = pushBlock(ch_ent->second.bl, bvc);
+        std::vector<Transaction> transactions;
+        bool r = takeBlockTransactions(ch_ent->second.bl, detachedTransactions, transactions);
+        if (r) {
+            r = pushBlock(ch_ent->second.bl, transactions, bvc);
+            if (!r) {
+                std::vector<Transaction> poolTransactions;
+                for (size_t i = 0; i < transactions.size(); ++i) {
+                    if (disconnectedTransactionHashes.count(ch_ent->second.bl.transactionHashes[i]) == 0) {
+                        poolTransactions.push_back(std::move(transactions[i]));
+                    }
+                }
+
+                saveTransactions(poolTransactions);
+            }
+        }
+
         if (!r || !bvc.m_added_to_main_chain) {
             logger(INFO, BRIGHT_WHITE) << "Failed to switch to alternative blockchain";
-            rollback_blockchain_switching(disconnected_chain, split_height);
+            rollback_blockchain_switching(
+                disconnected_chain,
+                disconnectedTransactionHashes,
+                split_height
+            );
             logger(INFO, BRIGHT_WHITE)
                 << "The block was inserted as invalid while connecting new alternative chain,"
                 << " block_id: " << getBlockHash(ch_ent->second.bl);
@@ -1269,11 +1435,25 @@ bool Blockchain::switch_to_alternative_blockchain(
         }
     }
 
+    // transactions of the old chain that the new one doesn't include
+    std::vector<Transaction> leftTransactions;
+    leftTransactions.reserve(detachedTransactions.size());
+    for (auto &detached : detachedTransactions) {
+        leftTransactions.push_back(std::move(detached.second));
+    }
+
+    saveTransactions(leftTransactions);
+
     if (!discard_disconnected_chain) {
         // pushing old chain as alternative chain
         for (auto &old_ch_ent : disconnected_chain) {
             block_verification_context bvc = boost::value_initialized<block_verification_context>();
-            bool r = handle_alternative_block(old_ch_ent, getBlockHash(old_ch_ent), bvc, false);
+            bool r = handle_alternative_block(
+                old_ch_ent.bl,
+                getBlockHash(old_ch_ent.bl),
+                bvc,
+                false
+            );
             if (!r) {
                 logger(WARNING, BRIGHT_YELLOW)
                     << "Failed to push ex-main chain blocks to alternative chain ";
@@ -1891,6 +2071,23 @@ bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Bloc
     return true;
 }
 
+void Blockchain::getCompactBlocks(
+    uint32_t start_offset,
+    uint32_t count,
+    uint64_t timestamp,
+    CompactBlocksWriter &writer)
+{
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    for (uint32_t i = start_offset; i < start_offset + count && i < m_compactBlocks.size(); i++) {
+        const CompactBlockEntry &entry = m_compactBlocks[i];
+        if (entry.timestamp >= timestamp) {
+            writer.write(entry.hash, entry.timestamp, entry.transactions);
+        } else {
+            writer.writeHash(entry.hash);
+        }
+    }
+}
+
 // TODO: Deprecated. Should be removed with CryptoNoteProtocolHandler.
 bool Blockchain::handleGetObjects(
     NOTIFY_REQUEST_GET_OBJECTS::request &arg,
@@ -2374,6 +2571,7 @@ bool Blockchain::checkTransactionInputs(
     }
 
     Crypto::Hash transactionHash = getObjectHash(tx);
+    Tracing::Span span("checkTransactionInputs", transactionHash);
     for (const auto &txin : tx.inputs) {
         assert(inputIndex < tx.signatures.size());
 
@@ -2432,6 +2630,106 @@ bool Blockchain::checkTransactionInputs(
     return true;
 }
 
+bool Blockchain::resolveTransactionInputs(
+    const Transaction &tx,
+    ResolvedTransactionInputs &inputs)
+{
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+    inputs.prefixHash = getObjectHash(*static_cast<const TransactionPrefix *>(&tx));
+    inputs.checkSignatures = !isInCheckpointZone(getCurrentBlockchainHeight());
+    inputs.keys.clear();
+    inputs.keys.resize(tx.inputs.size());
+
+    if (tx.signatures.size() != tx.inputs.size()) {
+        return false;
+    }
+
+    uint32_t maxUsedBlockHeight = 0;
+    Crypto::Hash transactionHash = getObjectHash(tx);
+    for (size_t i = 0; i < tx.inputs.size(); ++i) {
+        const auto &txin = tx.inputs[i];
+        if (txin.type() == typeid(KeyInput)) {
+            const KeyInput &in_to_key = boost::get<KeyInput>(txin);
+            if (in_to_key.outputIndexes.empty()) {
+                logger(ERROR, BRIGHT_RED)
+                    << "empty in_to_key.outputIndexes in transaction with id "
+                    << transactionHash;
+                return false;
+            }
+
+            if (have_tx_keyimg_as_spent(in_to_key.keyImage)) {
+                logger(DEBUGGING)
+                    << "Key image already spent in blockchain: "
+                    << Common::podToHex(in_to_key.keyImage);
+                return false;
+            }
+
+            if (inputs.checkSignatures
+                && !getInputRingKeys(
+                    in_to_key,
+                    tx.signatures[i],
+                    inputs.keys[i],
+                    &maxUsedBlockHeight)) {
+                logger(INFO, BRIGHT_WHITE)
+                    << "Failed to check input in transaction "
+                    << transactionHash;
+                return false;
+            }
+        } else if (txin.type() == typeid(MultiSignatureInput)) {
+            // multisignature inputs are rare and cheap to check, so they're verified here
+            if (inputs.checkSignatures
+                && !validateInput(
+                    ::boost::get<MultiSignatureInput>(txin),
+                    transactionHash,
+                    inputs.prefixHash,
+                    tx.signatures[i])) {
+                return false;
+            }
+        } else {
+            logger(INFO, BRIGHT_WHITE)
+                << "Transaction << "
+                << transactionHash
+                << " contains input of unsupported type.";
+            return false;
+        }
+    }
+
+    if (maxUsedBlockHeight >= m_blocks.size()) {
+        logger(ERROR, BRIGHT_RED)
+            << "internal error: max used block index=" << maxUsedBlockHeight
+            << " is not less then blockchain size = " << m_blocks.size();
+        return false;
+    }
+
+    inputs.maxUsedBlock.height = maxUsedBlockHeight;
+    getBlockHash(m_blocks[maxUsedBlockHeight].bl, inputs.maxUsedBlock.id);
+
+    return true;
+}
+
+bool Blockchain::checkTransactionSignatures(
+    const Transaction &tx,
+    const ResolvedTransactionInputs &inputs)
+{
+    if (!inputs.checkSignatures) {
+        return true;
+    }
+
+    for (size_t i = 0; i < tx.inputs.size(); ++i) {
+        if (tx.inputs[i].type() == typeid(KeyInput)
+            && !checkInputRingSignature(
+                boost::get<KeyInput>(tx.inputs[i]),
+                inputs.prefixHash,
+                tx.signatures[i],
+                inputs.keys[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time)
 {
     if (unlock_time < m_currency.maxBlockHeight()) {
@@ -2455,10 +2753,30 @@ bool Blockchain::check_tx_input(
 {
     std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
+    std::vector<Crypto::PublicKey> output_keys;
+    if (!getInputRingKeys(txin, sig, output_keys, pmax_related_block_height)) {
+        return false;
+    }
+
+    if (isInCheckpointZone(getCurrentBlockchainHeight())) {
+        return true;
+    }
+
+    return checkInputRingSignature(txin, tx_prefix_hash, sig, output_keys);
+}
+
+bool Blockchain::getInputRingKeys(
+    const KeyInput &txin,
+    const std::vector<Crypto::Signature> &sig,
+    std::vector<Crypto::PublicKey> &output_keys,
+    uint32_t *pmax_related_block_height)
+{
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
     struct outputs_visitor
     {
         outputs_visitor(
-            std::vector<const Crypto::PublicKey *> &results_collector,
+            std::vector<Crypto::PublicKey> &results_collector,
             Blockchain &bch,
             ILogger &logger)
             : m_results_collector(results_collector),
@@ -2487,12 +2805,12 @@ bool Blockchain::check_tx_input(
                 return false;
             }
 
-            m_results_collector.push_back(&boost::get<KeyOutput>(out.target).key);
+            m_results_collector.push_back(boost::get<KeyOutput>(out.target).key);
 
             return true;
         }
 
-        std::vector<const Crypto::PublicKey *> &m_results_collector;
+        std::vector<Crypto::PublicKey> &m_results_collector;
         Blockchain &m_bch;
         LoggerRef logger;
     };
@@ -2523,8 +2841,7 @@ bool Blockchain::check_tx_input(
         return false;
     }
 
-    // check ring signature
-    std::vector<const Crypto::PublicKey *> output_keys;
+    output_keys.clear();
     outputs_visitor vi(output_keys, *this, logger.getLogger());
     if (!scanOutputKeysForIndexes(txin, vi, pmax_related_block_height)) {
         logger(INFO, BRIGHT_WHITE)
@@ -2549,21 +2866,65 @@ bool Blockchain::check_tx_input(
             << " mismatch with outputs keys count for inputs=" << output_keys.size();
         return false;
     }
-    if (isInCheckpointZone(getCurrentBlockchainHeight())) {
+
+    return true;
+}
+
+bool Blockchain::checkInputRingSignature(
+    const KeyInput &txin,
+    const Crypto::Hash &tx_prefix_hash,
+    const std::vector<Crypto::Signature> &sig,
+    const std::vector<Crypto::PublicKey> &output_keys)
+{
+    static Metrics::Counter &validMetric = ringSignatureMetric("valid");
+    static Metrics::Counter &invalidMetric = ringSignatureMetric("invalid");
+    static Metrics::Counter &cachedMetric = ringSignatureMetric("cached");
+
+    // the signature check is a pure function of these inputs, so a digest
+    // of them identifies a signature that has already been verified
+    std::vector<uint8_t> signedData;
+    signedData.reserve(
+        sizeof(Crypto::Hash) + sizeof(Crypto::KeyImage)
+        + output_keys.size() * sizeof(Crypto::PublicKey) + sig.size() * sizeof(Crypto::Signature)
+    );
+    auto append = [&signedData](const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        signedData.insert(signedData.end(), bytes, bytes + size);
+    };
+    append(&tx_prefix_hash, sizeof(tx_prefix_hash));
+    append(&txin.keyImage, sizeof(txin.keyImage));
+    append(output_keys.data(), output_keys.size() * sizeof(Crypto::PublicKey));
+    append(sig.data(), sig.size() * sizeof(Crypto::Signature));
+    Crypto::Hash digest = Crypto::cn_fast_hash(signedData.data(), signedData.size());
+
+    if (m_verifiedSignatures.contains(digest)) {
+        cachedMetric.add();
         return true;
     }
 
+    std::vector<const Crypto::PublicKey *> output_key_ptrs;
+    output_key_ptrs.reserve(output_keys.size());
+    for (const auto &key : output_keys) {
+        output_key_ptrs.push_back(&key);
+    }
+
     bool check_tx_ring_signature = Crypto::checkRingSignature(
         tx_prefix_hash,
         txin.keyImage,
-        output_keys,
+        output_key_ptrs,
         sig.data()
     );
     if (!check_tx_ring_signature) {
+        invalidMetric.add();
         logger(ERROR) << "Failed to check ring signature for keyImage: " << txin.keyImage;
+        return false;
     }
 
-    return check_tx_ring_signature;
+    validMetric.add();
+
+    m_verifiedSignatures.insert(digest);
+
+    return true;
 }
 
 uint64_t Blockchain::get_adjusted_time()
@@ -2689,6 +3050,67 @@ bool Blockchain::update_next_cumulative_size_limit()
     return true;
 }
 
+void Blockchain::pruneAlternativeChains()
+{
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+    uint32_t height = getCurrentBlockchainHeight();
+    uint32_t keepHeight = height > ALTERNATIVE_BLOCKS_KEEP_DEPTH
+                          ? height - ALTERNATIVE_BLOCKS_KEEP_DEPTH
+                          : 0;
+
+    // a deep block stays as long as a chain that can still grow is built on it
+    std::unordered_set<Crypto::Hash> keep;
+    for (const auto &alt : m_alternative_chains) {
+        if (alt.second.height < keepHeight) {
+            continue;
+        }
+
+        auto it = m_alternative_chains.find(alt.second.bl.previousBlockHash);
+        while (it != m_alternative_chains.end() && keep.insert(it->first).second) {
+            it = m_alternative_chains.find(it->second.bl.previousBlockHash);
+        }
+    }
+
+    for (auto it = m_alternative_chains.begin(); it != m_alternative_chains.end();) {
+        if (it->second.height < keepHeight && keep.count(it->first) == 0) {
+            m_orphanBlocksIndex.remove(it->second.bl);
+            it = m_alternative_chains.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // still too many, drop the chain heads with the least work first
+    while (m_alternative_chains.size() > ALTERNATIVE_BLOCKS_MAX_COUNT) {
+        std::unordered_set<Crypto::Hash> parents;
+        for (const auto &alt : m_alternative_chains) {
+            parents.insert(alt.second.bl.previousBlockHash);
+        }
+
+        std::vector<blocks_ext_by_hash::iterator> heads;
+        for (auto it = m_alternative_chains.begin(); it != m_alternative_chains.end(); ++it) {
+            if (parents.count(it->first) == 0) {
+                heads.push_back(it);
+            }
+        }
+
+        std::sort(
+            heads.begin(),
+            heads.end(),
+            [](const blocks_ext_by_hash::iterator &a, const blocks_ext_by_hash::iterator &b) {
+                return a->second.cumulative_difficulty < b->second.cumulative_difficulty;
+            }
+        );
+
+        size_t excess = m_alternative_chains.size() - ALTERNATIVE_BLOCKS_MAX_COUNT;
+        for (size_t i = 0; i < heads.size() && i < excess; ++i) {
+            m_orphanBlocksIndex.remove(heads[i]->second.bl);
+            m_alternative_chains.erase(heads[i]);
+        }
+    }
+}
+
 bool Blockchain::addNewBlock(const Block &bl, block_verification_context &bvc)
 {
     Crypto::Hash id;
@@ -2698,6 +3120,7 @@ bool Blockchain::addNewBlock(const Block &bl, block_verification_context &bvc)
         return false;
     }
 
+    Tracing::Span span("addNewBlock", id);
     bool add_result;
 
     { // to avoid deadlock lets lock tx_pool for whole add/reorganize process
@@ -2723,18 +3146,42 @@ bool Blockchain::addNewBlock(const Block &bl, block_verification_context &bvc)
         } else {
             add_result = pushBlock(bl, bvc);
             if (add_result) {
+                Tracing::Span messageSpan("sendMessage");
                 sendMessage(BlockchainMessage(NewBlockMessage(id)));
             }
         }
+
+        pruneAlternativeChains();
     }
 
     if (add_result && bvc.m_added_to_main_chain) {
+        Tracing::Span observersSpan("notifyObservers");
         m_observerManager.notify(&IBlockchainStorageObserver::blockchainUpdated);
     }
 
     return add_result;
 }
 
+bool Blockchain::importBlock(
+    const Block &block,
+    const std::vector<Transaction> &transactions,
+    block_verification_context &bvc)
+{
+    std::lock_guard<decltype(m_tx_pool)> poolLock(m_tx_pool);
+    std::lock_guard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+
+    if (block.transactionHashes.size() != transactions.size()) {
+        logger(ERROR, BRIGHT_RED)
+            << "Block " << getBlockHash(block) << " has " << block.transactionHashes.size()
+            << " transactions, got " << transactions.size();
+        bvc.m_verification_failed = true;
+        return false;
+    }
+
+    // pushBlock() rejects blocks that don't refer to the chain tail
+    return pushBlock(block, transactions, bvc);
+}
+
 const Blockchain::TransactionEntry &Blockchain::transactionByIndex(TransactionIndex index)
 {
     return m_blocks[index.block].transactions[index.transaction];
@@ -2766,6 +3213,7 @@ bool Blockchain::pushBlock(
     auto blockProcessingStart = std::chrono::steady_clock::now();
 
     Crypto::Hash blockHash = getBlockHash(blockData);
+    Tracing::Span span("pushBlock", blockHash);
 
     if (m_blockIndex.hasBlock(blockHash)) {
         logger(ERROR, BRIGHT_RED) << "Block " << blockHash << " already exists in blockchain.";
@@ -2805,10 +3253,12 @@ bool Blockchain::pushBlock(
         return false;
     }
 
+    PushBlockTimings timings;
     auto targetTimeStart = std::chrono::steady_clock::now();
     difficulty_type currentDifficulty = getDifficultyForNextBlock(blockData.timestamp);
+    timings.difficulty = elapsedSince(targetTimeStart);
     auto target_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - targetTimeStart
+        timings.difficulty
     ).count();
 
     if (!(currentDifficulty)) {
@@ -2818,25 +3268,29 @@ bool Blockchain::pushBlock(
 
     auto longhashTimeStart = std::chrono::steady_clock::now();
     Crypto::Hash proof_of_work = NULL_HASH;
-    if (m_checkpoints.is_in_checkpoint_zone(getCurrentBlockchainHeight())) {
-        if (!m_checkpoints.check_block(getCurrentBlockchainHeight(), blockHash)) {
-            logger(ERROR, BRIGHT_RED) << "CHECKPOINT VALIDATION FAILED";
-            bvc.m_verification_failed = true;
-            return false;
-        }
-    } else {
-        if (!m_currency.checkProofOfWork(m_cn_context,blockData,currentDifficulty,proof_of_work)) {
-            logger(INFO, BRIGHT_WHITE)
-                << "Block " << blockHash
-                << ", has too weak proof of work: " << proof_of_work
-                << ", expected difficulty: " << currentDifficulty;
-            bvc.m_verification_failed = true;
-            return false;
+    {
+        Tracing::Span proofOfWorkSpan("checkProofOfWork");
+        if (m_checkpoints.is_in_checkpoint_zone(getCurrentBlockchainHeight())) {
+            if (!m_checkpoints.check_block(getCurrentBlockchainHeight(), blockHash)) {
+                logger(ERROR, BRIGHT_RED) << "CHECKPOINT VALIDATION FAILED";
+                bvc.m_verification_failed = true;
+                return false;
+            }
+        } else {
+            if (!m_currency.checkProofOfWork(m_cn_context,blockData,currentDifficulty,proof_of_work)) {
+                logger(INFO, BRIGHT_WHITE)
+                    << "Block " << blockHash
+                    << ", has too weak proof of work: " << proof_of_work
+                    << ", expected difficulty: " << currentDifficulty;
+                bvc.m_verification_failed = true;
+                return false;
+            }
         }
     }
 
+    timings.proofOfWork = elapsedSince(longhashTimeStart);
     auto longhash_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - longhashTimeStart
+        timings.proofOfWork
     ).count();
 
     if (!prevalidate_miner_transaction(blockData, static_cast<uint32_t>(m_blocks.size()))) {
@@ -2858,7 +3312,9 @@ bool Blockchain::pushBlock(
         static_cast<uint32_t>(m_blocks.size()),
         static_cast<uint16_t>(0)
     };
+    auto indicesTimeStart = std::chrono::steady_clock::now();
     pushTransaction(block, minerTransactionHash, transactionIndex);
+    timings.indices += elapsedSince(indicesTimeStart);
 
     size_t coinbase_blob_size = getObjectBinarySize(blockData.baseTransaction);
     size_t cumulative_block_size = coinbase_blob_size;
@@ -2873,7 +3329,10 @@ bool Blockchain::pushBlock(
         blob_size = toBinaryArray(block.transactions.back().tx).size();
         fee = getInputAmount(block.transactions.back().tx)
               - getOutputAmount(block.transactions.back().tx);
-        if (!checkTransactionInputs(block.transactions.back().tx)) {
+        auto inputsTimeStart = std::chrono::steady_clock::now();
+        bool inputsValid = checkTransactionInputs(block.transactions.back().tx);
+        timings.transactionInputs += elapsedSince(inputsTimeStart);
+        if (!inputsValid) {
             logger(INFO, BRIGHT_WHITE)
                 << "Block " << blockHash
                 << " has at least one transaction with wrong inputs: " << tx_id;
@@ -2886,7 +3345,9 @@ bool Blockchain::pushBlock(
         }
 
         ++transactionIndex.transaction;
+        indicesTimeStart = std::chrono::steady_clock::now();
         pushTransaction(block, tx_id, transactionIndex);
+        timings.indices += elapsedSince(indicesTimeStart);
 
         cumulative_block_size += blob_size;
         fee_summary += fee;
@@ -2925,8 +3386,27 @@ bool Blockchain::pushBlock(
 
     pushBlock(block);
 
+    timings.total = elapsedSince(blockProcessingStart);
+    m_pushBlockTimings.transactions += transactions.size();
+    m_pushBlockTimings.total += timings.total;
+    m_pushBlockTimings.difficulty += timings.difficulty;
+    m_pushBlockTimings.proofOfWork += timings.proofOfWork;
+    m_pushBlockTimings.transactionInputs += timings.transactionInputs;
+    m_pushBlockTimings.indices += timings.indices;
+
+    static Metrics::Histogram &totalMetric = blockStageMetric("total");
+    static Metrics::Histogram &difficultyMetric = blockStageMetric("difficulty");
+    static Metrics::Histogram &proofOfWorkMetric = blockStageMetric("proof_of_work");
+    static Metrics::Histogram &inputsMetric = blockStageMetric("transaction_inputs");
+    static Metrics::Histogram &indicesMetric = blockStageMetric("transaction_indices");
+    totalMetric.record(timings.total);
+    difficultyMetric.record(timings.difficulty);
+    proofOfWorkMetric.record(timings.proofOfWork);
+    inputsMetric.record(timings.transactionInputs);
+    indicesMetric.record(timings.indices);
+
     auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - blockProcessingStart
+        timings.total
     ).count();
 
     logger(DEBUGGING)
@@ -2958,32 +3438,45 @@ bool Blockchain::pushBlock(
 
 bool Blockchain::pushBlock(BlockEntry &block)
 {
+    static Metrics::Histogram &storageMetric = blockStageMetric("block_storage");
+    static Metrics::Histogram &indicesMetric = blockStageMetric("block_indices");
+
     Crypto::Hash blockHash = getBlockHash(block.bl);
 
-    m_blocks.push_back(block);
-    m_blockIndex.push(blockHash);
+    auto storageTimeStart = std::chrono::steady_clock::now();
+    {
+        Tracing::Span span("storeBlock");
+        m_blocks.push_back(block);
+        pushCompactBlock(block, blockHash);
+    }
+    auto storageTime = elapsedSince(storageTimeStart);
+    m_pushBlockTimings.storage += storageTime;
+    storageMetric.record(storageTime);
 
-    m_timestampIndex.add(block.bl.timestamp, blockHash);
-    m_generatedTransactionsIndex.add(block.bl);
+    auto indicesTimeStart = std::chrono::steady_clock::now();
+    {
+        Tracing::Span span("indexBlock");
+        m_blockIndex.push(blockHash);
+        m_timestampIndex.add(block.bl.timestamp, blockHash);
+        m_generatedTransactionsIndex.add(block.bl);
+    }
+    auto indicesTime = elapsedSince(indicesTimeStart);
+    m_pushBlockTimings.indices += indicesTime;
+    indicesMetric.record(indicesTime);
+    ++m_pushBlockTimings.blocks;
 
     assert(m_blockIndex.size() == m_blocks.size());
 
     return true;
 }
 
-void Blockchain::popBlock()
+void Blockchain::disconnectLastBlock()
 {
     if (m_blocks.empty()) {
         logger(ERROR, BRIGHT_RED) << "Attempt to pop block from empty blockchain.";
         return;
     }
 
-    std::vector<Transaction> transactions(m_blocks.back().transactions.size() - 1);
-    for (size_t i = 0; i < m_blocks.back().transactions.size() - 1; ++i) {
-        transactions[i] = m_blocks.back().transactions[1 + i].tx;
-    }
-
-    saveTransactions(transactions);
     removeLastBlock();
 
     m_upgradeDetectorV2.blockPopped();
@@ -2993,11 +3486,34 @@ void Blockchain::popBlock()
     m_upgradeDetectorV6.blockPopped();
 }
 
+void Blockchain::reconnectBlock(BlockEntry &block)
+{
+    assert(block.height == m_blocks.size());
+
+    TransactionIndex transactionIndex = { block.height, 0 };
+    pushTransaction(block, getObjectHash(block.bl.baseTransaction), transactionIndex);
+    for (size_t i = 1; i < block.transactions.size(); ++i) {
+        transactionIndex.transaction = static_cast<uint16_t>(i);
+        pushTransaction(block, block.bl.transactionHashes[i - 1], transactionIndex);
+    }
+
+    pushBlock(block);
+
+    m_upgradeDetectorV2.blockPushed();
+    m_upgradeDetectorV3.blockPushed();
+    m_upgradeDetectorV4.blockPushed();
+    m_upgradeDetectorV5.blockPushed();
+    m_upgradeDetectorV6.blockPushed();
+
+    update_next_cumulative_size_limit();
+}
+
 bool Blockchain::pushTransaction(
     BlockEntry &block,
     const Crypto::Hash &transactionHash,
     TransactionIndex transactionIndex)
 {
+    Tracing::Span span("pushTransaction", transactionHash);
     auto result = m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
     if (!result.second) {
         logger(ERROR, BRIGHT_RED) << "Duplicate transaction was pushed to blockchain.";
@@ -3293,6 +3809,7 @@ void Blockchain::removeLastBlock()
 
     m_blocks.pop_back();
     m_blockIndex.pop();
+    m_compactBlocks.pop_back();
 
     assert(m_blockIndex.size() == m_blocks.size());
 }
@@ -3517,6 +4034,7 @@ bool Blockchain::getTransactionIdsByPaymentId(
 
 bool Blockchain::loadTransactions(const Block &block, std::vector<Transaction> &transactions)
 {
+    Tracing::Span span("loadTransactions");
     transactions.resize(block.transactionHashes.size());
     size_t transactionSize;
     uint64_t fee;
@@ -3576,4 +4094,10 @@ bool Blockchain::isInCheckpointZone(const uint32_t height)
     return m_checkpoints.is_in_checkpoint_zone(height);
 }
 
+Blockchain::PushBlockTimings Blockchain::getPushBlockTimings()
+{
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    return m_pushBlockTimings;
+}
+
 } // namespace CryptoNote
@@ -21,14 +21,18 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <unordered_set>
 #include <google/sparse_hash_set>
 #include <google/sparse_hash_map>
+#include <Common/Metrics.h>
 #include <Common/ObserverManager.h>
 #include <Common/Util.h>
 #include <CryptoNoteCore/BlockchainIndices.h>
 #include <CryptoNoteCore/BlockchainMessages.h>
 #include <CryptoNoteCore/BlockIndex.h>
 #include <CryptoNoteCore/Checkpoints.h>
+#include <CryptoNoteCore/CompactBlock.h>
 #include <CryptoNoteCore/CryptoNoteFormatUtils.h>
 #include <CryptoNoteCore/Currency.h>
 #include <CryptoNoteCore/IBlockchainStorageObserver.h>
@@ -36,6 +40,7 @@
 #include <CryptoNoteCore/IntrusiveLinkedList.h>
 #include <CryptoNoteCore/ITransactionValidator.h>
 #include <CryptoNoteCore/MessageQueue.h>
+#include <CryptoNoteCore/SignatureCache.h>
 #include <CryptoNoteCore/SwappedVector.h>
 #include <CryptoNoteCore/TransactionPool.h>
 #include <CryptoNoteCore/UpgradeDetector.h>
@@ -69,6 +74,10 @@ public:
     // ITransactionValidator
     bool checkTransactionInputs(const Transaction &tx, BlockInfo &maxUsedBlock) override;
     bool checkTransactionInputs(const Transaction &tx, BlockInfo &maxUsedBlock, BlockInfo &lastFailed) override;
+    bool resolveTransactionInputs(const Transaction &tx, ResolvedTransactionInputs &inputs) override;
+    bool checkTransactionSignatures(
+        const Transaction &tx,
+        const ResolvedTransactionInputs &inputs) override;
     bool haveSpentKeyImages(const Transaction &tx) override;
     bool checkTransactionSize(size_t blobSize) override;
 
@@ -82,6 +91,12 @@ public:
     void setCheckpoints(Checkpoints &&chk_pts) { m_checkpoints = chk_pts; }
     bool getBlocks(uint32_t start_offset, uint32_t count, std::list<Block> &blocks, std::list<Transaction> &txs);
     bool getBlocks(uint32_t start_offset, uint32_t count, std::list<Block> &blocks);
+    // writes blocks older than timestamp as hashes only, see CompactBlock.h
+    void getCompactBlocks(
+        uint32_t start_offset,
+        uint32_t count,
+        uint64_t timestamp,
+        CompactBlocksWriter &writer);
     bool getTransactionsWithOutputGlobalIndexes(const std::vector<Crypto::Hash> &txsIds,
 							  					std::list<Crypto::Hash> &missedTxs,
 							  					std::vector<std::pair<Transaction,
@@ -109,6 +124,13 @@ public:
     uint64_t getCoinsInCirculation();
     uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
     bool addNewBlock(const Block &bl, block_verification_context &bvc);
+    // Pushes a block on top of the main chain with its transactions given directly instead of
+    // taken from the pool. Observers and message queues aren't notified, it is meant for bulk
+    // imports (see core::importBlockchain) which notify once they're done.
+    bool importBlock(
+        const Block &block,
+        const std::vector<Transaction> &transactions,
+        block_verification_context &bvc);
     bool resetAndSetGenesisBlock(const Block &b);
     bool haveBlock(const Crypto::Hash &id);
     size_t getTotalTransactions();
@@ -168,6 +190,25 @@ public:
     bool isInCheckpointZone(const uint32_t height);
     uint64_t getAvgDifficultyForHeight(uint32_t height, size_t window);
 
+    // Time spent in the stages of pushing blocks to the main chain, summed up since the start.
+    // The stages don't cover all of total, the rest goes to the smaller checks in between.
+    struct PushBlockTimings
+    {
+        uint64_t blocks = 0;
+        uint64_t transactions = 0;
+        std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+        std::chrono::nanoseconds difficulty = std::chrono::nanoseconds::zero();
+        std::chrono::nanoseconds proofOfWork = std::chrono::nanoseconds::zero();
+        // key images, ring members and signatures of the inputs
+        std::chrono::nanoseconds transactionInputs = std::chrono::nanoseconds::zero();
+        // transaction, key image, output and block indices
+        std::chrono::nanoseconds indices = std::chrono::nanoseconds::zero();
+        // appending to the block and compact block files
+        std::chrono::nanoseconds storage = std::chrono::nanoseconds::zero();
+    };
+
+    PushBlockTimings getPushBlockTimings();
+
     template<class visitor_t>
     bool scanOutputKeysForIndexes(
         const KeyInput &tx_in_to_key,
@@ -180,7 +221,7 @@ public:
     template<class T, class D, class S>
     bool getBlocks(const T &block_ids, D &blocks, S &missed_bs)
     {
-        std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+        std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
         for (const auto &bl_id : block_ids) {
             try {
@@ -303,6 +344,20 @@ private:
         std::vector<TransactionEntry> transactions;
     };
 
+    struct CompactBlockEntry
+    {
+        void serialize(ISerializer &s)
+        {
+            s(hash, "hash");
+            s(timestamp, "timestamp");
+            s(transactions, "transactions");
+        }
+
+        Crypto::Hash hash;
+        uint64_t timestamp;
+        std::string transactions;
+    };
+
     typedef google::sparse_hash_set<Crypto::KeyImage> key_images_container;
     typedef std::unordered_map<Crypto::Hash, BlockEntry> blocks_ext_by_hash;
     // crypto::Hash - tx hash, size_t - index of out in transaction
@@ -311,8 +366,11 @@ private:
 
     const Currency &m_currency;
     tx_memory_pool &m_tx_pool;
-    std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    Metrics::TimedMutex<std::recursive_mutex> m_blockchain_lock; // TODO: add here reader/writer lock
     Crypto::cn_context m_cn_context;
+    // digests of ring signatures known to be valid, so that reorgs and pool
+    // admissions don't verify the same signature against the same ring twice
+    SignatureCache m_verifiedSignatures;
     Tools::ObserverManager<IBlockchainStorageObserver> m_observerManager;
 
     key_images_container m_spent_keys;
@@ -332,6 +390,8 @@ private:
     friend class BlockchainIndicesSerializer;
 
     Blocks m_blocks;
+    // wallet scanning data of m_blocks, one entry per block
+    SwappedVector<CompactBlockEntry> m_compactBlocks;
     CryptoNote::BlockIndex m_blockIndex;
     TransactionMap m_transactionMap;
     MultisignatureOutputsContainer m_multisignatureOutputs;
@@ -346,12 +406,15 @@ private:
     GeneratedTransactionsIndex m_generatedTransactionsIndex;
     OrphanBlocksIndex m_orphanBlocksIndex;
     bool m_blockchainIndexesEnabled;
+    PushBlockTimings m_pushBlockTimings;
 
     IntrusiveLinkedList<MessageQueue<BlockchainMessage>> m_messageQueueList;
 
     Logging::LoggerRef logger;
 
     void rebuildCache();
+    void rebuildCompactBlocks();
+    void pushCompactBlock(const BlockEntry &block, const Crypto::Hash &blockHash);
     bool storeCache();
     bool switch_to_alternative_blockchain(
         std::list<blocks_ext_by_hash::iterator> &alt_chain,
@@ -372,7 +435,15 @@ private:
         uint64_t fee,
         uint64_t &reward,
         int64_t &emissionChange);
-    bool rollback_blockchain_switching(std::list<Block> &original_chain, size_t rollback_height);
+    bool rollback_blockchain_switching(
+        std::list<BlockEntry> &original_chain,
+        const std::unordered_set<Crypto::Hash> &original_transactions,
+        size_t rollback_height);
+    bool takeBlockTransactions(
+        const Block &block,
+        std::unordered_map<Crypto::Hash, Transaction> &detachedTransactions,
+        std::vector<Transaction> &transactions);
+    void pruneAlternativeChains();
     bool get_last_n_blocks_sizes(std::vector<size_t> &sz, size_t count);
     bool add_out_to_get_random_outs(
         std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs,
@@ -401,6 +472,16 @@ private:
         const Crypto::Hash &tx_prefix_hash,
         const std::vector<Crypto::Signature> &sig,
         uint32_t *pmax_related_block_height = nullptr);
+    bool getInputRingKeys(
+        const KeyInput &txin,
+        const std::vector<Crypto::Signature> &sig,
+        std::vector<Crypto::PublicKey> &output_keys,
+        uint32_t *pmax_related_block_height = nullptr);
+    bool checkInputRingSignature(
+        const KeyInput &txin,
+        const Crypto::Hash &tx_prefix_hash,
+        const std::vector<Crypto::Signature> &sig,
+        const std::vector<Crypto::PublicKey> &output_keys);
     bool checkTransactionInputs(
         const Transaction &tx,
         const Crypto::Hash &tx_prefix_hash,
@@ -413,7 +494,8 @@ private:
         const std::vector<Transaction> &transactions,
         block_verification_context &bvc);
     bool pushBlock(BlockEntry &block);
-    void popBlock();
+    void disconnectLastBlock();
+    void reconnectBlock(BlockEntry &block);
     bool pushTransaction(
         BlockEntry &block,
         const Crypto::Hash &transactionHash,
@@ -456,7 +538,7 @@ public:
 
 private:
     Blockchain &m_bc;
-    std::lock_guard<std::recursive_mutex> m_lock;
+    std::lock_guard<decltype(Blockchain::m_blockchain_lock)> m_lock;
 };
 
 template<class visitor_t>
@@ -465,7 +547,7 @@ bool Blockchain::scanOutputKeysForIndexes(
     visitor_t &vis,
     uint32_t *pmax_related_block_height)
 {
-    std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     auto it = m_outputs.find(tx_in_to_key.amount);
     if (it == m_outputs.end() || tx_in_to_key.outputIndexes.empty()) {
         return false;
@@ -0,0 +1,155 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/crc.hpp>
+#include <Common/MemoryInputStream.h>
+#include <Common/StreamTools.h>
+#include <Common/VectorOutputStream.h>
+#include <CryptoNoteCore/BlockchainBootstrap.h>
+
+namespace CryptoNote {
+
+namespace {
+
+const char BOOTSTRAP_MAGIC[8] = { 'S', 'O', 'C', 'I', 'B', 'O', 'O', 'T' };
+const uint32_t BOOTSTRAP_FORMAT_VERSION = 1;
+const uint32_t MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+uint32_t checksum(const BinaryArray &data)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+
+    return crc.checksum();
+}
+
+BinaryArray readBlob(Common::IInputStream &stream, size_t maxSize)
+{
+    auto size = Common::readVarint<uint64_t>(stream);
+    if (size > maxSize) {
+        throw std::runtime_error("invalid blob size");
+    }
+
+    return Common::read<BinaryArray>(stream, static_cast<size_t>(size));
+}
+
+} // namespace
+
+BlockchainBootstrapWriter::BlockchainBootstrapWriter(std::ostream &stream)
+    : m_stream(stream)
+{
+    Common::write(m_stream, BOOTSTRAP_MAGIC, sizeof(BOOTSTRAP_MAGIC));
+    Common::write(m_stream, BOOTSTRAP_FORMAT_VERSION);
+}
+
+void BlockchainBootstrapWriter::write(const RawBlock &block)
+{
+    m_payload.clear();
+    Common::VectorOutputStream payloadStream(m_payload);
+    Common::writeVarint(payloadStream, block.block.size());
+    Common::write(payloadStream, block.block);
+    Common::writeVarint(payloadStream, block.transactions.size());
+    for (const auto &transaction : block.transactions) {
+        Common::writeVarint(payloadStream, transaction.size());
+        Common::write(payloadStream, transaction);
+    }
+
+    if (m_payload.size() > MAX_RECORD_SIZE) {
+        throw std::runtime_error("Block record is too big");
+    }
+
+    Common::write(m_stream, static_cast<uint32_t>(m_payload.size()));
+    Common::write(m_stream, m_payload);
+    Common::write(m_stream, checksum(m_payload));
+}
+
+BlockchainBootstrapReader::BlockchainBootstrapReader(std::istream &stream)
+    : m_in(stream),
+      m_stream(stream)
+{
+    char magic[sizeof(BOOTSTRAP_MAGIC)];
+    uint32_t version = 0;
+    try {
+        Common::read(m_stream, magic, sizeof(magic));
+        Common::read(m_stream, version);
+    } catch (std::exception &) {
+        throw std::runtime_error("Not a blockchain bootstrap file");
+    }
+
+    if (!std::equal(std::begin(magic), std::end(magic), std::begin(BOOTSTRAP_MAGIC))) {
+        throw std::runtime_error("Not a blockchain bootstrap file");
+    }
+
+    if (version != BOOTSTRAP_FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported blockchain bootstrap file version "
+                                 + std::to_string(version));
+    }
+}
+
+bool BlockchainBootstrapReader::read(RawBlock &block)
+{
+    if (m_in.peek() == std::istream::traits_type::eof()) {
+        return false;
+    }
+
+    uint32_t payloadSize = 0;
+    uint32_t payloadChecksum = 0;
+    try {
+        Common::read(m_stream, payloadSize);
+        if (payloadSize > MAX_RECORD_SIZE) {
+            throw std::runtime_error("Block record is too big");
+        }
+
+        Common::read(m_stream, m_payload, payloadSize);
+        Common::read(m_stream, payloadChecksum);
+    } catch (std::exception &e) {
+        throw std::runtime_error(std::string("Truncated block record: ") + e.what());
+    }
+
+    if (checksum(m_payload) != payloadChecksum) {
+        throw std::runtime_error("Block record checksum mismatch");
+    }
+
+    Common::MemoryInputStream payloadStream(m_payload.data(), m_payload.size());
+    try {
+        block.block = readBlob(payloadStream, m_payload.size());
+
+        auto transactionCount = Common::readVarint<uint64_t>(payloadStream);
+        if (transactionCount > m_payload.size()) {
+            throw std::runtime_error("invalid transaction count");
+        }
+
+        block.transactions.resize(static_cast<size_t>(transactionCount));
+        for (auto &transaction : block.transactions) {
+            transaction = readBlob(payloadStream, m_payload.size());
+        }
+    } catch (std::exception &e) {
+        throw std::runtime_error(std::string("Malformed block record: ") + e.what());
+    }
+
+    if (!payloadStream.endOfStream()) {
+        throw std::runtime_error("Malformed block record: trailing data");
+    }
+
+    return true;
+}
+
+} // namespace CryptoNote
@@ -0,0 +1,75 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <Common/StdInputStream.h>
+#include <Common/StdOutputStream.h>
+#include <CryptoNoteCore/CryptoNoteBasic.h>
+
+namespace CryptoNote {
+
+struct RawBlock
+{
+    BinaryArray block;
+    std::vector<BinaryArray> transactions;
+};
+
+/*
+ * Bootstrap files hold the main chain as raw block and transaction blobs, so that nodes can be
+ * provisioned from disk instead of syncing over P2P. The file starts with a magic and a format
+ * version, followed by one record per block:
+ *
+ *   uint32 payload size, payload, uint32 CRC-32 of the payload
+ *
+ * The payload is the block blob and the transaction blobs of the block, each preceded by its
+ * varint size, the transactions also by their varint count.
+ */
+class BlockchainBootstrapWriter
+{
+public:
+    explicit BlockchainBootstrapWriter(std::ostream &stream);
+
+    void write(const RawBlock &block);
+
+private:
+    Common::StdOutputStream m_stream;
+    BinaryArray m_payload;
+};
+
+class BlockchainBootstrapReader
+{
+public:
+    // throws std::runtime_error if the stream doesn't start with a bootstrap file header
+    explicit BlockchainBootstrapReader(std::istream &stream);
+
+    // returns false at the end of the stream, throws std::runtime_error on a damaged record
+    bool read(RawBlock &block);
+
+private:
+    std::istream &m_in;
+    Common::StdInputStream m_stream;
+    BinaryArray m_payload;
+};
+
+} // namespace CryptoNote
@@ -45,11 +45,19 @@ bool PaymentIdIndex::add(const Transaction &transaction)
     }
 
     Crypto::Hash paymentId;
-    Crypto::Hash transactionHash = getObjectHash(transaction);
     if (!BlockchainExplorerDataBuilder::getPaymentId(transaction, paymentId)) {
         return false;
     }
 
+    return add(paymentId, getObjectHash(transaction));
+}
+
+bool PaymentIdIndex::add(const Crypto::Hash &paymentId, const Crypto::Hash &transactionHash)
+{
+    if (!enabled) {
+        return false;
+    }
+
     index.insert(std::make_pair(paymentId, transactionHash));
 
     return true;
@@ -62,11 +70,19 @@ bool PaymentIdIndex::remove(const Transaction &transaction)
     }
 
     Crypto::Hash paymentId;
-    Crypto::Hash transactionHash = getObjectHash(transaction);
     if (!BlockchainExplorerDataBuilder::getPaymentId(transaction, paymentId)) {
         return false;
     }
 
+    return remove(paymentId, getObjectHash(transaction));
+}
+
+bool PaymentIdIndex::remove(const Crypto::Hash &paymentId, const Crypto::Hash &transactionHash)
+{
+    if (!enabled) {
+        return false;
+    }
+
     auto range = index.equal_range(paymentId);
     for (auto iter = range.first; iter != range.second; ++iter) {
         if (iter->second == transactionHash) {
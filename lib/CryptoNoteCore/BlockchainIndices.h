@@ -42,7 +42,9 @@ public:
     explicit PaymentIdIndex(bool enabled);
 
     bool add(const Transaction &transaction);
+    bool add(const Crypto::Hash &paymentId, const Crypto::Hash &transactionHash);
     bool remove(const Transaction &transaction);
+    bool remove(const Crypto::Hash &paymentId, const Crypto::Hash &transactionHash);
     bool find(const Crypto::Hash &paymentId, std::vector<Crypto::Hash> &transactionHashes);
     std::vector<Crypto::Hash> find(const Crypto::Hash &paymentId);
     void clear();
@@ -0,0 +1,264 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+#include <Common/StreamTools.h>
+#include <Common/StringOutputStream.h>
+#include <CryptoNoteCore/CompactBlock.h>
+
+namespace CryptoNote {
+
+namespace {
+
+const uint8_t ENTRY_HASH = 0;
+const uint8_t ENTRY_BLOCK = 1;
+
+const uint8_t INPUT_BASE = 0;
+const uint8_t INPUT_KEY = 1;
+const uint8_t INPUT_MULTISIGNATURE = 2;
+
+const uint8_t OUTPUT_KEY = 0;
+const uint8_t OUTPUT_MULTISIGNATURE = 1;
+
+uint64_t zigzagEncode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void writeTransaction(
+    Common::IOutputStream &out,
+    const Crypto::Hash &hash,
+    const TransactionPrefix &transaction)
+{
+    Common::write(out, &hash, sizeof(hash));
+    Common::writeVarint(out, transaction.version);
+    Common::writeVarint(out, transaction.unlockTime);
+
+    Common::writeVarint(out, transaction.inputs.size());
+    for (const auto &input : transaction.inputs) {
+        if (input.type() == typeid(BaseInput)) {
+            Common::write(out, INPUT_BASE);
+            Common::writeVarint(out, boost::get<BaseInput>(input).blockIndex);
+        } else if (input.type() == typeid(KeyInput)) {
+            const auto &keyInput = boost::get<KeyInput>(input);
+            Common::write(out, INPUT_KEY);
+            Common::writeVarint(out, keyInput.amount);
+            Common::write(out, &keyInput.keyImage, sizeof(keyInput.keyImage));
+        } else {
+            const auto &multisignatureInput = boost::get<MultiSignatureInput>(input);
+            Common::write(out, INPUT_MULTISIGNATURE);
+            Common::writeVarint(out, multisignatureInput.amount);
+            Common::writeVarint(out, multisignatureInput.signatureCount);
+            Common::writeVarint(out, multisignatureInput.outputIndex);
+        }
+    }
+
+    Common::writeVarint(out, transaction.outputs.size());
+    for (const auto &output : transaction.outputs) {
+        if (output.target.type() == typeid(KeyOutput)) {
+            const auto &key = boost::get<KeyOutput>(output.target).key;
+            Common::write(out, OUTPUT_KEY);
+            Common::writeVarint(out, output.amount);
+            Common::write(out, &key, sizeof(key));
+        } else {
+            const auto &target = boost::get<MultiSignatureOutput>(output.target);
+            Common::write(out, OUTPUT_MULTISIGNATURE);
+            Common::writeVarint(out, output.amount);
+            Common::writeVarint(out, target.keys.size());
+            for (const auto &key : target.keys) {
+                Common::write(out, &key, sizeof(key));
+            }
+
+            Common::writeVarint(out, target.requiredSignatureCount);
+        }
+    }
+
+    Common::writeVarint(out, transaction.extra.size());
+    Common::write(out, transaction.extra);
+}
+
+size_t readCount(Common::MemoryInputStream &in, size_t limit)
+{
+    auto count = Common::readVarint<uint64_t>(in);
+    if (count > limit) {
+        throw std::runtime_error("Invalid compact block element count");
+    }
+
+    return static_cast<size_t>(count);
+}
+
+void readTransaction(Common::MemoryInputStream &in, size_t size, CompactTransaction &transaction)
+{
+    TransactionPrefix &prefix = transaction.prefix;
+    Common::read(in, &transaction.hash, sizeof(transaction.hash));
+    Common::readVarint(in, prefix.version);
+    Common::readVarint(in, prefix.unlockTime);
+
+    prefix.inputs.resize(readCount(in, size - in.getPosition()));
+    for (auto &input : prefix.inputs) {
+        switch (Common::read<uint8_t>(in)) {
+        case INPUT_BASE: {
+            BaseInput baseInput;
+            Common::readVarint(in, baseInput.blockIndex);
+            input = baseInput;
+            break;
+        }
+        case INPUT_KEY: {
+            KeyInput keyInput;
+            Common::readVarint(in, keyInput.amount);
+            Common::read(in, &keyInput.keyImage, sizeof(keyInput.keyImage));
+            input = std::move(keyInput);
+            break;
+        }
+        case INPUT_MULTISIGNATURE: {
+            MultiSignatureInput multisignatureInput;
+            Common::readVarint(in, multisignatureInput.amount);
+            Common::readVarint(in, multisignatureInput.signatureCount);
+            Common::readVarint(in, multisignatureInput.outputIndex);
+            input = multisignatureInput;
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown compact transaction input type");
+        }
+    }
+
+    prefix.outputs.resize(readCount(in, size - in.getPosition()));
+    for (auto &output : prefix.outputs) {
+        switch (Common::read<uint8_t>(in)) {
+        case OUTPUT_KEY: {
+            KeyOutput target;
+            Common::readVarint(in, output.amount);
+            Common::read(in, &target.key, sizeof(target.key));
+            output.target = target;
+            break;
+        }
+        case OUTPUT_MULTISIGNATURE: {
+            MultiSignatureOutput target;
+            Common::readVarint(in, output.amount);
+            target.keys.resize(readCount(in, size - in.getPosition()));
+            for (auto &key : target.keys) {
+                Common::read(in, &key, sizeof(key));
+            }
+
+            Common::readVarint(in, target.requiredSignatureCount);
+            output.target = std::move(target);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown compact transaction output type");
+        }
+    }
+
+    Common::read(in, prefix.extra, readCount(in, size - in.getPosition()));
+}
+
+} // namespace
+
+CompactTransactionsWriter::CompactTransactionsWriter(std::string &out, size_t transactionCount)
+    : m_out(out)
+{
+    Common::StringOutputStream stream(m_out);
+    Common::writeVarint(stream, transactionCount);
+}
+
+void CompactTransactionsWriter::write(
+    const Crypto::Hash &hash,
+    const TransactionPrefix &transaction)
+{
+    Common::StringOutputStream stream(m_out);
+    writeTransaction(stream, hash, transaction);
+}
+
+CompactBlocksWriter::CompactBlocksWriter(std::string &out)
+    : m_out(out),
+      m_lastTimestamp(0)
+{
+}
+
+void CompactBlocksWriter::writeHash(const Crypto::Hash &hash)
+{
+    Common::StringOutputStream out(m_out);
+    Common::write(out, ENTRY_HASH);
+    Common::write(out, &hash, sizeof(hash));
+}
+
+void CompactBlocksWriter::write(
+    const Crypto::Hash &hash,
+    uint64_t timestamp,
+    const std::string &transactions)
+{
+    Common::StringOutputStream out(m_out);
+    Common::write(out, ENTRY_BLOCK);
+    Common::write(out, &hash, sizeof(hash));
+    Common::writeVarint(out, zigzagEncode(static_cast<int64_t>(timestamp - m_lastTimestamp)));
+    m_out.append(transactions);
+
+    m_lastTimestamp = timestamp;
+}
+
+CompactBlocksReader::CompactBlocksReader(const std::string &in)
+    : m_stream(in.data(), in.size()),
+      m_size(in.size()),
+      m_lastTimestamp(0)
+{
+}
+
+bool CompactBlocksReader::read(CompactBlock &block)
+{
+    if (m_stream.endOfStream()) {
+        return false;
+    }
+
+    try {
+        uint8_t entryType = Common::read<uint8_t>(m_stream);
+        if (entryType != ENTRY_HASH && entryType != ENTRY_BLOCK) {
+            throw std::runtime_error("Unknown compact block entry type");
+        }
+
+        Common::read(m_stream, &block.hash, sizeof(block.hash));
+        block.hasTransactions = entryType == ENTRY_BLOCK;
+        block.timestamp = 0;
+        block.transactions.clear();
+        if (!block.hasTransactions) {
+            return true;
+        }
+
+        m_lastTimestamp += zigzagDecode(Common::readVarint<uint64_t>(m_stream));
+        block.timestamp = m_lastTimestamp;
+
+        block.transactions.resize(readCount(m_stream, m_size - m_stream.getPosition()));
+        for (auto &transaction : block.transactions) {
+            readTransaction(m_stream, m_size, transaction);
+        }
+    } catch (std::runtime_error &) {
+        throw;
+    } catch (std::exception &e) {
+        throw std::runtime_error(std::string("Truncated compact block: ") + e.what());
+    }
+
+    return true;
+}
+
+} // namespace CryptoNote
@@ -0,0 +1,94 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Common/MemoryInputStream.h>
+#include <CryptoNoteCore/CryptoNoteBasic.h>
+
+namespace CryptoNote {
+
+struct CompactTransaction
+{
+    Crypto::Hash hash;
+    // key inputs carry no ring members, everything else is as in the transaction
+    TransactionPrefix prefix;
+};
+
+struct CompactBlock
+{
+    Crypto::Hash hash;
+    bool hasTransactions;
+    uint64_t timestamp;
+    // the first transaction is the coinbase
+    std::vector<CompactTransaction> transactions;
+};
+
+/*
+ * Compact blocks carry only what a wallet needs to scan the chain: the block hash and timestamp,
+ * and per transaction its hash, unlock time, extra, input key images and amounts and its outputs.
+ * Block headers, ring members and signatures are left out. Integers are varints and timestamps
+ * are stored as zigzag encoded deltas to the previous block of the stream.
+ *
+ * The transactions of a block are encoded once, when the block joins the chain, and copied into
+ * responses as they are.
+ */
+class CompactTransactionsWriter
+{
+public:
+    CompactTransactionsWriter(std::string &out, size_t transactionCount);
+
+    void write(const Crypto::Hash &hash, const TransactionPrefix &transaction);
+
+private:
+    std::string &m_out;
+};
+
+class CompactBlocksWriter
+{
+public:
+    explicit CompactBlocksWriter(std::string &out);
+
+    // a block the wallet only needs the hash of, it is older than the wallet
+    void writeHash(const Crypto::Hash &hash);
+    void write(const Crypto::Hash &hash, uint64_t timestamp, const std::string &transactions);
+
+private:
+    std::string &m_out;
+    uint64_t m_lastTimestamp;
+};
+
+class CompactBlocksReader
+{
+public:
+    explicit CompactBlocksReader(const std::string &in);
+
+    // returns false at the end of the stream, throws std::runtime_error on malformed data
+    bool read(CompactBlock &block);
+
+private:
+    Common::MemoryInputStream m_stream;
+    size_t m_size;
+    uint64_t m_lastTimestamp;
+};
+
+} // namespace CryptoNote
@@ -18,12 +18,19 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 #include <boost/utility/value_init.hpp>
 #include <boost/range/combine.hpp>
 #include <Common/CommandLine.h>
 #include <Common/Math.h>
+#include <Common/Metrics.h>
 #include <Common/StringTools.h>
 #include <Common/Util.h>
 #include <crypto/Crypto.h>
@@ -48,6 +55,13 @@ using namespace Societatis;
 
 namespace CryptoNote {
 
+namespace {
+
+const uint32_t BOOTSTRAP_BATCH_SIZE = 256;
+const uint32_t BOOTSTRAP_PROGRESS_INTERVAL = 40;
+
+} // namespace
+
 class BlockWithTransactions : public IBlock
 {
 public:
@@ -84,8 +98,10 @@ core::core(
       m_mempool(currency, m_blockchain, *this, m_timeProvider, logger, blockchainIndexesEnabled),
       m_blockchain(currency, m_mempool, logger, blockchainIndexesEnabled),
       m_miner(new miner(currency, *this, logger)),
-      m_starter_message_showed(false)
+      m_starter_message_showed(false),
+      m_blockTemplateVersion(1)
 {
+    m_blockTemplateBase.version = 0;
     set_cryptonote_protocol(pprotocol);
     m_blockchain.addObserver(this);
     m_mempool.addObserver(this);
@@ -310,12 +326,290 @@ size_t core::addChain(const std::vector<const IBlock *> &chain)
     return blocksCounter;
 }
 
+bool core::exportBlockchain(const std::string &filename)
+{
+    try {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            logger(ERROR, BRIGHT_RED) << "Failed to open bootstrap file " << filename;
+            return false;
+        }
+
+        BlockchainBootstrapWriter writer(file);
+        uint32_t height = m_blockchain.getCurrentBlockchainHeight();
+        logger(INFO) << "Exporting " << height << " blocks to " << filename;
+
+        for (uint32_t start = 0; start < height; start += BOOTSTRAP_BATCH_SIZE) {
+            std::list<Block> blocks;
+            std::list<Transaction> transactions;
+            if (!m_blockchain.getBlocks(start, BOOTSTRAP_BATCH_SIZE, blocks, transactions)) {
+                logger(ERROR, BRIGHT_RED) << "Failed to get blocks from height " << start;
+                return false;
+            }
+
+            auto tx = transactions.begin();
+            for (const Block &block : blocks) {
+                RawBlock rawBlock;
+                rawBlock.block = toBinaryArray(block);
+                rawBlock.transactions.reserve(block.transactionHashes.size());
+                for (size_t i = 0; i < block.transactionHashes.size(); ++i, ++tx) {
+                    assert(tx != transactions.end());
+                    rawBlock.transactions.push_back(toBinaryArray(*tx));
+                }
+
+                writer.write(rawBlock);
+            }
+
+            if ((start / BOOTSTRAP_BATCH_SIZE) % BOOTSTRAP_PROGRESS_INTERVAL == 0) {
+                logger(INFO) << "Exported " << start + blocks.size() << "/" << height << " blocks";
+            }
+        }
+
+        file.flush();
+        if (!file) {
+            logger(ERROR, BRIGHT_RED) << "Failed to write bootstrap file " << filename;
+            return false;
+        }
+
+        logger(INFO, BRIGHT_GREEN) << "Exported " << height << " blocks to " << filename;
+    } catch (std::exception &e) {
+        logger(ERROR, BRIGHT_RED) << "Failed to export blockchain: " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
+bool core::importBlockchain(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        logger(ERROR, BRIGHT_RED) << "Failed to open bootstrap file " << filename;
+        return false;
+    }
+
+    uint32_t importedCount = 0;
+    uint32_t skippedCount = 0;
+    bool success = true;
+    auto startTime = std::chrono::steady_clock::now();
+
+    try {
+        BlockchainBootstrapReader reader(file);
+        size_t threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+        // Parsing, hashing and the context free checks run on all cores, the next batch is
+        // decoded while the current one is pushed to the chain.
+        auto readBatch = [&](std::vector<BlockWithTransactions> &batch, std::vector<char> &valid) {
+            std::vector<RawBlock> rawBlocks;
+            RawBlock rawBlock;
+            while (rawBlocks.size() < BOOTSTRAP_BATCH_SIZE && reader.read(rawBlock)) {
+                rawBlocks.push_back(std::move(rawBlock));
+            }
+
+            batch.clear();
+            batch.resize(rawBlocks.size());
+            valid.assign(rawBlocks.size(), 0);
+
+            std::vector<std::future<void>> workers;
+            for (size_t t = 0; t < std::min(threadCount, rawBlocks.size()); ++t) {
+                workers.push_back(std::async(std::launch::async, [&, t] {
+                    for (size_t i = t; i < rawBlocks.size(); i += threadCount) {
+                        valid[i] = decodeBootstrapBlock(
+                            rawBlocks[i],
+                            batch[i].block,
+                            batch[i].transactions);
+                    }
+                }));
+            }
+
+            for (auto &worker : workers) {
+                worker.get();
+            }
+        };
+
+        std::vector<BlockWithTransactions> batch;
+        std::vector<BlockWithTransactions> nextBatch;
+        std::vector<char> valid;
+        std::vector<char> nextValid;
+        readBatch(batch, valid);
+
+        while (success && !batch.empty()) {
+            std::future<void> prefetch = std::async(std::launch::async, [&] {
+                readBatch(nextBatch, nextValid);
+            });
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                uint32_t chainHeight = m_blockchain.getCurrentBlockchainHeight();
+                if (!valid[i]) {
+                    logger(ERROR, BRIGHT_RED)
+                        << "Invalid block in bootstrap file after height " << chainHeight - 1;
+                    success = false;
+                    break;
+                }
+
+                const BlockWithTransactions &block = batch[i];
+                uint32_t height = get_block_height(block.block);
+                if (height < chainHeight) {
+                    if (m_blockchain.getBlockIdByHeight(height) != getBlockHash(block.block)) {
+                        logger(ERROR, BRIGHT_RED)
+                            << "Bootstrap block " << height << " differs from the local chain";
+                        success = false;
+                        break;
+                    }
+
+                    ++skippedCount;
+                    continue;
+                }
+
+                if (height > chainHeight) {
+                    logger(ERROR, BRIGHT_RED)
+                        << "Bootstrap file has a gap, expected block " << chainHeight
+                        << ", got " << height;
+                    success = false;
+                    break;
+                }
+
+                // Checkpointed blocks are pushed directly, the checkpoints pin their hashes so
+                // the signature and proof of work checks are already skipped for them. Blocks
+                // past the last checkpoint take the same path as blocks from P2P.
+                if (m_blockchain.isInCheckpointZone(height)) {
+                    block_verification_context bvc =
+                        boost::value_initialized<block_verification_context>();
+                    if (!m_blockchain.importBlock(block.block, block.transactions, bvc)
+                        || !bvc.m_added_to_main_chain) {
+                        logger(ERROR, BRIGHT_RED) << "Failed to import block " << height;
+                        success = false;
+                        break;
+                    }
+                } else if (addChain({ &block }) != 1) {
+                    success = false;
+                    break;
+                }
+
+                ++importedCount;
+                if (importedCount % (BOOTSTRAP_BATCH_SIZE * BOOTSTRAP_PROGRESS_INTERVAL) == 0) {
+                    logger(INFO) << "Imported " << importedCount << " blocks, height " << height;
+                }
+            }
+
+            prefetch.get();
+            batch.swap(nextBatch);
+            valid.swap(nextValid);
+        }
+    } catch (std::exception &e) {
+        logger(ERROR, BRIGHT_RED) << "Failed to import blockchain: " << e.what();
+        success = false;
+    }
+
+    if (importedCount != 0) {
+        blockchainUpdated();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+    logger(success ? INFO : ERROR, success ? BRIGHT_GREEN : BRIGHT_RED)
+        << "Imported " << importedCount << " blocks, skipped " << skippedCount
+        << " known blocks in " << elapsed / 1000.0 << " s";
+
+    return success;
+}
+
+bool core::decodeBootstrapBlock(
+    const RawBlock &rawBlock,
+    Block &block,
+    std::vector<Transaction> &transactions)
+{
+    if (rawBlock.block.size() > m_currency.maxBlockBlobSize()
+        || !fromBinaryArray(block, rawBlock.block)) {
+        logger(ERROR) << "Failed to parse bootstrap block";
+        return false;
+    }
+
+    if (rawBlock.transactions.size() != block.transactionHashes.size()) {
+        logger(ERROR)
+            << "Bootstrap block " << get_block_height(block) << " has "
+            << rawBlock.transactions.size() << " transactions, expected "
+            << block.transactionHashes.size();
+        return false;
+    }
+
+    transactions.resize(rawBlock.transactions.size());
+    for (size_t i = 0; i < rawBlock.transactions.size(); ++i) {
+        Crypto::Hash txHash;
+        Crypto::Hash txPrefixHash;
+        if (!parseAndValidateTransactionFromBinaryArray(
+                rawBlock.transactions[i],
+                transactions[i],
+                txHash,
+                txPrefixHash)
+            || txHash != block.transactionHashes[i]
+            || !check_tx_semantic(transactions[i], true)) {
+            logger(ERROR)
+                << "Bootstrap block " << get_block_height(block) << " has an invalid transaction "
+                << block.transactionHashes[i];
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // TODO: Deprecated. Should be removed with CryptoNoteProtocolHandler.
 bool core::handle_incoming_tx(
     const BinaryArray &tx_blob,
     tx_verification_context &tvc,
     bool keeped_by_block,
     bool loose_check)
+{
+    bool r = admitTransactionBlob(tx_blob, tvc, keeped_by_block, loose_check);
+    if (tvc.m_added_to_pool) {
+        poolUpdated();
+    }
+
+    return r;
+}
+
+void core::handleIncomingTransactions(
+    const std::vector<BinaryArray> &transactions,
+    std::vector<tx_verification_context> &tvcs)
+{
+    tvcs.assign(transactions.size(), boost::value_initialized<tx_verification_context>());
+
+    // The pool serializes only the final insertion, so the transactions of one batch are
+    // verified in parallel
+    std::atomic<size_t> next(0);
+    auto admit = [&] {
+        for (size_t i = next++; i < transactions.size(); i = next++) {
+            admitTransactionBlob(transactions[i], tvcs[i], false, false);
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(
+        std::max(1u, std::thread::hardware_concurrency()),
+        transactions.size());
+    std::vector<std::future<void>> workers;
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.push_back(std::async(std::launch::async, admit));
+    }
+
+    admit();
+    for (auto &worker : workers) {
+        worker.get();
+    }
+
+    bool added = std::any_of(tvcs.begin(), tvcs.end(), [](const tx_verification_context &tvc) {
+        return tvc.m_added_to_pool;
+    });
+    if (added) {
+        poolUpdated();
+    }
+}
+
+bool core::admitTransactionBlob(
+    const BinaryArray &tx_blob,
+    tx_verification_context &tvc,
+    bool keeped_by_block,
+    bool loose_check)
 {
     tvc = boost::value_initialized<tx_verification_context>();
     // want to process all transactions sequentially
@@ -343,7 +637,7 @@ bool core::handle_incoming_tx(
     if (!ok) {
         blockHeight = this->getCurrentBlockchainHeight();
     }
-    return handleIncomingTransaction(
+    return admitTransaction(
         tx,
         tx_hash,
         tx_blob.size(),
@@ -394,6 +688,7 @@ bool core::check_tx_mixin(const Transaction &tx, uint32_t height)
 bool core::check_tx_fee(
     const Transaction &tx,
     size_t blobSize,
+    const TransactionExtraInfo &extraInfo,
     tx_verification_context &tvc,
     uint32_t height,
     bool loose_check)
@@ -424,13 +719,7 @@ bool core::check_tx_fee(
     bool isFusionTransaction = fee == 0 && m_currency.isFusionTransaction(tx, blobSize, height);
 
     if (!isFusionTransaction) {
-        std::vector<TransactionExtraField> txExtraFields;
-        parseTransactionExtra(tx.extra, txExtraFields);
-        TransactionExtraTTL ttl;
-
-        if (!findTransactionExtraFieldByType(txExtraFields, ttl)) {
-            ttl.ttl = 0;
-
+        if (!extraInfo.hasTtl) {
             // TODO: simplify overcomplicated expression.
             if (fee < CryptoNote::parameters::MINIMUM_FEE) {
                 logger(ERROR)
@@ -619,14 +908,12 @@ bool core::add_new_tx(
     const Transaction &tx,
     const Crypto::Hash &tx_hash,
     size_t blob_size,
+    const TransactionExtraInfo &extraInfo,
     tx_verification_context &tvc,
     bool keeped_by_block)
 {
-    // Locking on m_mempool and m_blockchain closes possibility to add tx
-    // to memory pool which is already in blockchain
-    std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-    LockedBlockchainStorage lbs(m_blockchain);
-
+    // No lock is held across the admission, the pool verifies the inputs unlocked and
+    // rechecks them against the blockchain when it inserts the transaction
     if (m_blockchain.haveTransaction(tx_hash)) {
         logger(TRACE) << "tx " << tx_hash << " is already in blockchain";
         return true;
@@ -637,7 +924,7 @@ bool core::add_new_tx(
         return true;
     }
 
-    return m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block);
+    return m_mempool.add_tx(tx, tx_hash, blob_size, extraInfo, tvc, keeped_by_block);
 }
 
 bool core::get_block_template(
@@ -646,110 +933,82 @@ bool core::get_block_template(
     difficulty_type &diffic,
     uint32_t &height,
     const BinaryArray &ex_nonce)
+{
+    uint64_t templateVersion;
+
+    return get_block_template(b, adr, diffic, height, ex_nonce, templateVersion);
+}
+
+bool core::get_block_template(
+    Block &b,
+    const AccountPublicAddress &adr,
+    difficulty_type &diffic,
+    uint32_t &height,
+    const BinaryArray &ex_nonce,
+    uint64_t &templateVersion)
 {
     size_t median_size;
     uint64_t already_generated_coins;
+    size_t txs_size;
+    uint64_t fee;
+    uint64_t blockTarget = CryptoNote::parameters::DIFFICULTY_TARGET;
 
     {
-        LockedBlockchainStorage blockchainLock(m_blockchain);
-        height = m_blockchain.getCurrentBlockchainHeight();
-
-        b = boost::value_initialized<Block>();
-        b.majorVersion = m_blockchain.getBlockMajorVersionForHeight(height);
-
-        if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
-            b.minorVersion =
-                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_1) == UpgradeDetectorBase::UNDEF_HEIGHT
-                ? BLOCK_MINOR_VERSION_1
-                : BLOCK_MINOR_VERSION_0;
-        }
-        else if (b.majorVersion == BLOCK_MAJOR_VERSION_2) {
-            b.minorVersion =
-                    m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_2) == UpgradeDetectorBase::UNDEF_HEIGHT
-                    ? BLOCK_MINOR_VERSION_1
-                    : BLOCK_MINOR_VERSION_0;
-        }
-        else if (b.majorVersion == BLOCK_MAJOR_VERSION_3) {
-            b.minorVersion =
-                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_3) == UpgradeDetectorBase::UNDEF_HEIGHT
-                ? BLOCK_MINOR_VERSION_1
-                : BLOCK_MINOR_VERSION_0;
-        }
-        else if (b.majorVersion == BLOCK_MAJOR_VERSION_4) {
-            b.minorVersion =
-                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_4) == UpgradeDetectorBase::UNDEF_HEIGHT
-                ? BLOCK_MINOR_VERSION_1
-                : BLOCK_MINOR_VERSION_0;
-        }
-        else if (b.majorVersion == BLOCK_MAJOR_VERSION_5) {
-            b.minorVersion =
-                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_5) == UpgradeDetectorBase::UNDEF_HEIGHT
-                ? BLOCK_MINOR_VERSION_1
-                : BLOCK_MINOR_VERSION_0;
-        }
-        else if (b.majorVersion >= BLOCK_MAJOR_VERSION_6) {
-            b.minorVersion =
-                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_6) == UpgradeDetectorBase::UNDEF_HEIGHT
-                ? BLOCK_MINOR_VERSION_1
-                : BLOCK_MINOR_VERSION_0;
-        }
-
-        b.previousBlockHash = get_tail_id();
-        b.timestamp = time(nullptr);
-
-        // Don't generate a block template with invalid timestamp
-        // Fix by Jagerman
-        // https://github.com/graft-project/GraftNetwork/pull/118/commits
-
-        if(height >= m_currency.timestampCheckWindow()) {
-            std::vector<uint64_t> timestamps;
-            for(size_t offset = height - m_currency.timestampCheckWindow();
-                offset < height;
-                ++offset) {
-                timestamps.push_back(m_blockchain.getBlockTimestamp(offset));
-            }
-            uint64_t median_ts = Common::medianValue(timestamps);
-            if (b.timestamp < median_ts) {
-                b.timestamp = median_ts;
+        std::lock_guard<std::mutex> templateLock(m_blockTemplateMutex);
+        BlockTemplateBase &base = m_blockTemplateBase;
+        for (;;) {
+            if (base.version != m_blockTemplateVersion.load() || base.previousBlockHash != get_tail_id()) {
+                if (!updateBlockTemplateBase()) {
+                    return false;
+                }
             }
-        }
 
-        diffic = m_blockchain.getDifficultyForNextBlock(b.timestamp);
-        if (!(diffic)) {
-            logger(ERROR, BRIGHT_RED) << "difficulty overhead.";
-            return false;
-        }
+            // the base is rebuilt without the chain lock held across the pool fill, so the tip is
+            // checked again under the lock the difficulty is computed with
+            LockedBlockchainStorage blockchainLock(m_blockchain);
+            if (base.previousBlockHash != get_tail_id()) {
+                continue;
+            }
 
-        median_size = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
-        already_generated_coins = m_blockchain.getCoinsInCirculation();
-    }
+            // only the timestamp dependent part is recalculated while the tip and the pool stay
+            uint64_t timestamp = std::max<uint64_t>(time(nullptr), base.medianTimestamp);
+            if (timestamp != base.timestamp) {
+                difficulty_type difficulty = m_blockchain.getDifficultyForNextBlock(timestamp);
+                if (!(difficulty)) {
+                    logger(ERROR, BRIGHT_RED) << "difficulty overhead.";
+                    return false;
+                }
 
-    size_t txs_size;
-    uint64_t fee;
-    if (!m_mempool.fill_block_template(
-            b,
-            median_size,
-            m_currency.maxBlockCumulativeSize(height),
-            already_generated_coins,
-            txs_size,
-            fee)
-        ) {
-        logger(ERROR, BRIGHT_RED) << "failed to fill block template from mempool.";
-        return false;
-    }
+                base.timestamp = timestamp;
+                base.difficulty = difficulty;
+            }
 
-    uint32_t previousBlockHeight = 0;
-    uint64_t blockTarget = CryptoNote::parameters::DIFFICULTY_TARGET;
+            b = boost::value_initialized<Block>();
+            b.majorVersion = base.majorVersion;
+            b.minorVersion = base.minorVersion;
+            b.previousBlockHash = base.previousBlockHash;
+            b.timestamp = base.timestamp;
+            b.transactionHashes = base.transactionHashes;
+
+            height = base.height;
+            diffic = base.difficulty;
+            median_size = base.medianSize;
+            already_generated_coins = base.alreadyGeneratedCoins;
+            txs_size = base.transactionsSize;
+            fee = base.fee;
+            templateVersion = base.version;
+
+            if (height > CryptoNote::parameters::UPGRADE_HEIGHT_V1) {
+                if (base.previousTimestamp > b.timestamp) {
+                    logger(ERROR, BRIGHT_RED) << "incorrect timestamp, prev = "
+                       << base.previousTimestamp << ",  new = " << b.timestamp;
+                    return false;
+                }
+                blockTarget = b.timestamp - base.previousTimestamp;
+            }
 
-    if (height > CryptoNote::parameters::UPGRADE_HEIGHT_V1) {
-        getBlockHeight(b.previousBlockHash, previousBlockHeight);
-        uint64_t prev_timestamp = getBlockTimestamp(previousBlockHeight);
-        if(prev_timestamp > b.timestamp) {
-            logger(ERROR, BRIGHT_RED) << "incorrect timestamp, prev = "
-               << prev_timestamp << ",  new = " << b.timestamp;
-            return false;
+            break;
         }
-        blockTarget = b.timestamp - getBlockTimestamp(previousBlockHeight);
     }
 
     // two-phase miner transaction generation: we don't know exact block size until we prepare
@@ -853,6 +1112,112 @@ bool core::get_block_template(
     return false;
 }
 
+bool core::updateBlockTemplateBase()
+{
+    BlockTemplateBase &base = m_blockTemplateBase;
+    base.version = m_blockTemplateVersion.load();
+
+    Block b = boost::value_initialized<Block>();
+
+    {
+        LockedBlockchainStorage blockchainLock(m_blockchain);
+        base.height = m_blockchain.getCurrentBlockchainHeight();
+
+        b.majorVersion = m_blockchain.getBlockMajorVersionForHeight(base.height);
+
+        if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
+            b.minorVersion =
+                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_1) == UpgradeDetectorBase::UNDEF_HEIGHT
+                ? BLOCK_MINOR_VERSION_1
+                : BLOCK_MINOR_VERSION_0;
+        }
+        else if (b.majorVersion == BLOCK_MAJOR_VERSION_2) {
+            b.minorVersion =
+                    m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_2) == UpgradeDetectorBase::UNDEF_HEIGHT
+                    ? BLOCK_MINOR_VERSION_1
+                    : BLOCK_MINOR_VERSION_0;
+        }
+        else if (b.majorVersion == BLOCK_MAJOR_VERSION_3) {
+            b.minorVersion =
+                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_3) == UpgradeDetectorBase::UNDEF_HEIGHT
+                ? BLOCK_MINOR_VERSION_1
+                : BLOCK_MINOR_VERSION_0;
+        }
+        else if (b.majorVersion == BLOCK_MAJOR_VERSION_4) {
+            b.minorVersion =
+                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_4) == UpgradeDetectorBase::UNDEF_HEIGHT
+                ? BLOCK_MINOR_VERSION_1
+                : BLOCK_MINOR_VERSION_0;
+        }
+        else if (b.majorVersion == BLOCK_MAJOR_VERSION_5) {
+            b.minorVersion =
+                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_5) == UpgradeDetectorBase::UNDEF_HEIGHT
+                ? BLOCK_MINOR_VERSION_1
+                : BLOCK_MINOR_VERSION_0;
+        }
+        else if (b.majorVersion >= BLOCK_MAJOR_VERSION_6) {
+            b.minorVersion =
+                m_currency.upgradeHeight(BLOCK_MAJOR_VERSION_6) == UpgradeDetectorBase::UNDEF_HEIGHT
+                ? BLOCK_MINOR_VERSION_1
+                : BLOCK_MINOR_VERSION_0;
+        }
+
+        b.previousBlockHash = get_tail_id();
+        base.majorVersion = b.majorVersion;
+        base.minorVersion = b.minorVersion;
+        base.previousBlockHash = b.previousBlockHash;
+        base.medianTimestamp = 0;
+        base.previousTimestamp = base.height > 0 ? m_blockchain.getBlockTimestamp(base.height - 1) : 0;
+
+        // Don't generate a block template with invalid timestamp
+        // Fix by Jagerman
+        // https://github.com/graft-project/GraftNetwork/pull/118/commits
+
+        if (base.height >= m_currency.timestampCheckWindow()) {
+            std::vector<uint64_t> timestamps;
+            for (size_t offset = base.height - m_currency.timestampCheckWindow();
+                 offset < base.height;
+                 ++offset) {
+                timestamps.push_back(m_blockchain.getBlockTimestamp(offset));
+            }
+            base.medianTimestamp = Common::medianValue(timestamps);
+        }
+
+        base.timestamp = std::max<uint64_t>(time(nullptr), base.medianTimestamp);
+        base.difficulty = m_blockchain.getDifficultyForNextBlock(base.timestamp);
+        if (!(base.difficulty)) {
+            logger(ERROR, BRIGHT_RED) << "difficulty overhead.";
+            base.version = 0;
+            return false;
+        }
+
+        base.medianSize = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
+        base.alreadyGeneratedCoins = m_blockchain.getCoinsInCirculation();
+    }
+
+    if (!m_mempool.fill_block_template(
+            b,
+            base.medianSize,
+            m_currency.maxBlockCumulativeSize(base.height),
+            base.alreadyGeneratedCoins,
+            base.transactionsSize,
+            base.fee)
+        ) {
+        logger(ERROR, BRIGHT_RED) << "failed to fill block template from mempool.";
+        base.version = 0;
+        return false;
+    }
+
+    base.transactionHashes = std::move(b.transactionHashes);
+
+    logger(DEBUGGING)
+        << "Block template base updated, height " << base.height
+        << ", transactions " << base.transactionHashes.size()
+        << ", version " << base.version;
+
+    return true;
+}
+
 bool core::get_difficulty_stat(uint32_t height,
                                IMinerHandler::stat_period period,
                                uint32_t &block_num,
@@ -956,8 +1321,33 @@ bool core::getPoolChanges(
     std::vector<Transaction> &addedTxs,
     std::vector<Crypto::Hash> &deletedTxsIds)
 {
-    getPoolChanges(knownTxsIds, addedTxs, deletedTxsIds);
-    return tailBlockId == m_blockchain.getTailId();
+    uint64_t poolVersion = 0;
+    return getPoolChanges(tailBlockId, knownTxsIds, 0, addedTxs, deletedTxsIds, poolVersion);
+}
+
+bool core::getPoolChanges(
+    const Crypto::Hash &tailBlockId,
+    const std::vector<Crypto::Hash> &knownTxsIds,
+    uint64_t knownPoolVersion,
+    std::vector<Transaction> &addedTxs,
+    std::vector<Crypto::Hash> &deletedTxsIds,
+    uint64_t &poolVersion)
+{
+    Crypto::Hash tailId = m_blockchain.getTailId();
+    std::vector<Crypto::Hash> addedTxsIds;
+    auto guard = m_mempool.obtainGuard();
+    if (!m_mempool.get_changes_since(knownPoolVersion, tailId, addedTxsIds, deletedTxsIds)) {
+        addedTxsIds.clear();
+        deletedTxsIds.clear();
+        m_mempool.get_difference(knownTxsIds, addedTxsIds, deletedTxsIds);
+    }
+
+    poolVersion = m_mempool.get_version();
+    std::vector<Crypto::Hash> misses;
+    m_mempool.getTransactions(addedTxsIds, addedTxs, misses);
+    assert(misses.empty());
+
+    return tailBlockId == tailId;
 }
 
 bool core::getPoolChangesLite(
@@ -965,9 +1355,27 @@ bool core::getPoolChangesLite(
     const std::vector<Crypto::Hash> &knownTxsIds,
     std::vector<TransactionPrefixInfo> &addedTxs,
     std::vector<Crypto::Hash> &deletedTxsIds)
+{
+    uint64_t poolVersion = 0;
+    return getPoolChangesLite(tailBlockId, knownTxsIds, 0, addedTxs, deletedTxsIds, poolVersion);
+}
+
+bool core::getPoolChangesLite(
+    const Crypto::Hash &tailBlockId,
+    const std::vector<Crypto::Hash> &knownTxsIds,
+    uint64_t knownPoolVersion,
+    std::vector<TransactionPrefixInfo> &addedTxs,
+    std::vector<Crypto::Hash> &deletedTxsIds,
+    uint64_t &poolVersion)
 {
     std::vector<Transaction> added;
-    bool returnStatus = getPoolChanges(tailBlockId, knownTxsIds, added, deletedTxsIds);
+    bool returnStatus = getPoolChanges(
+        tailBlockId,
+        knownTxsIds,
+        knownPoolVersion,
+        added,
+        deletedTxsIds,
+        poolVersion);
 
     for (const auto &tx: added) {
         TransactionPrefixInfo tpi;
@@ -1206,6 +1614,7 @@ bool core::removeObserver(ICoreObserver *observer)
 
 void core::blockchainUpdated()
 {
+    ++m_blockTemplateVersion;
     m_observerManager.notify(&ICoreObserver::blockchainUpdated);
 }
 
@@ -1216,6 +1625,7 @@ void core::txDeletedFromPool()
 
 void core::poolUpdated()
 {
+    ++m_blockTemplateVersion;
     m_observerManager.notify(&ICoreObserver::poolUpdated);
 }
 
@@ -1399,6 +1809,44 @@ bool core::queryBlocksLite(
     return true;
 }
 
+bool core::queryBlocksCompact(
+    const std::vector<Crypto::Hash> &knownBlockIds,
+    uint64_t timestamp,
+    uint32_t &resStartHeight,
+    uint32_t &resCurrentHeight,
+    uint32_t &resFullOffset,
+    std::string &blocks)
+{
+    LockedBlockchainStorage lbs(m_blockchain);
+
+    resCurrentHeight = lbs->getCurrentBlockchainHeight();
+    resStartHeight = 0;
+    resFullOffset = 0;
+
+    if (!findStartAndFullOffsets(knownBlockIds, timestamp, resStartHeight, resFullOffset)) {
+        return false;
+    }
+
+    CompactBlocksWriter writer(blocks);
+    std::vector<Crypto::Hash> blockIds = findIdsForShortBlocks(resStartHeight, resFullOffset);
+    for (const auto &id : blockIds) {
+        writer.writeHash(id);
+    }
+
+    uint32_t blocksLeft = static_cast<uint32_t>(std::min(
+        BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT - blockIds.size(),
+        size_t(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+    ));
+
+    if (blocksLeft == 0) {
+        return true;
+    }
+
+    lbs->getCompactBlocks(resFullOffset, blocksLeft, timestamp, writer);
+
+    return true;
+}
+
 bool core::queryBlocksDetailed(
     const std::vector<Crypto::Hash> &knownBlockHashes,
     uint64_t timestamp,
@@ -1732,13 +2180,25 @@ uint8_t core::getBlockMajorVersionForHeight(uint32_t height) const
 
 bool core::getPaymentId(const Transaction &transaction, Crypto::Hash &paymentId)
 {
-    std::vector<TransactionExtraField> txExtraFields;
-    parseTransactionExtra(transaction.extra, txExtraFields);
-    TransactionExtraNonce extraNonce;
-    if (!findTransactionExtraFieldByType(txExtraFields, extraNonce)) {
+    TransactionExtraInfo extraInfo;
+    parseTransactionExtra(transaction.extra, extraInfo);
+    if (!extraInfo.hasPaymentId) {
         return false;
     }
-    return getPaymentIdFromTransactionExtraNonce(extraNonce.nonce, paymentId);
+
+    paymentId = extraInfo.paymentId;
+
+    return true;
+}
+
+void core::getTransactionExtraInfo(
+    const Transaction &transaction,
+    const Crypto::Hash &transactionHash,
+    TransactionExtraInfo &extraInfo)
+{
+    if (!m_mempool.getTransactionExtraInfo(transactionHash, extraInfo)) {
+        parseTransactionExtra(transaction.extra, extraInfo);
+    }
 }
 
 void core::setBlocksToFind(uint64_t blocksToFind)
@@ -1756,6 +2216,35 @@ bool core::handleIncomingTransaction(
     uint32_t height,
     bool loose_check)
 {
+    bool r = admitTransaction(tx, txHash, blobSize, tvc, keptByBlock, height, loose_check);
+    if (tvc.m_added_to_pool) {
+        poolUpdated();
+    }
+
+    return r;
+}
+
+bool core::admitTransaction(
+    const Transaction &tx,
+    const Crypto::Hash &txHash,
+    size_t blobSize,
+    tx_verification_context &tvc,
+    bool keptByBlock,
+    uint32_t height,
+    bool loose_check)
+{
+    static Metrics::Histogram &blockMetric = Metrics::registry().histogram(
+        "pool_admission_seconds",
+        "Time spent admitting a transaction to the pool",
+        { { "source", "block" } }
+    );
+    static Metrics::Histogram &relayMetric = Metrics::registry().histogram(
+        "pool_admission_seconds",
+        "Time spent admitting a transaction to the pool",
+        { { "source", "relay" } }
+    );
+    Metrics::ScopedTimer timer(keptByBlock ? blockMetric : relayMetric);
+
     if (!check_tx_syntax(tx)) {
         logger(INFO)
             << "WRONG TRANSACTION BLOB, Failed to check tx "
@@ -1765,6 +2254,10 @@ bool core::handleIncomingTransaction(
         return false;
     }
 
+    // the fee check and the pool look at the same fields, the extra is parsed once for both
+    TransactionExtraInfo extraInfo;
+    parseTransactionExtra(tx.extra, extraInfo);
+
     // is in checkpoint zone
     if (!m_blockchain.isInCheckpointZone(getCurrentBlockchainHeight())) {
         if (blobSize > m_currency.maxTransactionSizeLimit() && getCurrentBlockMajorVersion() >= BLOCK_MAJOR_VERSION_3) {
@@ -1778,7 +2271,7 @@ bool core::handleIncomingTransaction(
             return false;
         }
 
-        if (!check_tx_fee(tx, blobSize, tvc, height, loose_check)) {
+        if (!check_tx_fee(tx, blobSize, extraInfo, tvc, height, loose_check)) {
             tvc.m_verification_failed = true;
             return false;
         }
@@ -1808,7 +2301,7 @@ bool core::handleIncomingTransaction(
         return false;
     }
 
-    bool r = add_new_tx(tx, txHash, blobSize, tvc, keptByBlock);
+    bool r = add_new_tx(tx, txHash, blobSize, extraInfo, tvc, keptByBlock);
     if (tvc.m_verification_failed) {
         if (!tvc.m_tx_fee_too_small) {
             logger(ERROR) << "Transaction verification failed: " << txHash;
@@ -1821,7 +2314,6 @@ bool core::handleIncomingTransaction(
 
     if (tvc.m_added_to_pool) {
         logger(DEBUGGING) << "tx added: " << txHash;
-        poolUpdated();
     }
 
     return r;
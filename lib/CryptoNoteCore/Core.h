@@ -19,12 +19,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <ctime>
+#include <mutex>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 #include <BlockchainExplorer/BlockchainExplorerData.h>
 #include <Common/ObserverManager.h>
 #include <CryptoNoteCore/Blockchain.h>
+#include <CryptoNoteCore/BlockchainBootstrap.h>
 #include <CryptoNoteCore/BlockchainMessages.h>
 #include <CryptoNoteCore/Currency.h>
 #include <CryptoNoteCore/ICore.h>
@@ -63,6 +66,9 @@ public:
         tx_verification_context &tvc,
         bool keeped_by_block,
         bool loose_check) override;
+    void handleIncomingTransactions(
+        const std::vector<BinaryArray> &transactions,
+        std::vector<tx_verification_context> &tvcs) override;
     bool handle_incoming_block_blob(
         const BinaryArray &block_blob,
         block_verification_context &bvc,
@@ -80,6 +86,14 @@ public:
         difficulty_type &diffic,
         uint32_t &height,
         const BinaryArray &ex_nonce) override;
+    // templateVersion changes whenever the chain tip or the pool transactions in templates change
+    bool get_block_template(
+        Block &b,
+        const AccountPublicAddress &adr,
+        difficulty_type &diffic,
+        uint32_t &height,
+        const BinaryArray &ex_nonce,
+        uint64_t &templateVersion);
     bool get_difficulty_stat(
         uint32_t height,
         stat_period period,
@@ -101,6 +115,12 @@ public:
     bool set_genesis_block(const Block &b);
     bool deinit();
 
+    // Writes the main chain to a bootstrap file, see BlockchainBootstrap.h
+    bool exportBlockchain(const std::string &filename);
+    // Appends the blocks of a bootstrap file to the main chain. Blocks already present are
+    // skipped, so an interrupted import can be resumed with the same file.
+    bool importBlockchain(const std::string &filename);
+
     // ICore
     size_t addChain(const std::vector<const IBlock *> &chain) override;
     bool handle_get_objects( // TODO: Deprecated. Should be removed with CryptoNoteProtocolHandler.
@@ -178,6 +198,11 @@ public:
     uint8_t getBlockMajorVersionForHeight(uint32_t height) override;
 
     static bool getPaymentId(const Transaction &transaction, Crypto::Hash &paymentId);
+    // takes the fields kept with the pool entry if the transaction is in the pool
+    void getTransactionExtraInfo(
+        const Transaction &transaction,
+        const Crypto::Hash &transactionHash,
+        TransactionExtraInfo &extraInfo);
 
     bool have_block(const Crypto::Hash &id) override;
     std::vector<Crypto::Hash> buildSparseChain() override;
@@ -214,6 +239,14 @@ public:
         uint32_t &resFullOffset,
         std::vector<BlockShortInfo> &entries) override;
 
+    bool queryBlocksCompact(
+        const std::vector<Crypto::Hash> &knownBlockIds,
+        uint64_t timestamp,
+        uint32_t &resStartHeight,
+        uint32_t &resCurrentHeight,
+        uint32_t &resFullOffset,
+        std::string &blocks) override;
+
     bool queryBlocksDetailed(
         const std::vector<Crypto::Hash> &knownBlockHashes,
         uint64_t timestamp,
@@ -289,6 +322,20 @@ public:
         const std::vector<Crypto::Hash> &knownTxsIds,
         std::vector<TransactionPrefixInfo> &addedTxs,
         std::vector<Crypto::Hash> &deletedTxsIds) override;
+    bool getPoolChanges(
+        const Crypto::Hash &tailBlockId,
+        const std::vector<Crypto::Hash> &knownTxsIds,
+        uint64_t knownPoolVersion,
+        std::vector<Transaction> &addedTxs,
+        std::vector<Crypto::Hash> &deletedTxsIds,
+        uint64_t &poolVersion) override;
+    bool getPoolChangesLite(
+        const Crypto::Hash &tailBlockId,
+        const std::vector<Crypto::Hash> &knownTxsIds,
+        uint64_t knownPoolVersion,
+        std::vector<TransactionPrefixInfo> &addedTxs,
+        std::vector<Crypto::Hash> &deletedTxsIds,
+        uint64_t &poolVersion);
     void getPoolChanges(
         const std::vector<Crypto::Hash> &knownTxsIds,
         std::vector<Transaction> &addedTxs,
@@ -310,6 +357,7 @@ private:
         const Transaction &tx,
         const Crypto::Hash &tx_hash,
         size_t blob_size,
+        const TransactionExtraInfo &extraInfo,
         tx_verification_context &tvc,
         bool keeped_by_block);
     bool load_state_data();
@@ -324,6 +372,20 @@ private:
         bool control_miner,
         bool relay_block);
 
+    bool admitTransactionBlob(
+        const BinaryArray &tx_blob,
+        tx_verification_context &tvc,
+        bool keeped_by_block,
+        bool loose_check);
+    // handleIncomingTransaction() without the pool update notification
+    bool admitTransaction(
+        const Transaction &tx,
+        const Crypto::Hash &txHash,
+        size_t blobSize,
+        tx_verification_context &tvc,
+        bool keptByBlock,
+        uint32_t height,
+        bool loose_check);
     bool check_tx_syntax(const Transaction &tx);
     // check correct values, amounts and all lightweight checks not related with database
     bool check_tx_semantic(const Transaction &tx, bool keeped_by_block);
@@ -333,6 +395,7 @@ private:
     bool check_tx_fee(
         const Transaction &tx,
         size_t blobSize,
+        const TransactionExtraInfo &extraInfo,
         tx_verification_context &tvc,
         uint32_t height,
         bool loose_check);
@@ -340,8 +403,13 @@ private:
     bool check_tx_unmixable(const Transaction &tx, uint32_t height);
 
     bool update_miner_block_template();
+    bool updateBlockTemplateBase();
     bool handle_command_line(const boost::program_options::variables_map &vm);
     bool check_tx_inputs_keyimages_diff(const Transaction &tx);
+    bool decodeBootstrapBlock(
+        const RawBlock &rawBlock,
+        Block &block,
+        std::vector<Transaction> &transactions);
     void blockchainUpdated() override;
     void txDeletedFromPool() override;
     void poolUpdated();
@@ -370,6 +438,29 @@ private:
     std::atomic<uint64_t> m_blocksFound;
     std::atomic<uint64_t> m_blocksToFind;
 
+    // Address independent part of the block template, shared by all requests on the same tip
+    struct BlockTemplateBase
+    {
+        uint64_t version;
+        uint32_t height;
+        uint8_t majorVersion;
+        uint8_t minorVersion;
+        Crypto::Hash previousBlockHash;
+        uint64_t medianTimestamp;
+        uint64_t previousTimestamp;
+        uint64_t timestamp;
+        difficulty_type difficulty;
+        size_t medianSize;
+        uint64_t alreadyGeneratedCoins;
+        size_t transactionsSize;
+        uint64_t fee;
+        std::vector<Crypto::Hash> transactionHashes;
+    };
+
+    std::mutex m_blockTemplateMutex;
+    BlockTemplateBase m_blockTemplateBase;
+    std::atomic<uint64_t> m_blockTemplateVersion;
+
     friend class tx_validate_inputs;
 };
 
@@ -48,6 +48,11 @@ bool operator==(const CryptoNote::Block &a, const CryptoNote::Block &b);
 template <class T>
 std::ostream &print256(std::ostream &o, const T &v)
 {
+    // skip the hex conversion for log messages below the logger level
+    if (!o.good()) {
+        return o;
+    }
+
     return o << Common::podToHex(v);
 }
 
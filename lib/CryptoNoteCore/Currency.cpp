@@ -71,6 +71,8 @@ bool Currency::init()
         m_blocksFileName = "testnet_" + m_blocksFileName;
         m_blocksCacheFileName = "testnet_" + m_blocksCacheFileName;
         m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+        m_compactBlocksFileName = "testnet_" + m_compactBlocksFileName;
+        m_compactBlockIndexesFileName = "testnet_" + m_compactBlockIndexesFileName;
         m_txPoolFileName = "testnet_" + m_txPoolFileName;
         m_blockchainIndicesFileName = "testnet_" + m_blockchainIndicesFileName;
     }
@@ -858,9 +860,9 @@ difficulty_type Currency::getClifDifficulty(uint32_t height, uint8_t blockMajorV
                                             uint64_t last_timestamp, uint64_t currentSolveTime,
                                             lazy_stat_callback_type &lazy_stat_cb) const
 {
-    logger(INFO) << "CLIF difficulty inputs: height " << height << ", block version "
-                 << (int)blockMajorVersion << ", last difficulty " << last_difficulty
-                 << ", current solve time " << currentSolveTime;
+    logger(DEBUGGING) << "CLIF difficulty inputs: height " << height << ", block version "
+                      << (int)blockMajorVersion << ", last difficulty " << last_difficulty
+                      << ", current solve time " << currentSolveTime;
 
     difficulty_type new_diff = last_difficulty;
 
@@ -873,30 +875,30 @@ difficulty_type Currency::getClifDifficulty(uint32_t height, uint8_t blockMajorV
         int round_counter = 1;
 
         new_diff = new_diff / 2;
-        logger(INFO) << "CLIF decreased difficulty " << round_counter
-                     << " times, intermediate difficulty is " << new_diff;
+        logger(DEBUGGING) << "CLIF decreased difficulty " << round_counter
+                          << " times, intermediate difficulty is " << new_diff;
         difficulty_type mean_diff = lazy_stat_cb(IMinerHandler::stat_period::hour, last_timestamp);
-        logger(INFO) << "Last hour average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last hour average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
         mean_diff = lazy_stat_cb(IMinerHandler::stat_period::day, last_timestamp);
-        logger(INFO) << "Last day average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last day average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
         mean_diff = lazy_stat_cb(IMinerHandler::stat_period::week, last_timestamp);
-        logger(INFO) << "Last week average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last week average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
         mean_diff = lazy_stat_cb(IMinerHandler::stat_period::month, last_timestamp);
-        logger(INFO) << "Last month average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last month average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
         mean_diff = lazy_stat_cb(IMinerHandler::stat_period::halfyear, last_timestamp);
-        logger(INFO) << "Last halfyear average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last halfyear average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
         mean_diff = lazy_stat_cb(IMinerHandler::stat_period::year, last_timestamp);
-        logger(INFO) << "Last year average difficulty is " << mean_diff;
+        logger(DEBUGGING) << "Last year average difficulty is " << mean_diff;
         if (mean_diff > 0)
             new_diff = std::min(mean_diff, new_diff);
 
@@ -907,14 +909,14 @@ difficulty_type Currency::getClifDifficulty(uint32_t height, uint8_t blockMajorV
                 if (new_diff <= CryptoNote::parameters::DEFAULT_DIFFICULTY)
                     break;
             }
-            logger(INFO) << "CLIF decreased difficulty " << round_counter
-                         << " times, intermediate difficulty is " << new_diff;
+            logger(DEBUGGING) << "CLIF decreased difficulty " << round_counter
+                              << " times, intermediate difficulty is " << new_diff;
         }
 
         new_diff = std::max(new_diff, difficulty_type(CryptoNote::parameters::DEFAULT_DIFFICULTY));
     }
 
-    logger(INFO) << "CLIF difficulty result: " << new_diff;
+    logger(DEBUGGING) << "CLIF difficulty result: " << new_diff;
     return new_diff;
 }
 
@@ -1023,6 +1025,8 @@ CurrencyBuilder::CurrencyBuilder(Logging::ILogger &log) : m_currency(log)
     blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
     blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
     blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+    compactBlocksFileName(parameters::CRYPTONOTE_COMPACTBLOCKS_FILENAME);
+    compactBlockIndexesFileName(parameters::CRYPTONOTE_COMPACTBLOCKINDEXES_FILENAME);
     txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
     blockchainIndicesFileName(parameters::CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME);
 
@@ -136,6 +136,11 @@ public:
     const std::string &blocksFileName() const { return m_blocksFileName; }
     const std::string &blocksCacheFileName() const { return m_blocksCacheFileName; }
     const std::string &blockIndexesFileName() const { return m_blockIndexesFileName; }
+    const std::string &compactBlocksFileName() const { return m_compactBlocksFileName; }
+    const std::string &compactBlockIndexesFileName() const
+    {
+        return m_compactBlockIndexesFileName;
+    }
     const std::string &txPoolFileName() const { return m_txPoolFileName; }
     const std::string &blockchainIndicesFileName() const { return m_blockchainIndicesFileName; }
 
@@ -309,6 +314,8 @@ private:
     std::string m_blocksFileName;
     std::string m_blocksCacheFileName;
     std::string m_blockIndexesFileName;
+    std::string m_compactBlocksFileName;
+    std::string m_compactBlockIndexesFileName;
     std::string m_txPoolFileName;
     std::string m_blockchainIndicesFileName;
 
@@ -557,6 +564,16 @@ public:
         m_currency.m_blockIndexesFileName = val;
         return *this;
     }
+    CurrencyBuilder &compactBlocksFileName(const std::string &val)
+    {
+        m_currency.m_compactBlocksFileName = val;
+        return *this;
+    }
+    CurrencyBuilder &compactBlockIndexesFileName(const std::string &val)
+    {
+        m_currency.m_compactBlockIndexesFileName = val;
+        return *this;
+    }
     CurrencyBuilder &txPoolFileName(const std::string &val)
     {
         m_currency.m_txPoolFileName = val;
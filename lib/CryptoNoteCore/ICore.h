@@ -97,6 +97,10 @@ public:
         tx_verification_context &tvc,
         bool keeped_by_block,
         bool loose_check) = 0;
+    // Verifies a batch of relayed transactions concurrently, tvcs receives one result per blob
+    virtual void handleIncomingTransactions(
+        const std::vector<BinaryArray> &transactions,
+        std::vector<tx_verification_context> &tvcs) = 0;
     virtual std::vector<Transaction> getPoolTransactions() = 0;
 
     virtual bool getPoolChanges(
@@ -109,6 +113,16 @@ public:
         const std::vector<Crypto::Hash> &knownTxsIds,
         std::vector<TransactionPrefixInfo> &addedTxs,
         std::vector<Crypto::Hash> &deletedTxsIds) = 0;
+    // Pool changes for a caller at pool version knownPoolVersion (0 if unknown), answered from
+    // the pool change log when possible and by diffing against knownTxsIds otherwise.
+    // poolVersion receives the version the result brings the caller to.
+    virtual bool getPoolChanges(
+        const Crypto::Hash &tailBlockId,
+        const std::vector<Crypto::Hash> &knownTxsIds,
+        uint64_t knownPoolVersion,
+        std::vector<Transaction> &addedTxs,
+        std::vector<Crypto::Hash> &deletedTxsIds,
+        uint64_t &poolVersion) = 0;
     virtual void getPoolChanges(
         const std::vector<Crypto::Hash> &knownTxsIds,
         std::vector<Transaction> &addedTxs,
@@ -130,6 +144,15 @@ public:
         uint32_t &full_offset,
         std::vector<BlockShortInfo> &entries) = 0;
 
+    // same as queryBlocksLite(), with the blocks encoded as described in CompactBlock.h
+    virtual bool queryBlocksCompact(
+        const std::vector<Crypto::Hash> &block_ids,
+        uint64_t timestamp,
+        uint32_t &start_height,
+        uint32_t &current_height,
+        uint32_t &full_offset,
+        std::string &blocks) = 0;
+
     virtual bool queryBlocksDetailed(
         const std::vector<Crypto::Hash> &knownBlockHashes,
         uint64_t timestamp,
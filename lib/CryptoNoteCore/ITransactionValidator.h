@@ -49,6 +49,17 @@ struct BlockInfo
     Crypto::Hash id;
 };
 
+// Inputs of a transaction resolved against the main chain, so that the ring signatures can be
+// verified afterwards without holding the blockchain lock
+struct ResolvedTransactionInputs
+{
+    Crypto::Hash prefixHash;
+    BlockInfo maxUsedBlock;
+    // ring member keys per input, empty for multisignature inputs
+    std::vector<std::vector<Crypto::PublicKey>> keys;
+    bool checkSignatures;
+};
+
 class ITransactionValidator
 {
 public:
@@ -59,6 +70,14 @@ public:
         const Transaction &tx,
         BlockInfo &maxUsedBlock,
         BlockInfo &lastFailed) = 0;
+    // checkTransactionInputs() split in two, the second part doesn't touch the chain and may
+    // run concurrently
+    virtual bool resolveTransactionInputs(
+        const Transaction &tx,
+        ResolvedTransactionInputs &inputs) = 0;
+    virtual bool checkTransactionSignatures(
+        const Transaction &tx,
+        const ResolvedTransactionInputs &inputs) = 0;
     virtual bool haveSpentKeyImages(const Transaction &tx) = 0;
     virtual bool checkTransactionSize(size_t blobSize) = 0;
 };
@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <crypto/hash.h>
+
+namespace CryptoNote {
+
+// digests of verified signatures, the oldest one is forgotten first once
+// the cache is full
+class SignatureCache
+{
+public:
+    explicit SignatureCache(size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    bool contains(const Crypto::Hash &digest) const
+    {
+        std::lock_guard<std::mutex> lk(m_lock);
+        return m_digests.count(digest) != 0;
+    }
+
+    void insert(const Crypto::Hash &digest)
+    {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if (!m_digests.insert(digest).second) {
+            return;
+        }
+
+        m_order.push_back(digest);
+        if (m_order.size() > m_capacity) {
+            m_digests.erase(m_order.front());
+            m_order.pop_front();
+        }
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lk(m_lock);
+        return m_order.size();
+    }
+
+private:
+    const size_t m_capacity;
+    mutable std::mutex m_lock;
+    std::unordered_set<Crypto::Hash> m_digests;
+    std::deque<Crypto::Hash> m_order;
+};
+
+} // namespace CryptoNote
@@ -28,6 +28,8 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <Common/Metrics.h>
+#include <Common/PathTools.h>
 #include <Common/StdInputStream.h>
 #include <Common/StdOutputStream.h>
 #include <Serialization/BinaryInputStreamSerializer.h>
@@ -221,6 +223,8 @@ private:
     std::list<CacheEntry> m_cache;
     uint64_t m_cacheHits;
     uint64_t m_cacheMisses;
+    Metrics::Counter *m_cacheHitsMetric = nullptr;
+    Metrics::Counter *m_cacheMissesMetric = nullptr;
 };
 
 template<class T>
@@ -288,6 +292,17 @@ bool SwappedVector<T>::open(
     m_cache.clear();
     m_cacheHits = 0;
     m_cacheMisses = 0;
+    Metrics::Labels labels = { { "file", Common::GetPathFilename(itemFileName) } };
+    m_cacheHitsMetric = &Metrics::registry().counter(
+        "swapped_vector_cache_hits_total",
+        "Items read from the cache of a swapped vector",
+        labels
+    );
+    m_cacheMissesMetric = &Metrics::registry().counter(
+        "swapped_vector_cache_misses_total",
+        "Items read from the file of a swapped vector",
+        labels
+    );
 
     return true;
 }
@@ -340,6 +355,7 @@ const T &SwappedVector<T>::operator[](uint64_t index)
         }
 
         ++m_cacheHits;
+        m_cacheHitsMetric->add();
 
         return itemIter->second.item;
     }
@@ -363,6 +379,7 @@ const T &SwappedVector<T>::operator[](uint64_t index)
     std::swap(tempItem, *item);
 
     ++m_cacheMisses;
+    m_cacheMissesMetric->add();
 
     return *item;
 }
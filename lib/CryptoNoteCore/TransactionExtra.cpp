@@ -173,6 +173,48 @@ struct ExtraSerializerVisitor : public boost::static_visitor<bool>
     std::vector<uint8_t> &extra;
 };
 
+void parseTransactionExtra(const std::vector<uint8_t> &tx_extra, TransactionExtraInfo &info)
+{
+    std::vector<TransactionExtraField> fields;
+    bool complete = parseTransactionExtra(tx_extra, fields);
+
+    getTransactionExtraInfo(fields, info);
+    info.complete = complete;
+}
+
+void getTransactionExtraInfo(
+    const std::vector<TransactionExtraField> &tx_extra_fields,
+    TransactionExtraInfo &info)
+{
+    info = TransactionExtraInfo();
+
+    for (const auto &field : tx_extra_fields) {
+        if (field.type() == typeid(TransactionExtraPublicKey)) {
+            if (!info.hasPublicKey) {
+                info.hasPublicKey = true;
+                info.publicKey = boost::get<TransactionExtraPublicKey>(field).publicKey;
+            }
+        } else if (field.type() == typeid(TransactionExtraNonce)) {
+            if (!info.hasNonce) {
+                info.hasNonce = true;
+                info.nonce = boost::get<TransactionExtraNonce>(field).nonce;
+                info.hasPaymentId = getPaymentIdFromTransactionExtraNonce(info.nonce,
+                                                                          info.paymentId);
+            }
+        } else if (field.type() == typeid(TransactionExtraTTL)) {
+            if (!info.hasTtl) {
+                info.hasTtl = true;
+                info.ttl = boost::get<TransactionExtraTTL>(field).ttl;
+            }
+        } else if (field.type() == typeid(TransactionExtraMergeMiningTag)) {
+            if (!info.hasMergeMiningTag) {
+                info.hasMergeMiningTag = true;
+                info.mergeMiningTag = boost::get<TransactionExtraMergeMiningTag>(field);
+            }
+        }
+    }
+}
+
 bool writeTransactionExtra(
     std::vector<uint8_t> &tx_extra,
     const std::vector<TransactionExtraField> &tx_extra_fields)
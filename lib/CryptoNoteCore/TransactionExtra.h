@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <boost/variant.hpp>
@@ -144,9 +145,35 @@ bool findTransactionExtraFieldByType(
     return true;
 }
 
+/*!
+    The fields of an extra which are looked up again and again during the life of a transaction,
+    taken from a single parse so that they can be kept with it. For each kind the first field in
+    the extra counts. 'complete' is false if the extra couldn't be parsed to its end, the fields
+    before the error are set nevertheless.
+*/
+struct TransactionExtraInfo
+{
+    bool complete = true;
+    bool hasPublicKey = false;
+    Crypto::PublicKey publicKey = Crypto::PublicKey();
+    bool hasNonce = false;
+    BinaryArray nonce;
+    bool hasPaymentId = false;
+    Crypto::Hash paymentId = Crypto::Hash();
+    bool hasTtl = false;
+    uint64_t ttl = 0;
+    bool hasMergeMiningTag = false;
+    TransactionExtraMergeMiningTag mergeMiningTag = TransactionExtraMergeMiningTag();
+};
+
 bool parseTransactionExtra(
     const std::vector<uint8_t> &tx_extra,
     std::vector<TransactionExtraField> &tx_extra_fields);
+void parseTransactionExtra(const std::vector<uint8_t> &tx_extra, TransactionExtraInfo &info);
+// The same fields from an extra the caller has parsed already, 'complete' is left true
+void getTransactionExtraInfo(
+    const std::vector<TransactionExtraField> &tx_extra_fields,
+    TransactionExtraInfo &info);
 bool writeTransactionExtra(
     std::vector<uint8_t> &tx_extra,
     const std::vector<TransactionExtraField> &tx_extra_fields);
@@ -26,6 +26,7 @@
 #include <boost/filesystem.hpp>
 #include <crypto/hash.h>
 #include <Common/int-util.h>
+#include <Common/ScopeExit.h>
 #include <Common/Util.h>
 #include <CryptoNoteCore/CryptoNoteFormatUtils.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
@@ -45,6 +46,12 @@ using namespace Societatis;
 
 namespace CryptoNote {
 
+namespace {
+
+const size_t MAX_CHANGE_LOG_SIZE = 16384;
+
+} // namespace
+
 class BlockTemplate
 {
 public:
@@ -102,6 +109,50 @@ private:
     std::vector<Crypto::Hash> m_txHashes;
 };
 
+bool KeyImageReservations::reserve(const Transaction &tx)
+{
+    for (size_t i = 0; i < tx.inputs.size(); ++i) {
+        if (tx.inputs[i].type() != typeid(KeyInput)) {
+            continue;
+        }
+
+        const auto &keyImage = boost::get<KeyInput>(tx.inputs[i]).keyImage;
+        Shard &shard = shardFor(keyImage);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.keyImages.insert(keyImage).second) {
+            release(tx, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void KeyImageReservations::release(const Transaction &tx)
+{
+    release(tx, tx.inputs.size());
+}
+
+void KeyImageReservations::release(const Transaction &tx, size_t inputCount)
+{
+    for (size_t i = 0; i < inputCount; ++i) {
+        if (tx.inputs[i].type() != typeid(KeyInput)) {
+            continue;
+        }
+
+        const auto &keyImage = boost::get<KeyInput>(tx.inputs[i]).keyImage;
+        Shard &shard = shardFor(keyImage);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.keyImages.erase(keyImage);
+    }
+}
+
+KeyImageReservations::Shard &KeyImageReservations::shardFor(const Crypto::KeyImage &keyImage)
+{
+    // key images are uniformly distributed, any byte will do
+    return m_shards[keyImage.data[0] % SHARD_COUNT];
+}
+
 using CryptoNote::BlockInfo;
 
 std::unordered_set<Crypto::Hash> m_validated_transactions;
@@ -119,10 +170,19 @@ tx_memory_pool::tx_memory_pool(
       m_core(core),
       m_timeProvider(timeProvider),
       m_txCheckInterval(60, timeProvider),
+      m_transactions_lock(Metrics::registry().histogram(
+          "lock_wait_seconds",
+          "Time spent waiting for a lock",
+          { { "lock", "transactions" } }
+      )),
       m_fee_index(boost::get<1>(m_transactions)),
       logger(log, "txpool"),
       m_paymentIdIndex(blockchainIndexesEnabled),
-      m_timestampIndex(blockchainIndexesEnabled)
+      m_timestampIndex(blockchainIndexesEnabled),
+      // versions are seeded from the clock so that they keep increasing across restarts
+      m_version(static_cast<uint64_t>(time(nullptr)) << 20),
+      m_changeLogStartVersion(m_version),
+      m_changeLogTailId(NULL_HASH)
 {
 }
 
@@ -130,6 +190,7 @@ bool tx_memory_pool::add_tx(
     const Transaction &tx,
     const Crypto::Hash &id,
     size_t blobSize,
+    const TransactionExtraInfo &extraInfo,
     tx_verification_context &tvc,
     bool keptByBlock)
 {
@@ -156,30 +217,23 @@ bool tx_memory_pool::add_tx(
         return false;
     }
 
-    std::vector<TransactionExtraField> txExtraFields;
-    parseTransactionExtra(tx.extra, txExtraFields);
-    TransactionExtraTTL ttl;
-    if (!findTransactionExtraFieldByType(txExtraFields, ttl)) {
-        ttl.ttl = 0;
-    }
-
     const uint64_t fee = inputs_amount - outputs_amount;
     bool isFusionTransaction =
         fee == 0
         && m_currency.isFusionTransaction(tx, blobSize, m_core.getCurrentBlockchainHeight());
 
-    if (ttl.ttl != 0 && !keptByBlock) {
+    if (extraInfo.ttl != 0 && !keptByBlock) {
         uint64_t now = static_cast<uint64_t>(time(nullptr));
-        if (ttl.ttl <= now) {
+        if (extraInfo.ttl <= now) {
             logger(WARNING, BRIGHT_YELLOW)
                 << "Transaction TTL has already expired: tx = " << id
-                << ", ttl = " << ttl.ttl;
+                << ", ttl = " << extraInfo.ttl;
             tvc.m_verification_failed = true;
             return false;
-        } else if (ttl.ttl - now > m_currency.mempoolTxLiveTime() + m_currency.blockFutureTimeLimit()) {
+        } else if (extraInfo.ttl - now > m_currency.mempoolTxLiveTime() + m_currency.blockFutureTimeLimit()) {
             logger(WARNING, BRIGHT_YELLOW)
                 << "Transaction TTL is out of range: tx = " << id
-                << ", ttl = " << ttl.ttl;
+                << ", ttl = " << extraInfo.ttl;
             tvc.m_verification_failed = true;
             return false;
         }
@@ -193,20 +247,36 @@ bool tx_memory_pool::add_tx(
         }
     }
 
-    // check key images for transaction if it is not kept by block
+    // Conflicts with the pool and with concurrent admissions are ruled out before the inputs
+    // are verified, the reservation is held until the transaction is inserted.
     if (!keptByBlock) {
-        std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+        if (!m_keyImageReservations.reserve(tx)) {
+            logger(INFO)
+                << "Transaction with id= " << id
+                << " spends inputs of a transaction being added concurrently";
+            tvc.m_verification_failed = true;
+            return false;
+        }
+
+        std::lock_guard<Mutex> lock(m_transactions_lock);
         if (haveSpentInputs(tx)) {
+            m_keyImageReservations.release(tx);
             logger(INFO) << "Transaction with id= " << id << " used already spent inputs";
             tvc.m_verification_failed = true;
             return false;
         }
     }
 
+    Tools::ScopeExit releaseReservation([this, &tx, keptByBlock] {
+        if (!keptByBlock) {
+            m_keyImageReservations.release(tx);
+        }
+    });
+
     BlockInfo maxUsedBlock;
 
     // check inputs
-    bool inputsValid = m_validator.checkTransactionInputs(tx, maxUsedBlock);
+    bool inputsValid = checkTransactionInputs(tx, id, maxUsedBlock);
 
     if (!inputsValid) {
         if (!keptByBlock) {
@@ -228,7 +298,12 @@ bool tx_memory_pool::add_tx(
         }
     }
 
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
+
+    if (m_transactions.count(id) != 0) {
+        logger(TRACE) << "tx " << id << " was added concurrently";
+        return true;
+    }
 
     if (!keptByBlock
         && m_recentlyDeletedTransactions.find(id) != m_recentlyDeletedTransactions.end()) {
@@ -239,6 +314,13 @@ bool tx_memory_pool::add_tx(
         return true;
     }
 
+    // the inputs were verified without the blockchain lock, a block could have spent them since
+    if (!keptByBlock && m_validator.haveSpentKeyImages(tx)) {
+        logger(INFO) << "Transaction with id= " << id << " was spent in blockchain meanwhile";
+        tvc.m_verification_failed = true;
+        return false;
+    }
+
     // add to pool
     {
         TransactionDetails txd;
@@ -249,6 +331,7 @@ bool tx_memory_pool::add_tx(
         txd.fee = fee;
         txd.keptByBlock = keptByBlock;
         txd.receiveTime = m_timeProvider.now();
+        txd.extraInfo = extraInfo;
 
         txd.maxUsedBlock = maxUsedBlock;
         txd.lastFailedBlock.clear();
@@ -258,16 +341,19 @@ bool tx_memory_pool::add_tx(
             logger(ERROR, BRIGHT_RED) << "transaction already exists at inserting in memory pool";
             return false;
         }
-        m_paymentIdIndex.add(tx);
+        if (extraInfo.hasPaymentId) {
+            m_paymentIdIndex.add(extraInfo.paymentId, id);
+        }
         m_timestampIndex.add(txd.receiveTime, txd.id);
+        recordChange(id, true);
 
-        if (ttl.ttl != 0) {
-            m_ttlIndex.emplace(std::make_pair(id, ttl.ttl));
+        if (extraInfo.ttl != 0) {
+            m_ttlIndex.emplace(std::make_pair(id, extraInfo.ttl));
         }
     }
 
     tvc.m_added_to_pool = true;
-    tvc.m_should_be_relayed = inputsValid && (fee > 0 || isFusionTransaction || ttl.ttl != 0);
+    tvc.m_should_be_relayed = inputsValid && (fee > 0 || isFusionTransaction || extraInfo.ttl != 0);
     tvc.m_verification_failed = true;
 
     if (!addTransactionInputs(id, tx, keptByBlock)) {
@@ -279,6 +365,28 @@ bool tx_memory_pool::add_tx(
     return true;
 }
 
+bool tx_memory_pool::checkTransactionInputs(
+    const Transaction &tx,
+    const Crypto::Hash &id,
+    BlockInfo &maxUsedBlock)
+{
+    // Only resolving the ring members needs the blockchain lock, the signatures are checked
+    // without it so that concurrent admissions verify in parallel
+    ResolvedTransactionInputs inputs;
+    if (!m_validator.resolveTransactionInputs(tx, inputs)) {
+        return false;
+    }
+
+    if (!m_validator.checkTransactionSignatures(tx, inputs)) {
+        logger(INFO) << "Transaction " << id << " has invalid signatures";
+        return false;
+    }
+
+    maxUsedBlock = inputs.maxUsedBlock;
+
+    return true;
+}
+
 bool tx_memory_pool::add_tx(const Transaction &tx,tx_verification_context &tvc,bool keeped_by_block)
 {
     Crypto::Hash h = NULL_HASH;
@@ -288,9 +396,22 @@ bool tx_memory_pool::add_tx(const Transaction &tx,tx_verification_context &tvc,b
     return add_tx(tx, h, blobSize, tvc, keeped_by_block);
 }
 
+bool tx_memory_pool::add_tx(
+    const Transaction &tx,
+    const Crypto::Hash &id,
+    size_t blobSize,
+    tx_verification_context &tvc,
+    bool keptByBlock)
+{
+    TransactionExtraInfo extraInfo;
+    parseTransactionExtra(tx.extra, extraInfo);
+
+    return add_tx(tx, id, blobSize, extraInfo, tvc, keptByBlock);
+}
+
 bool tx_memory_pool::take_tx(const Crypto::Hash &id,Transaction &tx,size_t &blobSize,uint64_t &fee)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     auto it = m_transactions.find(id);
     if (it == m_transactions.end()) {
         return false;
@@ -309,13 +430,13 @@ bool tx_memory_pool::take_tx(const Crypto::Hash &id,Transaction &tx,size_t &blob
 
 size_t tx_memory_pool::get_transactions_count() const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     return m_transactions.size();
 }
 
 void tx_memory_pool::get_transactions(std::list<Transaction> &txs) const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     for (const auto &tx_vt : m_transactions) {
         txs.push_back(tx_vt.tx);
     }
@@ -323,7 +444,7 @@ void tx_memory_pool::get_transactions(std::list<Transaction> &txs) const
 
 void tx_memory_pool::getMemoryPool(std::list<tx_memory_pool::TransactionDetails> txs) const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     for (const auto &txd : m_fee_index) {
         txs.push_back(txd);
     }
@@ -331,7 +452,7 @@ void tx_memory_pool::getMemoryPool(std::list<tx_memory_pool::TransactionDetails>
 
 std::list<CryptoNote::tx_memory_pool::TransactionDetails> tx_memory_pool::getMemoryPool() const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     std::list<tx_memory_pool::TransactionDetails> txs;
     for (const auto &txd : m_fee_index) {
         txs.push_back(txd);
@@ -344,7 +465,7 @@ void tx_memory_pool::get_difference(
     std::vector<Crypto::Hash> &new_tx_ids,
     std::vector<Crypto::Hash> &deleted_tx_ids) const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     std::unordered_set<Crypto::Hash> ready_tx_ids;
     for (const auto &tx : m_transactions) {
         TransactionCheckInfo checkInfo(tx);
@@ -373,9 +494,92 @@ void tx_memory_pool::get_difference(
     deleted_tx_ids.assign(known_set.begin(), known_set.end());
 }
 
+bool tx_memory_pool::get_changes_since(
+    uint64_t known_version,
+    const Crypto::Hash &tail_id,
+    std::vector<Crypto::Hash> &new_tx_ids,
+    std::vector<Crypto::Hash> &deleted_tx_ids)
+{
+    new_tx_ids.clear();
+    deleted_tx_ids.clear();
+
+    std::lock_guard<Mutex> lock(m_transactions_lock);
+    if (tail_id != m_changeLogTailId) {
+        resetChangeLog();
+        m_changeLogTailId = tail_id;
+        return false;
+    }
+
+    if (known_version < m_changeLogStartVersion || known_version > m_version) {
+        return false;
+    }
+
+    auto it = std::upper_bound(
+        m_changeLog.begin(),
+        m_changeLog.end(),
+        known_version,
+        [](uint64_t version, const PoolChange &change) { return version < change.version; });
+
+    // net effect of the changes, a transaction added and removed again isn't reported
+    std::unordered_set<Crypto::Hash> added;
+    std::unordered_set<Crypto::Hash> deleted;
+    for (; it != m_changeLog.end(); ++it) {
+        if (it->added) {
+            if (deleted.erase(it->id) == 0) {
+                added.insert(it->id);
+            }
+        } else if (added.erase(it->id) == 0) {
+            deleted.insert(it->id);
+        }
+    }
+
+    for (const auto &id : added) {
+        auto tx = m_transactions.find(id);
+        if (tx == m_transactions.end()) {
+            continue;
+        }
+
+        if (m_validated_transactions.count(id) != 0) {
+            new_tx_ids.push_back(id);
+            continue;
+        }
+
+        TransactionCheckInfo checkInfo(*tx);
+        if (is_transaction_ready_to_go(tx->tx, checkInfo)) {
+            m_validated_transactions.insert(id);
+            new_tx_ids.push_back(id);
+        }
+    }
+
+    deleted_tx_ids.assign(deleted.begin(), deleted.end());
+
+    return true;
+}
+
+uint64_t tx_memory_pool::get_version() const
+{
+    std::lock_guard<Mutex> lock(m_transactions_lock);
+    return m_version;
+}
+
+void tx_memory_pool::recordChange(const Crypto::Hash &id, bool added)
+{
+    m_changeLog.push_back({ ++m_version, id, added });
+    if (m_changeLog.size() > MAX_CHANGE_LOG_SIZE) {
+        m_changeLogStartVersion = m_changeLog.front().version;
+        m_changeLog.pop_front();
+    }
+}
+
+void tx_memory_pool::resetChangeLog()
+{
+    m_changeLog.clear();
+    m_changeLogStartVersion = ++m_version;
+}
+
 bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash& top_block_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     if (!m_validated_transactions.empty()) {
         logger(DEBUGGING)
             << "MemPool - Block height incremented, cleared " << m_validated_transactions.size()
@@ -388,7 +592,7 @@ bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::
 
 bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash& top_block_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     if (!m_validated_transactions.empty()) {
         logger(DEBUGGING, YELLOW)
             << "MemPool - Block height decremented " << m_validated_transactions.size()
@@ -401,13 +605,28 @@ bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const Crypto::
 
 bool tx_memory_pool::have_tx(const Crypto::Hash &id) const
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     if (m_transactions.count(id)) {
         return true;
     }
     return false;
 }
 
+bool tx_memory_pool::getTransactionExtraInfo(
+    const Crypto::Hash &id,
+    TransactionExtraInfo &extraInfo) const
+{
+    std::lock_guard<Mutex> lock(m_transactions_lock);
+    auto it = m_transactions.find(id);
+    if (it == m_transactions.end()) {
+        return false;
+    }
+
+    extraInfo = it->extraInfo;
+
+    return true;
+}
+
 void tx_memory_pool::lock() const
 {
     m_transactions_lock.lock();
@@ -418,9 +637,9 @@ void tx_memory_pool::unlock() const
     m_transactions_lock.unlock();
 }
 
-std::unique_lock<std::recursive_mutex> tx_memory_pool::obtainGuard() const
+std::unique_lock<tx_memory_pool::Mutex> tx_memory_pool::obtainGuard() const
 {
-    return std::unique_lock<std::recursive_mutex>(m_transactions_lock);
+    return std::unique_lock<Mutex>(m_transactions_lock);
 }
 
 bool tx_memory_pool::is_transaction_ready_to_go(const Transaction&tx,TransactionCheckInfo&txd) const
@@ -443,7 +662,7 @@ bool tx_memory_pool::is_transaction_ready_to_go(const Transaction&tx,Transaction
 std::string tx_memory_pool::print_pool(bool short_format) const
 {
     std::stringstream ss;
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     for (const auto &txd : m_fee_index) {
         ss << "id: " << txd.id << std::endl;
 
@@ -483,7 +702,7 @@ bool tx_memory_pool::fill_block_template(
     size_t &total_size,
     uint64_t &fee)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
 
     total_size = 0;
     fee = 0;
@@ -554,7 +773,7 @@ bool tx_memory_pool::fill_block_template(
 
 bool tx_memory_pool::init(const std::string &config_folder)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
 
     m_config_folder = config_folder;
     std::string state_file_path = config_folder + "/" + m_currency.txPoolFileName();
@@ -615,6 +834,12 @@ void serialize(CryptoNote::tx_memory_pool::TransactionDetails &td, ISerializer &
     s(td.lastFailedBlock.id, "lastFailedBlock.id");
     s(td.keptByBlock, "keptByBlock");
     s(reinterpret_cast<uint64_t &>(td.receiveTime), "receiveTime");
+
+    // not stored, the pool file stays as it was
+    if (s.type() == ISerializer::INPUT) {
+        td.extraInfo = TransactionExtraInfo();
+        parseTransactionExtra(td.tx.extra, td.extraInfo);
+    }
 }
 
 void tx_memory_pool::serialize(ISerializer &s)
@@ -627,9 +852,10 @@ void tx_memory_pool::serialize(ISerializer &s)
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
 
     if (s.type() == ISerializer::INPUT) {
+        resetChangeLog();
         m_transactions.clear();
         readSequence<TransactionDetails>(
             std::inserter(m_transactions, m_transactions.end()),
@@ -662,7 +888,7 @@ bool tx_memory_pool::removeExpiredTransactions()
     bool somethingRemoved = false;
 
     {
-        std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+        std::lock_guard<Mutex> lock(m_transactions_lock);
 
         uint64_t now = m_timeProvider.now();
 
@@ -719,8 +945,11 @@ bool tx_memory_pool::removeExpiredTransactions()
 tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(
     tx_memory_pool::tx_container_t::iterator i)
 {
+    recordChange(i->id, false);
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
-    m_paymentIdIndex.remove(i->tx);
+    if (i->extraInfo.hasPaymentId) {
+        m_paymentIdIndex.remove(i->extraInfo.paymentId, i->id);
+    }
     m_timestampIndex.remove(i->receiveTime, i->id);
     m_ttlIndex.erase(i->id);
     if (m_validated_transactions.find(i->id) != m_validated_transactions.end()) {
@@ -853,18 +1082,15 @@ bool tx_memory_pool::removeObserver(ITxPoolObserver *observer)
 
 void tx_memory_pool::buildIndices()
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     for (auto it = m_transactions.begin(); it != m_transactions.end(); it++) {
-        m_paymentIdIndex.add(it->tx);
-        m_timestampIndex.add(it->receiveTime, it->id);
+        if (it->extraInfo.hasPaymentId) {
+            m_paymentIdIndex.add(it->extraInfo.paymentId, it->id);
+        }
 
-        std::vector<TransactionExtraField> txExtraFields;
-        parseTransactionExtra(it->tx.extra, txExtraFields);
-        TransactionExtraTTL ttl;
-        if (findTransactionExtraFieldByType(txExtraFields, ttl)) {
-            if (ttl.ttl != 0) {
-                m_ttlIndex.emplace(std::make_pair(it->id, ttl.ttl));
-            }
+        m_timestampIndex.add(it->receiveTime, it->id);
+        if (it->extraInfo.ttl != 0) {
+            m_ttlIndex.emplace(std::make_pair(it->id, it->extraInfo.ttl));
         }
     }
 }
@@ -873,7 +1099,7 @@ bool tx_memory_pool::getTransactionIdsByPaymentId(
     const Crypto::Hash &paymentId,
     std::vector<Crypto::Hash> &transactionIds)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
 	transactionIds = m_paymentIdIndex.find(paymentId);
 	return true;
 }
@@ -885,7 +1111,7 @@ bool tx_memory_pool::getTransactionIdsByTimestamp(
     std::vector<Crypto::Hash> &hashes,
     uint64_t &transactionsNumberWithinTimestamps)
 {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<Mutex> lock(m_transactions_lock);
     return m_timestampIndex.find(
         timestampBegin,
         timestampEnd,
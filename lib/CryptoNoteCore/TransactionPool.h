@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <array>
+#include <deque>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -28,6 +31,7 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <Common/int-util.h>
+#include <Common/Metrics.h>
 #include <Common/ObserverManager.h>
 #include <Common/Util.h>
 #include <crypto/hash.h>
@@ -39,6 +43,7 @@
 #include <CryptoNoteCore/ITimeProvider.h>
 #include <CryptoNoteCore/ITransactionValidator.h>
 #include <CryptoNoteCore/ITxPoolObserver.h>
+#include <CryptoNoteCore/TransactionExtra.h>
 #include <CryptoNoteCore/VerificationContext.h>
 #include <Logging/LoggerRef.h>
 
@@ -76,12 +81,39 @@ private:
     CryptoNote::ITimeProvider &m_timeProvider;
 };
 
+// Key images of the transactions that are being admitted to the pool. Conflicting admissions
+// are rejected before their signatures are verified, the set is sharded by key image so that
+// unrelated admissions don't contend for one mutex.
+class KeyImageReservations
+{
+public:
+    // reserves all key images of the transaction or none of them
+    bool reserve(const Transaction &tx);
+    void release(const Transaction &tx);
+
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_set<Crypto::KeyImage> keyImages;
+    };
+
+    Shard &shardFor(const Crypto::KeyImage &keyImage);
+    void release(const Transaction &tx, size_t inputCount);
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+};
+
 using CryptoNote::BlockInfo;
 using namespace boost::multi_index;
 
 class tx_memory_pool: boost::noncopyable
 {
 public:
+    typedef Metrics::TimedMutex<std::recursive_mutex> Mutex;
+
         struct TransactionCheckInfo
     {
         BlockInfo maxUsedBlock;
@@ -96,6 +128,8 @@ public:
         uint64_t fee;
         bool keptByBlock;
         time_t receiveTime;
+        // parsed once on admission, the pool indices and their removal use it
+        TransactionExtraInfo extraInfo;
     };
 
 private:
@@ -150,10 +184,18 @@ public:
     bool deinit();
 
     bool have_tx(const Crypto::Hash &id) const;
+    bool getTransactionExtraInfo(const Crypto::Hash &id, TransactionExtraInfo &extraInfo) const;
+    bool add_tx(
+        const Transaction &tx,
+        const Crypto::Hash &id,
+        size_t blobSize,
+        tx_verification_context &tvc,
+        bool keeped_by_block);
     bool add_tx(
         const Transaction &tx,
         const Crypto::Hash &id,
         size_t blobSize,
+        const TransactionExtraInfo &extraInfo,
         tx_verification_context &tvc,
         bool keeped_by_block);
     bool add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block);
@@ -164,7 +206,7 @@ public:
 
     void lock() const;
     void unlock() const;
-    std::unique_lock<std::recursive_mutex> obtainGuard() const;
+    std::unique_lock<Mutex> obtainGuard() const;
 
     bool fill_block_template(
         Block &bl,
@@ -179,6 +221,15 @@ public:
         const std::vector<Crypto::Hash> &known_tx_ids,
         std::vector<Crypto::Hash> &new_tx_ids,
         std::vector<Crypto::Hash> &deleted_tx_ids) const;
+    // Same as get_difference() for a caller whose state matches pool version known_version,
+    // in O(changes) using the change log. Returns false if the log can't answer for that
+    // version (too old, or the chain tail moved since) and get_difference() has to be used.
+    bool get_changes_since(
+        uint64_t known_version,
+        const Crypto::Hash &tail_id,
+        std::vector<Crypto::Hash> &new_tx_ids,
+        std::vector<Crypto::Hash> &deleted_tx_ids);
+    uint64_t get_version() const;
     size_t get_transactions_count() const;
     std::string print_pool(bool short_format) const;
 
@@ -197,7 +248,7 @@ public:
     template<class T, class D, class S>
     void getTransactions(const T &txsIds, D &txs, S &missedTxs)
     {
-        std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+        std::lock_guard<Mutex> lock(m_transactions_lock);
 
         for (const auto &id : txsIds) {
             auto it = m_transactions.find(id);
@@ -219,20 +270,27 @@ private:
     bool addTransactionInputs(const Crypto::Hash &id, const Transaction &tx, bool keptByBlock);
     bool haveSpentInputs(const Transaction &tx) const;
     bool removeTransactionInputs(const Crypto::Hash &id, const Transaction &tx, bool keptByBlock);
+    bool checkTransactionInputs(
+        const Transaction &tx,
+        const Crypto::Hash &id,
+        BlockInfo &maxUsedBlock);
 
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
     bool removeExpiredTransactions();
     bool is_transaction_ready_to_go(const Transaction &tx, TransactionCheckInfo &txd) const;
 
     void buildIndices();
+    void recordChange(const Crypto::Hash &id, bool added);
+    void resetChangeLog();
 
     Tools::ObserverManager<ITxPoolObserver> m_observerManager;
     const CryptoNote::Currency &m_currency;
 	CryptoNote::ICore &m_core;
     OnceInTimeInterval m_txCheckInterval;
-    mutable std::recursive_mutex m_transactions_lock;
+    mutable Mutex m_transactions_lock;
     key_images_container m_spent_key_images;
     GlobalOutputsContainer m_spentOutputs;
+    KeyImageReservations m_keyImageReservations;
 
     std::string m_config_folder;
     CryptoNote::ITransactionValidator &m_validator;
@@ -247,6 +305,20 @@ private:
     PaymentIdIndex m_paymentIdIndex;
     TimestampTransactionsIndex m_timestampIndex;
     std::unordered_map<Crypto::Hash, uint64_t> m_ttlIndex;
+
+    // Adds and removals numbered by pool version. Readiness of pool transactions only changes
+    // with the chain, so the log is valid for one chain tail and is reset when it moves.
+    struct PoolChange
+    {
+        uint64_t version;
+        Crypto::Hash id;
+        bool added;
+    };
+
+    std::deque<PoolChange> m_changeLog;
+    uint64_t m_version;
+    uint64_t m_changeLogStartVersion;
+    Crypto::Hash m_changeLogTailId;
 };
 
 } // namespace CryptoNote
@@ -0,0 +1,341 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <Common/StringTools.h>
+#include <Common/Varint.h>
+#include <crypto/hash.h>
+#include <CryptoNoteCore/CryptoNoteFormatUtils.h>
+#include <CryptoNoteCore/CryptoNoteTools.h>
+#include <CryptoNoteCore/TransactionView.h>
+#include <Global/CryptoNoteConfig.h>
+
+namespace CryptoNote {
+
+namespace {
+
+// Reads the encoding of BinaryInputStreamSerializer with the same checks, but reports errors by
+// its return values instead of exceptions.
+class BlobReader
+{
+public:
+    BlobReader(const uint8_t *data, size_t size)
+        : m_position(data),
+          m_end(data + size)
+    {
+    }
+
+    const uint8_t *position() const { return m_position; }
+    size_t remaining() const { return static_cast<size_t>(m_end - m_position); }
+
+    template<typename T>
+    bool readVarint(T &value)
+    {
+        uint64_t temp = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            if (m_position == m_end) {
+                return false;
+            }
+
+            uint8_t piece = *m_position++;
+            if (shift >= sizeof(T) * 8 - 7 && piece >= 1 << (sizeof(T) * 8 - shift)) {
+                return false;
+            }
+
+            temp |= static_cast<uint64_t>(piece & 0x7f) << shift;
+            if ((piece & 0x80) == 0) {
+                if (piece == 0 && shift != 0) {
+                    return false;
+                }
+
+                break;
+            }
+        }
+
+        value = static_cast<T>(temp);
+        return true;
+    }
+
+    bool readByte(uint8_t &value)
+    {
+        if (m_position == m_end) {
+            return false;
+        }
+
+        value = *m_position++;
+        return true;
+    }
+
+    template<typename T>
+    bool readArray(const T *&values, uint64_t count)
+    {
+        if (count > remaining() / sizeof(T)) {
+            return false;
+        }
+
+        values = reinterpret_cast<const T *>(m_position);
+        m_position += count * sizeof(T);
+        return true;
+    }
+
+private:
+    const uint8_t *m_position;
+    const uint8_t *m_end;
+};
+
+bool readInput(BlobReader &reader, TransactionView::Input &input)
+{
+    input = TransactionView::Input();
+    if (!reader.readByte(input.type)) {
+        return false;
+    }
+
+    switch (input.type) {
+    case TransactionView::BASE_INPUT:
+        return reader.readVarint(input.blockIndex);
+    case TransactionView::KEY_INPUT: {
+        uint64_t count;
+        if (!reader.readVarint(input.amount) || !reader.readVarint(count)) {
+            return false;
+        }
+
+        // every index takes at least a byte
+        if (count > reader.remaining()) {
+            return false;
+        }
+
+        input.outputIndexes = reader.position();
+        input.outputIndexCount = static_cast<uint32_t>(count);
+        input.signatureCount = input.outputIndexCount;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint32_t index;
+            if (!reader.readVarint(index)) {
+                return false;
+            }
+        }
+
+        return reader.readArray(input.keyImage, 1);
+    }
+    case TransactionView::MULTISIGNATURE_INPUT: {
+        uint8_t signatureCount;
+        if (!reader.readVarint(input.amount) || !reader.readVarint(signatureCount)
+            || !reader.readVarint(input.outputIndex)) {
+            return false;
+        }
+
+        input.signatureCount = signatureCount;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool readOutput(BlobReader &reader, TransactionView::Output &output)
+{
+    output = TransactionView::Output();
+    if (!reader.readVarint(output.amount) || !reader.readByte(output.type)) {
+        return false;
+    }
+
+    switch (output.type) {
+    case TransactionView::KEY_OUTPUT:
+        output.keyCount = 1;
+        return reader.readArray(output.keys, 1);
+    case TransactionView::MULTISIGNATURE_OUTPUT: {
+        uint64_t count;
+        if (!reader.readVarint(count) || !reader.readArray(output.keys, count)) {
+            return false;
+        }
+
+        output.keyCount = static_cast<uint32_t>(count);
+        return reader.readVarint(output.requiredSignatureCount);
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+TransactionView::TransactionView()
+    : m_data(nullptr),
+      m_size(0),
+      m_prefixSize(0),
+      m_version(0),
+      m_unlockTime(0),
+      m_extra(nullptr),
+      m_extraSize(0),
+      m_hasSignatures(false)
+{
+}
+
+bool TransactionView::parse(const uint8_t *data, size_t size)
+{
+    return size != 0 && parsePartial(data, size) == size;
+}
+
+size_t TransactionView::parsePartial(const uint8_t *data, size_t size)
+{
+    BlobReader reader(data, size);
+    m_data = data;
+    m_size = 0;
+    m_inputs.clear();
+    m_outputs.clear();
+
+    uint64_t count;
+    if (!reader.readVarint(m_version) || m_version > CURRENT_TRANSACTION_VERSION
+        || !reader.readVarint(m_unlockTime) || !reader.readVarint(count)) {
+        return 0;
+    }
+
+    // every element takes at least a byte, so a broken count ends at the end of the blob
+    for (uint64_t i = 0; i < count; ++i) {
+        m_inputs.emplace_back();
+        if (!readInput(reader, m_inputs.back())) {
+            return 0;
+        }
+    }
+
+    if (!reader.readVarint(count)) {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < count; ++i) {
+        m_outputs.emplace_back();
+        if (!readOutput(reader, m_outputs.back())) {
+            return 0;
+        }
+    }
+
+    uint64_t extraSize;
+    if (!reader.readVarint(extraSize) || !reader.readArray(m_extra, extraSize)) {
+        return 0;
+    }
+
+    m_extraSize = static_cast<size_t>(extraSize);
+    m_prefixSize = static_cast<size_t>(reader.position() - data);
+
+    // a coinbase has no signatures, every other transaction has them for all of its inputs
+    m_hasSignatures = !m_inputs.empty()
+                      && !(m_inputs.size() == 1 && m_inputs[0].type == BASE_INPUT);
+    for (auto &input : m_inputs) {
+        if (m_hasSignatures) {
+            if (!reader.readArray(input.signatures, input.signatureCount)) {
+                return 0;
+            }
+        } else if (input.signatureCount != 0) {
+            return 0;
+        }
+    }
+
+    m_size = static_cast<size_t>(reader.position() - data);
+    return m_size;
+}
+
+Crypto::Hash TransactionView::hash() const
+{
+    Crypto::Hash hash;
+    Crypto::cn_fast_hash(m_data, m_size, hash);
+    return hash;
+}
+
+Crypto::Hash TransactionView::prefixHash() const
+{
+    Crypto::Hash hash;
+    Crypto::cn_fast_hash(m_data, m_prefixSize, hash);
+    return hash;
+}
+
+void TransactionView::getOutputIndexes(const Input &input, std::vector<uint32_t> &outputIndexes)
+{
+    // the indexes were checked by parse, they end where the key image starts
+    BlobReader reader(input.outputIndexes,
+                      reinterpret_cast<const uint8_t *>(input.keyImage) - input.outputIndexes);
+    outputIndexes.resize(input.outputIndexCount);
+    for (auto &index : outputIndexes) {
+        reader.readVarint(index);
+    }
+}
+
+BlockView::BlockView()
+    : m_data(nullptr),
+      m_headerSize(0),
+      m_majorVersion(0),
+      m_minorVersion(0),
+      m_timestamp(0),
+      m_previousBlockHash(nullptr),
+      m_nonce(0),
+      m_transactionCount(0),
+      m_transactionHashes(nullptr)
+{
+}
+
+bool BlockView::parse(const uint8_t *data, size_t size)
+{
+    BlobReader reader(data, size);
+    m_data = data;
+
+    const uint8_t *nonce;
+    if (!reader.readVarint(m_majorVersion) || m_majorVersion > BLOCK_MAJOR_VERSION_6
+        || m_majorVersion < BLOCK_MAJOR_VERSION_1 || !reader.readVarint(m_minorVersion)
+        || !reader.readVarint(m_timestamp) || !reader.readArray(m_previousBlockHash, 1)
+        || !reader.readArray(nonce, sizeof(m_nonce))) {
+        return false;
+    }
+
+    memcpy(&m_nonce, nonce, sizeof(m_nonce));
+    m_headerSize = static_cast<size_t>(reader.position() - data);
+
+    size_t baseTransactionSize = m_baseTransaction.parsePartial(reader.position(),
+                                                                reader.remaining());
+    if (baseTransactionSize == 0) {
+        return false;
+    }
+
+    BlobReader hashesReader(reader.position() + baseTransactionSize,
+                            reader.remaining() - baseTransactionSize);
+    uint64_t count;
+    if (!hashesReader.readVarint(count) || !hashesReader.readArray(m_transactionHashes, count)) {
+        return false;
+    }
+
+    m_transactionCount = static_cast<size_t>(count);
+    return hashesReader.remaining() == 0;
+}
+
+Crypto::Hash BlockView::hash() const
+{
+    std::vector<Crypto::Hash> hashes;
+    hashes.reserve(m_transactionCount + 1);
+    hashes.push_back(m_baseTransaction.hash());
+    hashes.insert(hashes.end(), m_transactionHashes, m_transactionHashes + m_transactionCount);
+
+    BinaryArray hashingBlob(m_data, m_data + m_headerSize);
+    Crypto::Hash treeRootHash = get_tx_tree_hash(hashes);
+    hashingBlob.insert(hashingBlob.end(), treeRootHash.data, treeRootHash.data + 32);
+    auto transactionCount = Common::asBinaryArray(Tools::get_varint_data(hashes.size()));
+    hashingBlob.insert(hashingBlob.end(), transactionCount.begin(), transactionCount.end());
+
+    Crypto::Hash hash;
+    getObjectHash(hashingBlob, hash);
+    return hash;
+}
+
+} // namespace CryptoNote
@@ -0,0 +1,157 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Common/ArrayView.h>
+#include <CryptoNote.h>
+
+namespace CryptoNote {
+
+/*
+ * Read-only access to a serialized transaction without deserializing it into a Transaction.
+ * parse() checks the blob as strictly as fromBinaryArray does and records where the inputs and
+ * outputs are; keys, key images, signatures and extra are returned as pointers into the blob,
+ * which has to outlive the view. A view reused for many blobs keeps its buffers, so parsing
+ * doesn't allocate once they have grown.
+ */
+class TransactionView
+{
+public:
+    enum : uint8_t
+    {
+        BASE_INPUT = 0xff,
+        KEY_INPUT = 0x2,
+        MULTISIGNATURE_INPUT = 0x3,
+        KEY_OUTPUT = 0x2,
+        MULTISIGNATURE_OUTPUT = 0x3
+    };
+
+    struct Input
+    {
+        uint8_t type;
+        uint64_t amount;
+        // base input
+        uint32_t blockIndex;
+        // key input: outputIndexCount varint encoded relative output indexes
+        const uint8_t *outputIndexes;
+        uint32_t outputIndexCount;
+        const Crypto::KeyImage *keyImage;
+        // multisignature input
+        uint32_t outputIndex;
+        uint32_t signatureCount;
+        // this input's signatures, signatureCount of them unless the transaction has none
+        const Crypto::Signature *signatures;
+    };
+
+    struct Output
+    {
+        uint64_t amount;
+        uint8_t type;
+        // the key of a key output, the keyCount keys of a multisignature output
+        const Crypto::PublicKey *keys;
+        uint32_t keyCount;
+        uint8_t requiredSignatureCount;
+    };
+
+    TransactionView();
+
+    // returns false if the blob isn't exactly one valid transaction
+    bool parse(const uint8_t *data, size_t size);
+    bool parse(const BinaryArray &blob) { return parse(blob.data(), blob.size()); }
+
+    uint8_t version() const { return m_version; }
+    uint64_t unlockTime() const { return m_unlockTime; }
+    const std::vector<Input> &inputs() const { return m_inputs; }
+    const std::vector<Output> &outputs() const { return m_outputs; }
+    Common::ArrayView<uint8_t> extra() const { return Common::ArrayView<uint8_t>(m_extra, m_extraSize); }
+    bool hasSignatures() const { return m_hasSignatures; }
+    // the whole transaction and its prefix as they are hashed
+    Common::ArrayView<uint8_t> blob() const { return Common::ArrayView<uint8_t>(m_data, m_size); }
+    Common::ArrayView<uint8_t> prefix() const
+    {
+        return Common::ArrayView<uint8_t>(m_data, m_prefixSize);
+    }
+
+    Crypto::Hash hash() const;
+    Crypto::Hash prefixHash() const;
+
+    // decodes the relative output indexes of a key input
+    static void getOutputIndexes(const Input &input, std::vector<uint32_t> &outputIndexes);
+
+private:
+    friend class BlockView;
+
+    // parses the transaction at the start of the blob, returns its size or 0 if it's invalid
+    size_t parsePartial(const uint8_t *data, size_t size);
+
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_prefixSize;
+    uint8_t m_version;
+    uint64_t m_unlockTime;
+    std::vector<Input> m_inputs;
+    std::vector<Output> m_outputs;
+    const uint8_t *m_extra;
+    size_t m_extraSize;
+    bool m_hasSignatures;
+};
+
+/*
+ * Read-only access to a serialized block, the counterpart of TransactionView. The coinbase is
+ * parsed in place as well, the hashes of the other transactions are pointers into the blob.
+ */
+class BlockView
+{
+public:
+    BlockView();
+
+    // returns false if the blob isn't exactly one valid block
+    bool parse(const uint8_t *data, size_t size);
+    bool parse(const BinaryArray &blob) { return parse(blob.data(), blob.size()); }
+
+    uint8_t majorVersion() const { return m_majorVersion; }
+    uint8_t minorVersion() const { return m_minorVersion; }
+    uint64_t timestamp() const { return m_timestamp; }
+    const Crypto::Hash &previousBlockHash() const { return *m_previousBlockHash; }
+    uint32_t nonce() const { return m_nonce; }
+    const TransactionView &baseTransaction() const { return m_baseTransaction; }
+    size_t transactionCount() const { return m_transactionCount; }
+    const Crypto::Hash *transactionHashes() const { return m_transactionHashes; }
+
+    // the same as getBlockHash of the deserialized block
+    Crypto::Hash hash() const;
+
+private:
+    const uint8_t *m_data;
+    size_t m_headerSize;
+    uint8_t m_majorVersion;
+    uint8_t m_minorVersion;
+    uint64_t m_timestamp;
+    const Crypto::Hash *m_previousBlockHash;
+    uint32_t m_nonce;
+    TransactionView m_baseTransaction;
+    size_t m_transactionCount;
+    const Crypto::Hash *m_transactionHashes;
+};
+
+} // namespace CryptoNote
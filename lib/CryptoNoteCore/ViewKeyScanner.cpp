@@ -0,0 +1,449 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <list>
+#include <CryptoNoteCore/CryptoNoteTools.h>
+#include <CryptoNoteCore/ICore.h>
+#include <CryptoNoteCore/TransactionExtra.h>
+#include <CryptoNoteCore/ViewKeyScanner.h>
+
+using namespace Logging;
+
+namespace CryptoNote {
+
+ViewKeyScanner::ViewKeyScanner(
+    ICore &core,
+    Logging::ILogger &logger,
+    size_t threadCount,
+    size_t batchSize,
+    size_t maxAccounts,
+    uint32_t maxScanDepth)
+    : m_core(core),
+      logger(logger, "ViewKeyScanner"),
+      m_threadCount(std::max<size_t>(threadCount, 1)),
+      m_batchSize(std::max<size_t>(batchSize, 1)),
+      m_maxAccounts(maxAccounts),
+      m_maxScanDepth(maxScanDepth),
+      m_nextAccountId(0),
+      m_updated(false),
+      m_stopped(false)
+{
+    m_core.addObserver(this);
+    m_workerThread = std::thread([this] { workerProcedure(); });
+}
+
+ViewKeyScanner::~ViewKeyScanner()
+{
+    m_core.removeObserver(this);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+
+    m_updatedCondition.notify_one();
+    m_workerThread.join();
+}
+
+ViewKeyScanner::AddResult ViewKeyScanner::addAccount(
+    const AccountPublicAddress &address,
+    const Crypto::SecretKey &viewSecretKey,
+    uint32_t startIndex)
+{
+    Crypto::PublicKey viewPublicKey;
+    if (!Crypto::secretKeyToPublicKey(viewSecretKey, viewPublicKey)
+        || viewPublicKey != address.viewPublicKey) {
+        return AddResult::WrongViewKey;
+    }
+
+    uint32_t topIndex;
+    Crypto::Hash topHash;
+    m_core.get_blockchain_top(topIndex, topHash);
+    if (startIndex < topIndex && topIndex - startIndex > m_maxScanDepth) {
+        return AddResult::StartTooFarBehind;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_accounts.count(address.spendPublicKey) != 0) {
+            return AddResult::AlreadyRegistered;
+        }
+
+        if (m_accounts.size() >= m_maxAccounts) {
+            return AddResult::TooManyAccounts;
+        }
+
+        Account &account = m_accounts[address.spendPublicKey];
+        account.id = m_nextAccountId++;
+        account.address = address;
+        account.viewSecretKey = viewSecretKey;
+        account.nextIndex = startIndex;
+        m_updated = true;
+    }
+
+    m_updatedCondition.notify_one();
+
+    return AddResult::Added;
+}
+
+bool ViewKeyScanner::removeAccount(
+    const AccountPublicAddress &address,
+    const Crypto::SecretKey &viewSecretKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_accounts.find(address.spendPublicKey);
+    if (it == m_accounts.end() || !isRegistered(it->second, address, viewSecretKey)) {
+        return false;
+    }
+
+    m_accounts.erase(it);
+
+    return true;
+}
+
+bool ViewKeyScanner::getOutputs(
+    const AccountPublicAddress &address,
+    const Crypto::SecretKey &viewSecretKey,
+    uint32_t startIndex,
+    std::vector<ViewKeyScannerOutput> &outputs,
+    uint32_t &scannedIndex)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_accounts.find(address.spendPublicKey);
+    if (it == m_accounts.end() || !isRegistered(it->second, address, viewSecretKey)) {
+        return false;
+    }
+
+    const Account &account = it->second;
+    auto first = std::lower_bound(
+        account.outputs.begin(),
+        account.outputs.end(),
+        startIndex,
+        [](const ViewKeyScannerOutput &output, uint32_t index) {
+            return output.blockIndex < index;
+        });
+    outputs.assign(first, account.outputs.end());
+    scannedIndex = account.nextIndex;
+
+    return true;
+}
+
+void ViewKeyScanner::blockchainUpdated()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_updated = true;
+    }
+
+    m_updatedCondition.notify_one();
+}
+
+void ViewKeyScanner::workerProcedure()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_updatedCondition.wait(lock, [this] { return m_updated || m_stopped; });
+        if (m_stopped) {
+            break;
+        }
+
+        m_updated = false;
+        lock.unlock();
+
+        try {
+            while (scanNextBatch()) {
+            }
+        } catch (std::exception &e) {
+            logger(ERROR, BRIGHT_RED) << "Failed to scan blocks: " << e.what();
+        }
+
+        lock.lock();
+    }
+}
+
+bool ViewKeyScanner::scanNextBatch()
+{
+    uint32_t topIndex;
+    Crypto::Hash topHash;
+    m_core.get_blockchain_top(topIndex, topHash);
+
+    size_t mainChainSize = m_blockHashes.size();
+    while (mainChainSize != 0
+           && (mainChainSize - 1 > topIndex
+               || m_core.getBlockIdByHeight(static_cast<uint32_t>(mainChainSize - 1))
+                  != m_blockHashes[mainChainSize - 1])) {
+        --mainChainSize;
+    }
+
+    if (mainChainSize != m_blockHashes.size()) {
+        m_blockHashes.resize(mainChainSize);
+        detachBlocks(static_cast<uint32_t>(mainChainSize));
+    }
+
+    // accounts sharing a view key share the key derivations as well
+    std::vector<ViewKeyGroup> groups;
+    uint32_t startIndex = std::numeric_limits<uint32_t>::max();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopped) {
+            return false;
+        }
+
+        std::unordered_map<Crypto::PublicKey, size_t> groupIndexes;
+        for (const auto &kv : m_accounts) {
+            const Account &account = kv.second;
+            if (account.nextIndex > topIndex) {
+                continue;
+            }
+
+            auto inserted = groupIndexes.emplace(account.address.viewPublicKey, groups.size());
+            if (inserted.second) {
+                groups.push_back(ViewKeyGroup{ account.viewSecretKey, {} });
+            }
+
+            groups[inserted.first->second].accounts.push_back(
+                AccountSnapshot{ account.id, account.address.spendPublicKey, account.nextIndex });
+            startIndex = std::min(startIndex, account.nextIndex);
+        }
+    }
+
+    if (groups.empty()) {
+        return false;
+    }
+
+    uint32_t endIndex = static_cast<uint32_t>(
+        std::min<uint64_t>(static_cast<uint64_t>(topIndex) + 1, startIndex + m_batchSize));
+    std::vector<BlockTransaction> transactions;
+    if (!loadBlocks(startIndex, endIndex, transactions)) {
+        // the chain changed under us, the next update starts over from the new top
+        return false;
+    }
+
+    std::vector<std::vector<std::pair<uint64_t, ViewKeyScannerOutput>>> found(transactions.size());
+    std::atomic<size_t> nextTransaction(0);
+    auto scanFunction = [&]() {
+        for (size_t i = nextTransaction++; i < transactions.size(); i = nextTransaction++) {
+            scanTransaction(transactions[i], groups, found[i]);
+        }
+    };
+
+    size_t workers = std::min(m_threadCount, std::max<size_t>(transactions.size(), 1));
+    std::vector<std::future<void>> scanThreads;
+    for (size_t i = 1; i < workers; ++i) {
+        scanThreads.push_back(std::async(std::launch::async, scanFunction));
+    }
+
+    scanFunction();
+    for (auto &f : scanThreads) {
+        f.get();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Account *> accountsById;
+    for (auto &kv : m_accounts) {
+        accountsById[kv.second.id] = &kv.second;
+    }
+
+    // accounts removed while the batch was scanned are not found by their id anymore
+    for (const auto &transactionOutputs : found) {
+        for (const auto &idAndOutput : transactionOutputs) {
+            auto it = accountsById.find(idAndOutput.first);
+            if (it != accountsById.end()) {
+                it->second->outputs.push_back(idAndOutput.second);
+            }
+        }
+    }
+
+    for (const auto &group : groups) {
+        for (const auto &snapshot : group.accounts) {
+            auto it = accountsById.find(snapshot.id);
+            if (it != accountsById.end()) {
+                it->second->nextIndex = std::max(it->second->nextIndex, endIndex);
+            }
+        }
+    }
+
+    logger(TRACE) << "Scanned blocks " << startIndex << " - " << endIndex - 1 << " for "
+                  << accountsById.size() << " accounts";
+
+    return true;
+}
+
+void ViewKeyScanner::detachBlocks(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &kv : m_accounts) {
+        Account &account = kv.second;
+        if (account.nextIndex <= index) {
+            continue;
+        }
+
+        auto first = std::lower_bound(
+            account.outputs.begin(),
+            account.outputs.end(),
+            index,
+            [](const ViewKeyScannerOutput &output, uint32_t blockIndex) {
+                return output.blockIndex < blockIndex;
+            });
+        account.outputs.erase(first, account.outputs.end());
+        account.nextIndex = index;
+    }
+
+    logger(DEBUGGING) << "Detached scanned blocks from " << index;
+}
+
+bool ViewKeyScanner::loadBlocks(
+    uint32_t startIndex,
+    uint32_t endIndex,
+    std::vector<BlockTransaction> &transactions)
+{
+    while (m_blockHashes.size() < startIndex) {
+        m_blockHashes.push_back(
+            m_core.getBlockIdByHeight(static_cast<uint32_t>(m_blockHashes.size())));
+    }
+
+    for (uint32_t index = startIndex; index < endIndex; ++index) {
+        Crypto::Hash blockHash = m_core.getBlockIdByHeight(index);
+        if (index < m_blockHashes.size()) {
+            if (m_blockHashes[index] != blockHash) {
+                return false;
+            }
+        } else {
+            m_blockHashes.push_back(blockHash);
+        }
+
+        Block block;
+        if (!m_core.getBlockByHash(blockHash, block)) {
+            return false;
+        }
+
+        std::vector<Crypto::Hash> transactionHashes;
+        transactionHashes.reserve(block.transactionHashes.size() + 1);
+        transactionHashes.push_back(getObjectHash(block.baseTransaction));
+        transactionHashes.insert(transactionHashes.end(),
+                                 block.transactionHashes.begin(),
+                                 block.transactionHashes.end());
+
+        std::list<Crypto::Hash> missedTransactions;
+        std::vector<std::pair<Transaction, std::vector<uint32_t>>> blockTransactions;
+        if (!m_core.getTransactionsWithOutputGlobalIndexes(transactionHashes,
+                                                           missedTransactions,
+                                                           blockTransactions)
+            || !missedTransactions.empty()
+            || blockTransactions.size() != transactionHashes.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < blockTransactions.size(); ++i) {
+            transactions.push_back(BlockTransaction{ index,
+                                                     transactionHashes[i],
+                                                     std::move(blockTransactions[i].first),
+                                                     std::move(blockTransactions[i].second) });
+        }
+    }
+
+    return true;
+}
+
+void ViewKeyScanner::scanTransaction(
+    const BlockTransaction &transaction,
+    const std::vector<ViewKeyGroup> &groups,
+    std::vector<std::pair<uint64_t, ViewKeyScannerOutput>> &found) const
+{
+    const Transaction &tx = transaction.transaction;
+    Crypto::PublicKey transactionPublicKey = getTransactionPublicKeyFromExtra(tx.extra);
+
+    auto matchOutput = [&](const ViewKeyGroup &group,
+                           const Crypto::KeyDerivation &derivation,
+                           const Crypto::PublicKey &key,
+                           size_t keyIndex,
+                           size_t outputIndex) {
+        Crypto::PublicKey spendPublicKey;
+        if (!Crypto::underivePublicKey(derivation, keyIndex, key, spendPublicKey)) {
+            return;
+        }
+
+        for (const auto &account : group.accounts) {
+            if (account.spendPublicKey != spendPublicKey
+                || account.nextIndex > transaction.blockIndex) {
+                continue;
+            }
+
+            ViewKeyScannerOutput output;
+            output.blockIndex = transaction.blockIndex;
+            output.transactionHash = transaction.hash;
+            output.transactionPublicKey = transactionPublicKey;
+            output.unlockTime = tx.unlockTime;
+            output.outputInTransaction = static_cast<uint32_t>(outputIndex);
+            output.globalOutputIndex = outputIndex < transaction.globalIndexes.size()
+                                       ? transaction.globalIndexes[outputIndex]
+                                       : 0;
+            output.amount = tx.outputs[outputIndex].amount;
+            output.outputKey = key;
+            found.emplace_back(account.id, output);
+        }
+    };
+
+    for (const auto &group : groups) {
+        bool blockNeeded = std::any_of(
+            group.accounts.begin(),
+            group.accounts.end(),
+            [&transaction](const AccountSnapshot &account) {
+                return account.nextIndex <= transaction.blockIndex;
+            });
+        if (!blockNeeded) {
+            continue;
+        }
+
+        Crypto::KeyDerivation derivation;
+        if (!Crypto::generateKeyDerivation(transactionPublicKey, group.viewSecretKey, derivation)) {
+            continue;
+        }
+
+        // output keys are derived the same way as in TransfersConsumer
+        size_t keyIndex = 0;
+        for (size_t idx = 0; idx < tx.outputs.size(); ++idx) {
+            const auto &target = tx.outputs[idx].target;
+            if (target.type() == typeid(KeyOutput)) {
+                matchOutput(group, derivation, boost::get<KeyOutput>(target).key, keyIndex, idx);
+                ++keyIndex;
+            } else if (target.type() == typeid(MultiSignatureOutput)) {
+                for (const auto &key : boost::get<MultiSignatureOutput>(target).keys) {
+                    matchOutput(group, derivation, key, idx, idx);
+                    ++keyIndex;
+                }
+            }
+        }
+    }
+}
+
+bool ViewKeyScanner::isRegistered(
+    const Account &account,
+    const AccountPublicAddress &address,
+    const Crypto::SecretKey &viewSecretKey) const
+{
+    return account.address.viewPublicKey == address.viewPublicKey
+           && account.viewSecretKey == viewSecretKey;
+}
+
+} // namespace CryptoNote
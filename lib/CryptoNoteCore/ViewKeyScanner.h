@@ -0,0 +1,169 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <CryptoNoteCore/ICoreObserver.h>
+#include <Logging/LoggerRef.h>
+#include <CryptoNote.h>
+
+namespace CryptoNote {
+
+class ICore;
+
+struct ViewKeyScannerOutput
+{
+    uint32_t blockIndex;
+    Crypto::Hash transactionHash;
+    Crypto::PublicKey transactionPublicKey;
+    uint64_t unlockTime;
+    uint32_t outputInTransaction;
+    uint32_t globalOutputIndex;
+    uint64_t amount;
+    Crypto::PublicKey outputKey;
+};
+
+/*
+ * Scans the main chain for the outputs of registered accounts, so that light wallets don't have
+ * to download and scan every block themselves. Each block is read from the core once and all
+ * registered accounts are checked against it in a single pass: the transactions of a batch of
+ * blocks are spread over the worker threads, and per transaction one key derivation is made per
+ * distinct view key, after which each output is matched against the spend keys of all accounts
+ * sharing it.
+ *
+ * The scan runs on a background thread which wakes up when the blockchain changes. Outputs found
+ * in blocks that leave the main chain are dropped again.
+ *
+ * Every account costs a key derivation per transaction and an account starting far behind the tip
+ * makes the scanner read all blocks since its start once more, so both the number of accounts and
+ * how far behind the tip an account may start are limited.
+ */
+class ViewKeyScanner : public ICoreObserver
+{
+public:
+    static const size_t DEFAULT_BATCH_SIZE = 100;
+    static const size_t DEFAULT_MAX_ACCOUNTS = 1000;
+    // about 30 days of blocks
+    static const uint32_t DEFAULT_MAX_SCAN_DEPTH = 21600;
+
+    enum class AddResult
+    {
+        Added,
+        WrongViewKey,
+        AlreadyRegistered,
+        TooManyAccounts,
+        StartTooFarBehind
+    };
+
+    ViewKeyScanner(ICore &core,
+                   Logging::ILogger &logger,
+                   size_t threadCount = std::thread::hardware_concurrency(),
+                   size_t batchSize = DEFAULT_BATCH_SIZE,
+                   size_t maxAccounts = DEFAULT_MAX_ACCOUNTS,
+                   uint32_t maxScanDepth = DEFAULT_MAX_SCAN_DEPTH);
+    ViewKeyScanner(const ViewKeyScanner &) = delete;
+    ~ViewKeyScanner();
+
+    ViewKeyScanner &operator=(const ViewKeyScanner &) = delete;
+
+    // the account is scanned from startIndex on, which may lie at most maxScanDepth blocks
+    // behind the tip
+    AddResult addAccount(const AccountPublicAddress &address,
+                    const Crypto::SecretKey &viewSecretKey,
+                    uint32_t startIndex);
+    bool removeAccount(const AccountPublicAddress &address, const Crypto::SecretKey &viewSecretKey);
+
+    // Returns the outputs of the account found in blocks from startIndex on and the index of the
+    // first block not scanned yet. Returns false if the account isn't registered with this key.
+    bool getOutputs(const AccountPublicAddress &address,
+                    const Crypto::SecretKey &viewSecretKey,
+                    uint32_t startIndex,
+                    std::vector<ViewKeyScannerOutput> &outputs,
+                    uint32_t &scannedIndex);
+
+    void blockchainUpdated() override;
+
+private:
+    struct Account
+    {
+        uint64_t id;
+        AccountPublicAddress address;
+        Crypto::SecretKey viewSecretKey;
+        uint32_t nextIndex;
+        std::vector<ViewKeyScannerOutput> outputs;
+    };
+
+    struct BlockTransaction
+    {
+        uint32_t blockIndex;
+        Crypto::Hash hash;
+        Transaction transaction;
+        std::vector<uint32_t> globalIndexes;
+    };
+
+    struct AccountSnapshot
+    {
+        uint64_t id;
+        Crypto::PublicKey spendPublicKey;
+        uint32_t nextIndex;
+    };
+
+    struct ViewKeyGroup
+    {
+        Crypto::SecretKey viewSecretKey;
+        std::vector<AccountSnapshot> accounts;
+    };
+
+    void workerProcedure();
+    bool scanNextBatch();
+    void detachBlocks(uint32_t index);
+    bool loadBlocks(uint32_t startIndex,
+                    uint32_t endIndex,
+                    std::vector<BlockTransaction> &transactions);
+    void scanTransaction(const BlockTransaction &transaction,
+                         const std::vector<ViewKeyGroup> &groups,
+                         std::vector<std::pair<uint64_t, ViewKeyScannerOutput>> &found) const;
+    bool isRegistered(const Account &account, const AccountPublicAddress &address,
+                      const Crypto::SecretKey &viewSecretKey) const;
+
+private:
+    ICore &m_core;
+    Logging::LoggerRef logger;
+    const size_t m_threadCount;
+    const size_t m_batchSize;
+    const size_t m_maxAccounts;
+    const uint32_t m_maxScanDepth;
+    // hashes of the main chain blocks seen by the scanner, used to notice reorganizations
+    std::vector<Crypto::Hash> m_blockHashes;
+    std::unordered_map<Crypto::PublicKey, Account> m_accounts;
+    uint64_t m_nextAccountId;
+    bool m_updated;
+    bool m_stopped;
+    std::mutex m_mutex;
+    std::condition_variable m_updatedCondition;
+    std::thread m_workerThread;
+};
+
+} // namespace CryptoNote
@@ -26,6 +26,7 @@
 #include <CryptoNoteCore/CryptoNoteFormatUtils.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/Currency.h>
+#include <CryptoNoteCore/TransactionView.h>
 #include <CryptoNoteCore/VerificationContext.h>
 #include <CryptoNoteProtocol/CryptoNoteProtocolHandler.h>
 #include <Global/Constants.h>
@@ -377,21 +378,25 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(
         return 1;
     }
 
-    for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();) {
-        auto transactionBinary = asBinaryArray(*tx_blob_it);
-        Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(),
-                                                            transactionBinary.size());
+    std::vector<BinaryArray> transactions;
+    transactions.reserve(arg.txs.size());
+    for (const auto &tx_blob : arg.txs) {
+        transactions.push_back(asBinaryArray(tx_blob));
         logger(DEBUGGING)
             << "transaction "
-            << transactionHash
+            << Crypto::cn_fast_hash(transactions.back().data(), transactions.back().size())
             << " came in NOTIFY_NEW_TRANSACTIONS";
+    }
 
-        CryptoNote::tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-        m_core.handle_incoming_tx(transactionBinary, tvc, false, false);
-        if (tvc.m_verification_failed) {
+    std::vector<CryptoNote::tx_verification_context> tvcs;
+    m_core.handleIncomingTransactions(transactions, tvcs);
+
+    auto tvc = tvcs.begin();
+    for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end(); ++tvc) {
+        if (tvc->m_verification_failed) {
             logger(Logging::DEBUGGING) << context << "Tx verification failed";
         }
-        if (!tvc.m_verification_failed && tvc.m_should_be_relayed) {
+        if (!tvc->m_verification_failed && tvc->m_should_be_relayed) {
             ++tx_blob_it;
         } else {
             tx_blob_it = arg.txs.erase(tx_blob_it);
@@ -474,10 +479,12 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(
     context.m_remote_blockchain_height = arg.current_blockchain_height;
 
     size_t count = 0;
+    // only the hash and the transaction count are needed here, the core parses the blocks
+    BlockView b;
     for (const BlockCompleteEntry & block_entry : arg.blocks) {
         ++count;
-        Block b;
-        if (!fromBinaryArray(b, asBinaryArray(block_entry.block))) {
+        if (!b.parse(reinterpret_cast<const uint8_t *>(block_entry.block.data()),
+                     block_entry.block.size())) {
             logger(Logging::ERROR)
                 << context
                 << "sent wrong block: failed to parse and validate block: \r\n"
@@ -490,7 +497,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(
         // to avoid concurrency in core between connections,
         // suspend connections which delivered block later then first one
         if (count == 2) {
-            if (m_core.have_block(getBlockHash(b))) {
+            if (m_core.have_block(b.hash())) {
                 context.m_state = CryptoNoteConnectionContext::state_idle;
                 context.m_needed_objects.clear();
                 context.m_requested_objects.clear();
@@ -499,7 +506,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(
             }
         }
 
-        auto blockHash = getBlockHash(b);
+        auto blockHash = b.hash();
         auto req_it = context.m_requested_objects.find(blockHash);
         if (req_it == context.m_requested_objects.end()) {
             logger(Logging::ERROR)
@@ -510,12 +517,12 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(
                 context.m_state = CryptoNoteConnectionContext::state_shutdown;
                 return 1;
         }
-        if (b.transactionHashes.size() != block_entry.txs.size()) {
+        if (b.transactionCount() != block_entry.txs.size()) {
             logger(Logging::ERROR)
                 << context
                 << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id="
                 << Common::podToHex(blockHash)
-                << ", transactionHashes.size()=" << b.transactionHashes.size()
+                << ", transactionHashes.size()=" << b.transactionCount()
                 << " mismatch with BlockCompleteEntry.m_txs.size()=" << block_entry.txs.size()
                 << ", dropping connection";
             context.m_state = CryptoNoteConnectionContext::state_shutdown;
@@ -134,6 +134,8 @@ static_assert(UPGRADE_VOTING_WINDOW > 1, "Bad UPGRADE_VOTING_WINDOW");
 const char     CRYPTONOTE_BLOCKS_FILENAME[]                  = "blocks.bin";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]            = "blockindexes.bin";
 const char     CRYPTONOTE_BLOCKSCACHE_FILENAME[]             = "blockscache.bin";
+const char     CRYPTONOTE_COMPACTBLOCKS_FILENAME[]           = "compactblocks.bin";
+const char     CRYPTONOTE_COMPACTBLOCKINDEXES_FILENAME[]     = "compactblockindexes.bin";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]                = "poolstate.dat";
 const char     P2P_NET_DATA_FILENAME[]                       = "p2pstate.dat";
 const char     CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME[]      = "blockchainindices.bin";
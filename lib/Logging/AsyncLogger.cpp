@@ -0,0 +1,120 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <string>
+#include <Logging/AsyncLogger.h>
+
+namespace Logging {
+
+AsyncLogger::AsyncLogger(ILogger &logger, size_t capacity)
+    : m_logger(logger),
+      m_records(std::max<size_t>(capacity, 1)),
+      m_first(0),
+      m_count(0),
+      m_dropped(0),
+      m_stopped(false),
+      m_waiting(false)
+{
+    m_workerThread = std::thread([this] { workerProcedure(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+
+    m_recordsAdded.notify_one();
+    m_workerThread.join();
+}
+
+void AsyncLogger::operator()(const std::string &category,
+                             Level level,
+                             boost::posix_time::ptime time,
+                             const std::string &body)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_count == m_records.size()) {
+        ++m_dropped;
+        return;
+    }
+
+    Record &record = m_records[(m_first + m_count) % m_records.size()];
+    record.category = category;
+    record.level = level;
+    record.time = time;
+    record.body = body;
+    ++m_count;
+
+    bool wakeUp = m_waiting;
+    lock.unlock();
+
+    if (wakeUp) {
+        m_recordsAdded.notify_one();
+    }
+}
+
+bool AsyncLogger::isEnabled(Level level) const
+{
+    return m_logger.isEnabled(level);
+}
+
+void AsyncLogger::workerProcedure()
+{
+    std::vector<Record> batch;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_waiting = true;
+        m_recordsAdded.wait(lock, [this] { return m_count != 0 || m_stopped; });
+        m_waiting = false;
+
+        if (m_count == 0) {
+            break;
+        }
+
+        // take everything written so far, the slots are refilled while the batch is logged
+        batch.clear();
+        for (; m_count != 0; --m_count) {
+            batch.push_back(std::move(m_records[m_first]));
+            m_first = (m_first + 1) % m_records.size();
+        }
+
+        size_t dropped = m_dropped;
+        m_dropped = 0;
+        lock.unlock();
+
+        for (const auto &record : batch) {
+            m_logger(record.category, record.level, record.time, record.body);
+        }
+
+        if (dropped != 0) {
+            m_logger("AsyncLogger",
+                     WARNING,
+                     boost::posix_time::microsec_clock::local_time(),
+                     std::to_string(dropped) + " log messages dropped\n");
+        }
+
+        lock.lock();
+    }
+}
+
+} // namespace Logging
@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Logging/ILogger.h>
+
+namespace Logging {
+
+// Hands messages over to a background thread through a bounded ring buffer, so that a slow
+// stream never blocks the logging threads. Messages are dropped while the buffer is full.
+class AsyncLogger : public ILogger
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 8192;
+
+    explicit AsyncLogger(ILogger &logger, size_t capacity = DEFAULT_CAPACITY);
+    AsyncLogger(const AsyncLogger &) = delete;
+    ~AsyncLogger();
+
+    AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+    void operator()(const std::string &category,
+                    Level level,
+                    boost::posix_time::ptime time,
+                    const std::string &body) override;
+    bool isEnabled(Level level) const override;
+
+private:
+    struct Record
+    {
+        std::string category;
+        Level level;
+        boost::posix_time::ptime time;
+        std::string body;
+    };
+
+    void workerProcedure();
+
+private:
+    ILogger &m_logger;
+    std::vector<Record> m_records;
+    size_t m_first;
+    size_t m_count;
+    size_t m_dropped;
+    bool m_stopped;
+    bool m_waiting;
+    std::mutex m_mutex;
+    std::condition_variable m_recordsAdded;
+    std::thread m_workerThread;
+};
+
+} // namespace Logging
@@ -104,12 +104,24 @@ void CommonLogger::operator()(const std::string &category,
     }
 }
 
+bool CommonLogger::isEnabled(Level level) const
+{
+    return level <= m_logLevel;
+}
+
 CommonLogger::CommonLogger(Level level)
     : m_logLevel(level),
       m_pattern("%D %T %L [%C] ")
 {
 }
 
+CommonLogger::CommonLogger(const CommonLogger &other)
+    : m_disabledCategories(other.m_disabledCategories),
+      m_logLevel(other.m_logLevel.load()),
+      m_pattern(other.m_pattern)
+{
+}
+
 void CommonLogger::doLogString(const std::string &message)
 {
 }
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <set>
 #include <Logging/ILogger.h>
 
@@ -37,15 +38,17 @@ public:
                     Level level,
                     boost::posix_time::ptime time,
                     const std::string &body) override;
+    bool isEnabled(Level level) const override;
 
 protected:
     explicit CommonLogger(Level level);
+    CommonLogger(const CommonLogger &other);
 
     virtual void doLogString(const std::string &message);
 
 protected:
     std::set<std::string> m_disabledCategories;
-    Level m_logLevel;
+    std::atomic<Level> m_logLevel;
     std::string m_pattern;
 };
 
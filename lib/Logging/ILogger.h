@@ -64,6 +64,12 @@ public:
                             Level level,
                             boost::posix_time::ptime time,
                             const std::string &body) = 0;
+
+    // Lets messages that would be dropped anyway skip their formatting
+    virtual bool isEnabled(Level level) const
+    {
+        return true;
+    }
 };
 
 #ifndef ENDL
@@ -29,6 +29,7 @@ using Common::JsonValue;
 void LoggerManager::configure(const JsonValue &val)
 {
     std::unique_lock<std::mutex> lock(reconfigureLock);
+    asyncLoggers.clear();
     loggers.clear();
     LoggerGroup::m_loggers.clear();
     Level globalLevel;
@@ -105,7 +106,13 @@ void LoggerManager::configure(const JsonValue &val)
                 }
 
                 loggers.emplace_back(std::move(logger));
-                addLogger(*loggers.back());
+                if (loggerConfiguration.contains("async")
+                    && loggerConfiguration("async").getBool()) {
+                    asyncLoggers.emplace_back(new AsyncLogger(*loggers.back()));
+                    addLogger(*asyncLoggers.back());
+                } else {
+                    addLogger(*loggers.back());
+                }
             }
         } else {
             throw std::runtime_error("loggers parameter has wrong type");
@@ -23,6 +23,7 @@
 #include <memory>
 #include <mutex>
 #include <Common/JsonValue.h>
+#include <Logging/AsyncLogger.h>
 #include <Logging/LoggerGroup.h>
 
 namespace Logging {
@@ -41,6 +42,7 @@ public:
 
 private:
     std::vector<std::unique_ptr<CommonLogger>> loggers;
+    std::vector<std::unique_ptr<AsyncLogger>> asyncLoggers; // write to loggers, so destroyed first
     std::mutex reconfigureLock;
 };
 
@@ -40,23 +40,31 @@ LoggerMessage::LoggerMessage(ILogger &logger,
     : std::ostream(this),
       std::streambuf(),
       m_logger(logger),
-      m_sCategory(category),
+      m_bEnabled(logger.isEnabled(level)),
+      m_sCategory(m_bEnabled ? category : std::string()),
       m_nLogLevel(level),
-      m_sMessage(color),
-      m_tmTimeStamp(boost::posix_time::microsec_clock::local_time()),
+      m_sMessage(m_bEnabled ? color : std::string()),
+      m_tmTimeStamp(m_bEnabled
+                    ? boost::posix_time::microsec_clock::local_time()
+                    : boost::posix_time::ptime()),
       m_bGotText(false)
 {
+    if (!m_bEnabled) {
+        // formatted output stops at the stream sentry, so nothing is formatted at all
+        setstate(std::ios_base::badbit);
+    }
 }
 
 #if defined __linux__ && !defined __ANDROID__
 LoggerMessage::LoggerMessage(LoggerMessage &&other) noexcept
     : std::ostream(nullptr),
       std::streambuf(),
+      m_logger(other.m_logger),
+      m_bEnabled(other.m_bEnabled),
       m_sCategory(other.m_sCategory),
       m_nLogLevel(other.m_nLogLevel),
-      m_logger(other.m_logger),
       m_sMessage(other.m_sMessage),
-      m_tmTimeStamp(boost::posix_time::microsec_clock::local_time()),
+      m_tmTimeStamp(other.m_tmTimeStamp),
       m_bGotText(false)
 {
     if (this != &other) {
@@ -101,10 +109,11 @@ LoggerMessage::LoggerMessage(LoggerMessage &&other) noexcept
     : std::ostream(std::move(other)),
       std::streambuf(std::move(other)),
       m_logger(other.m_logger),
+      m_bEnabled(other.m_bEnabled),
       m_sCategory(other.m_sCategory),
       m_nLogLevel(other.m_nLogLevel),
       m_sMessage(other.m_sMessage),
-      m_tmTimeStamp(boost::posix_time::microsec_clock::local_time()),
+      m_tmTimeStamp(other.m_tmTimeStamp),
       m_bGotText(false)
 {
     std::ostream::rdbuf(this);
@@ -120,6 +129,10 @@ LoggerMessage::~LoggerMessage()
 
 int LoggerMessage::sync()
 {
+    if (!m_bEnabled) {
+        return 0;
+    }
+
     m_logger(m_sCategory, m_nLogLevel, m_tmTimeStamp, m_sMessage);
     m_bGotText = false;
     m_sMessage = Logging::DEFAULT;
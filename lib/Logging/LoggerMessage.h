@@ -53,6 +53,7 @@ private:
 
 private:
     ILogger &m_logger;
+    const bool m_bEnabled;
     const std::string m_sCategory;
     Level m_nLogLevel;
     std::string m_sMessage;
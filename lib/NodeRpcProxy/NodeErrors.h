@@ -35,7 +35,9 @@ enum NodeErrorCodes
     NODE_BUSY,
     INTERNAL_NODE_ERROR,
     REQUEST_ERROR,
-    CONNECT_ERROR
+    CONNECT_ERROR,
+    TIMEOUT,
+    UNSUPPORTED_REQUEST
 };
 
 // custom category:
@@ -71,6 +73,10 @@ public:
             return "Error in request parameters";
         case CONNECT_ERROR:
             return "Can't connect to daemon";
+        case TIMEOUT:
+            return "Daemon request timed out";
+        case UNSUPPORTED_REQUEST:
+            return "Request is not supported by daemon";
         default:
             return "Unknown error";
         }
@@ -17,10 +17,12 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <atomic>
 #include <system_error>
 #include <thread>
 #include <Common/StringTools.h>
+#include <CryptoNoteCore/CompactBlock.h>
 #include <CryptoNoteCore/CryptoNoteBasicImpl.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/TransactionApi.h>
@@ -35,8 +37,8 @@
 #include <System/ContextGroup.h>
 #include <System/Dispatcher.h>
 #include <System/Event.h>
+#include <System/InterruptedException.h>
 #include <System/Timer.h>
-#include <System/EventLock.h>
 
 #ifndef AUTO_VAL_INIT
 #define AUTO_VAL_INIT(n) boost::value_initialized<decltype(n)>()
@@ -51,6 +53,8 @@ namespace CryptoNote {
 
 namespace {
 
+const size_t DEFAULT_CONNECTION_COUNT = 4;
+
 std::error_code interpretResponseStatus(const std::string &status)
 {
     if (CORE_RPC_STATUS_BUSY == status) {
@@ -64,8 +68,49 @@ std::error_code interpretResponseStatus(const std::string &status)
 
 } // namespace
 
+// Takes an idle daemon connection for a single request, waiting until one is released
+class NodeRpcProxy::HttpClientLease
+{
+public:
+    explicit HttpClientLease(NodeRpcProxy &proxy)
+        : m_proxy(proxy)
+    {
+        while (m_proxy.m_idleHttpClients.empty()) {
+            m_proxy.m_httpEvent->clear();
+            m_proxy.m_httpEvent->wait();
+        }
+
+        m_httpClient = m_proxy.m_idleHttpClients.back();
+        m_proxy.m_idleHttpClients.pop_back();
+    }
+
+    HttpClientLease(const HttpClientLease &) = delete;
+    HttpClientLease &operator=(const HttpClientLease &) = delete;
+
+    ~HttpClientLease()
+    {
+        if (!m_httpClient->isConnected()) {
+            m_proxy.dropIdleConnections();
+        }
+
+        m_proxy.m_idleHttpClients.push_back(m_httpClient);
+        m_proxy.m_httpEvent->set();
+    }
+
+    HttpClient &httpClient()
+    {
+        return *m_httpClient;
+    }
+
+private:
+    NodeRpcProxy &m_proxy;
+    HttpClient *m_httpClient;
+};
+
 NodeRpcProxy::NodeRpcProxy(const std::string &nodeHost, unsigned short nodePort)
     : m_rpcTimeout(10000),
+      m_blocksRpcTimeout(0),
+      m_connectionCount(DEFAULT_CONNECTION_COUNT),
       m_pullInterval(5000),
       m_nodeHost(nodeHost),
       m_nodePort(nodePort),
@@ -154,6 +199,8 @@ void NodeRpcProxy::resetInternalState()
     lastLocalBlockHeaderInfo.difficulty = 0;
     lastLocalBlockHeaderInfo.reward = 0;
     m_knownTxs.clear();
+    m_knownPoolVersion = 0;
+    m_compactBlocksSupported = true;
 }
 
 void NodeRpcProxy::workerThread(const INode::Callback &initialized_callback)
@@ -161,13 +208,17 @@ void NodeRpcProxy::workerThread(const INode::Callback &initialized_callback)
     try {
         Dispatcher dispatcher;
         m_dispatcher = &dispatcher;
-        ContextGroup contextGroup(dispatcher);
-        m_context_group = &contextGroup;
-        HttpClient httpClient(dispatcher, m_nodeHost, m_nodePort);
-        m_httpClient = &httpClient;
+        std::vector<std::unique_ptr<HttpClient>> httpClients;
+        for (size_t i = 0; i < std::max<size_t>(m_connectionCount, 1); ++i) {
+            httpClients.emplace_back(new HttpClient(dispatcher, m_nodeHost, m_nodePort));
+            m_httpClients.push_back(httpClients.back().get());
+            m_idleHttpClients.push_back(httpClients.back().get());
+        }
+
         Event httpEvent(dispatcher);
         m_httpEvent = &httpEvent;
-        m_httpEvent->set();
+        ContextGroup contextGroup(dispatcher);
+        m_context_group = &contextGroup;
 
         {
             std::lock_guard<std::mutex> lock(m_mutex);
@@ -199,7 +250,8 @@ void NodeRpcProxy::workerThread(const INode::Callback &initialized_callback)
 
     m_dispatcher = nullptr;
     m_context_group = nullptr;
-    m_httpClient = nullptr;
+    m_idleHttpClients.clear();
+    m_httpClients.clear();
     m_httpEvent = nullptr;
     m_connected = false;
     m_rpcProxyObserverManager.notify(&INodeRpcProxyObserver::connectionStatusUpdated, m_connected);
@@ -222,12 +274,15 @@ bool NodeRpcProxy::updatePoolStatus()
     bool isBcActual = false;
     std::vector<std::unique_ptr<ITransactionReader>> addedTxs;
     std::vector<Crypto::Hash> deletedTxsIds;
+    uint64_t poolVersion = 0;
 
     std::error_code ec = doGetPoolSymmetricDifference(std::move(knownTxs),
                                                       tailBlock,
+                                                      m_knownPoolVersion,
                                                       isBcActual,
                                                       addedTxs,
-                                                      deletedTxsIds);
+                                                      deletedTxsIds,
+                                                      poolVersion);
     if (ec) {
         return true;
     }
@@ -241,6 +296,8 @@ bool NodeRpcProxy::updatePoolStatus()
         m_observerManager.notify(&INodeObserver::poolChanged);
     }
 
+    m_knownPoolVersion = poolVersion;
+
     return true;
 }
 
@@ -305,13 +362,34 @@ void NodeRpcProxy::updateBlockchainStatus()
         m_GRBHeight.store(getInfoResp.height, std::memory_order_relaxed);
     }
 
-    if (m_connected != m_httpClient->isConnected()) {
-        m_connected = m_httpClient->isConnected();
+    updateConnectionStatus();
+}
+
+void NodeRpcProxy::updateConnectionStatus()
+{
+    // the daemon is reachable while any pooled connection is open, a failed request closes the
+    // idle ones too, see dropIdleConnections
+    bool connected = std::any_of(m_httpClients.begin(),
+                                 m_httpClients.end(),
+                                 [](const HttpClient *client) { return client->isConnected(); });
+    if (m_connected != connected) {
+        m_connected = connected;
         m_rpcProxyObserverManager.notify(&INodeRpcProxyObserver::connectionStatusUpdated,
                                          m_connected);
     }
 }
 
+void NodeRpcProxy::dropIdleConnections()
+{
+    // a connection that failed makes the idle ones suspect as well, they reconnect on next use
+    // instead of reporting a daemon that is gone as connected
+    for (HttpClient *client : m_idleHttpClients) {
+        if (client->isConnected()) {
+            client->disconnect();
+        }
+    }
+}
+
 void NodeRpcProxy::updatePeerCount(size_t peerCount)
 {
     if (peerCount != m_peerCount) {
@@ -471,7 +549,8 @@ void NodeRpcProxy::getNewBlocks(std::vector<Crypto::Hash> &&knownBlockIds,
             std::ref(newBlocks),
             std::ref(startHeight)
         ),
-        callback);
+        callback,
+        m_blocksRpcTimeout);
 }
 
 void NodeRpcProxy::getTransactionOutsGlobalIndices(const Crypto::Hash &transactionHash,
@@ -508,14 +587,15 @@ void NodeRpcProxy::queryBlocks(std::vector<Crypto::Hash> &&knownBlockIds,
 
     scheduleRequest(
         std::bind(
-            &NodeRpcProxy::doQueryBlocksLite,
+            &NodeRpcProxy::doQueryBlocks,
             this,
             std::move(knownBlockIds),
             timestamp,
             std::ref(newBlocks),
             std::ref(startHeight)
         ),
-        callback);
+        callback,
+        m_blocksRpcTimeout);
 }
 
 void NodeRpcProxy::getPoolSymmetricDifference(
@@ -539,11 +619,14 @@ void NodeRpcProxy::getPoolSymmetricDifference(
         &isBcActual,
         &newTxs,
         &deletedTxIds] () mutable -> std::error_code {
+        uint64_t poolVersion = 0;
         return this->doGetPoolSymmetricDifference(std::move(knownPoolTxIds),
                                                   knownBlockId,
+                                                  0,
                                                   isBcActual,
                                                   newTxs,
-                                                  deletedTxIds);
+                                                  deletedTxIds,
+                                                  poolVersion);
     }, callback);
 }
 
@@ -733,6 +816,79 @@ std::error_code NodeRpcProxy::doGetTransactionOutsGlobalIndices(
     return ec;
 }
 
+std::error_code NodeRpcProxy::doQueryBlocks(const std::vector<Crypto::Hash> &knownBlockIds,
+                                            uint64_t timestamp,
+                                            std::vector<CryptoNote::BlockShortEntry> &newBlocks,
+                                            uint32_t &startHeight)
+{
+    if (m_compactBlocksSupported) {
+        std::error_code ec = doQueryBlocksCompact(knownBlockIds, timestamp, newBlocks, startHeight);
+        if (ec != make_error_code(error::UNSUPPORTED_REQUEST)) {
+            // transient failures are retried with the compact format on the next query
+            return ec;
+        }
+
+        // older daemons answer the unknown url with 404
+        m_compactBlocksSupported = false;
+    }
+
+    return doQueryBlocksLite(knownBlockIds, timestamp, newBlocks, startHeight);
+}
+
+std::error_code NodeRpcProxy::doQueryBlocksCompact(
+    const std::vector<Crypto::Hash> &knownBlockIds,
+    uint64_t timestamp,
+    std::vector<CryptoNote::BlockShortEntry> &newBlocks,
+    uint32_t &startHeight)
+{
+    CryptoNote::COMMAND_RPC_QUERY_BLOCKS_COMPACT::request req = AUTO_VAL_INIT(req);
+    CryptoNote::COMMAND_RPC_QUERY_BLOCKS_COMPACT::response rsp = AUTO_VAL_INIT(rsp);
+
+    req.blockIds = knownBlockIds;
+    req.timestamp = timestamp;
+
+    std::error_code ec = binaryCommand("/queryblockscompact.bin", req, rsp);
+    if (ec) {
+        return ec;
+    }
+
+    std::vector<BlockShortEntry> blocks;
+    try {
+        CompactBlocksReader reader(rsp.blocks);
+        CompactBlock compactBlock;
+        while (reader.read(compactBlock)) {
+            BlockShortEntry bse;
+            bse.blockHash = compactBlock.hash;
+            bse.hasBlock = compactBlock.hasTransactions;
+            if (bse.hasBlock) {
+                if (compactBlock.transactions.empty()) {
+                    return std::make_error_code(std::errc::invalid_argument);
+                }
+
+                // only the timestamp and the coinbase of the block are used by the wallets
+                bse.block.timestamp = compactBlock.timestamp;
+                static_cast<TransactionPrefix &>(bse.block.baseTransaction) =
+                    std::move(compactBlock.transactions.front().prefix);
+                for (size_t i = 1; i < compactBlock.transactions.size(); ++i) {
+                    TransactionShortInfo tsi;
+                    tsi.txId = compactBlock.transactions[i].hash;
+                    tsi.txPrefix = std::move(compactBlock.transactions[i].prefix);
+                    bse.txsShortInfo.push_back(std::move(tsi));
+                }
+            }
+
+            blocks.push_back(std::move(bse));
+        }
+    } catch (std::exception &) {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    startHeight = static_cast<uint32_t>(rsp.startHeight);
+    std::move(blocks.begin(), blocks.end(), std::back_inserter(newBlocks));
+
+    return std::error_code{};
+}
+
 std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash> &knownBlockIds,
                                                 uint64_t timestamp,
                                                 std::vector<CryptoNote::BlockShortEntry> &newBlocks,
@@ -780,15 +936,18 @@ std::error_code NodeRpcProxy::doQueryBlocksLite(const std::vector<Crypto::Hash>
 std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(
     std::vector<Crypto::Hash> &&knownPoolTxIds,
     Crypto::Hash knownBlockId,
+    uint64_t knownPoolVersion,
     bool &isBcActual,
     std::vector<std::unique_ptr<ITransactionReader>> &newTxs,
-    std::vector<Crypto::Hash> &deletedTxIds)
+    std::vector<Crypto::Hash> &deletedTxIds,
+    uint64_t &poolVersion)
 {
     CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::request req = AUTO_VAL_INIT(req);
     CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::response rsp = AUTO_VAL_INIT(rsp);
 
     req.tailBlockId = knownBlockId;
     req.knownTxsIds = knownPoolTxIds;
+    req.poolVersion = knownPoolVersion;
 
     std::error_code ec = binaryCommand("/get_pool_changes_lite.bin", req, rsp);
 
@@ -797,6 +956,7 @@ std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(
     }
 
     isBcActual = rsp.isTailBlockActual;
+    poolVersion = rsp.poolVersion;
 
     deletedTxIds = std::move(rsp.deletedTxsIds);
 
@@ -809,6 +969,13 @@ std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(
 
 void NodeRpcProxy::scheduleRequest(std::function<std::error_code()> &&procedure,
                                    const Callback &callback)
+{
+    scheduleRequest(std::move(procedure), callback, m_rpcTimeout);
+}
+
+void NodeRpcProxy::scheduleRequest(std::function<std::error_code()> &&procedure,
+                                   const Callback &callback,
+                                   unsigned int timeout)
 {
     // callback is located on stack, so copy it inside binder
     class Wrapper
@@ -849,26 +1016,54 @@ void NodeRpcProxy::scheduleRequest(std::function<std::error_code()> &&procedure,
 
     assert(m_dispatcher != nullptr && m_context_group != nullptr);
 
-    m_dispatcher->remoteSpawn(Wrapper([this](std::function<std::error_code()> &procedure,
-                                             Callback &callback) {
-        m_context_group->spawn(Wrapper([this](std::function<std::error_code()> &procedure,
-                                              const Callback &callback) {
+    m_dispatcher->remoteSpawn(Wrapper([this, timeout](std::function<std::error_code()> &procedure,
+                                                      Callback &callback) {
+        m_context_group->spawn(Wrapper([this, timeout](
+                                           std::function<std::error_code()> &procedure,
+                                           const Callback &callback) {
             if (m_stop) {
                 callback(std::make_error_code(std::errc::operation_canceled));
             } else {
-                std::error_code ec = procedure();
-                if (m_connected != m_httpClient->isConnected()) {
-                    m_connected = m_httpClient->isConnected();
-                    m_rpcProxyObserverManager.notify(
-                        &INodeRpcProxyObserver::connectionStatusUpdated,
-                        m_connected);
-                }
+                std::error_code ec = runRequest(procedure, timeout);
+                updateConnectionStatus();
                 callback(m_stop ? std::make_error_code(std::errc::operation_canceled) : ec);
             }
         }, std::move(procedure), std::move(callback)));
     }, std::move(procedure), callback));
 }
 
+std::error_code NodeRpcProxy::runRequest(const std::function<std::error_code()> &procedure,
+                                         unsigned int timeout)
+{
+    if (timeout == 0) {
+        return procedure();
+    }
+
+    // every request runs in its own context, so it can time out independently of the others
+    std::error_code ec;
+    bool timedOut = false;
+    ContextGroup requestContext(*m_dispatcher);
+    Timer timeoutTimer(*m_dispatcher);
+    ContextGroup timeoutContext(*m_dispatcher);
+
+    timeoutContext.spawn([&] {
+        try {
+            timeoutTimer.sleep(std::chrono::milliseconds(timeout));
+            timedOut = true;
+            requestContext.interrupt();
+        } catch (InterruptedException &) {
+            // do nothing
+        }
+    });
+
+    requestContext.spawn([&] { ec = procedure(); });
+    requestContext.wait();
+    timeoutContext.interrupt();
+    timeoutContext.wait();
+
+    return timedOut ? make_error_code(error::TIMEOUT) : ec;
+}
+
 template <typename Request, typename Response>
 std::error_code NodeRpcProxy::binaryCommand(const std::string &url,
                                             const Request &req,
@@ -877,11 +1072,13 @@ std::error_code NodeRpcProxy::binaryCommand(const std::string &url,
     std::error_code ec;
 
     try {
-        EventLock eventLock(*m_httpEvent);
-        invokeBinaryCommand(*m_httpClient, url, req, res);
+        HttpClientLease lease(*this);
+        invokeBinaryCommand(lease.httpClient(), url, req, res);
         ec = interpretResponseStatus(res.status);
     } catch (const ConnectException &) {
         ec = make_error_code(error::CONNECT_ERROR);
+    } catch (const UnsupportedRequestException &) {
+        ec = make_error_code(error::UNSUPPORTED_REQUEST);
     } catch (const std::exception &) {
         ec = make_error_code(error::NETWORK_ERROR);
     }
@@ -895,8 +1092,8 @@ std::error_code NodeRpcProxy::jsonCommand(const std::string &url, const Request
     std::error_code ec;
 
     try {
-        EventLock eventLock(*m_httpEvent);
-        invokeJsonCommand(*m_httpClient, url, req, res);
+        HttpClientLease lease(*this);
+        invokeJsonCommand(lease.httpClient(), url, req, res);
         ec = interpretResponseStatus(res.status);
     } catch (const ConnectException &) {
         ec = make_error_code(error::CONNECT_ERROR);
@@ -915,7 +1112,7 @@ std::error_code NodeRpcProxy::jsonRpcCommand(const std::string &method,
     std::error_code ec = make_error_code(error::INTERNAL_NODE_ERROR);
 
     try {
-        EventLock eventLock(*m_httpEvent);
+        HttpClientLease lease(*this);
 
         JsonRpc::JsonRpcRequest jsReq;
 
@@ -929,7 +1126,7 @@ std::error_code NodeRpcProxy::jsonRpcCommand(const std::string &method,
         httpReq.setUrl("/json_rpc");
         httpReq.setBody(jsReq.getBody());
 
-        m_httpClient->request(httpReq, httpRes);
+        lease.httpClient().request(httpReq, httpRes);
 
         JsonRpc::JsonRpcResponse jsRes;
 
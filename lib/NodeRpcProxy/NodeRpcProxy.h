@@ -26,6 +26,7 @@
 #include <string>
 #include <thread>
 #include <unordered_set>
+#include <vector>
 #include <Common/ObserverManager.h>
 #include <Global/CryptoNoteConfig.h>
 #include <INode.h>
@@ -141,10 +142,21 @@ public:
     unsigned int rpcTimeout() const { return m_rpcTimeout; }
     void rpcTimeout(unsigned int val) { m_rpcTimeout = val; }
 
+    // deadline of getNewBlocks and queryBlocks in ms, large batches may legitimately take long,
+    // so 0 (the default) waits for them without a deadline
+    unsigned int blocksRpcTimeout() const { return m_blocksRpcTimeout; }
+    void blocksRpcTimeout(unsigned int val) { m_blocksRpcTimeout = val; }
+
+    // number of daemon connections requests are spread over, takes effect on init
+    size_t connectionCount() const { return m_connectionCount; }
+    void connectionCount(size_t val) { m_connectionCount = val; }
+
     const std::string m_nodeHost;
     const unsigned short m_nodePort;
 
 private:
+    class HttpClientLease;
+
     void resetInternalState();
     void workerThread(const Callback &initialized_callback);
 
@@ -167,19 +179,37 @@ private:
                                    uint32_t &startHeight);
     std::error_code doGetTransactionOutsGlobalIndices(const Crypto::Hash &transactionHash,
                                                       std::vector<uint32_t> &outsGlobalIndices);
+    std::error_code doQueryBlocks(const std::vector<Crypto::Hash> &knownBlockIds,
+                                  uint64_t timestamp,
+                                  std::vector<CryptoNote::BlockShortEntry> &newBlocks,
+                                  uint32_t &startHeight);
+    std::error_code doQueryBlocksCompact(const std::vector<Crypto::Hash> &knownBlockIds,
+                                         uint64_t timestamp,
+                                         std::vector<CryptoNote::BlockShortEntry> &newBlocks,
+                                         uint32_t &startHeight);
     std::error_code doQueryBlocksLite(const std::vector<Crypto::Hash> &knownBlockIds,
                                       uint64_t timestamp,
                                       std::vector<CryptoNote::BlockShortEntry> &newBlocks,
                                       uint32_t &startHeight);
     std::error_code doGetPoolSymmetricDifference(std::vector<Crypto::Hash> &&knownPoolTxIds,
                                                  Crypto::Hash knownBlockId,
+                                                 uint64_t knownPoolVersion,
                                                  bool &isBcActual,
                                                  std::vector<
                                                      std::unique_ptr<ITransactionReader>
                                                      > &newTxs,
-                                                 std::vector<Crypto::Hash> &deletedTxIds);
+                                                 std::vector<Crypto::Hash> &deletedTxIds,
+                                                 uint64_t &poolVersion);
 
     void scheduleRequest(std::function<std::error_code()> &&procedure, const Callback &callback);
+    void scheduleRequest(std::function<std::error_code()> &&procedure,
+                         const Callback &callback,
+                         unsigned int timeout);
+    std::error_code runRequest(const std::function<std::error_code()> &procedure,
+                               unsigned int timeout);
+
+    void updateConnectionStatus();
+    void dropIdleConnections();
 
     template <typename Request, typename Response>
     std::error_code binaryCommand(const std::string &url, const Request &req, Response &res);
@@ -199,7 +229,10 @@ private:
     Tools::ObserverManager<CryptoNote::INodeRpcProxyObserver> m_rpcProxyObserverManager;
 
     unsigned int m_rpcTimeout;
-    HttpClient *m_httpClient = nullptr;
+    unsigned int m_blocksRpcTimeout;
+    size_t m_connectionCount;
+    std::vector<HttpClient *> m_httpClients;
+    std::vector<HttpClient *> m_idleHttpClients;
     System::Event *m_httpEvent = nullptr;
 
     uint64_t m_pullInterval;
@@ -215,6 +248,10 @@ private:
     BlockHeaderInfo lastLocalBlockHeaderInfo;
     // protect it with mutex if decided to add worker threads
     std::unordered_set<Crypto::Hash> m_knownTxs;
+    // daemon pool version m_knownTxs corresponds to, 0 if unknown
+    uint64_t m_knownPoolVersion;
+    // cleared once the daemon turns out not to serve /queryblockscompact.bin
+    std::atomic<bool> m_compactBlocksSupported;
 
     bool m_connected;
 };
@@ -17,6 +17,8 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <string>
+#include <Common/Metrics.h>
 #include <P2p/LevinProtocol.h>
 #include <System/TcpConnection.h>
 
@@ -44,6 +46,16 @@ struct bucket_head2
 };
 #pragma pack(pop)
 
+// the bytes of a message with its header, by the command id
+void countBytes(const std::string &name, uint32_t command, size_t size)
+{
+    Metrics::registry().counter(
+        name,
+        "Bytes of Levin messages with their headers by command",
+        { { "command", std::to_string(command) } }
+    ).add(size);
+}
+
 } // namespace
 
 bool LevinProtocol::Command::needReply() const
@@ -75,6 +87,7 @@ void LevinProtocol::sendMessage(uint32_t command, const BinaryArray &out, bool n
     stream.writeSome(out.data(), out.size());
 
     writeStrict(writeBuffer.data(), writeBuffer.size());
+    countBytes("p2p_sent_bytes_total", command, writeBuffer.size());
 }
 
 bool LevinProtocol::readCommand(Command &cmd)
@@ -102,6 +115,8 @@ bool LevinProtocol::readCommand(Command &cmd)
         }
     }
 
+    countBytes("p2p_received_bytes_total", head.m_command, sizeof(head) + buf.size());
+
     cmd.command = head.m_command;
     cmd.buf = std::move(buf);
     cmd.isNotify = !head.m_have_to_return_data;
@@ -129,6 +144,7 @@ void LevinProtocol::sendReply(uint32_t command, const BinaryArray &out, int32_t
     stream.writeSome(out.data(), out.size());
 
     writeStrict(writeBuffer.data(), writeBuffer.size());
+    countBytes("p2p_sent_bytes_total", command, writeBuffer.size());
 }
 
 bool LevinProtocol::readStrict(uint8_t *ptr, size_t size)
@@ -166,9 +166,14 @@ private:
     std::future<std::error_code> initFuture;
 };
 
-CryptoNote::INode *NodeFactory::createNode(const std::string &daemonAddress, uint16_t daemonPort)
+CryptoNote::INode *NodeFactory::createNode(const std::string &daemonAddress,
+                                           uint16_t daemonPort,
+                                           size_t daemonConnections)
 {
-    std::unique_ptr<CryptoNote::INode> node(new CryptoNote::NodeRpcProxy(daemonAddress,daemonPort));
+    std::unique_ptr<CryptoNote::NodeRpcProxy> node(
+        new CryptoNote::NodeRpcProxy(daemonAddress, daemonPort)
+    );
+    node->connectionCount(daemonConnections);
 
     NodeInitObserver initObserver;
     node->init(std::bind(&NodeInitObserver::initCompleted, &initObserver, std::placeholders::_1));
@@ -27,7 +27,9 @@ namespace PaymentService {
 class NodeFactory
 {
 public:
-    static CryptoNote::INode *createNode(const std::string &daemonAddress, uint16_t daemonPort);
+    static CryptoNote::INode *createNode(const std::string &daemonAddress,
+                                         uint16_t daemonPort,
+                                         size_t daemonConnections);
     static CryptoNote::INode *createNodeStub();
 
 private:
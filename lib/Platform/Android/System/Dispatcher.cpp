@@ -255,6 +255,16 @@ NativeContext *Dispatcher::getCurrentContext() const
     return currentContext;
 }
 
+size_t Dispatcher::getResumingContextCount() const
+{
+    size_t count = 0;
+    for (NativeContext *context = firstResumingContext; context != nullptr; context = context->next) {
+        ++count;
+    }
+
+    return count;
+}
+
 void Dispatcher::interrupt()
 {
     interrupt(currentContext);
@@ -73,6 +73,8 @@ public:
     void clear();
     void dispatch();
     NativeContext *getCurrentContext() const;
+    // contexts waiting in the run queue to be resumed, walks the queue
+    size_t getResumingContextCount() const;
     void interrupt();
     void interrupt(NativeContext *context);
     bool interrupted();
@@ -0,0 +1,45 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Switches between coroutines by saving and restoring the callee-saved registers on their stacks,
+ * see ContextSwitch.S. Unlike swapcontext it doesn't make the rt_sigprocmask syscall, contexts
+ * share the signal mask of their thread. Other architectures use ucontext.
+ */
+#if defined(__x86_64__) || defined(__aarch64__)
+#define SYSTEM_CONTEXT_SWITCH 1
+#endif
+
+#ifdef SYSTEM_CONTEXT_SWITCH
+
+extern "C" {
+
+// Prepares the top of a stack to run procedure(argument) when switched to, procedure must not
+// return. Returns the stack pointer to switch to.
+void *systemMakeContext(void *stackTop, void (*procedure)(void *), void *argument);
+
+// Saves the registers of the current context on its stack and its stack pointer to *from, then
+// resumes the context whose stack pointer is to.
+void systemSwitchContext(void **from, void *to);
+
+}
+
+#endif
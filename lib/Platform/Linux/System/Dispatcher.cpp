@@ -17,16 +17,21 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <cassert>
 #include <fcntl.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/timerfd.h>
 #include <ucontext.h>
 #include <unistd.h>
+#include "ContextSwitch.h"
 #include "Dispatcher.h"
 #include "ErrorMessage.h"
+#include "IoUring.h"
 
 namespace System {
 
@@ -35,7 +40,7 @@ namespace {
 struct ContextMakingData
 {
     Dispatcher *dispatcher;
-    void *ucontext;
+    void *machineContext;
 };
 
 class MutextGuard
@@ -64,6 +69,106 @@ static_assert(Dispatcher::SIZEOF_PTHREAD_MUTEX_T == sizeof(pthread_mutex_t),
 
 //const size_t STACK_SIZE = 64 * 1024;
 const size_t STACK_SIZE = 512 * 1024;
+// reusable contexts beyond this many give the pages of their stacks back to the kernel when the
+// dispatcher runs out of work
+const size_t HOT_CONTEXT_COUNT = 16;
+// the top of a released stack stays, it holds the frames of the idle context
+const size_t STACK_KEEP_SIZE = 16 * 1024;
+// the completion ring is twice as large, the kernel keeps the completions that overflow it
+const unsigned IO_URING_ENTRIES = 256;
+
+size_t pageSize()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// The stack has an inaccessible page below it, an overflow faults instead of overwriting memory.
+uint8_t *allocateStack()
+{
+    void *memory = mmap(nullptr,
+                        pageSize() + STACK_SIZE,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+                        -1,
+                        0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error(
+            "Dispatcher::getReusableContext, mmap failed, " + lastErrorMessage()
+        );
+    }
+
+    if (mprotect(memory, pageSize(), PROT_NONE) == -1) {
+        std::string message = "Dispatcher::getReusableContext, mprotect failed, " + lastErrorMessage();
+        munmap(memory, pageSize() + STACK_SIZE);
+        throw std::runtime_error(message);
+    }
+
+    return static_cast<uint8_t *>(memory) + pageSize();
+}
+
+void freeStack(void *stack)
+{
+    auto result = munmap(static_cast<uint8_t *>(stack) - pageSize(), pageSize() + STACK_SIZE);
+    assert(result == 0);
+}
+
+// The pages below the kept top read as zeros again when touched.
+void releaseStack(void *stack)
+{
+    size_t size = (STACK_SIZE - STACK_KEEP_SIZE) / pageSize() * pageSize();
+    // advice only, the stack stays usable if it fails
+    madvise(stack, size, MADV_DONTNEED);
+}
+
+// the main context is saved by the first switch from it
+void *newMainContext()
+{
+#ifdef SYSTEM_CONTEXT_SWITCH
+    return nullptr;
+#else
+    return new ucontext_t;
+#endif
+}
+
+// The context runs procedure(argument) on the stack when switched to.
+void *makeContext(uint8_t *stack, void (*procedure)(void *), void *argument)
+{
+#ifdef SYSTEM_CONTEXT_SWITCH
+    return systemMakeContext(stack + STACK_SIZE, procedure, argument);
+#else
+    ucontext_t *context = new ucontext_t;
+    if (getcontext(context) == -1) { // make context precondition
+        delete context;
+        throw std::runtime_error(
+            "Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage()
+        );
+    }
+
+    context->uc_stack.ss_sp = stack;
+    context->uc_stack.ss_size = STACK_SIZE;
+    makecontext(context, (void(*)())procedure, 1, reinterpret_cast<int *>(argument));
+    return context;
+#endif
+}
+
+void freeMachineContext(void *machineContext)
+{
+#ifndef SYSTEM_CONTEXT_SWITCH
+    delete static_cast<ucontext_t *>(machineContext);
+#endif
+}
+
+void switchContext(void **from, void *to)
+{
+#ifdef SYSTEM_CONTEXT_SWITCH
+    systemSwitchContext(from, to);
+#else
+    if (swapcontext(static_cast<ucontext_t *>(*from), static_cast<ucontext_t *>(to)) == -1) {
+        throw std::runtime_error("Dispatcher, swapcontext failed, " + lastErrorMessage());
+    }
+#endif
+}
 
 };
 
@@ -74,47 +179,58 @@ Dispatcher::Dispatcher()
     if (epoll == -1) {
         message = "epoll_create1 failed, " + lastErrorMessage();
     } else {
-        mainContext.ucontext = new ucontext_t;
-        if (getcontext(reinterpret_cast<ucontext_t*>(mainContext.ucontext)) == -1) {
-            message = "getcontext failed, " + lastErrorMessage();
+        remoteSpawnEvent = eventfd(0, O_NONBLOCK);
+        if(remoteSpawnEvent == -1) {
+            message = "eventfd failed, " + lastErrorMessage();
         } else {
-            remoteSpawnEvent = eventfd(0, O_NONBLOCK);
-            if(remoteSpawnEvent == -1) {
-                message = "eventfd failed, " + lastErrorMessage();
-            } else {
-                remoteSpawnEventContext.writeContext = nullptr;
-                remoteSpawnEventContext.readContext = nullptr;
+            remoteSpawnEventContext.writeContext = nullptr;
+            remoteSpawnEventContext.readContext = nullptr;
 
-                epoll_event remoteSpawnEventEpollEvent;
-                remoteSpawnEventEpollEvent.events = EPOLLIN;
-                remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
+            epoll_event remoteSpawnEventEpollEvent;
+            remoteSpawnEventEpollEvent.events = EPOLLIN;
+            remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
 
-                if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
-                    message = "epoll_ctl failed, " + lastErrorMessage();
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
+                message = "epoll_ctl failed, " + lastErrorMessage();
+            } else {
+                *reinterpret_cast<pthread_mutex_t *>(this->mutex) =
+                    pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
+
+                mainContext.machineContext = newMainContext();
+                mainContext.interrupted = false;
+                mainContext.group = &contextGroup;
+                mainContext.groupPrev = nullptr;
+                mainContext.groupNext = nullptr;
+                mainContext.inExecutionQueue = false;
+                contextGroup.firstContext = nullptr;
+                contextGroup.lastContext = nullptr;
+                contextGroup.firstWaiter = nullptr;
+                contextGroup.lastWaiter = nullptr;
+                currentContext = &mainContext;
+                firstResumingContext = nullptr;
+                firstReusableContext = nullptr;
+                reusableContextCount = 0;
+                releasedContextCount = 0;
+                runningContextCount = 0;
+
+#ifdef SYSTEM_IO_URING
+                ioUring = new IoUring;
+                if (ioUring->open(IO_URING_ENTRIES)) {
+                    epollOperation.context = nullptr;
+                    armEpoll();
                 } else {
-                    *reinterpret_cast<pthread_mutex_t *>(this->mutex) =
-                        pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-
-                    mainContext.interrupted = false;
-                    mainContext.group = &contextGroup;
-                    mainContext.groupPrev = nullptr;
-                    mainContext.groupNext = nullptr;
-                    mainContext.inExecutionQueue = false;
-                    contextGroup.firstContext = nullptr;
-                    contextGroup.lastContext = nullptr;
-                    contextGroup.firstWaiter = nullptr;
-                    contextGroup.lastWaiter = nullptr;
-                    currentContext = &mainContext;
-                    firstResumingContext = nullptr;
-                    firstReusableContext = nullptr;
-                    runningContextCount = 0;
-
-                    return;
+                    delete ioUring;
+                    ioUring = nullptr;
                 }
+#else
+                ioUring = nullptr;
+#endif
 
-                auto result = close(remoteSpawnEvent);
-                assert(result == 0);
+                return;
             }
+
+            auto result = close(remoteSpawnEvent);
+            assert(result == 0);
         }
 
         auto result = close(epoll);
@@ -137,13 +253,7 @@ Dispatcher::~Dispatcher()
     assert(contextGroup.firstWaiter == nullptr);
     assert(firstResumingContext == nullptr);
     assert(runningContextCount == 0);
-    while (firstReusableContext != nullptr) {
-        auto ucontext = static_cast<ucontext_t *>(firstReusableContext->ucontext);
-        auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
-        firstReusableContext = firstReusableContext->next;
-        delete[] stackPtr;
-        delete ucontext;
-    }
+    clearReusableContexts();
 
     while (!timers.empty()) {
         int result = ::close(timers.top());
@@ -151,23 +261,21 @@ Dispatcher::~Dispatcher()
         timers.pop();
     }
 
+#ifdef SYSTEM_IO_URING
+    delete ioUring;
+#endif
     auto result = close(epoll);
     assert(result == 0);
     result = close(remoteSpawnEvent);
     assert(result == 0);
     result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t *>(this->mutex));
     assert(result == 0);
+    freeMachineContext(mainContext.machineContext);
 }
 
 void Dispatcher::clear()
 {
-    while (firstReusableContext != nullptr) {
-        auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-        auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
-        firstReusableContext = firstReusableContext->next;
-        delete[] stackPtr;
-        delete ucontext;
-    }
+    clearReusableContexts();
 
     while (!timers.empty()) {
         int result = ::close(timers.top());
@@ -191,6 +299,15 @@ void Dispatcher::dispatch()
             break;
         }
 
+        releaseIdleStacks();
+#ifdef SYSTEM_IO_URING
+        if (ioUring != nullptr) {
+            ioUring->enter(1);
+            completeIo();
+            continue;
+        }
+#endif
+
         epoll_event event;
         int count = epoll_wait(epoll, &event, 1, -1);
         if (count == 1) {
@@ -237,13 +354,9 @@ void Dispatcher::dispatch()
     }
 
     if (context != currentContext) {
-        ucontext_t *oldContext = static_cast<ucontext_t *>(currentContext->ucontext);
+        NativeContext *oldContext = currentContext;
         currentContext = context;
-        if (swapcontext(oldContext, static_cast<ucontext_t *>(context->ucontext)) == -1) {
-            throw std::runtime_error(
-                "Dispatcher::dispatch, swapcontext failed, " + lastErrorMessage()
-            );
-        }
+        switchContext(&oldContext->machineContext, context->machineContext);
     }
 }
 
@@ -252,6 +365,26 @@ NativeContext *Dispatcher::getCurrentContext() const
     return currentContext;
 }
 
+size_t Dispatcher::getResumingContextCount() const
+{
+    size_t count = 0;
+    for (NativeContext *context = firstResumingContext; context != nullptr; context = context->next) {
+        ++count;
+    }
+
+    return count;
+}
+
+size_t Dispatcher::getReusableContextCount() const
+{
+    return reusableContextCount;
+}
+
+size_t Dispatcher::getReleasedContextCount() const
+{
+    return releasedContextCount;
+}
+
 void Dispatcher::interrupt()
 {
     interrupt(currentContext);
@@ -335,6 +468,148 @@ void Dispatcher::spawn(std::function<void()> &&procedure)
 }
 
 void Dispatcher::yield()
+{
+    pollEpoll();
+#ifdef SYSTEM_IO_URING
+    if (ioUring != nullptr) {
+        ioUring->enter(0);
+        completeIo();
+    }
+#endif
+
+    if (firstResumingContext != nullptr) {
+        pushContext(currentContext);
+        dispatch();
+    }
+}
+
+int Dispatcher::getEpoll() const
+{
+    return epoll;
+}
+
+IoUring *Dispatcher::getIoUring() const
+{
+    return ioUring;
+}
+
+void Dispatcher::waitForIo(OperationContext &operation, bool timeout)
+{
+    assert(ioUring != nullptr);
+#ifdef SYSTEM_IO_URING
+    operation.context = currentContext;
+    operation.interrupted = false;
+    currentContext->interruptProcedure = [this, &operation, timeout]() {
+        ioUring->cancel(reinterpret_cast<uintptr_t>(&operation), timeout);
+        operation.interrupted = true;
+    };
+
+    dispatch();
+    currentContext->interruptProcedure = nullptr;
+    assert(operation.context == currentContext);
+    if (operation.interrupted && operation.result != -ECANCELED) {
+        operation.interrupted = false;
+        if (operation.result >= 0) {
+            currentContext->interrupted = true;
+        }
+    }
+#endif
+}
+
+NativeContext &Dispatcher::getReusableContext()
+{
+    if(firstReusableContext == nullptr) {
+        uint8_t *stack = allocateStack();
+        ContextMakingData makingContextData {this, nullptr};
+        try {
+            makingContextData.machineContext = makeContext(stack, contextProcedureStatic, &makingContextData);
+        } catch (std::exception &) {
+            freeStack(stack);
+            throw;
+        }
+
+        switchContext(&currentContext->machineContext, makingContextData.machineContext);
+        assert(firstReusableContext != nullptr);
+        firstReusableContext->stackPtr = stack;
+    };
+
+    NativeContext *context = firstReusableContext;
+    firstReusableContext = firstReusableContext-> next;
+    --reusableContextCount;
+    releasedContextCount = std::min(releasedContextCount, reusableContextCount);
+    return *context;
+}
+
+void Dispatcher::pushReusableContext(NativeContext &context)
+{
+    context.next = firstReusableContext;
+    firstReusableContext = &context;
+    ++reusableContextCount;
+    --runningContextCount;
+}
+
+void Dispatcher::clearReusableContexts()
+{
+    while (firstReusableContext != nullptr) {
+        NativeContext *context = firstReusableContext;
+        firstReusableContext = firstReusableContext->next;
+        // the context lives on its stack
+        void *machineContext = context->machineContext;
+        freeStack(context->stackPtr);
+        freeMachineContext(machineContext);
+    }
+
+    reusableContextCount = 0;
+    releasedContextCount = 0;
+}
+
+void Dispatcher::releaseIdleStacks()
+{
+    if (reusableContextCount - releasedContextCount <= HOT_CONTEXT_COUNT) {
+        return;
+    }
+
+    NativeContext *context = firstReusableContext;
+    for (size_t i = 0; i < HOT_CONTEXT_COUNT; ++i) {
+        context = context->next;
+    }
+
+    for (size_t i = HOT_CONTEXT_COUNT; i < reusableContextCount - releasedContextCount; ++i) {
+        releaseStack(context->stackPtr);
+        context = context->next;
+    }
+
+    releasedContextCount = reusableContextCount - HOT_CONTEXT_COUNT;
+}
+
+int Dispatcher::getTimer()
+{
+    int timer;
+    if (timers.empty()) {
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        epoll_event timerEvent;
+        timerEvent.events = 0;
+        timerEvent.data.ptr = nullptr;
+
+        if (epoll_ctl(getEpoll(), EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
+            throw std::runtime_error(
+                "Dispatcher::getTimer, epoll_ctl failed, "  + lastErrorMessage()
+            );
+        }
+    } else {
+        timer = timers.top();
+        timers.pop();
+    }
+
+    return timer;
+}
+
+void Dispatcher::pushTimer(int timer)
+{
+    timers.push(timer);
+}
+
+void Dispatcher::pollEpoll()
 {
     for(;;) {
         epoll_event events[16];
@@ -399,104 +674,50 @@ void Dispatcher::yield()
             }
         }
     }
-
-    if (firstResumingContext != nullptr) {
-        pushContext(currentContext);
-        dispatch();
-    }
 }
 
-int Dispatcher::getEpoll() const
+void Dispatcher::armEpoll()
 {
-    return epoll;
+#ifdef SYSTEM_IO_URING
+    io_uring_sqe &sqe = ioUring->prepare(IORING_OP_POLL_ADD,
+                                         epoll,
+                                         reinterpret_cast<uintptr_t>(&epollOperation));
+    sqe.poll_events = POLLIN;
+#endif
 }
 
-NativeContext &Dispatcher::getReusableContext()
+void Dispatcher::completeIo()
 {
-    if(firstReusableContext == nullptr) {
-        ucontext_t *newlyCreatedContext = new ucontext_t;
-        if (getcontext(newlyCreatedContext) == -1) { // make context precondition
-            throw std::runtime_error(
-                "Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage()
-            );
+#ifdef SYSTEM_IO_URING
+    io_uring_cqe cqe;
+    while (ioUring->complete(cqe)) {
+        if (cqe.user_data == 0) { // a cancel
+            continue;
         }
 
-        auto stackPointer = new uint8_t[STACK_SIZE];
-        newlyCreatedContext->uc_stack.ss_sp = stackPointer;
-        newlyCreatedContext->uc_stack.ss_size = STACK_SIZE;
-
-        ContextMakingData makingContextData {this, newlyCreatedContext};
-        makecontext(newlyCreatedContext,
-                    (void(*)())contextProcedureStatic,
-                    1,
-                    reinterpret_cast<int *>(&makingContextData));
-
-        ucontext_t *oldContext = static_cast<ucontext_t *>(currentContext->ucontext);
-        if (swapcontext(oldContext, newlyCreatedContext) == -1) {
-            throw std::runtime_error(
-                "Dispatcher::getReusableContext, swapcontext failed, " + lastErrorMessage()
-            );
-        }
-
-        assert(firstReusableContext != nullptr);
-        assert(firstReusableContext->ucontext == newlyCreatedContext);
-        firstReusableContext->stackPtr = stackPointer;
-    };
-
-    NativeContext *context = firstReusableContext;
-    firstReusableContext = firstReusableContext-> next;
-    return *context;
-}
-
-void Dispatcher::pushReusableContext(NativeContext &context)
-{
-    context.next = firstReusableContext;
-    firstReusableContext = &context;
-    --runningContextCount;
-}
-
-int Dispatcher::getTimer()
-{
-    int timer;
-    if (timers.empty()) {
-        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-        epoll_event timerEvent;
-        timerEvent.events = 0;
-        timerEvent.data.ptr = nullptr;
-
-        if (epoll_ctl(getEpoll(), EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
-            throw std::runtime_error(
-                "Dispatcher::getTimer, epoll_ctl failed, "  + lastErrorMessage()
-            );
+        auto *operation = reinterpret_cast<OperationContext *>(cqe.user_data);
+        if (operation == &epollOperation) {
+            pollEpoll();
+            armEpoll();
+        } else {
+            operation->result = cqe.res;
+            pushContext(operation->context);
         }
-    } else {
-        timer = timers.top();
-        timers.pop();
     }
-
-    return timer;
+#endif
 }
 
-void Dispatcher::pushTimer(int timer)
-{
-    timers.push(timer);
-}
-
-void Dispatcher::contextProcedure(void *ucontext)
+void Dispatcher::contextProcedure(void *machineContext)
 {
     assert(firstReusableContext == nullptr);
     NativeContext context;
-    context.ucontext = ucontext;
+    context.machineContext = machineContext;
     context.interrupted = false;
     context.next = nullptr;
     context.inExecutionQueue = false;
     firstReusableContext = &context;
-    ucontext_t *oldContext = static_cast<ucontext_t *>(context.ucontext);
-    if (swapcontext(oldContext, static_cast<ucontext_t *>(currentContext->ucontext)) == -1) {
-        throw std::runtime_error(
-            "Dispatcher::contextProcedure, swapcontext failed, " + lastErrorMessage()
-        );
-    }
+    ++reusableContextCount;
+    switchContext(&context.machineContext, currentContext->machineContext);
 
     for (;;) {
         ++runningContextCount;
@@ -549,7 +770,7 @@ void Dispatcher::contextProcedure(void *ucontext)
 void Dispatcher::contextProcedureStatic(void *context)
 {
     auto *makingContextData = reinterpret_cast<ContextMakingData *>(context);
-    makingContextData->dispatcher->contextProcedure(makingContextData->ucontext);
+    makingContextData->dispatcher->contextProcedure(makingContextData->machineContext);
 }
 
 } // namespace System
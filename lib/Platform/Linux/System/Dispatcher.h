@@ -32,11 +32,13 @@
 
 namespace System {
 
+class IoUring;
 struct NativeContextGroup;
 
 struct NativeContext
 {
-    void *ucontext;
+    // the saved stack pointer, or the ucontext_t without the assembly context switch
+    void *machineContext;
     void *stackPtr;
     bool interrupted;
     bool inExecutionQueue;
@@ -61,6 +63,8 @@ struct OperationContext
     NativeContext *context;
     bool interrupted;
     uint32_t events;
+    // of an io_uring operation, a negative errno if it failed
+    int32_t result;
 };
 
 struct ContextPair
@@ -79,6 +83,11 @@ public:
     void clear();
     void dispatch();
     NativeContext *getCurrentContext() const;
+    // contexts waiting in the run queue to be resumed, walks the queue
+    size_t getResumingContextCount() const;
+    // finished contexts kept for reuse, and how many of them gave their stack pages back
+    size_t getReusableContextCount() const;
+    size_t getReleasedContextCount() const;
     void interrupt();
     void interrupt(NativeContext *context);
     bool interrupted();
@@ -88,6 +97,12 @@ public:
 
     // system-dependent
     int getEpoll() const;
+    // nullptr if the kernel or the build lacks io_uring, the dispatcher then waits with epoll alone
+    IoUring *getIoUring() const;
+    // Waits for the io_uring operation prepared with the operation as its user data. An interrupt
+    // cancels it, if the operation completes anyway its result stays and the interrupt is kept
+    // for the next operation of the context.
+    void waitForIo(OperationContext &operation, bool timeout);
     NativeContext &getReusableContext();
     void pushReusableContext(NativeContext &);
     int getTimer();
@@ -107,8 +122,16 @@ public:
 
 private:
     void spawn(std::function<void()> &&procedure);
+    void clearReusableContexts();
+    void releaseIdleStacks();
+    void pollEpoll();
+    void armEpoll();
+    void completeIo();
 
     int epoll;
+    IoUring *ioUring;
+    // the epoll descriptor is polled through io_uring when there is one
+    OperationContext epollOperation;
     alignas(void *) uint8_t mutex[SIZEOF_PTHREAD_MUTEX_T];
     int remoteSpawnEvent;
     ContextPair remoteSpawnEventContext;
@@ -120,10 +143,13 @@ private:
     NativeContext *currentContext;
     NativeContext *firstResumingContext;
     NativeContext *lastResumingContext;
+    // the most recently used first, the contexts with released stacks at the end
     NativeContext *firstReusableContext;
+    size_t reusableContextCount;
+    size_t releasedContextCount;
     size_t runningContextCount;
 
-    void contextProcedure(void *ucontext);
+    void contextProcedure(void *machineContext);
     static void contextProcedureStatic(void *context);
 };
 
@@ -0,0 +1,204 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include "ErrorMessage.h"
+#include "IoUring.h"
+
+#ifdef SYSTEM_IO_URING
+
+namespace System {
+
+namespace {
+
+// retrying on a nonblocking socket by polling it in the kernel, 5.7
+const uint32_t REQUIRED_FEATURES = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+
+const uint8_t REQUIRED_OPERATIONS[] = {
+    IORING_OP_ACCEPT,
+    IORING_OP_ASYNC_CANCEL,
+    IORING_OP_POLL_ADD,
+    IORING_OP_RECV,
+    IORING_OP_SEND,
+    IORING_OP_TIMEOUT,
+    IORING_OP_TIMEOUT_REMOVE
+};
+
+template<typename T>
+T *ringField(void *ringMemory, uint32_t offset)
+{
+    return reinterpret_cast<T *>(static_cast<uint8_t *>(ringMemory) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring()
+    : ring(-1),
+      ringMemory(MAP_FAILED),
+      ringSize(0),
+      sqes(static_cast<io_uring_sqe *>(MAP_FAILED)),
+      sqesSize(0),
+      sqPrepared(0),
+      sqSubmitted(0)
+{
+}
+
+IoUring::~IoUring()
+{
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+
+    if (ringMemory != MAP_FAILED) {
+        munmap(ringMemory, ringSize);
+    }
+
+    if (ring != -1) {
+        close(ring);
+    }
+}
+
+bool IoUring::open(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CLAMP;
+    ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring == -1 || (params.features & REQUIRED_FEATURES) != REQUIRED_FEATURES) {
+        return false;
+    }
+
+    std::vector<uint8_t> probeMemory(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    auto probe = reinterpret_cast<io_uring_probe *>(probeMemory.data());
+    if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == -1) {
+        return false;
+    }
+
+    for (uint8_t operation : REQUIRED_OPERATIONS) {
+        if (operation > probe->last_op || (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) == 0) {
+            return false;
+        }
+    }
+
+    ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    ringMemory = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                      IORING_OFF_SQ_RING);
+    if (ringMemory == MAP_FAILED) {
+        return false;
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+
+    sqHead = ringField<unsigned>(ringMemory, params.sq_off.head);
+    sqTail = ringField<unsigned>(ringMemory, params.sq_off.tail);
+    sqMask = *ringField<unsigned>(ringMemory, params.sq_off.ring_mask);
+    sqEntries = *ringField<unsigned>(ringMemory, params.sq_off.ring_entries);
+    sqArray = ringField<unsigned>(ringMemory, params.sq_off.array);
+    sqPrepared = *sqTail;
+    sqSubmitted = sqPrepared;
+    cqHead = ringField<unsigned>(ringMemory, params.cq_off.head);
+    cqTail = ringField<unsigned>(ringMemory, params.cq_off.tail);
+    cqMask = *ringField<unsigned>(ringMemory, params.cq_off.ring_mask);
+    cqes = ringField<io_uring_cqe>(ringMemory, params.cq_off.cqes);
+
+    return true;
+}
+
+io_uring_sqe &IoUring::prepare(uint8_t opcode, int fd, uint64_t userData)
+{
+    if (sqPrepared - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+        enter(0);
+    }
+
+    unsigned index = sqPrepared & sqMask;
+    io_uring_sqe &sqe = sqes[index];
+    memset(&sqe, 0, sizeof sqe);
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = userData;
+    sqArray[index] = index;
+    // the tail is published by enter(), after the caller filled the rest of the entry in
+    ++sqPrepared;
+
+    return sqe;
+}
+
+void IoUring::cancel(uint64_t userData, bool timeout)
+{
+    io_uring_sqe &sqe = prepare(timeout ? IORING_OP_TIMEOUT_REMOVE : IORING_OP_ASYNC_CANCEL, -1, 0);
+    sqe.addr = userData;
+}
+
+void IoUring::enter(unsigned minComplete)
+{
+    unsigned submitting = sqPrepared - sqSubmitted;
+    if (submitting == 0 && minComplete == 0) {
+        return;
+    }
+
+    // the entries are filled in before the kernel can see them
+    __atomic_store_n(sqTail, sqPrepared, __ATOMIC_RELEASE);
+    for (;;) {
+        long result = syscall(__NR_io_uring_enter,
+                              ring,
+                              submitting,
+                              minComplete,
+                              minComplete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                              nullptr,
+                              0);
+        if (result >= 0) {
+            sqSubmitted += static_cast<unsigned>(result);
+            return;
+        }
+
+        if (errno != EINTR) {
+            throw std::runtime_error("IoUring::enter, io_uring_enter failed, " + lastErrorMessage());
+        }
+    }
+}
+
+bool IoUring::complete(io_uring_cqe &cqe)
+{
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    cqe = cqes[head & cqMask];
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+} // namespace System
+
+#endif
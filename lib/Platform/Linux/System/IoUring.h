@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * The io_uring backend needs the 5.7 uapi header for IORING_FEAT_FAST_POLL. Built against
+ * older kernel headers, the dispatcher waits with epoll alone, as it does when the running
+ * kernel lacks io_uring.
+ */
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_FAST_POLL
+#define SYSTEM_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef SYSTEM_IO_URING
+
+#include <cstddef>
+#include <cstdint>
+
+namespace System {
+
+/*
+ * The submission and completion rings of an io_uring instance, driven with the raw syscalls.
+ * Submissions queue up in the ring and reach the kernel in one io_uring_enter when the
+ * dispatcher runs out of work, which also waits for the completions of all of them.
+ */
+class IoUring
+{
+public:
+    IoUring();
+    IoUring(const IoUring &) = delete;
+    ~IoUring();
+
+    // false if the kernel lacks io_uring or an operation the dispatcher needs
+    bool open(unsigned entries);
+
+    // the entry is cleared, userData comes back with the completion, the kernel sees it on enter
+    io_uring_sqe &prepare(uint8_t opcode, int fd, uint64_t userData);
+    // the completion of the cancel itself comes back with userData 0
+    void cancel(uint64_t userData, bool timeout);
+    // submits the prepared entries and waits until there are minComplete completions
+    void enter(unsigned minComplete);
+    // takes the oldest completion
+    bool complete(io_uring_cqe &cqe);
+
+    IoUring &operator=(const IoUring &) = delete;
+
+private:
+    int ring;
+    void *ringMemory;
+    size_t ringSize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned *sqArray;
+    unsigned sqPrepared;
+    unsigned sqSubmitted;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+};
+
+} // namespace System
+
+#endif
@@ -17,13 +17,16 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cassert>
+#include <limits>
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <System/ErrorMessage.h>
 #include <System/InterruptedException.h>
 #include <System/Ipv4Address.h>
+#include "IoUring.h"
 #include "TcpConnection.h"
 
 namespace System {
@@ -92,6 +95,31 @@ size_t TcpConnection::read(uint8_t *data, size_t size)
     if (transferred == -1) {
         if (errno != EAGAIN) {
             message = "recv failed, " + lastErrorMessage();
+#ifdef SYSTEM_IO_URING
+        } else if (dispatcher->getIoUring() != nullptr) {
+            OperationContext operationContext;
+            io_uring_sqe &sqe = dispatcher->getIoUring()->prepare(
+                IORING_OP_RECV,
+                connection,
+                reinterpret_cast<uintptr_t>(&operationContext)
+            );
+            sqe.addr = reinterpret_cast<uintptr_t>(data);
+            sqe.len = static_cast<uint32_t>(std::min<size_t>(size, std::numeric_limits<uint32_t>::max()));
+
+            contextPair.readContext = &operationContext;
+            dispatcher->waitForIo(operationContext, false);
+            contextPair.readContext = nullptr;
+            if (operationContext.interrupted) {
+                throw InterruptedException();
+            }
+
+            if (operationContext.result < 0) {
+                message = "recv failed, " + errorMessage(-operationContext.result);
+            } else {
+                assert(operationContext.result <= static_cast<ssize_t>(size));
+                return operationContext.result;
+            }
+#endif
         } else {
             epoll_event connectionEvent;
             OperationContext operationContext;
@@ -201,6 +229,32 @@ std::size_t TcpConnection::write(const uint8_t *data, size_t size)
     if (transferred == -1) {
         if (errno != EAGAIN) {
             message = "send failed, " + lastErrorMessage();
+#ifdef SYSTEM_IO_URING
+        } else if (dispatcher->getIoUring() != nullptr) {
+            OperationContext operationContext;
+            io_uring_sqe &sqe = dispatcher->getIoUring()->prepare(
+                IORING_OP_SEND,
+                connection,
+                reinterpret_cast<uintptr_t>(&operationContext)
+            );
+            sqe.addr = reinterpret_cast<uintptr_t>(data);
+            sqe.len = static_cast<uint32_t>(std::min<size_t>(size, std::numeric_limits<uint32_t>::max()));
+            sqe.msg_flags = MSG_NOSIGNAL;
+
+            contextPair.writeContext = &operationContext;
+            dispatcher->waitForIo(operationContext, false);
+            contextPair.writeContext = nullptr;
+            if (operationContext.interrupted) {
+                throw InterruptedException();
+            }
+
+            if (operationContext.result < 0) {
+                message = "send failed, " + errorMessage(-operationContext.result);
+            } else {
+                assert(operationContext.result <= static_cast<ssize_t>(size));
+                return operationContext.result;
+            }
+#endif
         } else {
             epoll_event connectionEvent;
             OperationContext operationContext;
@@ -308,6 +362,10 @@ TcpConnection::TcpConnection(Dispatcher &dispatcher, int socket)
 {
     contextPair.readContext = nullptr;
     contextPair.writeContext = nullptr;
+    if (dispatcher.getIoUring() != nullptr) { // reads and writes wait in the ring
+        return;
+    }
+
     epoll_event connectionEvent;
     connectionEvent.events = EPOLLONESHOT;
     connectionEvent.data.ptr = nullptr;
@@ -28,6 +28,7 @@
 #include <System/InterruptedException.h>
 #include <System/Ipv4Address.h>
 #include "Dispatcher.h"
+#include "IoUring.h"
 #include "TcpConnection.h"
 #include "TcpListener.h"
 
@@ -67,7 +68,9 @@ TcpListener::TcpListener(Dispatcher &dispatcher, const Ipv4Address &addr, uint16
                     listenEvent.events = 0;
                     listenEvent.data.ptr = nullptr;
 
-                    if (epoll_ctl(dispatcher.getEpoll(),EPOLL_CTL_ADD,listener,&listenEvent)==-1) {
+                    // accepts wait in the ring if there is one
+                    if (dispatcher.getIoUring() == nullptr
+                        && epoll_ctl(dispatcher.getEpoll(),EPOLL_CTL_ADD,listener,&listenEvent)==-1) {
                         message = "epoll_ctl failed, " + lastErrorMessage();
                     } else {
                         context = nullptr;
@@ -133,6 +136,33 @@ TcpConnection TcpListener::accept()
         throw InterruptedException();
     }
 
+#ifdef SYSTEM_IO_URING
+    if (dispatcher->getIoUring() != nullptr) {
+        OperationContext listenerContext;
+        io_uring_sqe &sqe = dispatcher->getIoUring()->prepare(
+            IORING_OP_ACCEPT,
+            listener,
+            reinterpret_cast<uintptr_t>(&listenerContext)
+        );
+        sqe.accept_flags = SOCK_NONBLOCK;
+
+        context = &listenerContext;
+        dispatcher->waitForIo(listenerContext, false);
+        context = nullptr;
+        if (listenerContext.interrupted) {
+            throw InterruptedException();
+        }
+
+        if (listenerContext.result < 0) {
+            throw std::runtime_error(
+                "TcpListener::accept, accept failed, " + errorMessage(-listenerContext.result)
+            );
+        }
+
+        return TcpConnection(*dispatcher, listenerContext.result);
+    }
+#endif
+
     ContextPair contextPair;
     OperationContext listenerContext;
     listenerContext.interrupted = false;
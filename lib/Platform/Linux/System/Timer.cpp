@@ -25,6 +25,7 @@
 #include <System/ErrorMessage.h>
 #include <System/InterruptedException.h>
 #include "Dispatcher.h"
+#include "IoUring.h"
 #include "Timer.h"
 
 namespace System {
@@ -83,6 +84,40 @@ void Timer::sleep(std::chrono::nanoseconds duration)
 
     if(duration.count() == 0 ) {
         dispatcher->yield();
+#ifdef SYSTEM_IO_URING
+    } else if (dispatcher->getIoUring() != nullptr) {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
+        __kernel_timespec expires;
+        expires.tv_sec = seconds.count();
+        expires.tv_nsec =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration - seconds).count();
+
+        OperationContext timerContext;
+        io_uring_sqe &sqe = dispatcher->getIoUring()->prepare(
+            IORING_OP_TIMEOUT,
+            -1,
+            reinterpret_cast<uintptr_t>(&timerContext)
+        );
+        sqe.addr = reinterpret_cast<uintptr_t>(&expires);
+        sqe.len = 1;
+        // the timeout starts when it's submitted, not with the next batch
+        dispatcher->getIoUring()->enter(0);
+
+        context = &timerContext;
+        dispatcher->waitForIo(timerContext, true);
+        context = nullptr;
+        // An expired timeout completes with -ETIME, a removed one with -ECANCELED. Like a timerfd
+        // that was read by the interrupt, an expired timeout returns even if one came with it.
+        if (timerContext.result != -ETIME) {
+            if (timerContext.interrupted) {
+                throw InterruptedException();
+            }
+
+            throw std::runtime_error(
+                "Timer::sleep, timeout failed, " + errorMessage(-timerContext.result)
+            );
+        }
+#endif
     } else {
         timer = dispatcher->getTimer();
 
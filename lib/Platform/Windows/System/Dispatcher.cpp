@@ -216,6 +216,17 @@ NativeContext *Dispatcher::getCurrentContext() const
     return currentContext;
 }
 
+size_t Dispatcher::getResumingContextCount() const
+{
+    assert(GetCurrentThreadId() == threadId);
+    size_t count = 0;
+    for (NativeContext *context = firstResumingContext; context != nullptr; context = context->next) {
+        ++count;
+    }
+
+    return count;
+}
+
 void Dispatcher::interrupt()
 {
     interrupt(currentContext);
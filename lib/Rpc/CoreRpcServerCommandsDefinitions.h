@@ -230,10 +230,13 @@ struct COMMAND_RPC_GET_POOL_CHANGES {
         {
             KV_MEMBER(tailBlockId);
             serializeAsBinary(knownTxsIds, "knownTxsIds", s);
+            KV_MEMBER(poolVersion);
         }
 
         Crypto::Hash tailBlockId;
         std::vector<Crypto::Hash> knownTxsIds;
+        // pool version of the previous response, lets the daemon answer from its change log
+        uint64_t poolVersion;
     };
 
     struct response {
@@ -242,12 +245,14 @@ struct COMMAND_RPC_GET_POOL_CHANGES {
             KV_MEMBER(isTailBlockActual);
             KV_MEMBER(addedTxs);
             serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+            KV_MEMBER(poolVersion);
             KV_MEMBER(status);
         }
 
         bool isTailBlockActual;
         std::vector<BinaryArray> addedTxs; // added transactions blobs
         std::vector<Crypto::Hash> deletedTxsIds; // IDs of not found transactions
+        uint64_t poolVersion;
         std::string status;
     };
 };
@@ -258,10 +263,13 @@ struct COMMAND_RPC_GET_POOL_CHANGES_LITE {
         {
             KV_MEMBER(tailBlockId);
             serializeAsBinary(knownTxsIds, "knownTxsIds", s);
+            KV_MEMBER(poolVersion);
         }
 
         Crypto::Hash tailBlockId;
         std::vector<Crypto::Hash> knownTxsIds;
+        // pool version of the previous response, lets the daemon answer from its change log
+        uint64_t poolVersion;
     };
 
     struct response {
@@ -270,12 +278,14 @@ struct COMMAND_RPC_GET_POOL_CHANGES_LITE {
             KV_MEMBER(isTailBlockActual);
             KV_MEMBER(addedTxs);
             serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+            KV_MEMBER(poolVersion);
             KV_MEMBER(status);
         }
 
         bool isTailBlockActual;
         std::vector<TransactionPrefixInfo> addedTxs; // added transactions blobs
         std::vector<Crypto::Hash> deletedTxsIds; // IDs of not found transactions
+        uint64_t poolVersion;
         std::string status;
     };
 };
@@ -606,6 +616,7 @@ struct COMMAND_RPC_GET_BLOCK_TEMPLATE {
             KV_MEMBER(reserved_offset);
             KV_MEMBER(blocktemplate_blob);
             KV_MEMBER(blockhashing_blob);
+            KV_MEMBER(template_version);
             KV_MEMBER(status);
         }
 
@@ -614,6 +625,7 @@ struct COMMAND_RPC_GET_BLOCK_TEMPLATE {
         uint64_t reserved_offset;
         std::string blocktemplate_blob;
         std::string blockhashing_blob;
+        uint64_t template_version; // changes with the chain tip and the included transactions
         std::string status;
     };
 };
@@ -1063,6 +1075,27 @@ struct COMMAND_RPC_QUERY_BLOCKS_LITE {
     };
 };
 
+struct COMMAND_RPC_QUERY_BLOCKS_COMPACT {
+    typedef COMMAND_RPC_QUERY_BLOCKS_LITE::request request;
+
+    struct response {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(status);
+            KV_MEMBER(startHeight);
+            KV_MEMBER(currentHeight);
+            KV_MEMBER(fullOffset);
+            KV_MEMBER(blocks);
+        }
+
+        std::string status;
+        uint64_t startHeight;
+        uint64_t currentHeight;
+        uint64_t fullOffset;
+        std::string blocks; // see CompactBlock.h
+    };
+};
+
 struct COMMAND_RPC_QUERY_BLOCKS_DETAILED {
     struct request {
         void serialize(ISerializer &s)
@@ -1594,4 +1627,139 @@ struct COMMAND_RPC_RESOLVE_OPEN_ALIAS {
     };
 };
 
+struct COMMAND_RPC_REGISTER_VIEW_KEY {
+    struct request {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(address);
+            KV_MEMBER(view_key);
+            KV_MEMBER(start_height);
+        }
+
+        std::string address;
+        std::string view_key;
+        uint32_t start_height = 0;
+    };
+
+    typedef STATUS_STRUCT response;
+};
+
+struct COMMAND_RPC_UNREGISTER_VIEW_KEY {
+    struct request {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(address);
+            KV_MEMBER(view_key);
+        }
+
+        std::string address;
+        std::string view_key;
+    };
+
+    typedef STATUS_STRUCT response;
+};
+
+struct VIEW_KEY_OUTPUT_ENTRY {
+    void serialize(ISerializer &s)
+    {
+        KV_MEMBER(block_height);
+        KV_MEMBER(tx_hash);
+        KV_MEMBER(tx_public_key);
+        KV_MEMBER(unlock_time);
+        KV_MEMBER(output_index);
+        KV_MEMBER(global_index);
+        KV_MEMBER(amount);
+        KV_MEMBER(key);
+    }
+
+    uint32_t block_height;
+    std::string tx_hash;
+    std::string tx_public_key;
+    uint64_t unlock_time;
+    uint32_t output_index;
+    uint32_t global_index;
+    uint64_t amount;
+    std::string key;
+};
+
+struct COMMAND_RPC_GET_VIEW_KEY_OUTPUTS {
+    struct request {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(address);
+            KV_MEMBER(view_key);
+            KV_MEMBER(start_height);
+        }
+
+        std::string address;
+        std::string view_key;
+        uint32_t start_height = 0;
+    };
+
+    struct response {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(outputs);
+            KV_MEMBER(scanned_height);
+            KV_MEMBER(status);
+        }
+
+        std::vector<VIEW_KEY_OUTPUT_ENTRY> outputs;
+        // blocks below this height have been scanned
+        uint32_t scanned_height;
+        std::string status;
+    };
+};
+
+struct RPC_EVENT_ENTRY {
+    void serialize(ISerializer &s)
+    {
+        KV_MEMBER(version);
+        KV_MEMBER(type);
+        KV_MEMBER(height);
+        KV_MEMBER(hash);
+        KV_MEMBER(added_transactions);
+        KV_MEMBER(removed_transactions);
+    }
+
+    uint64_t version;
+    // "block", "reorganization" or "pool"
+    std::string type;
+    uint32_t height;
+    Crypto::Hash hash;
+    std::vector<Crypto::Hash> added_transactions;
+    std::vector<Crypto::Hash> removed_transactions;
+};
+
+struct COMMAND_RPC_GET_EVENTS {
+    struct request {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(known_version);
+            KV_MEMBER(timeout);
+        }
+
+        // version of the last event seen, 0 to only get the current version
+        uint64_t known_version = 0;
+        // seconds to wait for new events
+        uint32_t timeout = 30;
+    };
+
+    struct response {
+        void serialize(ISerializer &s)
+        {
+            KV_MEMBER(version);
+            KV_MEMBER(events);
+            KV_MEMBER(complete);
+            KV_MEMBER(status);
+        }
+
+        uint64_t version;
+        std::vector<RPC_EVENT_ENTRY> events;
+        // false if events after known_version were dropped from the log already
+        bool complete;
+        std::string status;
+    };
+};
+
 } // namespace CryptoNote
@@ -98,4 +98,9 @@ ConnectException::ConnectException(const std::string &whatArg)
 {
 }
 
+UnsupportedRequestException::UnsupportedRequestException(const std::string &whatArg)
+    : std::runtime_error(whatArg.c_str())
+{
+}
+
 } // namespace CryptoNote
@@ -36,6 +36,13 @@ public:
     explicit ConnectException(const std::string &whatArg);
 };
 
+// the server doesn't know the url or answers it with a body that doesn't parse
+class UnsupportedRequestException : public std::runtime_error
+{
+public:
+    explicit UnsupportedRequestException(const std::string &whatArg);
+};
+
 class HttpClient
 {
 public:
@@ -45,10 +52,10 @@ public:
     void request(const HttpRequest &req, HttpResponse &res);
 
     bool isConnected() const;
+    void disconnect();
 
 private:
     void connect();
-    void disconnect();
 
 private:
     const std::string m_address;
@@ -148,8 +155,12 @@ void invokeBinaryCommand(HttpClient &cli,
     hreq.setBody(storeToBinaryKeyValue(req));
     cli.request(hreq, hres);
 
+    if (hres.getStatus() == HttpResponse::STATUS_404) {
+        throw UnsupportedRequestException("HTTP status: " + std::to_string(hres.getStatus()));
+    }
+
     if (!loadFromBinaryKeyValue(res, hres.getBody())) {
-        throw std::runtime_error("Failed to parse binary response");
+        throw UnsupportedRequestException("Failed to parse binary response");
     }
 }
 
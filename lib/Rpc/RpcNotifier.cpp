@@ -0,0 +1,266 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <boost/scope_exit.hpp>
+#include <CryptoNoteCore/CryptoNoteTools.h>
+#include <CryptoNoteCore/ICore.h>
+#include <Rpc/RpcNotifier.h>
+#include <System/InterruptedException.h>
+#include <System/Timer.h>
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t RECENT_BLOCKS_COUNT = 1000;
+const std::chrono::seconds TICK_INTERVAL(1);
+
+} // namespace
+
+RpcNotifier::RpcNotifier(System::Dispatcher &dispatcher, ICore &core)
+    : m_dispatcher(dispatcher),
+      m_core(core),
+      m_alive(std::make_shared<bool>(true)),
+      m_aliveToken(m_alive),
+      m_updateScheduled(false),
+      m_initialized(false),
+      m_version(1),
+      m_firstRecentBlock(0),
+      m_poolVersion(0),
+      m_eventsAdded(dispatcher),
+      m_waiterCount(0),
+      m_ticking(false),
+      m_tickContextGroup(dispatcher)
+{
+    m_core.addObserver(this);
+}
+
+RpcNotifier::~RpcNotifier()
+{
+    m_core.removeObserver(this);
+    m_alive.reset();
+}
+
+bool RpcNotifier::waitForEvents(
+    uint64_t knownVersion,
+    std::chrono::milliseconds timeout,
+    std::vector<RpcEvent> &events,
+    uint64_t &version)
+{
+    if (!m_initialized) {
+        update();
+    }
+
+    if (knownVersion != 0 && knownVersion == m_version) {
+        ++m_waiterCount;
+        BOOST_SCOPE_EXIT_ALL(this) {
+            --m_waiterCount;
+        };
+
+        if (!m_ticking) {
+            m_ticking = true;
+            m_tickContextGroup.spawn([this] { tickProcedure(); });
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (knownVersion == m_version && std::chrono::steady_clock::now() < deadline) {
+            m_eventsAdded.wait();
+        }
+    }
+
+    version = m_version;
+    if (knownVersion == 0) {
+        return true;
+    }
+
+    for (const auto &event : m_events) {
+        if (event.version > knownVersion) {
+            events.push_back(event);
+        }
+    }
+
+    return knownVersion <= m_version
+           && (m_events.empty() || m_events.front().version <= knownVersion + 1);
+}
+
+void RpcNotifier::blockchainUpdated()
+{
+    scheduleUpdate();
+}
+
+void RpcNotifier::poolUpdated()
+{
+    scheduleUpdate();
+}
+
+void RpcNotifier::scheduleUpdate()
+{
+    // notifications coming in while an update is pending are covered by it
+    if (m_updateScheduled.exchange(true)) {
+        return;
+    }
+
+    std::weak_ptr<bool> alive = m_aliveToken;
+    m_dispatcher.remoteSpawn([this, alive]() {
+        if (alive.lock()) {
+            m_updateScheduled = false;
+            update();
+        }
+    });
+}
+
+void RpcNotifier::update()
+{
+    uint64_t version = m_version;
+    updateChain();
+    updatePool();
+    m_initialized = true;
+
+    if (m_version != version) {
+        m_eventsAdded.set();
+        m_eventsAdded.clear();
+    }
+}
+
+void RpcNotifier::updateChain()
+{
+    uint32_t topIndex;
+    Crypto::Hash topHash;
+    m_core.get_blockchain_top(topIndex, topHash);
+
+    if (!m_initialized) {
+        m_recentBlocks.assign(1, topHash);
+        m_firstRecentBlock = topIndex;
+        return;
+    }
+
+    if (!m_recentBlocks.empty() && m_recentBlocks.back() == topHash) {
+        return;
+    }
+
+    size_t lastBlockCount = m_recentBlocks.size();
+    while (!m_recentBlocks.empty()) {
+        uint32_t index = m_firstRecentBlock + static_cast<uint32_t>(m_recentBlocks.size()) - 1;
+        if (index <= topIndex && m_core.getBlockIdByHeight(index) == m_recentBlocks.back()) {
+            break;
+        }
+
+        m_recentBlocks.pop_back();
+    }
+
+    // with all recent blocks dropped, the chain may have got shorter than the first of them
+    uint32_t splitIndex = std::min(
+        m_firstRecentBlock + static_cast<uint32_t>(m_recentBlocks.size()), topIndex + 1);
+    if (m_recentBlocks.size() != lastBlockCount) {
+        RpcEvent event;
+        event.type = RpcEvent::REORGANIZATION;
+        if (splitIndex > topIndex) {
+            event.height = topIndex;
+            event.hash = topHash;
+        } else {
+            event.height = splitIndex;
+            event.hash = m_core.getBlockIdByHeight(splitIndex);
+        }
+        addEvent(std::move(event));
+    }
+
+    if (m_recentBlocks.empty()) {
+        m_firstRecentBlock = splitIndex;
+    }
+
+    for (uint32_t index = splitIndex; index <= topIndex; ++index) {
+        RpcEvent event;
+        event.type = RpcEvent::NEW_BLOCK;
+        event.height = index;
+        event.hash = index == topIndex ? topHash : m_core.getBlockIdByHeight(index);
+        m_recentBlocks.push_back(event.hash);
+        addEvent(std::move(event));
+    }
+
+    while (m_recentBlocks.size() > RECENT_BLOCKS_COUNT) {
+        m_recentBlocks.pop_front();
+        ++m_firstRecentBlock;
+    }
+}
+
+void RpcNotifier::updatePool()
+{
+    uint32_t topIndex;
+    Crypto::Hash topHash;
+    m_core.get_blockchain_top(topIndex, topHash);
+
+    std::vector<Crypto::Hash> knownTransactions(m_poolTransactions.begin(),
+                                                m_poolTransactions.end());
+    std::vector<Transaction> addedTransactions;
+    RpcEvent event;
+    m_core.getPoolChanges(topHash,
+                          knownTransactions,
+                          m_poolVersion,
+                          addedTransactions,
+                          event.removedTransactions,
+                          m_poolVersion);
+
+    for (const auto &transaction : addedTransactions) {
+        Crypto::Hash hash = getObjectHash(transaction);
+        if (m_poolTransactions.insert(hash).second) {
+            event.addedTransactions.push_back(hash);
+        }
+    }
+
+    for (const auto &hash : event.removedTransactions) {
+        m_poolTransactions.erase(hash);
+    }
+
+    if (!m_initialized || (event.addedTransactions.empty() && event.removedTransactions.empty())) {
+        return;
+    }
+
+    event.type = RpcEvent::POOL_CHANGED;
+    event.height = topIndex;
+    event.hash = topHash;
+    addEvent(std::move(event));
+}
+
+void RpcNotifier::addEvent(RpcEvent &&event)
+{
+    event.version = ++m_version;
+    m_events.push_back(std::move(event));
+    if (m_events.size() > MAX_EVENTS) {
+        m_events.pop_front();
+    }
+}
+
+void RpcNotifier::tickProcedure()
+{
+    System::Timer timer(m_dispatcher);
+    try {
+        while (m_waiterCount != 0) {
+            timer.sleep(TICK_INTERVAL);
+            m_eventsAdded.set();
+            m_eventsAdded.clear();
+        }
+    } catch (System::InterruptedException &) {
+        // do nothing
+    }
+
+    m_ticking = false;
+}
+
+} // namespace CryptoNote
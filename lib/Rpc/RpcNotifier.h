@@ -0,0 +1,117 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <CryptoNoteCore/ICoreObserver.h>
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+#include <CryptoNote.h>
+
+namespace CryptoNote {
+
+class ICore;
+
+struct RpcEvent
+{
+    enum Type
+    {
+        NEW_BLOCK,
+        // The blocks from height on were replaced, NEW_BLOCK events for the new ones follow.
+        // If the chain got shorter than height, the event carries the new top block instead.
+        REORGANIZATION,
+        POOL_CHANGED
+    };
+
+    uint64_t version;
+    Type type;
+    uint32_t height;
+    Crypto::Hash hash;
+    std::vector<Crypto::Hash> addedTransactions;
+    std::vector<Crypto::Hash> removedTransactions;
+};
+
+/*
+ * Turns the core's blockchain and pool notifications into a numbered event log for RPC clients
+ * that long-poll instead of polling getinfo and the pool in a loop. Notifications arrive on any
+ * thread and are handed over to the dispatcher, the log itself is only used on the dispatcher.
+ */
+class RpcNotifier : public ICoreObserver
+{
+public:
+    static const size_t MAX_EVENTS = 1000;
+
+    RpcNotifier(System::Dispatcher &dispatcher, ICore &core);
+    RpcNotifier(const RpcNotifier &) = delete;
+    ~RpcNotifier();
+
+    RpcNotifier &operator=(const RpcNotifier &) = delete;
+
+    // Waits until there are events after knownVersion or the timeout expires and returns them.
+    // Returns false if the log doesn't reach back to knownVersion anymore, the caller then has to
+    // query the state it is interested in. A knownVersion of 0 only returns the current version.
+    bool waitForEvents(uint64_t knownVersion,
+                       std::chrono::milliseconds timeout,
+                       std::vector<RpcEvent> &events,
+                       uint64_t &version);
+
+    void blockchainUpdated() override;
+    void poolUpdated() override;
+
+private:
+    void scheduleUpdate();
+    void update();
+    void updateChain();
+    void updatePool();
+    void addEvent(RpcEvent &&event);
+    void tickProcedure();
+
+private:
+    System::Dispatcher &m_dispatcher;
+    ICore &m_core;
+    std::shared_ptr<bool> m_alive;
+    const std::weak_ptr<bool> m_aliveToken;
+    std::atomic<bool> m_updateScheduled;
+
+    bool m_initialized;
+    // starts at 1, as a knownVersion of 0 stands for a client that hasn't seen any version yet
+    uint64_t m_version;
+    std::deque<RpcEvent> m_events;
+    // hashes of the last main chain blocks, from height m_firstRecentBlock on
+    std::deque<Crypto::Hash> m_recentBlocks;
+    uint32_t m_firstRecentBlock;
+    uint64_t m_poolVersion;
+    std::unordered_set<Crypto::Hash> m_poolTransactions;
+
+    // wakes up the waiting requests on new events, and once a second to check their timeouts
+    System::Event m_eventsAdded;
+    size_t m_waiterCount;
+    bool m_ticking;
+    System::ContextGroup m_tickContextGroup;
+};
+
+} // namespace CryptoNote
@@ -29,6 +29,8 @@
 #include <Common/Base58.h>
 #include <Common/HardwareInfo.h>
 #include <Common/Math.h>
+#include <Common/Metrics.h>
+#include <Common/Trace.h>
 #include <CryptoNoteCore/TransactionUtils.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/CryptoNoteFormatUtils.h>
@@ -36,6 +38,7 @@
 #include <CryptoNoteCore/IBlock.h>
 #include <CryptoNoteCore/Miner.h>
 #include <CryptoNoteCore/TransactionExtra.h>
+#include <CryptoNoteCore/ViewKeyScanner.h>
 #include <CryptoNoteProtocol/ICryptoNoteProtocolQuery.h>
 #include <P2p/NetNode.h>
 #include <Rpc/CoreRpcServerErrorCodes.h>
@@ -61,6 +64,9 @@ namespace CryptoNote {
 
 namespace {
 
+// upper bound for how long a get_events request may hold its connection, in seconds
+const uint32_t MAX_EVENTS_TIMEOUT = 60;
+
 template<typename Command>
 RpcServer::HandlerFunction binMethod(bool (RpcServer::*handler)(typename Command::request const &,
                                                                 typename Command::response &))
@@ -140,6 +146,20 @@ RpcServer::HandlerFunction httpMethod(bool (RpcServer::*handler)(typename Comman
     };
 }
 
+Metrics::Histogram &requestMetric(const std::string &method)
+{
+    return Metrics::registry().histogram(
+        "rpc_request_duration_seconds",
+        "Time spent handling RPC requests by URL or JSON-RPC method",
+        { { "method", method } }
+    );
+}
+
+void setGauge(const std::string &name, const std::string &help, int64_t value)
+{
+    Metrics::registry().gauge(name, help).set(value);
+}
+
 } // namespace
 
 std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>>
@@ -151,6 +171,9 @@ std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction
               { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::onQueryBlocks), false } },
             { "/queryblockslite.bin",
               { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::onQueryBlocksLite), false } },
+            { "/queryblockscompact.bin",
+              { binMethod<COMMAND_RPC_QUERY_BLOCKS_COMPACT>(&RpcServer::onQueryBlocksCompact),
+                false } },
 
             { "/get_o_indexes.bin",
               { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::onGetIndexes),
@@ -212,6 +235,7 @@ std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction
             { "/get_pool_changes_lite",
               { jsonMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite),
                 false } },
+            { "/get_events", { jsonMethod<COMMAND_RPC_GET_EVENTS>(&RpcServer::onGetEvents), true } },
             { "/get_block_details_by_height",
               { jsonMethod<COMMAND_RPC_GET_BLOCK_DETAILS_BY_HEIGHT>(
                         &RpcServer::onGetBlockDetailsByHeight),
@@ -272,6 +296,18 @@ std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction
             { "/json_rpc",
               { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1,
                           std::placeholders::_2, std::placeholders::_3),
+                true } },
+
+            // prometheus
+            { "/metrics",
+              { std::bind(&RpcServer::processMetricsRequest, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
+                true } },
+
+            // chrome trace events, disabled in restricted rpc mode
+            { "/trace",
+              { std::bind(&RpcServer::processTraceRequest, std::placeholders::_1,
+                          std::placeholders::_2, std::placeholders::_3),
                 true } }
         };
 
@@ -282,7 +318,8 @@ RpcServer::RpcServer(System::Dispatcher &dispatcher, Logging::ILogger &log, core
       m_core(core),
       m_p2p(p2p),
       m_protocolQuery(protocolQuery),
-      blockchainExplorerDataBuilder(core, protocolQuery)
+      blockchainExplorerDataBuilder(core, protocolQuery),
+      m_notifier(dispatcher, core)
 {
 }
 
@@ -555,6 +592,7 @@ void RpcServer::processRequest(const HttpRequest &request, HttpResponse &respons
             return;
         }
 
+        Metrics::ScopedTimer timer(requestMetric(url));
         it->second.handler(this, request, response);
 
     } catch (const JsonRpc::JsonRpcError &err) {
@@ -646,7 +684,13 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest &request, HttpResponse &
                       { makeMemberMethod(&RpcServer::onCheckReserveProof), false } },
                     { "validateaddress",
                       { makeMemberMethod(&RpcServer::onValidateAddress), false } },
-                    { "verifymessage", { makeMemberMethod(&RpcServer::onVerifyMessage), false } }
+                    { "verifymessage", { makeMemberMethod(&RpcServer::onVerifyMessage), false } },
+                    { "register_view_key",
+                      { makeMemberMethod(&RpcServer::onRegisterViewKey), true } },
+                    { "unregister_view_key",
+                      { makeMemberMethod(&RpcServer::onUnregisterViewKey), true } },
+                    { "get_view_key_outputs",
+                      { makeMemberMethod(&RpcServer::onGetViewKeyOutputs), true } }
                 };
 
         auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
@@ -656,6 +700,7 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest &request, HttpResponse &
         if (!it->second.allowBusyCore && !isCoreReady()) {
             throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
         }
+        Metrics::ScopedTimer timer(requestMetric(it->first));
         it->second.handler(this, jsonRequest, jsonResponse);
     } catch (const JsonRpcError &err) {
         jsonResponse.setError(err);
@@ -669,6 +714,43 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest &request, HttpResponse &
     return true;
 }
 
+bool RpcServer::processMetricsRequest(const HttpRequest &request, HttpResponse &response)
+{
+    // the values kept elsewhere are read on scrape, the dispatcher of the server runs the node
+    setGauge("blockchain_height", "Blocks in the main chain", m_core.getCurrentBlockchainHeight());
+    setGauge("alternative_blocks", "Blocks in alternative chains", m_core.getAlternativeBlocksCount());
+    setGauge("pool_transactions", "Transactions in the pool", m_core.get_pool_transactions_count());
+    setGauge("p2p_connections", "Open P2P connections", m_p2p.get_connections_count());
+    setGauge("rpc_connections", "Open RPC connections", get_connections_count());
+    setGauge(
+        "dispatcher_run_queue_depth",
+        "Contexts waiting to be resumed by the dispatcher of the node",
+        m_dispatcher.getResumingContextCount()
+    );
+
+    response.addHeader("Content-Type", "text/plain; version=0.0.4");
+    response.setStatus(HttpResponse::HTTP_STATUS::STATUS_200);
+    response.setBody(Metrics::registry().format());
+
+    return true;
+}
+
+bool RpcServer::processTraceRequest(const HttpRequest &request, HttpResponse &response)
+{
+    // the spans carry transaction ids and their timing and the export holds the recorder lock
+    if (m_restricted_rpc) {
+        response.setStatus(HttpResponse::STATUS_500);
+        response.setBody("Failed, restricted handle");
+        return false;
+    }
+
+    response.addHeader("Content-Type", "application/json");
+    response.setStatus(HttpResponse::HTTP_STATUS::STATUS_200);
+    response.setBody(Tracing::recorder().toChromeTrace());
+
+    return true;
+}
+
 bool RpcServer::restrictRPC(const bool is_restricted)
 {
     m_restricted_rpc = is_restricted;
@@ -718,6 +800,11 @@ bool RpcServer::setContactInfo(const std::string &contact)
     return true;
 }
 
+void RpcServer::setViewKeyScanner(ViewKeyScanner *scanner)
+{
+    m_viewKeyScanner = scanner;
+}
+
 bool RpcServer::isCoreReady()
 {
     return m_core.currency().isTestnet() || m_p2p.get_payload_object().isSynchronized();
@@ -850,6 +937,27 @@ bool RpcServer::onQueryBlocksLite(const COMMAND_RPC_QUERY_BLOCKS_LITE::request &
     return true;
 }
 
+bool RpcServer::onQueryBlocksCompact(const COMMAND_RPC_QUERY_BLOCKS_COMPACT::request &req,
+                                     COMMAND_RPC_QUERY_BLOCKS_COMPACT::response &res)
+{
+    uint32_t startHeight;
+    uint32_t currentHeight;
+    uint32_t fullOffset;
+    if (!m_core.queryBlocksCompact(req.blockIds, req.timestamp, startHeight, currentHeight,
+                                   fullOffset, res.blocks)) {
+        res.status = "Failed to perform query";
+        return false;
+    }
+
+    res.startHeight = startHeight;
+    res.currentHeight = currentHeight;
+    res.fullOffset = fullOffset;
+
+    res.status = CORE_RPC_STATUS_OK;
+
+    return true;
+}
+
 bool RpcServer::onQueryBlocksDetailed(const COMMAND_RPC_QUERY_BLOCKS_DETAILED::request &req,
                                       COMMAND_RPC_QUERY_BLOCKS_DETAILED::response &res)
 {
@@ -927,7 +1035,8 @@ bool RpcServer::onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request &re
     rsp.status = CORE_RPC_STATUS_OK;
     std::vector<CryptoNote::Transaction> addedTransactions;
     rsp.isTailBlockActual = m_core.getPoolChanges(req.tailBlockId, req.knownTxsIds,
-                                                  addedTransactions, rsp.deletedTxsIds);
+                                                  req.poolVersion, addedTransactions,
+                                                  rsp.deletedTxsIds, rsp.poolVersion);
     for (auto &tx : addedTransactions) {
         BinaryArray txBlob;
         if (!toBinaryArray(tx, txBlob)) {
@@ -945,8 +1054,45 @@ bool RpcServer::onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::re
 {
     rsp.status = CORE_RPC_STATUS_OK;
     rsp.isTailBlockActual = m_core.getPoolChangesLite(req.tailBlockId, req.knownTxsIds,
-                                                      rsp.addedTxs, rsp.deletedTxsIds);
+                                                      req.poolVersion, rsp.addedTxs,
+                                                      rsp.deletedTxsIds, rsp.poolVersion);
+
+    return true;
+}
+
+bool RpcServer::onGetEvents(const COMMAND_RPC_GET_EVENTS::request &req,
+                            COMMAND_RPC_GET_EVENTS::response &res)
+{
+    uint32_t timeout = std::min(req.timeout, MAX_EVENTS_TIMEOUT);
+    std::vector<RpcEvent> events;
+    res.complete = m_notifier.waitForEvents(req.known_version,
+                                            std::chrono::seconds(timeout),
+                                            events,
+                                            res.version);
+
+    for (auto &event : events) {
+        RPC_EVENT_ENTRY entry;
+        entry.version = event.version;
+        switch (event.type) {
+        case RpcEvent::NEW_BLOCK:
+            entry.type = "block";
+            break;
+        case RpcEvent::REORGANIZATION:
+            entry.type = "reorganization";
+            break;
+        case RpcEvent::POOL_CHANGED:
+            entry.type = "pool";
+            break;
+        }
 
+        entry.height = event.height;
+        entry.hash = event.hash;
+        entry.added_transactions = std::move(event.addedTransactions);
+        entry.removed_transactions = std::move(event.removedTransactions);
+        res.events.push_back(std::move(entry));
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
     return true;
 }
 
@@ -2182,23 +2328,26 @@ bool RpcServer::onTransactionJson(const COMMAND_RPC_GET_TRANSACTION_DETAILS::req
     }
     res.txDetails.mixin = mixin;
 
-    Crypto::Hash paymentId;
-    if (CryptoNote::getPaymentIdFromTxExtra(res.tx.extra, paymentId)) {
-        res.txDetails.paymentId = Common::podToHex(paymentId);
+    // every field is listed, the payment id and the public key are taken from the same parse
+    std::vector<CryptoNote::TransactionExtraField> txExtraFields;
+    parseTransactionExtra(res.tx.extra, txExtraFields);
+    TransactionExtraInfo extraInfo;
+    getTransactionExtraInfo(txExtraFields, extraInfo);
+
+    if (extraInfo.hasPaymentId) {
+        res.txDetails.paymentId = Common::podToHex(extraInfo.paymentId);
     } else {
         res.txDetails.paymentId = "";
     }
 
     res.txDetails.extra.raw = res.tx.extra;
 
-    std::vector<CryptoNote::TransactionExtraField> txExtraFields;
-    parseTransactionExtra(res.tx.extra, txExtraFields);
     for (const CryptoNote::TransactionExtraField &field : txExtraFields) {
         if (typeid(CryptoNote::TransactionExtraPadding) == field.type()) {
             res.txDetails.extra.padding.push_back(
                     std::move(boost::get<CryptoNote::TransactionExtraPadding>(field).size));
         } else if (typeid(CryptoNote::TransactionExtraPublicKey) == field.type()) {
-            res.txDetails.extra.publicKey = getTransactionPublicKeyFromExtra(res.tx.extra);
+            res.txDetails.extra.publicKey = extraInfo.publicKey;
         } else if (typeid(CryptoNote::TransactionExtraNonce) == field.type()) {
             res.txDetails.extra.nonce.push_back(Common::toHex(
                     boost::get<CryptoNote::TransactionExtraNonce>(field).nonce.data(),
@@ -2545,7 +2694,12 @@ bool RpcServer::onGetBlockTemplate(const COMMAND_RPC_GET_BLOCK_TEMPLATE::request
     Block b = boost::value_initialized<Block>();
     CryptoNote::BinaryArray blob_reserve;
     blob_reserve.resize(req.reserve_size, 0);
-    if (!m_core.get_block_template(b, acc, res.difficulty, res.height, blob_reserve)) {
+    if (!m_core.get_block_template(b,
+                                   acc,
+                                   res.difficulty,
+                                   res.height,
+                                   blob_reserve,
+                                   res.template_version)) {
         logger(ERROR) << "Failed to create block template";
         throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_INTERNAL_ERROR,
                                       "Internal error: failed to create block template" };
@@ -2867,7 +3021,9 @@ bool RpcServer::onCheckTxWithViewKey(const COMMAND_RPC_CHECK_TX_WITH_PRIVATE_VIE
     CryptoNote::TransactionPrefix transaction = *static_cast<const TransactionPrefix *>(&tx);
 
     // get tx pub key
-    Crypto::PublicKey txPubKey = getTransactionPublicKeyFromExtra(transaction.extra);
+    TransactionExtraInfo extraInfo;
+    m_core.getTransactionExtraInfo(tx, txid, extraInfo);
+    Crypto::PublicKey txPubKey = extraInfo.publicKey;
 
     // obtain key derivation
     Crypto::KeyDerivation derivation;
@@ -2974,7 +3130,9 @@ bool RpcServer::onCheckTxProof(const COMMAND_RPC_CHECK_TX_PROOF::request &req,
     }
     CryptoNote::TransactionPrefix transaction = *static_cast<const TransactionPrefix *>(&tx);
 
-    Crypto::PublicKey R = getTransactionPublicKeyFromExtra(transaction.extra);
+    TransactionExtraInfo extraInfo;
+    m_core.getTransactionExtraInfo(tx, txid, extraInfo);
+    Crypto::PublicKey R = extraInfo.publicKey;
     if (R == NULL_PUBLIC_KEY) {
         throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_INTERNAL_ERROR,
                                       "Tx pubkey was not found" };
@@ -3103,7 +3261,9 @@ bool RpcServer::onCheckReserveProof(const COMMAND_RPC_CHECK_RESERVE_PROOF::reque
         const KeyOutput out_key = boost::get<KeyOutput>(tx.outputs[proof.index_in_tx].target);
 
         // get tx pub key
-        Crypto::PublicKey txPubKey = getTransactionPublicKeyFromExtra(tx.extra);
+        TransactionExtraInfo extraInfo;
+        m_core.getTransactionExtraInfo(transactions[i], proof.txid, extraInfo);
+        Crypto::PublicKey txPubKey = extraInfo.publicKey;
 
         // check singature for shared secret
         if (!Crypto::checkTxProof(prefix_hash, address.viewPublicKey, txPubKey, proof.shared_secret,
@@ -3302,4 +3462,106 @@ bool RpcServer::onGetDifficultyStat(const COMMAND_RPC_GET_DIFFICULTY_STAT::reque
     return true;
 }
 
+void RpcServer::parseViewKeyAccount(const std::string &addressString,
+                                    const std::string &viewKeyString,
+                                    AccountPublicAddress &address,
+                                    Crypto::SecretKey &viewKey)
+{
+    if (m_viewKeyScanner == nullptr) {
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_RESTRICTED,
+                                      "View key scanning is not enabled on this node" };
+    }
+
+    if (!m_core.currency().parseAccountAddressString(addressString, address)) {
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "Failed to parse address " + addressString + '.' };
+    }
+
+    size_t size;
+    if (!Common::fromHex(viewKeyString, &viewKey, sizeof(viewKey), size)
+        || size != sizeof(viewKey)) {
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "Failed to parse private view key" };
+    }
+}
+
+bool RpcServer::onRegisterViewKey(const COMMAND_RPC_REGISTER_VIEW_KEY::request &req,
+                                  COMMAND_RPC_REGISTER_VIEW_KEY::response &res)
+{
+    AccountPublicAddress address;
+    Crypto::SecretKey viewKey;
+    parseViewKeyAccount(req.address, req.view_key, address, viewKey);
+
+    switch (m_viewKeyScanner->addAccount(address, viewKey, req.start_height)) {
+    case ViewKeyScanner::AddResult::Added:
+        break;
+    case ViewKeyScanner::AddResult::WrongViewKey:
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "The view key doesn't belong to the address" };
+    case ViewKeyScanner::AddResult::AlreadyRegistered:
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "The address is registered already" };
+    case ViewKeyScanner::AddResult::TooManyAccounts:
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_CORE_BUSY,
+                                      "No more view keys can be registered on this node" };
+    case ViewKeyScanner::AddResult::StartTooFarBehind:
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "The start height is too far behind the top block" };
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
+
+    return true;
+}
+
+bool RpcServer::onUnregisterViewKey(const COMMAND_RPC_UNREGISTER_VIEW_KEY::request &req,
+                                    COMMAND_RPC_UNREGISTER_VIEW_KEY::response &res)
+{
+    AccountPublicAddress address;
+    Crypto::SecretKey viewKey;
+    parseViewKeyAccount(req.address, req.view_key, address, viewKey);
+
+    if (!m_viewKeyScanner->removeAccount(address, viewKey)) {
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "The address is not registered with this view key" };
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
+
+    return true;
+}
+
+bool RpcServer::onGetViewKeyOutputs(const COMMAND_RPC_GET_VIEW_KEY_OUTPUTS::request &req,
+                                    COMMAND_RPC_GET_VIEW_KEY_OUTPUTS::response &res)
+{
+    AccountPublicAddress address;
+    Crypto::SecretKey viewKey;
+    parseViewKeyAccount(req.address, req.view_key, address, viewKey);
+
+    std::vector<ViewKeyScannerOutput> outputs;
+    if (!m_viewKeyScanner->getOutputs(address, viewKey, req.start_height, outputs,
+                                      res.scanned_height)) {
+        throw JsonRpc::JsonRpcError { CORE_RPC_ERROR_CODE_WRONG_PARAM,
+                                      "The address is not registered with this view key" };
+    }
+
+    res.outputs.reserve(outputs.size());
+    for (const auto &output : outputs) {
+        VIEW_KEY_OUTPUT_ENTRY entry;
+        entry.block_height = output.blockIndex;
+        entry.tx_hash = Common::podToHex(output.transactionHash);
+        entry.tx_public_key = Common::podToHex(output.transactionPublicKey);
+        entry.unlock_time = output.unlockTime;
+        entry.output_index = output.outputInTransaction;
+        entry.global_index = output.globalOutputIndex;
+        entry.amount = output.amount;
+        entry.key = Common::podToHex(output.outputKey);
+        res.outputs.push_back(entry);
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
+
+    return true;
+}
+
 } // namespace CryptoNote
@@ -35,6 +35,7 @@
 
 #include <Rpc/CoreRpcServerCommandsDefinitions.h>
 #include <Rpc/HttpServer.h>
+#include <Rpc/RpcNotifier.h>
 
 using namespace Societatis;
 
@@ -48,6 +49,8 @@ class BlockchainExplorer;
 
 class ICryptoNoteProtocolQuery;
 
+class ViewKeyScanner;
+
 class RpcServer : public HttpServer
 {
     template<class Handler>
@@ -76,6 +79,8 @@ public:
 
     bool setContactInfo(const std::string &contact);
 
+    void setViewKeyScanner(ViewKeyScanner *scanner);
+
     bool masternodeCheckIncomingTx(const BinaryArray &tx_blob);
 
     std::string getCorsDomain();
@@ -84,6 +89,10 @@ private:
     void processRequest(const HttpRequest &request, HttpResponse &response) override;
 
     bool processJsonRpcRequest(const HttpRequest &request, HttpResponse &response);
+    // counters and latencies in the Prometheus text format
+    bool processMetricsRequest(const HttpRequest &request, HttpResponse &response);
+    // the latest block processing spans in the Chrome trace event format
+    bool processTraceRequest(const HttpRequest &request, HttpResponse &response);
 
     bool isCoreReady();
 
@@ -97,6 +106,9 @@ private:
     bool onQueryBlocksLite(const COMMAND_RPC_QUERY_BLOCKS_LITE::request &req,
                            COMMAND_RPC_QUERY_BLOCKS_LITE::response &res);
 
+    bool onQueryBlocksCompact(const COMMAND_RPC_QUERY_BLOCKS_COMPACT::request &req,
+                              COMMAND_RPC_QUERY_BLOCKS_COMPACT::response &res);
+
     bool onQueryBlocksDetailed(const COMMAND_RPC_QUERY_BLOCKS_DETAILED::request &req,
                                COMMAND_RPC_QUERY_BLOCKS_DETAILED::response &res);
 
@@ -112,6 +124,9 @@ private:
     bool onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request &req,
                               COMMAND_RPC_GET_POOL_CHANGES_LITE::response &rsp);
 
+    bool onGetEvents(const COMMAND_RPC_GET_EVENTS::request &req,
+                     COMMAND_RPC_GET_EVENTS::response &res);
+
     // http handlers
     bool onGetIndex(const COMMAND_HTTP::request &req, COMMAND_HTTP::response &res);
 
@@ -272,6 +287,17 @@ private:
     bool onResolveOpenAlias(const COMMAND_RPC_RESOLVE_OPEN_ALIAS::request &req,
                             COMMAND_RPC_RESOLVE_OPEN_ALIAS::response &res);
 
+    bool onRegisterViewKey(const COMMAND_RPC_REGISTER_VIEW_KEY::request &req,
+                           COMMAND_RPC_REGISTER_VIEW_KEY::response &res);
+    bool onUnregisterViewKey(const COMMAND_RPC_UNREGISTER_VIEW_KEY::request &req,
+                             COMMAND_RPC_UNREGISTER_VIEW_KEY::response &res);
+    bool onGetViewKeyOutputs(const COMMAND_RPC_GET_VIEW_KEY_OUTPUTS::request &req,
+                             COMMAND_RPC_GET_VIEW_KEY_OUTPUTS::response &res);
+    void parseViewKeyAccount(const std::string &addressString,
+                             const std::string &viewKeyString,
+                             AccountPublicAddress &address,
+                             Crypto::SecretKey &viewKey);
+
 private:
     static std::unordered_map<std::string, RpcHandler<HandlerFunction>> s_handlers;
     CryptoNote::BlockchainExplorerDataBuilder blockchainExplorerDataBuilder;
@@ -285,6 +311,8 @@ private:
     std::string m_contact_info;
     Crypto::SecretKey m_view_key = NULL_SECRET_KEY;
     AccountPublicAddress m_fee_acc;
+    ViewKeyScanner *m_viewKeyScanner = nullptr;
+    RpcNotifier m_notifier;
 };
 
 } // namespace CryptoNote
@@ -17,6 +17,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <sstream>
@@ -35,6 +36,14 @@ using namespace Logging;
 namespace {
 
 const int RETRY_TIMEOUT = 5;
+const size_t INITIAL_PREFETCH_DEPTH = 2;
+const size_t MAX_PREFETCH_DEPTH = 8;
+
+template<typename Duration>
+void updateAverage(Duration &average, Duration sample)
+{
+    average = average.count() == 0 ? sample : (average * 3 + sample) / 4;
+}
 
 std::ostream &operator<<(std::ostream &os, const CryptoNote::IBlockchainConsumer *consumer)
 {
@@ -94,8 +103,16 @@ BlockchainSynchronizer::BlockchainSynchronizer(
       m_node(node),
       m_genesisBlockHash(genesisBlockHash),
       m_currentState(State::stopped),
-      m_futureState(State::stopped)
+      m_futureState(State::stopped),
+      m_prefetchGeneration(0),
+      m_prefetchActive(false),
+      m_prefetchStopped(true),
+      m_prefetchDepth(INITIAL_PREFETCH_DEPTH),
+      m_queryLatency(std::chrono::steady_clock::duration::zero()),
+      m_processingTime(std::chrono::steady_clock::duration::zero()),
+      m_consumerUpdatesSuspender(std::thread::id())
 {
+    m_pendingBlocks.startHeight = 0;
 }
 
 BlockchainSynchronizer::~BlockchainSynchronizer()
@@ -220,6 +237,7 @@ std::future<void> BlockchainSynchronizer::removeUnconfirmedTransaction(
 std::error_code BlockchainSynchronizer::doAddUnconfirmedTransaction(
     const ITransactionReader &transaction)
 {
+    std::unique_lock<std::mutex> updatesLock(m_consumerUpdatesMutex);
     std::unique_lock<std::mutex> lk(m_consumersMutex);
 
     std::error_code ec;
@@ -256,6 +274,7 @@ std::error_code BlockchainSynchronizer::doAddUnconfirmedTransaction(
 
 void BlockchainSynchronizer::doRemoveUnconfirmedTransaction(const Crypto::Hash &transactionHash)
 {
+    std::unique_lock<std::mutex> updatesLock(m_consumerUpdatesMutex);
     std::unique_lock<std::mutex> lk(m_consumersMutex);
 
     for (auto &consumer : m_consumers) {
@@ -414,6 +433,183 @@ void BlockchainSynchronizer::workingProcedure()
     m_logger(DEBUGGING) << "Working thread stopped";
 }
 
+void BlockchainSynchronizer::prefetchProcedure()
+{
+    m_logger(DEBUGGING) << "Prefetch thread started";
+
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    for (;;) {
+        m_prefetchChanged.wait(lk, [this] {
+            return m_prefetchStopped
+                   || (m_prefetchActive && m_prefetchedBlocks.size() < m_prefetchDepth);
+        });
+
+        if (m_prefetchStopped) {
+            break;
+        }
+
+        uint64_t generation = m_prefetchGeneration;
+        GetBlocksRequest request = getCommonHistory();
+        lk.unlock();
+
+        uint32_t knownHeight = request.knownHeight;
+        bool hasRequest = !request.knownBlocks.empty();
+
+        PrefetchedBlocks prefetched;
+        auto queryStart = std::chrono::steady_clock::now();
+        if (hasRequest) {
+            prefetched.ec = queryBlocks(std::move(request), prefetched);
+        }
+
+        auto queryLatency = std::chrono::steady_clock::now() - queryStart;
+
+        lk.lock();
+        if (generation != m_prefetchGeneration) {
+            m_logger(DEBUGGING) << "Prefetched blocks discarded";
+            continue;
+        }
+
+        if (!hasRequest) {
+            m_prefetchActive = false;
+            m_prefetchChanged.notify_all();
+            continue;
+        }
+
+        // keep requesting while the node returns blocks above the known ones
+        const BlockchainInterval &interval = prefetched.interval;
+        uint32_t intervalEnd = interval.startHeight + static_cast<uint32_t>(interval.blocks.size());
+        bool caughtUp = prefetched.ec || intervalEnd <= knownHeight;
+
+        if (!prefetched.ec) {
+            updateAverage(m_queryLatency, queryLatency);
+
+            uint32_t pendingEnd = m_pendingBlocks.startHeight
+                                  + static_cast<uint32_t>(m_pendingBlocks.blocks.size());
+            if (m_pendingBlocks.blocks.empty()
+                || interval.startHeight <= m_pendingBlocks.startHeight) {
+                m_pendingBlocks = interval;
+            } else if (interval.startHeight <= pendingEnd) {
+                m_pendingBlocks.blocks.resize(interval.startHeight - m_pendingBlocks.startHeight);
+                m_pendingBlocks.blocks.insert(m_pendingBlocks.blocks.end(),
+                                              interval.blocks.begin(),
+                                              interval.blocks.end());
+            } else {
+                caughtUp = true;
+            }
+        }
+
+        m_prefetchActive = !caughtUp;
+        m_prefetchedBlocks.push_back(std::move(prefetched));
+        m_prefetchChanged.notify_all();
+    }
+
+    m_logger(DEBUGGING) << "Prefetch thread stopped";
+}
+
+void BlockchainSynchronizer::startPrefetch()
+{
+    resetPrefetch();
+
+    std::unique_lock<std::mutex> consumersLock(m_consumersMutex);
+    updateConsumersHistory();
+    consumersLock.unlock();
+
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    m_prefetchStopped = false;
+    lk.unlock();
+
+    m_prefetchThread.reset(new std::thread([this] { prefetchProcedure(); }));
+}
+
+void BlockchainSynchronizer::stopPrefetch()
+{
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    m_prefetchStopped = true;
+    m_prefetchChanged.notify_all();
+    lk.unlock();
+
+    if (m_prefetchThread.get() != nullptr && m_prefetchThread->joinable()) {
+        m_prefetchThread->join();
+    }
+
+    m_prefetchThread.reset();
+    resetPrefetch();
+}
+
+void BlockchainSynchronizer::resetPrefetch()
+{
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    ++m_prefetchGeneration;
+    m_prefetchedBlocks.clear();
+    m_pendingBlocks.startHeight = 0;
+    m_pendingBlocks.blocks.clear();
+    m_prefetchActive = false;
+    m_prefetchChanged.notify_all();
+}
+
+bool BlockchainSynchronizer::takePrefetchedBlocks(PrefetchedBlocks &prefetched)
+{
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    if (m_prefetchedBlocks.empty() && !m_prefetchActive) {
+        // every prefetched batch is added to the consumers already
+        m_pendingBlocks.blocks.clear();
+        m_prefetchActive = true;
+        m_prefetchChanged.notify_all();
+    }
+
+    m_prefetchChanged.wait(lk, [this] {
+        return !m_prefetchedBlocks.empty() || !m_prefetchActive || m_prefetchStopped;
+    });
+
+    if (m_prefetchedBlocks.empty()) {
+        return false;
+    }
+
+    prefetched = std::move(m_prefetchedBlocks.front());
+    m_prefetchedBlocks.pop_front();
+    m_prefetchChanged.notify_all();
+
+    return true;
+}
+
+void BlockchainSynchronizer::releasePrefetchedBlocks(
+    const BlockchainInterval &interval,
+    std::chrono::steady_clock::duration processingTime)
+{
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+
+    // consumers now know these blocks, so they are dropped from the pending ones
+    uint32_t intervalEnd = interval.startHeight + static_cast<uint32_t>(interval.blocks.size());
+    uint32_t pendingEnd = m_pendingBlocks.startHeight
+                          + static_cast<uint32_t>(m_pendingBlocks.blocks.size());
+    if (interval.startHeight <= m_pendingBlocks.startHeight
+        && intervalEnd > m_pendingBlocks.startHeight) {
+        auto count = std::min(intervalEnd, pendingEnd) - m_pendingBlocks.startHeight;
+        auto pendingBegin = m_pendingBlocks.blocks.begin();
+        if (std::equal(pendingBegin,
+                       pendingBegin + count,
+                       interval.blocks.begin()
+                       + (m_pendingBlocks.startHeight - interval.startHeight))) {
+            m_pendingBlocks.blocks.erase(pendingBegin, pendingBegin + count);
+            m_pendingBlocks.startHeight += count;
+        }
+    }
+
+    // fetch further ahead while a query takes longer than the consumers need for a batch
+    updateAverage(m_processingTime, processingTime);
+    if (m_processingTime.count() > 0) {
+        size_t depth = 1 + static_cast<size_t>(m_queryLatency / m_processingTime);
+        m_prefetchDepth = std::max<size_t>(1, std::min(depth, MAX_PREFETCH_DEPTH));
+    }
+
+    m_logger(DEBUGGING)
+        << "Blocks added in "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(processingTime).count()
+        << " ms, prefetch depth "
+        << m_prefetchDepth;
+    m_prefetchChanged.notify_all();
+}
+
 void BlockchainSynchronizer::start()
 {
     m_logger(INFO, BRIGHT_WHITE) << "Starting...";
@@ -432,6 +628,7 @@ void BlockchainSynchronizer::start()
         throw std::runtime_error(message);
     }
 
+    startPrefetch();
     workingThread.reset(new std::thread([this] { workingProcedure(); }));
 }
 
@@ -446,9 +643,23 @@ void BlockchainSynchronizer::stop()
     }
 
     workingThread.reset();
+    stopPrefetch();
     m_logger(INFO, BRIGHT_WHITE) << "Stopped";
 }
 
+BlockchainSynchronizer::ConsumerUpdatesSuspension::ConsumerUpdatesSuspension(
+    BlockchainSynchronizer &synchronizer)
+    : m_synchronizer(synchronizer),
+      m_lock(synchronizer.m_consumerUpdatesMutex)
+{
+    m_synchronizer.m_consumerUpdatesSuspender = std::this_thread::get_id();
+}
+
+BlockchainSynchronizer::ConsumerUpdatesSuspension::~ConsumerUpdatesSuspension()
+{
+    m_synchronizer.m_consumerUpdatesSuspender = std::thread::id();
+}
+
 void BlockchainSynchronizer::localBlockchainUpdated(uint32_t height)
 {
     m_logger(DEBUGGING) << "Event: localBlockchainUpdated " << height;
@@ -498,32 +709,80 @@ void BlockchainSynchronizer::getPoolUnionAndIntersection(
         << poolIntersection.size();
 }
 
+/// \pre m_consumersMutex is locked
+void BlockchainSynchronizer::updateConsumersHistory()
+{
+    ConsumersHistory history;
+    history.height = 0;
+
+    if (!m_consumers.empty()) {
+        auto shortest = m_consumers.begin();
+        history.syncStart = shortest->first->getSyncStart();
+        auto it = shortest;
+        ++it;
+        for (; it != m_consumers.end(); ++it) {
+            if (it->second->getHeight() < shortest->second->getHeight()) {
+                shortest = it;
+            }
+
+            auto consumerStart = it->first->getSyncStart();
+            history.syncStart.timestamp = std::min(history.syncStart.timestamp,
+                                                   consumerStart.timestamp);
+            history.syncStart.height = std::min(history.syncStart.height, consumerStart.height);
+        }
+
+        m_logger(DEBUGGING) << "Shortest chain size " << shortest->second->getHeight();
+
+        auto localHeight = m_node.getLastLocalBlockHeight();
+        history.height = shortest->second->getHeight();
+        history.blocks = shortest->second->getShortHistory(localHeight);
+        history.blockHeights = SynchronizationState::getShortHistoryHeights(
+            std::min(history.height, localHeight + 1));
+    }
+
+    std::unique_lock<std::mutex> lk(m_prefetchMutex);
+    m_consumersHistory = std::move(history);
+}
+
+/// \pre m_prefetchMutex is locked
 BlockchainSynchronizer::GetBlocksRequest BlockchainSynchronizer::getCommonHistory()
 {
     GetBlocksRequest request;
-    std::unique_lock<std::mutex> lk(m_consumersMutex);
-    if (m_consumers.empty()) {
+    if (m_consumersHistory.blocks.empty()) {
         return request;
     }
 
-    auto shortest = m_consumers.begin();
-    auto syncStart = shortest->first->getSyncStart();
-    auto it = shortest;
-    ++it;
-    for (; it != m_consumers.end(); ++it) {
-        if (it->second->getHeight() < shortest->second->getHeight()) {
-            shortest = it;
+    // continue from the blocks that are prefetched, but not added to the consumers yet
+    if (!m_pendingBlocks.blocks.empty()
+        && m_pendingBlocks.startHeight <= m_consumersHistory.height) {
+        uint32_t pendingEnd = m_pendingBlocks.startHeight
+                              + static_cast<uint32_t>(m_pendingBlocks.blocks.size());
+        auto localHeight = m_node.getLastLocalBlockHeight();
+        auto heights = SynchronizationState::getShortHistoryHeights(
+            std::min(pendingEnd, localHeight + 1));
+        for (uint32_t height : heights) {
+            if (height < m_pendingBlocks.startHeight) {
+                break;
+            }
+
+            request.knownBlocks.push_back(
+                m_pendingBlocks.blocks[height - m_pendingBlocks.startHeight]);
         }
 
-        auto consumerStart = it->first->getSyncStart();
-        syncStart.timestamp = std::min(syncStart.timestamp, consumerStart.timestamp);
-        syncStart.height = std::min(syncStart.height, consumerStart.height);
-    }
+        // the consumers already have the blocks below the pending ones
+        for (size_t i = 0; i < m_consumersHistory.blocks.size(); ++i) {
+            if (m_consumersHistory.blockHeights[i] < m_pendingBlocks.startHeight) {
+                request.knownBlocks.push_back(m_consumersHistory.blocks[i]);
+            }
+        }
 
-    m_logger(DEBUGGING) << "Shortest chain size " << shortest->second->getHeight();
+        request.knownHeight = pendingEnd;
+    } else {
+        request.knownBlocks = m_consumersHistory.blocks;
+        request.knownHeight = m_consumersHistory.height;
+    }
 
-    request.knownBlocks = shortest->second->getShortHistory(m_node.getLastLocalBlockHeight());
-    request.syncStart = syncStart;
+    request.syncStart = m_consumersHistory.syncStart;
 
     m_logger(DEBUGGING)
         << "Common history: start block index "
@@ -538,106 +797,119 @@ void BlockchainSynchronizer::startBlockchainSync()
 {
     m_logger(DEBUGGING) << "Starting blockchain synchronization...";
 
-    GetBlocksResponse response;
-    GetBlocksRequest req = getCommonHistory();
+    PrefetchedBlocks prefetched;
+    if (!takePrefetchedBlocks(prefetched)) {
+        return;
+    }
 
-    try {
-        if (!req.knownBlocks.empty()) {
-            auto queryBlocksCompleted = std::promise<std::error_code>();
-            auto queryBlocksWaitFuture = queryBlocksCompleted.get_future();
-
-            m_node.queryBlocks(
-                std::move(req.knownBlocks),
-                req.syncStart.timestamp,
-                response.newBlocks,
-                response.startHeight,
-                [&queryBlocksCompleted](std::error_code ec) {
-                    auto detachedPromise = std::move(queryBlocksCompleted);
-                    detachedPromise.set_value(ec);
-                }
-            );
+    if (prefetched.ec) {
+        resetPrefetch();
+        setFutureStateIf(State::idle, [this] { return m_futureState != State::stopped; });
+        m_observerManager.notify(&IBlockchainSynchronizerObserver::synchronizationCompleted,
+                                 prefetched.ec);
+        return;
+    }
 
-            std::error_code ec = queryBlocksWaitFuture.get();
+    processBlocks(prefetched);
+}
 
-            if (ec) {
-                m_logger(ERROR, BRIGHT_RED)
-                    << "Failed to query blocks: "
-                    << ec
-                    << ", "
-                    << ec.message();
-                setFutureStateIf(State::idle, [this] { return m_futureState != State::stopped; });
-                m_observerManager.notify(
-                    &IBlockchainSynchronizerObserver::synchronizationCompleted,
-                    ec);
-            } else {
-                m_logger(DEBUGGING)
-                    << "Blocks received, start index "
-                    << response.startHeight
-                    << ", count "
-                    << response.newBlocks.size();
-                processBlocks(response);
+std::error_code BlockchainSynchronizer::queryBlocks(GetBlocksRequest &&request,
+                                                    PrefetchedBlocks &prefetched)
+{
+    GetBlocksResponse response;
+
+    try {
+        auto queryBlocksCompleted = std::promise<std::error_code>();
+        auto queryBlocksWaitFuture = queryBlocksCompleted.get_future();
+
+        m_node.queryBlocks(
+            std::move(request.knownBlocks),
+            request.syncStart.timestamp,
+            response.newBlocks,
+            response.startHeight,
+            [&queryBlocksCompleted](std::error_code ec) {
+                auto detachedPromise = std::move(queryBlocksCompleted);
+                detachedPromise.set_value(ec);
             }
+        );
+
+        std::error_code ec = queryBlocksWaitFuture.get();
+        if (ec) {
+            m_logger(ERROR, BRIGHT_RED) << "Failed to query blocks: " << ec << ", " << ec.message();
+            return ec;
         }
     } catch (const std::exception &e) {
-        m_logger(ERROR, BRIGHT_RED) << "Failed to query and process blocks: " << e.what();
-        setFutureStateIf(State::idle,  [this] { return m_futureState != State::stopped; });
-        m_observerManager.notify(&IBlockchainSynchronizerObserver::synchronizationCompleted,
-                                 std::make_error_code(std::errc::invalid_argument));
+        m_logger(ERROR, BRIGHT_RED) << "Failed to query blocks: " << e.what();
+        return std::make_error_code(std::errc::invalid_argument);
     }
-}
 
-void BlockchainSynchronizer::processBlocks(GetBlocksResponse &response)
-{
     m_logger(DEBUGGING)
-        << "Process blocks, start index "
+        << "Blocks received, start index "
         << response.startHeight
         << ", count "
         << response.newBlocks.size();
 
-    BlockchainInterval interval;
-    interval.startHeight = response.startHeight;
-    std::vector<CompleteBlock> blocks;
-
-    for (auto &block : response.newBlocks) {
-        if (checkIfShouldStop()) {
-            break;
-        }
+    prefetched.interval.startHeight = response.startHeight;
+    prefetched.interval.blocks.reserve(response.newBlocks.size());
+    prefetched.blocks.reserve(response.newBlocks.size());
 
-        CompleteBlock completeBlock;
-        completeBlock.blockHash = block.blockHash;
-        interval.blocks.push_back(completeBlock.blockHash);
-        if (block.hasBlock) {
-            completeBlock.block = std::move(block.block);
-            completeBlock.transactions.push_back(createTransactionPrefix(
-                completeBlock.block->baseTransaction
-            ));
+    try {
+        for (auto &block : response.newBlocks) {
+            CompleteBlock completeBlock;
+            completeBlock.blockHash = block.blockHash;
+            prefetched.interval.blocks.push_back(completeBlock.blockHash);
+            if (block.hasBlock) {
+                completeBlock.block = std::move(block.block);
+                completeBlock.transactions.push_back(createTransactionPrefix(
+                    completeBlock.block->baseTransaction
+                ));
 
-            try {
                 for (const auto &txShortInfo : block.txsShortInfo) {
                     completeBlock.transactions.push_back(createTransactionPrefix(
                         txShortInfo.txPrefix,
                         reinterpret_cast<const Hash&>(txShortInfo.txId)
                     ));
                 }
-            } catch (const std::exception &e) {
-                m_logger(ERROR, BRIGHT_RED) << "Failed to process blocks: " << e.what();
-                setFutureStateIf(State::idle, [this] { return m_futureState != State::stopped; });
-                m_observerManager.notify(&IBlockchainSynchronizerObserver::synchronizationCompleted,
-                                         std::make_error_code(std::errc::invalid_argument));
-                return;
             }
-        }
 
-        blocks.push_back(std::move(completeBlock));
+            prefetched.blocks.push_back(std::move(completeBlock));
+        }
+    } catch (const std::exception &e) {
+        m_logger(ERROR, BRIGHT_RED) << "Failed to process blocks: " << e.what();
+        return std::make_error_code(std::errc::invalid_argument);
     }
 
-    uint32_t processedBlockCount = response.startHeight
-                                   + static_cast<uint32_t>(response.newBlocks.size());
+    return std::error_code();
+}
+
+void BlockchainSynchronizer::processBlocks(PrefetchedBlocks &prefetched)
+{
+    const BlockchainInterval &interval = prefetched.interval;
+    const std::vector<CompleteBlock> &blocks = prefetched.blocks;
+
+    m_logger(DEBUGGING)
+        << "Process blocks, start index "
+        << interval.startHeight
+        << ", count "
+        << blocks.size();
+
+    uint32_t processedBlockCount = interval.startHeight + static_cast<uint32_t>(blocks.size());
     if (!checkIfShouldStop()) {
-        response.newBlocks.clear();
+        auto processingStart = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> updatesLock(m_consumerUpdatesMutex);
         std::unique_lock<std::mutex> lk(m_consumersMutex);
         auto result = updateConsumers(interval, blocks);
+        updateConsumersHistory();
         lk.unlock();
+        updatesLock.unlock();
+
+        // prefetched blocks stay valid only while every batch is added in order
+        if (result == UpdateConsumersResult::addedNewBlocks) {
+            releasePrefetchedBlocks(interval,
+                                    std::chrono::steady_clock::now() - processingStart);
+        } else {
+            resetPrefetch();
+        }
 
         switch (result) {
         case UpdateConsumersResult::errorOccurred:
@@ -669,6 +941,7 @@ void BlockchainSynchronizer::processBlocks(GetBlocksResponse &response)
     }
 
     if (checkIfShouldStop()) { //Sic!
+        resetPrefetch();
         m_logger(WARNING, BRIGHT_YELLOW) << "Block processing is interrupted";
         m_observerManager.notify(&IBlockchainSynchronizerObserver::synchronizationCompleted,
                                  std::make_error_code(std::errc::interrupted));
@@ -754,6 +1027,7 @@ void BlockchainSynchronizer::removeOutdatedTransactions()
             << ':'
             << makeContainerFormatter(response.deletedTxIds);
 
+        std::unique_lock<std::mutex> updatesLock(m_consumerUpdatesMutex);
         std::unique_lock<std::mutex> lock(m_consumersMutex);
         for (auto &consumer : m_consumers) {
             ec = consumer.first->onPoolUpdated({}, response.deletedTxIds);
@@ -919,6 +1193,7 @@ std::error_code BlockchainSynchronizer::processPoolTxs(GetPoolResponse &response
 
     std::error_code error;
     {
+        std::unique_lock<std::mutex> updatesLock(m_consumerUpdatesMutex);
         std::unique_lock<std::mutex> lk(m_consumersMutex);
         for (auto &consumer : m_consumers) {
             if (checkIfShouldStop()) { // if stop, return immediately, without notification
@@ -953,7 +1228,8 @@ SynchronizationState *BlockchainSynchronizer::getConsumerSynchronizationState(
 {
     assert(consumer != nullptr);
 
-    if (!(checkIfStopped() && checkIfShouldStop())) {
+    if (!(checkIfStopped() && checkIfShouldStop())
+        && m_consumerUpdatesSuspender != std::this_thread::get_id()) {
         auto message = "Failed to get consumer state: not stopped";
         m_logger(ERROR, BRIGHT_RED) << message << ", consumer " << consumer;
         throw std::runtime_error(message);
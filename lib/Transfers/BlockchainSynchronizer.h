@@ -20,9 +20,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <future>
 #include <mutex>
+#include <thread>
 #include <Logging/LoggerRef.h>
 #include <Transfers/IBlockchainSynchronizer.h>
 #include <Transfers/IObservableImpl.h>
@@ -49,10 +52,30 @@ class BlockchainSynchronizer : public IObservableImpl<
         {
             syncStart.timestamp = 0;
             syncStart.height = 0;
+            knownHeight = 0;
         }
 
         SynchronizationStart syncStart;
         std::vector<Crypto::Hash> knownBlocks;
+        uint32_t knownHeight;
+    };
+
+    // short history of the shortest consumer chain, copied whenever the consumers change,
+    // so that building the next request never waits for the consumers to add blocks
+    struct ConsumersHistory
+    {
+        SynchronizationStart syncStart;
+        uint32_t height;
+        std::vector<uint32_t> blockHeights;
+        SynchronizationState::ShortHistory blocks;
+    };
+
+    // a queried and decoded batch, waiting for the consumers
+    struct PrefetchedBlocks
+    {
+        std::error_code ec;
+        BlockchainInterval interval;
+        std::vector<CompleteBlock> blocks;
     };
 
     struct GetPoolResponse
@@ -89,6 +112,22 @@ class BlockchainSynchronizer : public IObservableImpl<
     typedef std::map<IBlockchainConsumer *, std::shared_ptr<SynchronizationState>> ConsumersMap;
 
 public:
+    // Holds consumer updates back while alive, so that consumer states can be saved
+    // consistently without stopping synchronization
+    class ConsumerUpdatesSuspension
+    {
+    public:
+        explicit ConsumerUpdatesSuspension(BlockchainSynchronizer &synchronizer);
+        ~ConsumerUpdatesSuspension();
+
+        ConsumerUpdatesSuspension(const ConsumerUpdatesSuspension &) = delete;
+        ConsumerUpdatesSuspension &operator=(const ConsumerUpdatesSuspension &) = delete;
+
+    private:
+        BlockchainSynchronizer &m_synchronizer;
+        std::unique_lock<std::mutex> m_lock;
+    };
+
     BlockchainSynchronizer(INode &node,
                            Logging::ILogger &logger,
                            const Crypto::Hash &genesisBlockHash);
@@ -120,7 +159,7 @@ private:
     void startPoolSync();
     void startBlockchainSync();
 
-    void processBlocks(GetBlocksResponse &response);
+    void processBlocks(PrefetchedBlocks &prefetched);
     UpdateConsumersResult updateConsumers(const BlockchainInterval &interval,
                                           const std::vector<CompleteBlock> &blocks);
     std::error_code processPoolTxs(GetPoolResponse &response);
@@ -140,6 +179,16 @@ private:
 
     void workingProcedure();
 
+    void prefetchProcedure();
+    void startPrefetch();
+    void stopPrefetch();
+    void resetPrefetch();
+    bool takePrefetchedBlocks(PrefetchedBlocks &prefetched);
+    void releasePrefetchedBlocks(const BlockchainInterval &interval,
+                                 std::chrono::steady_clock::duration processingTime);
+    std::error_code queryBlocks(GetBlocksRequest &&request, PrefetchedBlocks &prefetched);
+
+    void updateConsumersHistory();
     GetBlocksRequest getCommonHistory();
     void getPoolUnionAndIntersection(std::unordered_set<Crypto::Hash> &poolUnion,
                                      std::unordered_set<Crypto::Hash> &poolIntersection) const;
@@ -159,7 +208,23 @@ private:
     std::list<std::pair<const ITransactionReader *, std::promise<std::error_code>>> m_addTransactionTasks;
     std::list<std::pair<const Crypto::Hash *, std::promise<void>>> m_removeTransactionTasks;
 
+    std::unique_ptr<std::thread> m_prefetchThread;
+    std::deque<PrefetchedBlocks> m_prefetchedBlocks;
+    // blocks handed out by the prefetcher, but not added to the consumers yet
+    BlockchainInterval m_pendingBlocks;
+    ConsumersHistory m_consumersHistory;
+    uint64_t m_prefetchGeneration;
+    bool m_prefetchActive;
+    bool m_prefetchStopped;
+    size_t m_prefetchDepth;
+    std::chrono::steady_clock::duration m_queryLatency;
+    std::chrono::steady_clock::duration m_processingTime;
+
     mutable std::mutex m_consumersMutex;
+    std::mutex m_consumerUpdatesMutex; // locked before m_consumersMutex
+    std::atomic<std::thread::id> m_consumerUpdatesSuspender;
+    std::mutex m_prefetchMutex; // locked after m_consumersMutex
+    std::condition_variable m_prefetchChanged;
     mutable std::mutex m_stateMutex;
     std::condition_variable m_hasWork;
 };
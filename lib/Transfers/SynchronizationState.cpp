@@ -31,19 +31,30 @@ namespace CryptoNote {
 SynchronizationState::ShortHistory SynchronizationState::getShortHistory(uint32_t localHeight) const
 {
     ShortHistory history;
+    uint32_t sz = std::min(static_cast<uint32_t>(m_blockchain.size()), localHeight + 1);
+    for (uint32_t height : getShortHistoryHeights(sz)) {
+        history.push_back(m_blockchain[height]);
+    }
+
+    return history;
+}
+
+std::vector<uint32_t> SynchronizationState::getShortHistoryHeights(uint32_t size)
+{
+    std::vector<uint32_t> heights;
     uint32_t i = 0;
     uint32_t current_multiplier = 1;
-    uint32_t sz = std::min(static_cast<uint32_t>(m_blockchain.size()), localHeight + 1);
+    uint32_t sz = size;
 
     if (!sz) {
-        return history;
+        return heights;
     }
 
     uint32_t current_back_offset = 1;
     bool genesis_included = false;
 
     while (current_back_offset < sz) {
-        history.push_back(m_blockchain[sz - current_back_offset]);
+        heights.push_back(sz - current_back_offset);
         if (sz - current_back_offset == 0) {
             genesis_included = true;
         }
@@ -56,10 +67,10 @@ SynchronizationState::ShortHistory SynchronizationState::getShortHistory(uint32_
     }
 
     if (!genesis_included) {
-        history.push_back(m_blockchain[0]);
+        heights.push_back(0);
     }
 
-    return history;
+    return heights;
 }
 
 SynchronizationState::CheckResult SynchronizationState::checkInterval(
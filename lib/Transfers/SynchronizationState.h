@@ -46,6 +46,8 @@ public:
     }
 
     ShortHistory getShortHistory(uint32_t localHeight) const;
+    // Heights of the blocks in the short history of a chain of the given size, top down
+    static std::vector<uint32_t> getShortHistoryHeights(uint32_t size);
     CheckResult checkInterval(const BlockchainInterval &interval) const;
 
     void detach(uint32_t height);
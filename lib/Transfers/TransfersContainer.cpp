@@ -120,6 +120,17 @@ TransferIteratorList<TIterator> createTransferIteratorList(const std::pair<TIter
     return TransferIteratorList<TIterator>(it.first, it.second);
 }
 
+// Flags matching the dimensions of TransfersContainer::BalanceTotals
+const std::array<uint32_t, 2> BALANCE_TYPES = {{
+    ITransfersContainer::IncludeTypeKey,
+    ITransfersContainer::IncludeTypeMultisignature
+}};
+const std::array<uint32_t, 3> BALANCE_STATES = {{
+    ITransfersContainer::IncludeStateUnlocked,
+    ITransfersContainer::IncludeStateLocked,
+    ITransfersContainer::IncludeStateSoftLocked
+}};
+
 } // namespace
 
 SpentOutputDescriptor::SpentOutputDescriptor()
@@ -205,7 +216,8 @@ TransfersContainer::TransfersContainer(const Currency &currency,
                                        Logging::ILogger &logger,
                                        size_t transactionSpendableAge,
                                        size_t safeTransactionSpendableAge)
-    : m_currentHeight(0),
+    : m_balances(),
+      m_currentHeight(0),
       m_transactionSpendableAge(transactionSpendableAge),
       m_safeTransactionSpendableAge(safeTransactionSpendableAge),
       m_currency(currency),
@@ -252,6 +264,7 @@ bool TransfersContainer::addTransaction(
 
         if (block.height != WALLET_LEGACY_UNCONFIRMED_TRANSACTION_HEIGHT) {
             m_currentHeight = block.height;
+            updateLockedTransfers();
         }
 
         return added;
@@ -328,8 +341,8 @@ bool TransfersContainer::addTransactionOutputs(
 
         if (transferIsUnconfirmed) {
             auto result = m_unconfirmedTransfers.emplace(std::move(info));
-            (void)result; // Disable unused warning
             assert(result.second);
+            addTransferToBalance(*result.first);
         } else {
             if (info.type == TransactionTypes::OutputType::Key) {
                 bool duplicate = false;
@@ -377,8 +390,8 @@ bool TransfersContainer::addTransactionOutputs(
             }
 
             auto result = m_availableTransfers.emplace(std::move(info));
-            (void)result; // Disable unused warning
             assert(result.second);
+            addTransferToBalance(*result.first);
         }
 
         if (info.type == TransactionTypes::OutputType::Key) {
@@ -471,6 +484,7 @@ bool TransfersContainer::addTransactionInputs(
 
             copyToSpent(block, tx, i, *spendingTransferIt);
             // erase from available outputs
+            subtractFromBalance(*spendingTransferIt);
             outputDescriptorIndex.erase(spendingTransferIt);
             updateTransfersVisibility(input.keyImage);
 
@@ -486,6 +500,7 @@ bool TransfersContainer::addTransactionInputs(
             if (availableOutputIt != outputDescriptorIndex.end()) {
                 copyToSpent(block, tx, i, *availableOutputIt);
                 // erase from available outputs
+                subtractFromBalance(*availableOutputIt);
                 outputDescriptorIndex.erase(availableOutputIt);
 
                 inputsAdded = true;
@@ -574,9 +589,10 @@ bool TransfersContainer::markTransactionConfirmed(const TransactionBlockInfo &bl
         }
 
         auto result = m_availableTransfers.emplace(std::move(transfer));
-        (void)result; // Disable unused warning
         assert(result.second);
+        addTransferToBalance(*result.first);
 
+        subtractFromBalance(*transferIt);
         transferIt = m_unconfirmedTransfers.get<ContainingTransactionIndex>().erase(transferIt);
 
         if (transfer.type == TransactionTypes::OutputType::Key) {
@@ -601,6 +617,14 @@ void TransfersContainer::markTransactionSafe(const Hash &transactionHash)
 {
     std::unique_lock<std::mutex> lock(m_mutex);
     m_safeTxes.insert(transactionHash);
+
+    // Safe transactions unlock earlier, reschedule their outputs
+    auto range = m_availableTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->state == IncludeStateSoftLocked) {
+            updateTransferState(*it);
+        }
+    }
 }
 
 void TransfersContainer::getSafeTransactions(std::vector<Hash> &transactions) const
@@ -623,6 +647,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
             static_cast<const TransactionOutputInformationEx &>(*it)
         );
         assert(result.second);
+        addTransferToBalance(*result.first);
         it = spendingTransactionIndex.erase(it);
 
         if (result.first->type == TransactionTypes::OutputType::Key) {
@@ -633,6 +658,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
     auto unconfirmedTransfersRange =
         m_unconfirmedTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
     for (auto it = unconfirmedTransfersRange.first; it != unconfirmedTransfersRange.second;) {
+        subtractFromBalance(*it);
         if (it->type == TransactionTypes::OutputType::Key) {
             KeyImage keyImage = it->keyImage;
             it = m_unconfirmedTransfers.get<ContainingTransactionIndex>().erase(it);
@@ -645,6 +671,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
     auto &transactionTransfersIndex = m_availableTransfers.get<ContainingTransactionIndex>();
     auto transactionTransfersRange = transactionTransfersIndex.equal_range(transactionHash);
     for (auto it = transactionTransfersRange.first; it != transactionTransfersRange.second;) {
+        subtractFromBalance(*it);
         if (it->type == TransactionTypes::OutputType::Key) {
             KeyImage keyImage = it->keyImage;
             it = transactionTransfersIndex.erase(it);
@@ -674,7 +701,7 @@ void TransfersContainer::copyToSpent(const TransactionBlockInfo &block,
     assert(result.second);
 }
 
-std::vector<Hash> TransfersContainer::detach(uint32_t height)
+std::vector<Hash> TransfersContainer::detach(uint32_t height, bool *transfersLocked)
 {
     // This method expects that WALLET_LEGACY_UNCONFIRMED_TRANSACTION_HEIGHT
     // is a big positive number.
@@ -715,6 +742,11 @@ std::vector<Hash> TransfersContainer::detach(uint32_t height)
 
     // TODO: notification on detach
     m_currentHeight = height == 0 ? 0 : height - 1;
+    // transfers may get locked again, the queues only work forward
+    bool locked = rebuildBalances();
+    if (transfersLocked != nullptr) {
+        *transfersLocked = locked;
+    }
 
     return deletedTransactions;
 }
@@ -750,6 +782,13 @@ void TransfersContainer::updateTransfersVisibility(const KeyImage &keyImage)
     size_t spentCount = std::distance(spentRange.first, spentRange.second);
     assert(spentCount == 0 || spentCount == 1);
 
+    for (auto it = unconfirmedRange.first; it != unconfirmedRange.second; ++it) {
+        subtractFromBalance(*it);
+    }
+    for (auto it = availableRange.first; it != availableRange.second; ++it) {
+        subtractFromBalance(*it);
+    }
+
     if (spentCount > 0) {
         updateVisibility(unconfirmedIndex, unconfirmedRange, false);
         updateVisibility(availableIndex, availableRange, false);
@@ -768,6 +807,13 @@ void TransfersContainer::updateTransfersVisibility(const KeyImage &keyImage)
     } else {
         updateVisibility(unconfirmedIndex, unconfirmedRange, unconfirmedCount == 1);
     }
+
+    for (auto it = unconfirmedRange.first; it != unconfirmedRange.second; ++it) {
+        addToBalance(*it);
+    }
+    for (auto it = availableRange.first; it != availableRange.second; ++it) {
+        addToBalance(*it);
+    }
 }
 
 bool TransfersContainer::advanceHeight(uint32_t height)
@@ -776,6 +822,7 @@ bool TransfersContainer::advanceHeight(uint32_t height)
 
     if (m_currentHeight <= height) {
         m_currentHeight = height;
+        updateLockedTransfers();
         return true;
     }
 
@@ -797,18 +844,17 @@ size_t TransfersContainer::transactionsCount() const
 uint64_t TransfersContainer::balance(uint32_t flags) const
 {
     std::lock_guard<std::mutex> lk(m_mutex);
-    uint64_t amount = 0;
+    updateLockedTransfers();
 
-    for (const auto &t : m_availableTransfers) {
-        if (t.visible && isIncluded(t, flags)) {
-            amount += t.amount;
+    uint64_t amount = 0;
+    for (size_t type = 0; type < BALANCE_TYPES.size(); ++type) {
+        if ((flags & BALANCE_TYPES[type]) == 0) {
+            continue;
         }
-    }
 
-    if ((flags & IncludeStateLocked) != 0) {
-        for (const auto &t : m_unconfirmedTransfers) {
-            if (t.visible && isIncluded(t.type, IncludeStateLocked, flags)) {
-                amount += t.amount;
+        for (size_t state = 0; state < BALANCE_STATES.size(); ++state) {
+            if ((flags & BALANCE_STATES[state]) != 0) {
+                amount += m_balances[type][state];
             }
         }
     }
@@ -821,8 +867,10 @@ void TransfersContainer::getOutputs(
     uint32_t flags) const
 {
     std::lock_guard<std::mutex> lk(m_mutex);
+    updateLockedTransfers();
+
     for (const auto &t : m_availableTransfers) {
-        if (t.visible && isIncluded(t, flags)) {
+        if (t.visible && isIncluded(t.type, t.state, flags)) {
             transfers.push_back(t);
         }
     }
@@ -891,6 +939,7 @@ std::vector<TransactionOutputInformation> TransfersContainer::getTransactionOutp
     uint32_t flags) const
 {
     std::lock_guard<std::mutex> lk(m_mutex);
+    updateLockedTransfers();
 
     std::vector<TransactionOutputInformation> result;
 
@@ -898,7 +947,7 @@ std::vector<TransactionOutputInformation> TransfersContainer::getTransactionOutp
         m_availableTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
     for (auto i = availableRange.first; i != availableRange.second; ++i) {
         const auto &t = *i;
-        if (isIncluded(t, flags)) {
+        if (isIncluded(t.type, t.state, flags)) {
             result.push_back(t);
         }
     }
@@ -1065,6 +1114,7 @@ void TransfersContainer::load(std::istream &in)
     m_unconfirmedTransfers = std::move(unconfirmedTransfers);
     m_availableTransfers = std::move(availableTransfers);
     m_spentTransfers = std::move(spentTransfers);
+    rebuildBalances();
 
     // Repair the container if it was broken while handling addTransaction()
     // in previous version of the code.
@@ -1100,6 +1150,7 @@ void TransfersContainer::repair()
                 static_cast<const TransactionOutputInformationEx &>(*it)
             );
             assert(result.second);
+            addTransferToBalance(*result.first);
             it = m_spentTransfers.erase(it);
 
             if (result.first->type == TransactionTypes::OutputType::Key) {
@@ -1122,6 +1173,7 @@ void TransfersContainer::repair()
             ", output " << std::setw(2) << it->outputInTransaction <<
             ", amount " << m_currency.formatAmount(it->amount);
 
+            subtractFromBalance(*it);
             if (it->type == TransactionTypes::OutputType::Key) {
             KeyImage keyImage = it->keyImage;
             it = m_unconfirmedTransfers.erase(it);
@@ -1148,6 +1200,7 @@ void TransfersContainer::repair()
                 ", output " << std::setw(2) << it->outputInTransaction <<
                 ", amount " << m_currency.formatAmount(it->amount);
 
+            subtractFromBalance(*it);
             if (it->type == TransactionTypes::OutputType::Key) {
                 KeyImage keyImage = it->keyImage;
                 it = m_availableTransfers.erase(it);
@@ -1175,6 +1228,156 @@ void TransfersContainer::repair()
     }
 }
 
+// pre: m_mutex is locked.
+uint64_t *TransfersContainer::balanceTotal(const TransactionOutputInformationEx &transfer) const
+{
+    size_t type;
+    if (transfer.type == TransactionTypes::OutputType::Key) {
+        type = 0;
+    } else if (transfer.type == TransactionTypes::OutputType::Multisignature) {
+        type = 1;
+    } else {
+        return nullptr;
+    }
+
+    auto state = std::find(BALANCE_STATES.begin(), BALANCE_STATES.end(), transfer.state);
+    assert(state != BALANCE_STATES.end());
+
+    return &m_balances[type][state - BALANCE_STATES.begin()];
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::addToBalance(const TransactionOutputInformationEx &transfer) const
+{
+    uint64_t *total = balanceTotal(transfer);
+    if (transfer.visible && total != nullptr) {
+        *total += transfer.amount;
+    }
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::subtractFromBalance(const TransactionOutputInformationEx &transfer) const
+{
+    uint64_t *total = balanceTotal(transfer);
+    if (transfer.visible && total != nullptr) {
+        assert(*total >= transfer.amount);
+        *total -= transfer.amount;
+    }
+}
+
+// pre: m_mutex is locked, transfer has just been inserted to the available
+// or unconfirmed transfers.
+void TransfersContainer::addTransferToBalance(const TransactionOutputInformationEx &transfer)
+{
+    transfer.state = transferState(transfer);
+    addToBalance(transfer);
+    scheduleStateUpdate(transfer);
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::updateTransferState(const TransactionOutputInformationEx &transfer) const
+{
+    subtractFromBalance(transfer);
+    transfer.state = transferState(transfer);
+    addToBalance(transfer);
+    scheduleStateUpdate(transfer);
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::scheduleStateUpdate(const TransactionOutputInformationEx &transfer) const
+{
+    LockedTransfer lockedTransfer{ transfer.transactionHash, transfer.outputInTransaction };
+
+    if (transfer.state == IncludeStateLocked) {
+        if (transfer.blockHeight == WALLET_LEGACY_UNCONFIRMED_TRANSACTION_HEIGHT) {
+            // changes state only when confirmed
+            return;
+        }
+
+        // see isSpendTimeUnlocked()
+        if (transfer.unlockTime < m_currency.maxBlockHeight()) {
+            auto height = transfer.unlockTime - m_currency.lockedTxAllowedDeltaBlocks();
+            m_lockedTransfersByHeight.emplace(static_cast<uint32_t>(height), lockedTransfer);
+        } else {
+            auto time = transfer.unlockTime - m_currency.lockedTxAllowedDeltaSeconds();
+            m_lockedTransfersByTime.emplace(time, lockedTransfer);
+        }
+    } else if (transfer.state == IncludeStateSoftLocked) {
+        // see transferState()
+        auto height = transfer.blockHeight + static_cast<uint32_t>(m_transactionSpendableAge);
+        if (m_safeTxes.count(transfer.transactionHash) != 0) {
+            auto safeHeight =
+                transfer.blockHeight - 1 + static_cast<uint32_t>(m_safeTransactionSpendableAge);
+            height = std::min(height, safeHeight);
+        }
+
+        m_lockedTransfersByHeight.emplace(height, lockedTransfer);
+    }
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::updateLockedTransfers() const
+{
+    while (!m_lockedTransfersByHeight.empty()
+           && m_lockedTransfersByHeight.begin()->first <= m_currentHeight) {
+        auto lockedTransfer = m_lockedTransfersByHeight.begin()->second;
+        m_lockedTransfersByHeight.erase(m_lockedTransfersByHeight.begin());
+        updateLockedTransfer(lockedTransfer);
+    }
+
+    if (m_lockedTransfersByTime.empty()) {
+        return;
+    }
+
+    uint64_t currentTime = static_cast<uint64_t>(time(nullptr));
+    while (!m_lockedTransfersByTime.empty()
+           && m_lockedTransfersByTime.begin()->first <= currentTime) {
+        auto lockedTransfer = m_lockedTransfersByTime.begin()->second;
+        m_lockedTransfersByTime.erase(m_lockedTransfersByTime.begin());
+        updateLockedTransfer(lockedTransfer);
+    }
+}
+
+// pre: m_mutex is locked.
+void TransfersContainer::updateLockedTransfer(const LockedTransfer &lockedTransfer) const
+{
+    // The queues aren't cleaned up when transfers are spent or deleted,
+    // so the transfer may be gone or rescheduled already
+    auto range =
+        m_availableTransfers.get<ContainingTransactionIndex>().equal_range(
+            lockedTransfer.transactionHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->outputInTransaction == lockedTransfer.outputInTransaction) {
+            if (transferState(*it) != it->state) {
+                updateTransferState(*it);
+            }
+            break;
+        }
+    }
+}
+
+// pre: m_mutex is locked.
+// Returns true if an unlocked transfer is locked again.
+bool TransfersContainer::rebuildBalances()
+{
+    m_balances = BalanceTotals();
+    m_lockedTransfersByHeight.clear();
+    m_lockedTransfersByTime.clear();
+
+    for (const auto &transfer : m_unconfirmedTransfers) {
+        addTransferToBalance(transfer);
+    }
+
+    bool locked = false;
+    for (const auto &transfer : m_availableTransfers) {
+        bool unlocked = transfer.state == IncludeStateUnlocked;
+        addTransferToBalance(transfer);
+        locked |= unlocked && transfer.state != IncludeStateUnlocked;
+    }
+
+    return locked;
+}
+
 bool TransfersContainer::isSpendTimeUnlocked(uint64_t unlockTime) const
 {
     if (unlockTime < m_currency.maxBlockHeight()) {
@@ -1189,7 +1392,7 @@ bool TransfersContainer::isSpendTimeUnlocked(uint64_t unlockTime) const
     return false;
 }
 
-bool TransfersContainer::isIncluded(const TransactionOutputInformationEx &info,uint32_t flags) const
+uint32_t TransfersContainer::transferState(const TransactionOutputInformationEx &info) const
 {
     uint32_t state;
     if (info.blockHeight == WALLET_LEGACY_UNCONFIRMED_TRANSACTION_HEIGHT
@@ -1212,7 +1415,7 @@ bool TransfersContainer::isIncluded(const TransactionOutputInformationEx &info,u
         }
     }
 
-    return isIncluded(info.type, state, flags);
+    return state;
 }
 
 bool TransfersContainer::isIncluded(TransactionTypes::OutputType type,uint32_t state,uint32_t flags)
@@ -19,7 +19,9 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <map>
 #include <mutex>
 #include <unordered_map>
 #include <boost/multi_index_container.hpp>
@@ -113,7 +115,9 @@ struct TransactionOutputInformationEx : public TransactionOutputInformationIn
     uint32_t blockHeight;
     uint32_t transactionIndex;
     bool visible;
-
+    // ITransfersContainer state flag the transfer is counted under in the container balance,
+    // maintained by TransfersContainer and not serialized
+    mutable uint32_t state = 0;
 };
 
 struct TransactionBlockInfo
@@ -166,7 +170,7 @@ public:
                                   const Crypto::Hash &transactionHash,
                                   const std::vector<uint32_t> &globalIndices);
 
-    std::vector<Crypto::Hash> detach(uint32_t height);
+    std::vector<Crypto::Hash> detach(uint32_t height, bool *transfersLocked = nullptr);
     bool advanceHeight(uint32_t height);
 
     // ITransfersContainer
@@ -291,6 +295,16 @@ private:
         >
     > SpentTransfersMultiIndex;
 
+    // A transfer waiting for the height (or time) at which its state may change
+    struct LockedTransfer
+    {
+        Crypto::Hash transactionHash;
+        uint32_t outputInTransaction;
+    };
+
+    // Visible amounts by output type (key, multisignature) and state (unlocked, locked, soft locked)
+    typedef std::array<std::array<uint64_t, 3>, 2> BalanceTotals;
+
 private:
     void addTransaction(const TransactionBlockInfo &block, const ITransactionReader &tx);
     bool addTransactionOutputs(const TransactionBlockInfo &block,
@@ -299,10 +313,20 @@ private:
     bool addTransactionInputs(const TransactionBlockInfo &block, const ITransactionReader &tx);
     void deleteTransactionTransfers(const Crypto::Hash &transactionHash);
     bool isSpendTimeUnlocked(uint64_t unlockTime) const;
-    bool isIncluded(const TransactionOutputInformationEx &info, uint32_t flags) const;
+    uint32_t transferState(const TransactionOutputInformationEx &info) const;
     static bool isIncluded(TransactionTypes::OutputType type, uint32_t state, uint32_t flags);
     void updateTransfersVisibility(const Crypto::KeyImage &keyImage);
 
+    uint64_t *balanceTotal(const TransactionOutputInformationEx &transfer) const;
+    void addToBalance(const TransactionOutputInformationEx &transfer) const;
+    void subtractFromBalance(const TransactionOutputInformationEx &transfer) const;
+    void addTransferToBalance(const TransactionOutputInformationEx &transfer);
+    void updateTransferState(const TransactionOutputInformationEx &transfer) const;
+    void scheduleStateUpdate(const TransactionOutputInformationEx &transfer) const;
+    void updateLockedTransfers() const;
+    void updateLockedTransfer(const LockedTransfer &lockedTransfer) const;
+    bool rebuildBalances();
+
     void copyToSpent(const TransactionBlockInfo &block,
                      const ITransactionReader &tx,
                      size_t inputIndex,
@@ -317,6 +341,14 @@ private:
 
     mutable std::set<Crypto::Hash, Crypto::HashCompare> m_safeTxes;
 
+    // Running balance totals, kept in step with the transfer containers and the current height.
+    // Transfers that are not unlocked yet are queued by the height (or time for time locked
+    // transfers) of their next possible state change, so advancing the height only touches
+    // the transfers that actually change state.
+    mutable BalanceTotals m_balances;
+    mutable std::multimap<uint32_t, LockedTransfer> m_lockedTransfersByHeight;
+    mutable std::multimap<uint64_t, LockedTransfer> m_lockedTransfersByTime;
+
     uint32_t m_currentHeight; // current height is needed to check if a transfer is unlocked
     size_t m_transactionSpendableAge;
     size_t m_safeTransactionSpendableAge;
@@ -40,18 +40,27 @@ SynchronizationStart TransfersSubscription::getSyncStart()
 
 void TransfersSubscription::onBlockchainDetach(uint32_t height)
 {
-    std::vector<Hash> deletedTransactions = transfers.detach(height);
+    bool transfersLocked = false;
+    std::vector<Hash> deletedTransactions = transfers.detach(height, &transfersLocked);
     for (auto &hash : deletedTransactions) {
         m_observerManager.notify(&ITransfersObserver::onTransactionDeleted, this, hash);
     }
+
+    if (transfersLocked) {
+        m_observerManager.notify(&ITransfersObserver::onTransfersLocked, this);
+    }
 }
 
 void TransfersSubscription::onError(const std::error_code &ec, uint32_t height)
 {
+    bool transfersLocked = false;
     if (height != WALLET_LEGACY_UNCONFIRMED_TRANSACTION_HEIGHT) {
-        transfers.detach(height);
+        transfers.detach(height, &transfersLocked);
     }
     m_observerManager.notify(&ITransfersObserver::onError, this, height, ec);
+    if (transfersLocked) {
+        m_observerManager.notify(&ITransfersObserver::onTransfersLocked, this);
+    }
 }
 
 bool TransfersSubscription::advanceHeight(uint32_t height)
@@ -143,6 +143,14 @@ uint64_t calculateDonationAmount(uint64_t freeAmount,
     return donationAmount;
 }
 
+// The journal is compacted into the container once it outgrows the cache stored there
+const uint64_t MIN_JOURNAL_COMPACTION_SIZE = 4 * 1024 * 1024;
+
+std::string getJournalPath(const std::string &containerPath)
+{
+    return containerPath + ".journal";
+}
+
 } // namespace
 
 namespace CryptoNote {
@@ -157,6 +165,8 @@ WalletGreen::WalletGreen(System::Dispatcher &dispatcher,
       m_node(node),
       m_logger(logger, "WalletGreen/empty"),
       m_stopped(false),
+      m_journalSynchronizerStateChanged(true),
+      m_journalCompactionRequired(false),
       m_blockchainSynchronizerStarted(false),
       m_blockchainSynchronizer(node, logger, currency.genesisBlockHash()),
       m_synchronizer(currency, logger, m_blockchainSynchronizer, node),
@@ -250,6 +260,8 @@ void WalletGreen::doShutdown()
     m_blockchainSynchronizer.removeObserver(this);
 
     m_containerStorage.close();
+    m_journal.close();
+    m_journalChunks.clear();
     m_walletsContainer.clear();
     clearCaches(true, true);
 
@@ -264,8 +276,12 @@ void WalletGreen::clearCaches(bool clearTransactions, bool clearCachedData)
     if (clearTransactions) {
         m_transactions.clear();
         m_transfers.clear();
+        m_journalTransactions.clear();
     }
 
+    // the journal can only extend the cache it was started for
+    m_journalCompactionRequired = true;
+
     if (clearCachedData) {
         size_t walletIndex = 0;
         for (auto it = m_walletsContainer.begin(); it != m_walletsContainer.end(); ++it) {
@@ -296,6 +312,11 @@ void WalletGreen::clearCaches(bool clearTransactions, bool clearCachedData)
 
         m_uncommitedTransactions.clear();
         m_unlockTransactionsJob.clear();
+        m_spendableOutputs.clear();
+        m_staleSpendableContainers.clear();
+        m_spendableUnlocksByHeight.clear();
+        m_spendableUnlocksByTime.clear();
+        m_unlockedSpendableContainers.clear();
         m_actualBalance = 0;
         m_pendingBalance = 0;
         m_fusionTxsCache.clear();
@@ -508,17 +529,22 @@ void WalletGreen::save(WalletSaveLevel saveLevel, const std::string &extra)
     throwIfNotInitialized();
     throwIfStopped();
 
-    stopBlockchainSynchronizer();
-
     try {
-        saveWalletCache(m_containerStorage, m_key, saveLevel, extra);
+        bool compactionRequired = !m_journal.isOpened()
+                                  || m_journalCompactionRequired
+                                  || m_journal.size() > std::max(
+                                      MIN_JOURNAL_COMPACTION_SIZE,
+                                      m_containerStorage.suffixSize());
+        if (saveLevel == WalletSaveLevel::SAVE_ALL && !compactionRequired) {
+            appendToJournal(extra);
+        } else {
+            compactContainer(saveLevel, extra);
+        }
     } catch (const std::exception &e) {
         m_logger(ERROR, BRIGHT_RED) << "Failed to save container: " << e.what();
-        startBlockchainSynchronizer();
         throw;
     }
 
-    startBlockchainSynchronizer();
     m_logger(INFO, BRIGHT_WHITE) << "Container saved";
 }
 
@@ -532,8 +558,6 @@ void WalletGreen::exportWallet(const std::string &path,
     throwIfNotInitialized();
     throwIfStopped();
 
-    stopBlockchainSynchronizer();
-
     try {
         bool storageCreated = false;
         Tools::ScopeExit failExitHandler([path, &storageCreated] {
@@ -559,20 +583,23 @@ void WalletGreen::exportWallet(const std::string &path,
             generate_chacha8_key(cnContext, "", newStorageKey);
         }
 
+        std::string transfersSynchronizerState;
+        if (saveLevel == WalletSaveLevel::SAVE_ALL) {
+            transfersSynchronizerState = getTransfersSynchronizerState();
+        }
+
         copyContainerStoragePrefix(m_containerStorage, m_key, newStorage, newStorageKey);
         copyContainerStorageKeys(m_containerStorage, m_key, newStorage, newStorageKey);
-        saveWalletCache(newStorage, newStorageKey, saveLevel, extra);
+        saveWalletCache(newStorage, newStorageKey, saveLevel, extra, transfersSynchronizerState);
 
         failExitHandler.cancel();
 
         m_logger(DEBUGGING) << "Container export finished";
     } catch (const std::exception &e) {
         m_logger(ERROR, BRIGHT_RED) << "Failed to export container: " << e.what();
-        startBlockchainSynchronizer();
         throw;
     }
 
-    startBlockchainSynchronizer();
     m_logger(INFO, BRIGHT_WHITE) << "Container exported";
 }
 
@@ -595,6 +622,7 @@ void WalletGreen::load(const std::string &path,
 
     Crypto::cn_context cnContext;
     generate_chacha8_key(cnContext, password, m_key);
+    m_path = path;
 
     std::ifstream walletFileStream(path, std::ios_base::binary);
     int version = walletFileStream.peek();
@@ -644,7 +672,7 @@ void WalletGreen::load(const std::string &path,
                 }
 
                 if (!addedSpendKeys.empty() || !deletedSpendKeys.empty()) {
-                    saveWalletCache(m_containerStorage, m_key, WalletSaveLevel::SAVE_ALL, extra);
+                    compactContainer(WalletSaveLevel::SAVE_ALL, extra);
                 }
             } catch (const std::exception &e) {
                 m_logger(ERROR, BRIGHT_RED)
@@ -697,7 +725,6 @@ void WalletGreen::load(const std::string &path,
     }
 
     m_password = password;
-    m_path = path;
     m_extra = extra;
 
     m_state = WalletState::INITIALIZED;
@@ -782,12 +809,15 @@ void WalletGreen::loadWalletCache(std::unordered_set<Crypto::PublicKey> &addedKe
     deletedKeys = std::move(s.deletedKeys());
 
     m_logger(DEBUGGING) << "Container cache loaded";
+
+    loadJournal(s.transfersSynchronizerState(), extra);
 }
 
 void WalletGreen::saveWalletCache(ContainerStorage &storage,
                                   const Crypto::chacha8_key &key,
                                   WalletSaveLevel saveLevel,
-                                  const std::string &extra)
+                                  const std::string &extra,
+                                  const std::string &transfersSynchronizerState)
 {
     m_logger(DEBUGGING) << "Saving cache...";
 
@@ -831,6 +861,10 @@ void WalletGreen::saveWalletCache(ContainerStorage &storage,
         m_transactionSoftLockTime
     );
 
+    if (!transfersSynchronizerState.empty()) {
+        s.setTransfersSynchronizerState(transfersSynchronizerState);
+    }
+
     s.save(containerStream, saveLevel);
 
     encryptAndSaveContainerData(storage, key, containerData.data(), containerData.size());
@@ -841,6 +875,176 @@ void WalletGreen::saveWalletCache(ContainerStorage &storage,
     m_logger(DEBUGGING) << "Container saving finished";
 }
 
+std::string WalletGreen::getTransfersSynchronizerState()
+{
+    // consumer states and containers must not change while being saved
+    BlockchainSynchronizer::ConsumerUpdatesSuspension suspension(m_blockchainSynchronizer);
+
+    std::stringstream stream;
+    m_synchronizer.save(stream);
+
+    return stream.str();
+}
+
+void WalletGreen::compactContainer(WalletSaveLevel saveLevel, const std::string &extra)
+{
+    std::string transfersSynchronizerState;
+    if (saveLevel == WalletSaveLevel::SAVE_ALL) {
+        transfersSynchronizerState = getTransfersSynchronizerState();
+    }
+
+    m_journal.close();
+    m_journalChunks.clear();
+
+    saveWalletCache(m_containerStorage, m_key, saveLevel, extra, transfersSynchronizerState);
+
+    clearJournalChanges();
+    m_journalCompactionRequired = false;
+
+    // only a cache saved with SAVE_ALL can be extended by the journal
+    if (saveLevel == WalletSaveLevel::SAVE_ALL) {
+        m_journal.create(getJournalPath(m_path), getContainerDataIv(m_containerStorage));
+        m_journalChunks.add(transfersSynchronizerState);
+    } else {
+        WalletJournal::remove(getJournalPath(m_path));
+    }
+
+    m_logger(DEBUGGING) << "Container compacted";
+}
+
+void WalletGreen::appendToJournal(const std::string &extra)
+{
+    // the synchronizer state is only serialized when the synchronizer reported a change
+    std::string encodedSynchronizerState;
+    std::vector<Crypto::Hash> newChunks;
+    if (m_journalSynchronizerStateChanged) {
+        encodedSynchronizerState = m_journalChunks.encode(
+            getTransfersSynchronizerState(),
+            newChunks
+        );
+    }
+
+    std::vector<size_t> transactionIds(m_journalTransactions.begin(), m_journalTransactions.end());
+    std::vector<Crypto::PublicKey> walletKeys(m_journalWallets.begin(), m_journalWallets.end());
+    std::vector<Crypto::Hash> unlockJobTransactions(
+        m_journalUnlockJobs.begin(),
+        m_journalUnlockJobs.end()
+    );
+    std::vector<size_t> uncommitedTransactionIds(
+        m_journalUncommitedTransactions.begin(),
+        m_journalUncommitedTransactions.end()
+    );
+
+    std::string entry;
+    Common::StringOutputStream entryStream(entry);
+
+    WalletSerializerV2 s(
+        *this,
+        m_viewPublicKey,
+        m_viewSecretKey,
+        m_actualBalance,
+        m_pendingBalance,
+        m_walletsContainer,
+        m_synchronizer,
+        m_unlockTransactionsJob,
+        m_transactions,
+        m_transfers,
+        m_uncommitedTransactions,
+        const_cast<std::string &>(extra),
+        m_transactionSoftLockTime
+    );
+
+    s.saveJournalEntry(
+        entryStream,
+        transactionIds,
+        walletKeys,
+        unlockJobTransactions,
+        uncommitedTransactionIds,
+        extra != m_extra,
+        encodedSynchronizerState
+    );
+    m_journal.append(m_key, entry);
+    // later entries may refer to the chunks of this one only once it is written
+    m_journalChunks.commit(newChunks);
+
+    clearJournalChanges();
+    m_extra = extra;
+
+    m_logger(DEBUGGING)
+        << "Container journal entry saved, transactions " << transactionIds.size()
+        << ", wallets " << walletKeys.size()
+        << ", unlock jobs " << unlockJobTransactions.size()
+        << ", size " << entry.size()
+        << ", journal size " << m_journal.size();
+}
+
+void WalletGreen::clearJournalChanges()
+{
+    m_journalTransactions.clear();
+    m_journalWallets.clear();
+    m_journalUnlockJobs.clear();
+    m_journalUncommitedTransactions.clear();
+    m_journalSynchronizerStateChanged = false;
+}
+
+void WalletGreen::loadJournal(const std::string &baseTransfersSynchronizerState,
+                              std::string &extra)
+{
+    std::vector<BinaryArray> entries;
+    bool opened = m_journal.open(
+        getJournalPath(m_path),
+        getContainerDataIv(m_containerStorage),
+        m_key,
+        entries
+    );
+    if (!opened) {
+        m_logger(DEBUGGING) << "Container journal not found";
+        return;
+    }
+
+    WalletSerializerV2 s(
+        *this,
+        m_viewPublicKey,
+        m_viewSecretKey,
+        m_actualBalance,
+        m_pendingBalance,
+        m_walletsContainer,
+        m_synchronizer,
+        m_unlockTransactionsJob,
+        m_transactions,
+        m_transfers,
+        m_uncommitedTransactions,
+        extra,
+        m_transactionSoftLockTime
+    );
+
+    m_journalChunks.clear();
+    m_journalChunks.addDecoded(baseTransfersSynchronizerState);
+
+    std::string transfersSynchronizerState;
+    for (const auto &entry : entries) {
+        Common::MemoryInputStream entryStream(entry.data(), entry.size());
+
+        std::string encodedSynchronizerState;
+        s.loadJournalEntry(entryStream, encodedSynchronizerState);
+        if (!encodedSynchronizerState.empty()) {
+            transfersSynchronizerState = m_journalChunks.decode(encodedSynchronizerState);
+        }
+    }
+
+    m_journalChunks.releaseDecodedChunks();
+
+    if (!transfersSynchronizerState.empty()) {
+        std::stringstream stream(transfersSynchronizerState);
+        m_synchronizer.load(stream);
+    }
+
+    clearJournalChanges();
+    m_journalCompactionRequired = false;
+
+    m_logger(DEBUGGING) << "Container journal loaded, entries " << entries.size();
+}
+
 void WalletGreen::copyContainerStorageKeys(ContainerStorage &src,
                                            const chacha8_key &srcKey,
                                            ContainerStorage &dst,
@@ -947,6 +1151,16 @@ void WalletGreen::loadAndDecryptContainerData(ContainerStorage &storage,
     );
 }
 
+Crypto::chacha8_iv WalletGreen::getContainerDataIv(ContainerStorage &storage)
+{
+    Common::MemoryInputStream suffixStream(storage.suffix(), storage.suffixSize());
+    BinaryInputStreamSerializer suffixSerializer(suffixStream);
+    Crypto::chacha8_iv suffixIv;
+    suffixSerializer(suffixIv, "suffixIv");
+
+    return suffixIv;
+}
+
 void WalletGreen::initTransactionPool()
 {
     std::unordered_set<Crypto::Hash> uncommitedTransactionsSet;
@@ -1040,6 +1254,7 @@ void WalletGreen::subscribeWallets()
             sub.keys.viewSecretKey = m_viewSecretKey;
             sub.keys.spendSecretKey = wallet.spendSecretKey;
             sub.transactionSpendableAge = m_transactionSoftLockTime;
+            sub.safeTransactionSpendableAge = m_currency.safeTransactionSpendableAge();
             sub.syncStart.height = 0;
             sub.syncStart.timestamp = std::max(
                 static_cast<uint64_t>(wallet.creationTimestamp),
@@ -1052,6 +1267,7 @@ void WalletGreen::subscribeWallets()
             });
             assert(r);
 
+            m_staleSpendableContainers.insert(it->container);
             subscription.addObserver(this);
         }
     } catch (const std::exception &e) {
@@ -1132,7 +1348,7 @@ void WalletGreen::convertAndLoadWalletFile(const std::string &path,std::ifstream
         incNextIv();
     }
 
-    saveWalletCache(m_containerStorage, m_key, WalletSaveLevel::SAVE_ALL, "");
+    saveWalletCache(m_containerStorage, m_key, WalletSaveLevel::SAVE_ALL, "", "");
 
     boost::filesystem::rename(path, bakPath);
     std::error_code ec;
@@ -1187,6 +1403,15 @@ void WalletGreen::changePassword(const std::string &oldPassword, const std::stri
     m_key = newKey;
     m_password = newPassword;
 
+    // the cache is encrypted anew, so the journal no longer extends it
+    if (m_journal.isOpened()) {
+        if (m_journal.empty()) {
+            m_journal.create(getJournalPath(m_path), getContainerDataIv(m_containerStorage));
+        } else {
+            compactContainer(WalletSaveLevel::SAVE_ALL, m_extra);
+        }
+    }
+
     m_logger(INFO, BRIGHT_WHITE) << "Container password changed";
 }
 
@@ -1444,6 +1669,7 @@ std::string WalletGreen::addWallet(const Crypto::PublicKey &spendPublicKey,
 
     m_containerStorage.push_back(encryptKeyPair(spendPublicKey, spendSecretKey, creationTimestamp));
     incNextIv();
+    m_journalCompactionRequired = true;
 
     try {
         AccountSubscription sub;
@@ -1452,6 +1678,7 @@ std::string WalletGreen::addWallet(const Crypto::PublicKey &spendPublicKey,
         sub.keys.viewSecretKey = m_viewSecretKey;
         sub.keys.spendSecretKey = spendSecretKey;
         sub.transactionSpendableAge = m_transactionSoftLockTime;
+        sub.safeTransactionSpendableAge = m_currency.safeTransactionSpendableAge();
         sub.syncStart.height = 0;
         sub.syncStart.timestamp = std::max(
             creationTimestamp,
@@ -1469,6 +1696,7 @@ std::string WalletGreen::addWallet(const Crypto::PublicKey &spendPublicKey,
         trSubscription.addObserver(this);
 
         index.insert(insertIt, std::move(wallet));
+        m_staleSpendableContainers.insert(container);
         m_logger(DEBUGGING) << "Wallet count " << m_walletsContainer.size();
 
         if (index.size() == 1) {
@@ -1534,10 +1762,15 @@ void WalletGreen::deleteAddress(const std::string &address)
 #endif
 
     m_containerStorage.erase(std::next(m_containerStorage.begin(), addressIndex));
+    m_journalCompactionRequired = true;
 
     m_synchronizer.removeSubscription(pubAddr);
 
     deleteContainerFromUnlockTransactionJobs(it->container);
+    m_spendableOutputs.get<TransfersContainerIndex>().erase(it->container);
+    m_staleSpendableContainers.erase(it->container);
+    deleteSpendableUnlockJobs(it->container);
+    m_unlockedSpendableContainers.erase(it->container);
     std::vector<size_t> deletedTransactions;
     std::vector<size_t> updatedTransactions=deleteTransfersForAddress(address,deletedTransactions);
     deleteFromUncommitedTransactions(deletedTransactions);
@@ -1641,21 +1874,12 @@ WalletTransfer WalletGreen::getTransactionTransfer(size_t transactionIndex,
         throw std::system_error(make_error_code(std::errc::invalid_argument));
     }
 
-    return std::next(bounds.first, transferIndex)->second;
+    return *std::next(bounds.first, transferIndex);
 }
 
 WalletGreen::TransfersRange WalletGreen::getTransactionTransfersRange(size_t transactionIndex) const
 {
-    auto val = std::make_pair(transactionIndex, WalletTransfer());
-
-    auto bounds = std::equal_range(
-        m_transfers.begin(),
-        m_transfers.end(), val,
-        [](const TransactionTransferPair &a, const TransactionTransferPair &b) {
-        return a.first < b.first;
-    });
-
-    return bounds;
+    return m_transfers.getTransfers(transactionIndex);
 }
 
 size_t WalletGreen::transfer(const TransactionParameters &transactionParameters,
@@ -1697,7 +1921,7 @@ size_t WalletGreen::transfer(const TransactionParameters &transactionParameters,
     return id;
 }
 
-void WalletGreen::prepareTransaction(std::vector<WalletOuts> &&wallets,
+void WalletGreen::prepareTransaction(const std::vector<std::string> &sourceAddresses,
                                      const std::vector<WalletOrder> &orders,
                                      uint64_t fee,
                                      uint64_t mixIn,
@@ -1711,12 +1935,12 @@ void WalletGreen::prepareTransaction(std::vector<WalletOuts> &&wallets,
     preparedTransaction.destinations = convertOrdersToTransfers(orders);
     preparedTransaction.neededMoney = countNeededMoney(preparedTransaction.destinations, fee);
 
-    std::vector<OutputToTransfer> selectedTransfers;
+    std::vector<OutputToTransfer> &selectedTransfers = preparedTransaction.selectedTransfers;
     uint64_t foundMoney = selectTransfers(
         preparedTransaction.neededMoney,
         mixIn == 0,
         0,
-        std::move(wallets),
+        sourceAddresses,
         selectedTransfers
     );
 
@@ -2042,15 +2266,8 @@ size_t WalletGreen::doTransfer(const TransactionParameters &transactionParameter
     );
     m_logger(DEBUGGING)<< "Change address " << m_currency.accountAddressAsString(changeDestination);
 
-    std::vector<WalletOuts> wallets;
-    if (!transactionParameters.sourceAddresses.empty()) {
-        wallets = pickWallets(transactionParameters.sourceAddresses);
-    } else {
-        wallets = pickWalletsWithMoney();
-    }
-
     PreparedTransaction preparedTransaction;
-    prepareTransaction(std::move(wallets),
+    prepareTransaction(transactionParameters.sourceAddresses,
     transactionParameters.destinations,
     transactionParameters.fee,
     transactionParameters.mixIn,
@@ -2061,12 +2278,15 @@ size_t WalletGreen::doTransfer(const TransactionParameters &transactionParameter
     preparedTransaction,
     txSecretKey);
 
-    return validateSaveAndSendTransaction(
+    size_t transactionId = validateSaveAndSendTransaction(
         *preparedTransaction.transaction,
         preparedTransaction.destinations,
         false,
         true
     );
+    removeSpendableOutputs(preparedTransaction.selectedTransfers);
+
+    return transactionId;
 }
 
 size_t WalletGreen::makeTransaction(const TransactionParameters &sendingTransaction)
@@ -2109,17 +2329,10 @@ size_t WalletGreen::makeTransaction(const TransactionParameters &sendingTransact
     );
     m_logger(DEBUGGING) << "Change address " << m_currency.accountAddressAsString(changeDestination);
 
-    std::vector<WalletOuts> wallets;
-    if (!sendingTransaction.sourceAddresses.empty()) {
-        wallets = pickWallets(sendingTransaction.sourceAddresses);
-    } else {
-        wallets = pickWalletsWithMoney();
-    }
-
     PreparedTransaction preparedTransaction;
     Crypto::SecretKey txSecretKey;
     prepareTransaction(
-    std::move(wallets),
+    sendingTransaction.sourceAddresses,
     sendingTransaction.destinations,
     sendingTransaction.fee,
     sendingTransaction.mixIn,
@@ -2136,6 +2349,7 @@ size_t WalletGreen::makeTransaction(const TransactionParameters &sendingTransact
         false,
         false
     );
+    removeSpendableOutputs(preparedTransaction.selectedTransfers);
 
     return id;
 }
@@ -2180,6 +2394,7 @@ void WalletGreen::commitTransaction(size_t transactionId)
     if (!ec) {
         updateTransactionStateAndPushEvent(transactionId, WalletTransactionState::SUCCEEDED);
         m_uncommitedTransactions.erase(transactionId);
+        m_journalUncommitedTransactions.insert(transactionId);
     } else {
         m_logger(ERROR, BRIGHT_RED)
             << "Failed to relay transaction: " << ec
@@ -2226,6 +2441,7 @@ void WalletGreen::rollbackUncommitedTransaction(size_t transactionId)
 
     removeUnconfirmedTransaction(getObjectHash(m_uncommitedTransactions[transactionId]));
     m_uncommitedTransactions.erase(transactionId);
+    m_journalUncommitedTransactions.insert(transactionId);
 
     m_logger(INFO, BRIGHT_WHITE)
         << "Delayed transaction rolled back, ID " << transactionId
@@ -2241,7 +2457,7 @@ void WalletGreen::pushBackOutgoingTransfers(size_t txId,
         d.address = dest.address;
         d.amount = dest.amount;
 
-        m_transfers.emplace_back(txId, std::move(d));
+        m_transfers.push_back(txId, std::move(d));
     }
 }
 
@@ -2401,11 +2617,7 @@ bool WalletGreen::updateTransactionTransfers(
 
     bool updated = false;
 
-    auto transfersRange = getTransactionTransfersRange(transactionId);
-    // Iterators can be invalidated, so the first transfer is addressed by its index
-    size_t firstTransferIdx = std::distance(m_transfers.cbegin(), transfersRange.first);
-
-    TransfersMap initialTransfers = getKnownTransfersMap(transactionId, firstTransferIdx);
+    TransfersMap initialTransfers = getKnownTransfersMap(transactionId);
 
     std::unordered_set<std::string> myInputAddresses;
     std::unordered_set<std::string> myOutputAddresses;
@@ -2420,14 +2632,12 @@ bool WalletGreen::updateTransactionTransfers(
 
         updated |= updateAddressTransfers(
             transactionId,
-            firstTransferIdx,
             addressString,
             initialTransfers[addressString].input,
             containerAmount.amounts.input
         );
         updated |= updateAddressTransfers(
             transactionId,
-            firstTransferIdx,
             addressString,
             initialTransfers[addressString].output,
             containerAmount.amounts.output
@@ -2450,7 +2660,7 @@ bool WalletGreen::updateTransactionTransfers(
 
     int64_t knownInputsAmount = 0;
     int64_t knownOutputsAmount = 0;
-    auto updatedTransfers = getKnownTransfersMap(transactionId, firstTransferIdx);
+    auto updatedTransfers = getKnownTransfersMap(transactionId);
     for (const auto &pair : updatedTransfers) {
         knownInputsAmount += pair.second.input;
         knownOutputsAmount += pair.second.output;
@@ -2461,7 +2671,6 @@ bool WalletGreen::updateTransactionTransfers(
 
     updated |= updateUnknownTransfers(
         transactionId,
-        firstTransferIdx,
         myInputAddresses,
         knownInputsAmount,
         myInputsAmount,
@@ -2470,7 +2679,6 @@ bool WalletGreen::updateTransactionTransfers(
     );
     updated |= updateUnknownTransfers(
         transactionId,
-        firstTransferIdx,
         myOutputAddresses,
         knownOutputsAmount,
         myOutputsAmount,
@@ -2481,22 +2689,20 @@ bool WalletGreen::updateTransactionTransfers(
     return updated;
 }
 
-WalletGreen::TransfersMap WalletGreen::getKnownTransfersMap(size_t transactionId,
-                                                            size_t firstTransferIdx) const
+WalletGreen::TransfersMap WalletGreen::getKnownTransfersMap(size_t transactionId) const
 {
     TransfersMap result;
 
-    for (auto it = std::next(m_transfers.begin(), firstTransferIdx);
-         it != m_transfers.end() && it->first == transactionId;
-         ++it) {
-        const auto &address = it->second.address;
+    auto range = m_transfers.getTransfers(transactionId);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto &address = it->address;
 
         if (!address.empty()) {
-            if (it->second.amount < 0) {
-                result[address].input += it->second.amount;
+            if (it->amount < 0) {
+                result[address].input += it->amount;
             } else {
-                assert(it->second.amount > 0);
-                result[address].output += it->second.amount;
+                assert(it->amount > 0);
+                result[address].output += it->amount;
             }
         }
     }
@@ -2505,7 +2711,7 @@ WalletGreen::TransfersMap WalletGreen::getKnownTransfersMap(size_t transactionId
 }
 
 bool WalletGreen::updateAddressTransfers(size_t transactionId,
-                                         size_t firstTransferIdx, const std::string &address,
+                                         const std::string &address,
                                          int64_t knownAmount,
                                          int64_t targetAmount)
 {
@@ -2520,13 +2726,13 @@ bool WalletGreen::updateAddressTransfers(size_t transactionId,
 
     if (knownAmount != targetAmount) {
         if (knownAmount == 0) {
-            appendTransfer(transactionId, firstTransferIdx, address, targetAmount);
+            appendTransfer(transactionId, address, targetAmount);
             updated = true;
         } else if (targetAmount == 0) {
             assert(knownAmount != 0);
-            updated|=eraseTransfersByAddress(transactionId,firstTransferIdx,address,knownAmount>0);
+            updated|=eraseTransfersByAddress(transactionId, address, knownAmount > 0);
         } else {
-            updated |= adjustTransfer(transactionId, firstTransferIdx, address, targetAmount);
+            updated |= adjustTransfer(transactionId, address, targetAmount);
         }
     }
 
@@ -2534,7 +2740,6 @@ bool WalletGreen::updateAddressTransfers(size_t transactionId,
 }
 
 bool WalletGreen::updateUnknownTransfers(size_t transactionId,
-                                         size_t firstTransferIdx,
                                          const std::unordered_set<std::string> &myAddresses,
                                          int64_t knownAmount,
                                          int64_t myAmount,
@@ -2544,11 +2749,10 @@ bool WalletGreen::updateUnknownTransfers(size_t transactionId,
     bool updated = false;
 
     if (std::abs(knownAmount) > std::abs(totalAmount)) {
-        updated |= eraseForeignTransfers(transactionId, firstTransferIdx, myAddresses, isOutput);
+        updated |= eraseForeignTransfers(transactionId, myAddresses, isOutput);
         if (totalAmount == myAmount) {
             updated |= eraseTransfersByAddress(
                 transactionId,
-                firstTransferIdx,
                 std::string(),
                 isOutput
             );
@@ -2556,18 +2760,16 @@ bool WalletGreen::updateUnknownTransfers(size_t transactionId,
             assert(std::abs(totalAmount) > std::abs(myAmount));
             updated |= adjustTransfer(
                 transactionId,
-                firstTransferIdx,
                 std::string(),
                 totalAmount - myAmount
             );
         }
     } else if (knownAmount == totalAmount) {
-        updated |= eraseTransfersByAddress(transactionId, firstTransferIdx, std::string(),isOutput);
+        updated |= eraseTransfersByAddress(transactionId, std::string(), isOutput);
     } else {
         assert(std::abs(totalAmount) > std::abs(knownAmount));
         updated |= adjustTransfer(
             transactionId,
-            firstTransferIdx,
             std::string(),
             totalAmount - knownAmount
         );
@@ -2577,30 +2779,14 @@ bool WalletGreen::updateUnknownTransfers(size_t transactionId,
 }
 
 void WalletGreen::appendTransfer(size_t transactionId,
-                                 size_t firstTransferIdx,
                                  const std::string &address,
                                  int64_t amount)
 {
-    auto it = std::next(m_transfers.begin(), firstTransferIdx);
-    auto insertIt = std::upper_bound(
-        it,
-        m_transfers.end(),
-        transactionId,
-        [](size_t transactionId, const TransactionTransferPair &pair) {
-        return transactionId < pair.first;
-    });
-
     WalletTransfer transfer{ WalletTransferType::USUAL, address, amount };
-    m_transfers.emplace(
-        insertIt,
-        std::piecewise_construct,
-        std::forward_as_tuple(transactionId),
-        std::forward_as_tuple(transfer)
-    );
+    m_transfers.push_back(transactionId, std::move(transfer));
 }
 
 bool WalletGreen::adjustTransfer(size_t transactionId,
-                                 size_t firstTransferIdx,
                                  const std::string &address,
                                  int64_t amount)
 {
@@ -2609,17 +2795,19 @@ bool WalletGreen::adjustTransfer(size_t transactionId,
     bool updated = false;
     bool updateOutputTransfers = amount > 0;
     bool firstAddressTransferFound = false;
-    auto it = std::next(m_transfers.begin(), firstTransferIdx);
-    while (it != m_transfers.end() && it->first == transactionId) {
-        assert(it->second.amount != 0);
-        bool transferIsOutput = it->second.amount > 0;
-        if (transferIsOutput == updateOutputTransfers && it->second.address == address) {
+    auto range = m_transfers.getTransfers(transactionId);
+    auto it = range.first;
+    while (it != range.second) {
+        assert(it->amount != 0);
+        bool transferIsOutput = it->amount > 0;
+        if (transferIsOutput == updateOutputTransfers && it->address == address) {
             if (firstAddressTransferFound) {
-                it = m_transfers.erase(it);
+                it = m_transfers.erase(transactionId, it);
+                --range.second;
                 updated = true;
             } else {
-                if (it->second.amount != amount) {
-                    it->second.amount = amount;
+                if (it->amount != amount) {
+                    it->amount = amount;
                     updated = true;
                 }
 
@@ -2632,13 +2820,7 @@ bool WalletGreen::adjustTransfer(size_t transactionId,
     }
 
     if (!firstAddressTransferFound) {
-        WalletTransfer transfer{ WalletTransferType::USUAL, address, amount };
-        m_transfers.emplace(
-            it,
-            std::piecewise_construct,
-            std::forward_as_tuple(transactionId),
-            std::forward_as_tuple(transfer)
-        );
+        appendTransfer(transactionId, address, amount);
         updated = true;
     }
 
@@ -2647,15 +2829,16 @@ bool WalletGreen::adjustTransfer(size_t transactionId,
 
 bool WalletGreen::eraseTransfers(
     size_t transactionId,
-    size_t firstTransferIdx,
     std::function<bool(bool, const std::string &)> &&predicate)
 {
     bool erased = false;
-    auto it = std::next(m_transfers.begin(), firstTransferIdx);
-    while (it != m_transfers.end() && it->first == transactionId) {
-        bool transferIsOutput = it->second.amount > 0;
-        if (predicate(transferIsOutput, it->second.address)) {
-            it = m_transfers.erase(it);
+    auto range = m_transfers.getTransfers(transactionId);
+    auto it = range.first;
+    while (it != range.second) {
+        bool transferIsOutput = it->amount > 0;
+        if (predicate(transferIsOutput, it->address)) {
+            it = m_transfers.erase(transactionId, it);
+            --range.second;
             erased = true;
         } else {
             ++it;
@@ -2666,26 +2849,22 @@ bool WalletGreen::eraseTransfers(
 }
 
 bool WalletGreen::eraseTransfersByAddress(size_t transactionId,
-                                          size_t firstTransferIdx,
                                           const std::string &address,
                                           bool eraseOutputTransfers)
 {
     return eraseTransfers(
         transactionId,
-        firstTransferIdx,
         [&address, eraseOutputTransfers](bool isOutput, const std::string& transferAddress) {
         return eraseOutputTransfers == isOutput && address == transferAddress;
     });
 }
 
 bool WalletGreen::eraseForeignTransfers(size_t transactionId,
-                                        size_t firstTransferIdx,
                                         const std::unordered_set<std::string> &knownAddresses,
                                         bool eraseOutputTransfers)
 {
     return eraseTransfers(
         transactionId,
-        firstTransferIdx,
         [this, &knownAddresses, eraseOutputTransfers](bool isOutput, const std::string &ta) {
         return eraseOutputTransfers == isOutput && knownAddresses.count(ta) == 0;
     });
@@ -2841,6 +3020,7 @@ size_t WalletGreen::validateSaveAndSendTransaction(
     } else {
         assert(m_uncommitedTransactions.count(transactionId) == 0);
         m_uncommitedTransactions.emplace(transactionId, std::move(cryptoNoteTransaction));
+        m_journalUncommitedTransactions.insert(transactionId);
         m_logger(DEBUGGING)
             << "Transaction delayed, ID " << transactionId
             << ", hash " << transaction.getTransactionHash();
@@ -2910,104 +3090,328 @@ void WalletGreen::requestMixinOuts(
 uint64_t WalletGreen::selectTransfers(uint64_t neededMoney,
                                       bool dust,
                                       uint64_t dustThreshold,
-                                      std::vector<WalletOuts> &&wallets,
+                                      const std::vector<std::string> &sourceAddresses,
                                       std::vector<OutputToTransfer> &selectedTransfers)
 {
     uint64_t foundMoney = 0;
 
-    typedef std::pair<WalletRecord *, TransactionOutputInformation> OutputData;
-    std::vector<OutputData> dustOutputs;
-    std::vector<OutputData> walletOuts;
-    for (auto walletIt = wallets.begin(); walletIt != wallets.end(); ++walletIt) {
-        for (auto outIt = walletIt->outs.begin(); outIt != walletIt->outs.end(); ++outIt) {
-            if (outIt->amount > dustThreshold) {
-                walletOuts.emplace_back(
-                    std::piecewise_construct,
-                    std::forward_as_tuple(walletIt->wallet),
-                    std::forward_as_tuple(*outIt)
-                );
+    if (!sourceAddresses.empty()) {
+        std::vector<const SpendableOutput *> dustOutputs;
+        std::vector<const SpendableOutput *> walletOuts;
+        for (const SpendableOutput *output : pickSpendableOutputs(sourceAddresses)) {
+            if (output->out.amount > dustThreshold) {
+                walletOuts.push_back(output);
             } else if (dust) {
-                dustOutputs.emplace_back(
-                    std::piecewise_construct,
-                    std::forward_as_tuple(walletIt->wallet),
-                    std::forward_as_tuple(*outIt)
-                );
+                dustOutputs.push_back(output);
             }
         }
+
+        ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> indexGenerator(walletOuts.size());
+        while (foundMoney < neededMoney && !indexGenerator.empty()) {
+            const SpendableOutput &output = *walletOuts[indexGenerator()];
+            foundMoney += output.out.amount;
+            selectedTransfers.emplace_back(makeOutputToTransfer(output));
+        }
+
+        if (dust && !dustOutputs.empty()) {
+            ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> dustIndexGenerator(
+                dustOutputs.size()
+            );
+            do {
+                const SpendableOutput &output = *dustOutputs[dustIndexGenerator()];
+                foundMoney += output.out.amount;
+                selectedTransfers.emplace_back(makeOutputToTransfer(output));
+            } while (foundMoney < neededMoney && !dustIndexGenerator.empty());
+        }
+
+        return foundMoney;
     }
 
-    ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> indexGenerator(walletOuts.size());
+    // The index is ordered by amount, so dust outputs form its prefix and both groups
+    // can be sampled by rank without copying any output that is not selected.
+    refreshSpendableOutputs();
+    auto &amountIndex = m_spendableOutputs.get<SpendableAmountIndex>();
+    size_t dustCount = amountIndex.rank(amountIndex.upper_bound(dustThreshold));
+
+    ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> indexGenerator(
+        amountIndex.size() - dustCount
+    );
     while (foundMoney < neededMoney && !indexGenerator.empty()) {
-        auto &out = walletOuts[indexGenerator()];
-        foundMoney += out.second.amount;
-        selectedTransfers.emplace_back(OutputToTransfer{
-            std::move(out.second), std::move(out.first)
-        });
+        const SpendableOutput &output = *amountIndex.nth(dustCount + indexGenerator());
+        foundMoney += output.out.amount;
+        selectedTransfers.emplace_back(makeOutputToTransfer(output));
     }
 
-    if (dust && !dustOutputs.empty()) {
-        auto dustOutputsSize = dustOutputs.size();
-        ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> dustIndexGenerator(dustOutputsSize);
+    if (dust && dustCount != 0) {
+        ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> dustIndexGenerator(dustCount);
         do {
-            auto &out = dustOutputs[dustIndexGenerator()];
-            foundMoney += out.second.amount;
-            selectedTransfers.emplace_back(OutputToTransfer{
-                std::move(out.second), std::move(out.first)
-            });
+            const SpendableOutput &output = *amountIndex.nth(dustIndexGenerator());
+            foundMoney += output.out.amount;
+            selectedTransfers.emplace_back(makeOutputToTransfer(output));
         } while (foundMoney < neededMoney && !dustIndexGenerator.empty());
     }
 
     return foundMoney;
 }
 
-std::vector<WalletGreen::WalletOuts> WalletGreen::pickWalletsWithMoney() const
+std::vector<const SpendableOutput *> WalletGreen::pickSpendableOutputs(
+    const std::vector<std::string> &addresses) const
 {
-    auto &walletsIndex = m_walletsContainer.get<RandomAccessIndex>();
+    refreshSpendableOutputs();
 
-    std::vector<WalletOuts> walletOuts;
-    for (const auto &wallet: walletsIndex) {
-        if (wallet.actualBalance == 0) {
-            continue;
+    auto &containerIndex = m_spendableOutputs.get<TransfersContainerIndex>();
+
+    std::vector<const SpendableOutput *> outputs;
+    for (const auto &address : addresses) {
+        auto range = containerIndex.equal_range(getWalletRecord(address).container);
+        for (auto it = range.first; it != range.second; ++it) {
+            outputs.push_back(&*it);
         }
+    }
 
-        ITransfersContainer *container = wallet.container;
+    return outputs;
+}
+
+WalletGreen::OutputToTransfer WalletGreen::makeOutputToTransfer(
+    const SpendableOutput &output) const
+{
+    const auto &wallet = getWalletRecord(output.container);
 
-        WalletOuts outs;
-        container->getOutputs(outs.outs, ITransfersContainer::IncludeKeyUnlocked);
-        outs.wallet = const_cast<WalletRecord *>(&wallet);
+    return OutputToTransfer{ output.out, const_cast<WalletRecord *>(&wallet) };
+}
 
-        walletOuts.push_back(std::move(outs));
+void WalletGreen::refreshSpendableOutputs() const
+{
+    for (auto container : m_staleSpendableContainers) {
+        rebuildSpendableOutputs(container);
     }
 
-    return walletOuts;
+    m_staleSpendableContainers.clear();
+
+    // A job finds the outputs still locked if it runs before their container reaches its height,
+    // containers unlock outputs as they are queried, so the index catches up as it is queried
+    uint32_t height = m_blockchain.empty() ? 0 : static_cast<uint32_t>(m_blockchain.size() - 1);
+    unlockSpendableOutputs(height);
 }
 
-WalletGreen::WalletOuts WalletGreen::pickWallet(const std::string &address) const
+void WalletGreen::rebuildSpendableOutputs(ITransfersContainer *container) const
 {
-    const auto &wallet = getWalletRecord(address);
+    m_spendableOutputs.get<TransfersContainerIndex>().erase(container);
+    deleteSpendableUnlockJobs(container);
 
-    ITransfersContainer *container = wallet.container;
-    WalletOuts outs;
-    container->getOutputs(outs.outs, ITransfersContainer::IncludeKeyUnlocked);
-    outs.wallet = const_cast<WalletRecord *>(&wallet);
+    std::vector<TransactionOutputInformation> outputs;
+    container->getOutputs(outputs, ITransfersContainer::IncludeKeyUnlocked);
+    for (auto &output : outputs) {
+        m_spendableOutputs.insert(SpendableOutput{ container, std::move(output) });
+    }
 
-    return outs;
+    std::vector<TransactionOutputInformation> lockedOutputs;
+    container->getOutputs(lockedOutputs, ITransfersContainer::IncludeKeyNotUnlocked);
+    std::vector<Crypto::Hash> safeTransactionList;
+    container->getSafeTransactions(safeTransactionList);
+    std::unordered_set<Crypto::Hash> safeTransactions(
+        safeTransactionList.begin(),
+        safeTransactionList.end()
+    );
+    std::unordered_set<Crypto::Hash> scheduledTransactions;
+    for (const auto &output : lockedOutputs) {
+        if (scheduledTransactions.insert(output.transactionHash).second) {
+            bool safe = safeTransactions.count(output.transactionHash) != 0;
+            scheduleSpendableUnlock(container, output.transactionHash, safe);
+        }
+    }
+
+    m_logger(TRACE) << "Spendable outputs rebuilt, container outputs " << outputs.size()
+                    << ", locked " << lockedOutputs.size()
+                    << ", total " << m_spendableOutputs.size();
 }
 
-std::vector<WalletGreen::WalletOuts> WalletGreen::pickWallets(
-    const std::vector<std::string> &addresses) const
+bool WalletGreen::updateSpendableOutputs(ITransfersContainer *container,
+                                         const Crypto::Hash &transactionHash) const
 {
-    std::vector<WalletOuts> wallets;
-    wallets.reserve(addresses.size());
+    auto &walletsIndex = m_walletsContainer.get<TransfersContainerIndex>();
+    if (walletsIndex.find(container) == walletsIndex.end()
+        || m_staleSpendableContainers.count(container) != 0) {
+        return false;
+    }
 
-    for (const auto &address : addresses) {
-        WalletOuts wallet = pickWallet(address);
-        if (!wallet.outs.empty()) {
-            wallets.emplace_back(std::move(wallet));
+    auto &outputIndex = m_spendableOutputs.get<TransactionOutputIndex>();
+
+    auto inputs = container->getTransactionInputs(
+        transactionHash,
+        ITransfersContainer::IncludeTypeKey
+    );
+    for (const auto &input : inputs) {
+        auto it = outputIndex.find(
+            boost::make_tuple(input.transactionHash, input.outputInTransaction)
+        );
+        if (it != outputIndex.end()) {
+            outputIndex.erase(it);
         }
     }
 
-    return wallets;
+    bool added = false;
+    auto outputs = container->getTransactionOutputs(
+        transactionHash,
+        ITransfersContainer::IncludeKeyUnlocked
+    );
+    for (auto &output : outputs) {
+        added |= m_spendableOutputs.insert(SpendableOutput{ container, std::move(output) }).second;
+    }
+
+    auto lockedOutputs = container->getTransactionOutputs(
+        transactionHash,
+        ITransfersContainer::IncludeKeyNotUnlocked
+    );
+    if (!lockedOutputs.empty()) {
+        scheduleSpendableUnlock(
+            container,
+            transactionHash,
+            isSafeTransaction(container, transactionHash)
+        );
+    }
+
+    return added;
+}
+
+void WalletGreen::scheduleSpendableUnlock(ITransfersContainer *container,
+                                          const Crypto::Hash &transactionHash,
+                                          bool safe) const
+{
+    // unconfirmed outputs are scheduled once transactionUpdated() reports their block
+    TransactionInformation info;
+    if (!container->getTransactionInformation(transactionHash, info)
+        || info.blockHeight == WALLET_UNCONFIRMED_TRANSACTION_HEIGHT) {
+        return;
+    }
+
+    uint32_t unlockHeight = getUnlockHeight(info.blockHeight, info.unlockTime, safe);
+    uint32_t height = m_blockchain.empty() ? 0 : static_cast<uint32_t>(m_blockchain.size() - 1);
+    if (info.unlockTime < m_currency.maxBlockHeight() || height < unlockHeight) {
+        m_spendableUnlocksByHeight.insert(
+            SpendableUnlockJob{ unlockHeight, container, transactionHash }
+        );
+    } else {
+        // see TransfersContainer::isSpendTimeUnlocked()
+        m_spendableUnlocksByTime.insert(SpendableUnlockJob{
+            info.unlockTime - m_currency.lockedTxAllowedDeltaSeconds(),
+            container,
+            transactionHash
+        });
+    }
+}
+
+void WalletGreen::deleteSpendableUnlockJobs(ITransfersContainer *container) const
+{
+    m_spendableUnlocksByHeight.get<TransfersContainerIndex>().erase(container);
+    m_spendableUnlocksByTime.get<TransfersContainerIndex>().erase(container);
+}
+
+// Adds the outputs unlocked by the given height or by now to the index
+void WalletGreen::unlockSpendableOutputs(uint32_t height) const
+{
+    std::vector<SpendableUnlockJob> jobs;
+    auto &heightIndex = m_spendableUnlocksByHeight.get<UnlockIndex>();
+    auto heightEnd = heightIndex.upper_bound(height);
+    jobs.insert(jobs.end(), heightIndex.begin(), heightEnd);
+    heightIndex.erase(heightIndex.begin(), heightEnd);
+
+    auto &timeIndex = m_spendableUnlocksByTime.get<UnlockIndex>();
+    auto timeEnd = timeIndex.upper_bound(static_cast<uint64_t>(time(nullptr)));
+    jobs.insert(jobs.end(), timeIndex.begin(), timeEnd);
+    timeIndex.erase(timeIndex.begin(), timeEnd);
+
+    // outputs that are still locked are scheduled again for a later call
+    for (const auto &job : jobs) {
+        if (updateSpendableOutputs(job.container, job.transactionHash)) {
+            m_unlockedSpendableContainers.insert(job.container);
+        }
+    }
+}
+
+// The height from which TransfersContainer::transferState() counts the outputs of a transaction
+// as unlocked. Outputs locked until a timestamp wait for the time as well.
+uint32_t WalletGreen::getUnlockHeight(uint32_t blockHeight, uint64_t unlockTime, bool safe) const
+{
+    uint32_t height = blockHeight + m_transactionSoftLockTime;
+    if (safe) {
+        height = std::min(
+            height,
+            blockHeight - 1 + static_cast<uint32_t>(m_currency.safeTransactionSpendableAge())
+        );
+    }
+
+    if (unlockTime < m_currency.maxBlockHeight()) {
+        uint64_t deltaBlocks = m_currency.lockedTxAllowedDeltaBlocks();
+        uint64_t lockedHeight = unlockTime > deltaBlocks ? unlockTime - deltaBlocks : 0;
+        height = std::max(height, static_cast<uint32_t>(lockedHeight));
+    }
+
+    return height;
+}
+
+bool WalletGreen::isSafeTransaction(const ITransfersContainer *container,
+                                    const Crypto::Hash &transactionHash) const
+{
+    std::vector<Crypto::Hash> safeTransactions;
+    container->getSafeTransactions(safeTransactions);
+
+    return std::find(safeTransactions.begin(), safeTransactions.end(), transactionHash)
+           != safeTransactions.end();
+}
+
+void WalletGreen::removeSpendableOutputs(const std::vector<OutputToTransfer> &spentOutputs)
+{
+    auto &outputIndex = m_spendableOutputs.get<TransactionOutputIndex>();
+    for (const auto &spent : spentOutputs) {
+        auto it = outputIndex.find(
+            boost::make_tuple(spent.out.transactionHash, spent.out.outputInTransaction)
+        );
+        if (it != outputIndex.end()) {
+            outputIndex.erase(it);
+        }
+    }
+}
+
+size_t WalletGreen::getFusionBucketSizes(
+    const std::vector<std::string> &addresses,
+    uint64_t threshold,
+    std::array<size_t, std::numeric_limits<uint64_t>::digits10 + 1> &bucketSizes) const
+{
+    bucketSizes.fill(0);
+    uint32_t height = m_node.getLastKnownBlockHeight();
+
+    if (!addresses.empty()) {
+        auto outputs = pickSpendableOutputs(addresses);
+        for (const SpendableOutput *output : outputs) {
+            uint8_t powerOfTen = 0;
+            if (m_currency.isAmountApplicableInFusionTransactionInput(
+                    output->out.amount, threshold, powerOfTen, height)) {
+                assert(powerOfTen < std::numeric_limits<uint64_t>::digits10 + 1);
+                bucketSizes[powerOfTen]++;
+            }
+        }
+
+        return outputs.size();
+    }
+
+    // Walk distinct amounts only, counting outputs of each amount by rank
+    refreshSpendableOutputs();
+    auto &amountIndex = m_spendableOutputs.get<SpendableAmountIndex>();
+    for (auto it = amountIndex.begin(); it != amountIndex.end();) {
+        auto next = amountIndex.upper_bound(it->out.amount);
+
+        uint8_t powerOfTen = 0;
+        if (m_currency.isAmountApplicableInFusionTransactionInput(
+                it->out.amount, threshold, powerOfTen, height)) {
+            assert(powerOfTen < std::numeric_limits<uint64_t>::digits10 + 1);
+            bucketSizes[powerOfTen] += amountIndex.rank(next) - amountIndex.rank(it);
+        }
+
+        it = next;
+    }
+
+    return amountIndex.size();
 }
 
 std::vector<CryptoNote::WalletGreen::ReceiverAmounts> WalletGreen::splitDestinations(
@@ -3301,6 +3705,9 @@ void WalletGreen::onError(ITransfersSubscription *object, uint32_t height, std::
         << "Synchronization error: " << ec
         << ", " << ec.message()
         << ", height " << height;
+
+    // the subscription has detached its container
+    m_dispatcher.remoteSpawn([this]() { m_journalSynchronizerStateChanged = true; });
 }
 
 void WalletGreen::synchronizationProgressUpdated(uint32_t processedBlockCount,
@@ -3365,6 +3772,7 @@ void WalletGreen::blocksAdded(const std::vector<Crypto::Hash> &blockHashes)
     }
 
     m_blockchain.insert(m_blockchain.end(), blockHashes.begin(), blockHashes.end());
+    m_journalSynchronizerStateChanged = true;
 }
 
 void WalletGreen::onBlockchainDetach(const Crypto::PublicKey &viewPublicKey, uint32_t blockIndex)
@@ -3387,6 +3795,7 @@ void WalletGreen::blocksRollback(uint32_t blockIndex)
         std::next(blockHeightIndex.begin(), blockIndex),
         blockHeightIndex.end()
     );
+    m_journalSynchronizerStateChanged = true;
 }
 
 void WalletGreen::onTransactionDeleteBegin(const Crypto::PublicKey &viewPublicKey,
@@ -3411,6 +3820,7 @@ void WalletGreen::onTransactionDeleteEnd(const Crypto::PublicKey &viewPublicKey,
 void WalletGreen::transactionDeleteEnd(Crypto::Hash transactionHash)
 {
     m_logger(TRACE) << "transactionDeleteEnd " << transactionHash;
+    m_journalSynchronizerStateChanged = true;
 }
 
 void WalletGreen::unlockBalances(uint32_t height)
@@ -3418,12 +3828,25 @@ void WalletGreen::unlockBalances(uint32_t height)
     auto &index = m_unlockTransactionsJob.get<BlockHeightIndex>();
     auto upper = index.upper_bound(height);
 
-    if (index.begin() != upper) {
-        for (auto it = index.begin(); it != upper; ++it) {
-            updateBalance(it->container);
-        }
+    bool unlocked = index.begin() != upper;
+    for (auto it = index.begin(); it != upper; ++it) {
+        updateBalance(it->container);
+        m_journalUnlockJobs.insert(it->transactionHash);
+    }
 
-        index.erase(index.begin(), upper);
+    index.erase(index.begin(), upper);
+
+    // the jobs above don't know about unlock timestamps, the ones of the spendable index do
+    refreshSpendableOutputs();
+    unlockSpendableOutputs(height);
+    for (auto container : m_unlockedSpendableContainers) {
+        updateBalance(container);
+        unlocked = true;
+    }
+
+    m_unlockedSpendableContainers.clear();
+
+    if (unlocked) {
         pushEvent(makeMoneyUnlockedEvent());
     }
 }
@@ -3489,6 +3912,8 @@ void WalletGreen::transactionUpdated(
         return;
     }
 
+    m_journalSynchronizerStateChanged = true;
+
     bool updated = false;
     bool isNew = false;
 
@@ -3519,17 +3944,21 @@ void WalletGreen::transactionUpdated(
     if (transactionInfo.blockHeight != CryptoNote::WALLET_UNCONFIRMED_TRANSACTION_HEIGHT) {
         // In some cases a transaction can be included to a block but not removed
         // from m_uncommitedTransactions. Fix it.
-        m_uncommitedTransactions.erase(transactionId);
+        if (m_uncommitedTransactions.erase(transactionId) != 0) {
+            m_journalUncommitedTransactions.insert(transactionId);
+        }
     }
 
     // Update cached balance
     for (auto containerAmounts : containerAmountsList) {
         updateBalance(containerAmounts.container);
+        updateSpendableOutputs(containerAmounts.container, transactionInfo.transactionHash);
 
         if (transactionInfo.blockHeight != CryptoNote::WALLET_UNCONFIRMED_TRANSACTION_HEIGHT) {
-            uint32_t unlockHeight = std::max(
-                transactionInfo.blockHeight + m_transactionSoftLockTime,
-                static_cast<uint32_t>(transactionInfo.unlockTime)
+            uint32_t unlockHeight = getUnlockHeight(
+                transactionInfo.blockHeight,
+                transactionInfo.unlockTime,
+                isSafeTransaction(containerAmounts.container, transactionInfo.transactionHash)
             );
             insertUnlockTransactionJob(
                 transactionInfo.transactionHash,
@@ -3574,6 +4003,13 @@ void WalletGreen::transactionUpdated(
 
 void WalletGreen::pushEvent(const WalletEvent &event)
 {
+    // every change of a transaction or its transfers is announced by an event
+    if (event.type == WalletEventType::TRANSACTION_CREATED) {
+        m_journalTransactions.insert(event.transactionCreated.transactionIndex);
+    } else if (event.type == WalletEventType::TRANSACTION_UPDATED) {
+        m_journalTransactions.insert(event.transactionUpdated.transactionIndex);
+    }
+
     m_events.push(event);
     m_eventOccurred.set();
 }
@@ -3602,6 +4038,32 @@ void WalletGreen::onTransactionDeleted(ITransfersSubscription *object, const Has
     });
 }
 
+void WalletGreen::onTransfersLocked(ITransfersSubscription *object)
+{
+    m_dispatcher.remoteSpawn([object, this] () { this->transfersLocked(object); });
+}
+
+// Transfers older than the split may be soft locked again, see TransfersContainer::detach()
+void WalletGreen::transfersLocked(ITransfersSubscription *object)
+{
+    System::EventLock lk(m_readyEvent);
+
+    m_logger(DEBUGGING) << "transfersLocked event";
+
+    if (m_state == WalletState::NOT_INITIALIZED) {
+        return;
+    }
+
+    m_journalSynchronizerStateChanged = true;
+
+    ITransfersContainer *container = &object->getContainer();
+    auto &walletsIndex = m_walletsContainer.get<TransfersContainerIndex>();
+    if (walletsIndex.find(container) != walletsIndex.end()) {
+        updateBalance(container);
+        m_staleSpendableContainers.insert(container);
+    }
+}
+
 void WalletGreen::transactionDeleted(ITransfersSubscription *object, const Hash &transactionHash)
 {
     System::EventLock lk(m_readyEvent);
@@ -3612,6 +4074,8 @@ void WalletGreen::transactionDeleted(ITransfersSubscription *object, const Hash
         return;
     }
 
+    m_journalSynchronizerStateChanged = true;
+
     auto it = m_transactions.get<TransactionIndex>().find(transactionHash);
     if (it == m_transactions.get<TransactionIndex>().end()) {
         return;
@@ -3620,6 +4084,8 @@ void WalletGreen::transactionDeleted(ITransfersSubscription *object, const Hash
     CryptoNote::ITransfersContainer *container = &object->getContainer();
     updateBalance(container);
     deleteUnlockTransactionJob(transactionHash);
+    // Outputs spent by the deleted transaction become available again
+    m_staleSpendableContainers.insert(container);
 
     bool updated = false;
     m_transactions.get<TransactionIndex>().modify(
@@ -3658,12 +4124,15 @@ void WalletGreen::insertUnlockTransactionJob(
 {
     auto &index = m_unlockTransactionsJob.get<BlockHeightIndex>();
     index.insert( { blockHeight, container, transactionHash } );
+    m_journalUnlockJobs.insert(transactionHash);
 }
 
 void WalletGreen::deleteUnlockTransactionJob(const Hash &transactionHash)
 {
     auto &index = m_unlockTransactionsJob.get<TransactionHashIndex>();
-    index.erase(transactionHash);
+    if (index.erase(transactionHash) != 0) {
+        m_journalUnlockJobs.insert(transactionHash);
+    }
 }
 
 void WalletGreen::startBlockchainSynchronizer()
@@ -3752,6 +4221,7 @@ void WalletGreen::updateBalance(CryptoNote::ITransfersContainer *container)
             wallet.actualBalance = actual;
             wallet.pendingBalance = pending;
         });
+        m_journalWallets.insert(it->spendPublicKey);
 
         m_logger(INFO, BRIGHT_WHITE)
             << "Wallet balance updated, address "
@@ -3966,6 +4436,7 @@ size_t WalletGreen::createFusionTransaction(
     }
 
     id = validateSaveAndSendTransaction(*fusionTransaction, {}, true, true);
+    removeSpendableOutputs(fusionInputs);
 
     return id;
 }
@@ -4074,26 +4545,8 @@ IFusionManager::EstimateResult WalletGreen::estimate(
     validateSourceAddresses(sourceAddresses);
 
     IFusionManager::EstimateResult result{0, 0};
-    auto walletOuts = sourceAddresses.empty() ? pickWalletsWithMoney():pickWallets(sourceAddresses);
     std::array<size_t, std::numeric_limits<uint64_t>::digits10 + 1> bucketSizes;
-    bucketSizes.fill(0);
-    for (size_t walletIndex = 0; walletIndex < walletOuts.size(); ++walletIndex) {
-        for (auto &out : walletOuts[walletIndex].outs) {
-            uint8_t powerOfTen = 0;
-            bool b = m_currency.isAmountApplicableInFusionTransactionInput(
-                out.amount,
-                threshold,
-                powerOfTen,
-                m_node.getLastKnownBlockHeight()
-            );
-            if (b) {
-                assert(powerOfTen < std::numeric_limits<uint64_t>::digits10 + 1);
-                bucketSizes[powerOfTen]++;
-            }
-        }
-
-        result.totalOutputCount += walletOuts[walletIndex].outs.size();
-    }
+    result.totalOutputCount = getFusionBucketSizes(sourceAddresses, threshold, bucketSizes);
 
     for (auto bucketSize : bucketSizes) {
         if (bucketSize >= m_currency.fusionTxMinInputCount()) {
@@ -4110,26 +4563,8 @@ std::vector<WalletGreen::OutputToTransfer> WalletGreen::pickRandomFusionInputs(
     size_t minInputCount,
     size_t maxInputCount)
 {
-    std::vector<WalletGreen::OutputToTransfer> allFusionReadyOuts;
-    auto walletOuts = addresses.empty() ? pickWalletsWithMoney() : pickWallets(addresses);
     std::array<size_t, std::numeric_limits<uint64_t>::digits10 + 1> bucketSizes;
-    bucketSizes.fill(0);
-    for (size_t walletIndex = 0; walletIndex < walletOuts.size(); ++walletIndex) {
-        for (auto &out : walletOuts[walletIndex].outs) {
-            uint8_t powerOfTen = 0;
-            bool b = m_currency.isAmountApplicableInFusionTransactionInput(
-                out.amount,
-                threshold,
-                powerOfTen,
-                m_node.getLastKnownBlockHeight()
-            );
-            if (b) {
-                allFusionReadyOuts.push_back({std::move(out), walletOuts[walletIndex].wallet});
-                assert(powerOfTen < std::numeric_limits<uint64_t>::digits10 + 1);
-                bucketSizes[powerOfTen]++;
-            }
-        }
-    }
+    getFusionBucketSizes(addresses, threshold, bucketSizes);
 
     // now, pick the bucket
     std::vector<uint8_t> bucketNumbers(bucketSizes.size());
@@ -4160,35 +4595,63 @@ std::vector<WalletGreen::OutputToTransfer> WalletGreen::pickRandomFusionInputs(
 
     uint64_t upperBound = selectedBucket == std::numeric_limits<uint64_t>::digits10 ? UINT64_MAX
                                                                                     : lowerBound*10;
-    std::vector<WalletGreen::OutputToTransfer> selectedOuts;
-    selectedOuts.reserve(bucketSizes[selectedBucket]);
-    for (size_t outIndex = 0; outIndex < allFusionReadyOuts.size(); ++outIndex) {
-        if (allFusionReadyOuts[outIndex].out.amount >= lowerBound
-            && allFusionReadyOuts[outIndex].out.amount < upperBound) {
-            selectedOuts.push_back(std::move(allFusionReadyOuts[outIndex]));
+    uint32_t height = m_node.getLastKnownBlockHeight();
+    auto isFusionReady = [this, threshold, height](const SpendableOutput &output) {
+        return m_currency.isAmountApplicableInFusionTransactionInput(
+            output.out.amount,
+            threshold,
+            height
+        );
+    };
+
+    std::vector<const SpendableOutput *> bucketOuts;
+    bucketOuts.reserve(bucketSizes[selectedBucket]);
+    if (addresses.empty()) {
+        auto &amountIndex = m_spendableOutputs.get<SpendableAmountIndex>();
+        auto end = upperBound == UINT64_MAX ? amountIndex.end()
+                                            : amountIndex.lower_bound(upperBound);
+        for (auto it = amountIndex.lower_bound(lowerBound); it != end; ++it) {
+            if (isFusionReady(*it)) {
+                bucketOuts.push_back(&*it);
+            }
+        }
+    } else {
+        for (const SpendableOutput *output : pickSpendableOutputs(addresses)) {
+            if (output->out.amount >= lowerBound
+                && output->out.amount < upperBound
+                && isFusionReady(*output)) {
+                bucketOuts.push_back(output);
+            }
         }
     }
 
-    assert(selectedOuts.size() >= minInputCount);
+    assert(bucketOuts.size() >= minInputCount);
 
-    auto outputsSortingFunction = [](const OutputToTransfer& l, const OutputToTransfer& r) {
-        return l.out.amount < r.out.amount;
-    };
-    if (selectedOuts.size() <= maxInputCount) {
-        std::sort(selectedOuts.begin(), selectedOuts.end(), outputsSortingFunction);
-        return selectedOuts;
+    if (bucketOuts.size() > maxInputCount) {
+        ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> generator(bucketOuts.size());
+        std::vector<const SpendableOutput *> trimmedBucketOuts;
+        trimmedBucketOuts.reserve(maxInputCount);
+        for (size_t i = 0; i < maxInputCount; ++i) {
+            trimmedBucketOuts.push_back(bucketOuts[generator()]);
+        }
+
+        bucketOuts.swap(trimmedBucketOuts);
     }
 
-    ShuffleGenerator<size_t, Crypto::RandomEngine<size_t>> generator(selectedOuts.size());
-    std::vector<WalletGreen::OutputToTransfer> trimmedSelectedOuts;
-    trimmedSelectedOuts.reserve(maxInputCount);
-    for (size_t i = 0; i < maxInputCount; ++i) {
-        trimmedSelectedOuts.push_back(std::move(selectedOuts[generator()]));
+    std::vector<WalletGreen::OutputToTransfer> selectedOuts;
+    selectedOuts.reserve(bucketOuts.size());
+    for (const SpendableOutput *output : bucketOuts) {
+        selectedOuts.push_back(makeOutputToTransfer(*output));
     }
 
-    std::sort(trimmedSelectedOuts.begin(), trimmedSelectedOuts.end(), outputsSortingFunction);
+    std::sort(
+        selectedOuts.begin(),
+        selectedOuts.end(),
+        [](const OutputToTransfer &l, const OutputToTransfer &r) {
+        return l.out.amount < r.out.amount;
+    });
 
-    return trimmedSelectedOuts;
+    return selectedOuts;
 }
 
 std::vector<TransactionsInBlockInfo> WalletGreen::getTransactionsInBlocks(
@@ -4255,14 +4718,7 @@ std::vector<WalletTransfer> WalletGreen::getTransactionTransfers(
     size_t transactionId = std::distance(transactionIdIndex.begin(), it);
     auto bounds = getTransactionTransfersRange(transactionId);
 
-    std::vector<WalletTransfer> result;
-    result.reserve(std::distance(bounds.first, bounds.second));
-
-    for (auto i = bounds.first; i != bounds.second; ++i) {
-        result.emplace_back(i->second);
-    }
-
-    return result;
+    return std::vector<WalletTransfer>(bounds.first, bounds.second);
 }
 
 void WalletGreen::filterOutTransactions(
@@ -4276,22 +4732,17 @@ void WalletGreen::filterOutTransactions(
     transfers.reserve(m_transfers.size());
 
     auto &index = m_transactions.get<RandomAccessIndex>();
-    size_t transferIdx = 0;
     for (size_t i = 0; i < m_transactions.size(); ++i) {
         const WalletTransaction& transaction = index[i];
 
         if (pred(transaction)) {
             ++cancelledTransactions;
-
-            while (transferIdx < m_transfers.size() && m_transfers[transferIdx].first == i) {
-                ++transferIdx;
-            }
         } else {
             transactions.emplace_back(transaction);
 
-            while (transferIdx < m_transfers.size() && m_transfers[transferIdx].first == i) {
-                transfers.emplace_back(i - cancelledTransactions, m_transfers[transferIdx].second);
-                ++transferIdx;
+            auto range = m_transfers.getTransfers(i);
+            for (auto it = range.first; it != range.second; ++it) {
+                transfers.push_back(i - cancelledTransactions, *it);
             }
         }
     }
@@ -4338,6 +4789,7 @@ void WalletGreen::deleteContainerFromUnlockTransactionJobs(const ITransfersConta
 {
     for (auto it = m_unlockTransactionsJob.begin(); it != m_unlockTransactionsJob.end();) {
         if (it->container == container) {
+            m_journalUnlockJobs.insert(it->transactionHash);
             it = m_unlockTransactionsJob.erase(it);
         } else {
             ++it;
@@ -4351,89 +4803,73 @@ std::vector<size_t> WalletGreen::deleteTransfersForAddress(
 {
     assert(!address.empty());
 
-    int64_t deletedInputs = 0;
-    int64_t deletedOutputs = 0;
+    std::vector<size_t> updatedTransactions;
 
-    int64_t unknownInputs = 0;
+    for (size_t transactionId = 0; transactionId < m_transfers.transactionCount(); ++transactionId) {
+        int64_t deletedInputs = 0;
+        int64_t deletedOutputs = 0;
 
-    bool transfersLeft = false;
-    size_t firstTransactionTransfer = 0;
+        int64_t unknownInputs = 0;
 
-    std::vector<size_t> updatedTransactions;
+        bool transfersLeft = false;
+
+        auto range = m_transfers.getTransfers(transactionId);
+        if (range.first == range.second) {
+            continue;
+        }
 
-    for (size_t i = 0; i < m_transfers.size(); ++i) {
-        WalletTransfer &transfer = m_transfers[i].second;
+        for (auto it = range.first; it != range.second; ++it) {
+            WalletTransfer &transfer = *it;
 
-        if (transfer.address == address) {
-            if (transfer.amount >= 0) {
-                deletedOutputs += transfer.amount;
-            } else {
-                deletedInputs += transfer.amount;
-                transfer.address = "";
-            }
-        } else if (transfer.address.empty()) {
-            if (transfer.amount < 0) {
-                unknownInputs += transfer.amount;
+            if (transfer.address == address) {
+                if (transfer.amount >= 0) {
+                    deletedOutputs += transfer.amount;
+                } else {
+                    deletedInputs += transfer.amount;
+                    transfer.address = "";
+                }
+            } else if (transfer.address.empty()) {
+                if (transfer.amount < 0) {
+                    unknownInputs += transfer.amount;
+                }
+            } else if (isMyAddress(transfer.address)) {
+                transfersLeft = true;
             }
-        } else if (isMyAddress(transfer.address)) {
-            transfersLeft = true;
         }
 
-        size_t transactionId = m_transfers[i].first;
-        if ((i == m_transfers.size() - 1) || (transactionId != m_transfers[i + 1].first)) {
-            // the last transfer for current transaction
-
-            size_t transfersBeforeMerge = m_transfers.size();
-            if (deletedInputs != 0) {
-                adjustTransfer(
-                    transactionId,
-                    firstTransactionTransfer,
-                    "",
-                    deletedInputs + unknownInputs
-                );
-            }
+        if (deletedInputs != 0) {
+            adjustTransfer(transactionId, "", deletedInputs + unknownInputs);
+        }
 
-            assert(transfersBeforeMerge >= m_transfers.size());
-
-            i -= transfersBeforeMerge - m_transfers.size();
-
-            auto &randomIndex = m_transactions.get<RandomAccessIndex>();
-
-            randomIndex.modify(
-                std::next(randomIndex.begin(), transactionId),
-                [
-                    this,
-                    transactionId,
-                    transfersLeft,
-                    deletedInputs,
-                    deletedOutputs
-                ](WalletTransaction &transaction) {
-                transaction.totalAmount -= deletedInputs + deletedOutputs;
-
-                if (!transfersLeft) {
-                    transaction.state = WalletTransactionState::DELETED;
-                    transaction.blockHeight = WALLET_UNCONFIRMED_TRANSACTION_HEIGHT;
-                    m_logger(DEBUGGING)
-                        << "Transaction state changed, ID " << transactionId
-                        << ", hash " << transaction.hash
-                        << ", new state " << transaction.state;
-                }
-            });
+        auto &randomIndex = m_transactions.get<RandomAccessIndex>();
+
+        randomIndex.modify(
+            std::next(randomIndex.begin(), transactionId),
+            [
+                this,
+                transactionId,
+                transfersLeft,
+                deletedInputs,
+                deletedOutputs
+            ](WalletTransaction &transaction) {
+            transaction.totalAmount -= deletedInputs + deletedOutputs;
 
             if (!transfersLeft) {
-                deletedTransactions.push_back(transactionId);
+                transaction.state = WalletTransactionState::DELETED;
+                transaction.blockHeight = WALLET_UNCONFIRMED_TRANSACTION_HEIGHT;
+                m_logger(DEBUGGING)
+                    << "Transaction state changed, ID " << transactionId
+                    << ", hash " << transaction.hash
+                    << ", new state " << transaction.state;
             }
+        });
 
-            if (deletedInputs != 0 || deletedOutputs != 0) {
-                updatedTransactions.push_back(transactionId);
-            }
+        if (!transfersLeft) {
+            deletedTransactions.push_back(transactionId);
+        }
 
-            // reset values for next transaction
-            deletedInputs = 0;
-            deletedOutputs = 0;
-            unknownInputs = 0;
-            transfersLeft = false;
-            firstTransactionTransfer = i + 1;
+        if (deletedInputs != 0 || deletedOutputs != 0) {
+            updatedTransactions.push_back(transactionId);
         }
     }
 
@@ -4444,6 +4880,7 @@ void WalletGreen::deleteFromUncommitedTransactions(const std::vector<size_t> &de
 {
     for (auto transactionId : deletedTransactions) {
         m_uncommitedTransactions.erase(transactionId);
+        m_journalUncommitedTransactions.insert(transactionId);
     }
 }
 
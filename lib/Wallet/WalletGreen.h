@@ -20,8 +20,13 @@
 
 #pragma once
 
+#include <array>
+#include <limits>
+#include <map>
 #include <queue>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <Global/CryptoNoteConfig.h>
 #include <Logging/LoggerRef.h>
 #include <System/Dispatcher.h>
@@ -31,6 +36,7 @@
 #include <Wallet/IFusionManager.h>
 #include <Wallet/IWallet.h>
 #include <Wallet/WalletIndices.h>
+#include <Wallet/WalletJournal.h>
 
 namespace CryptoNote {
 
@@ -214,16 +220,7 @@ protected:
         std::vector<uint64_t> amounts;
     };
 
-    struct WalletOuts
-    {
-        WalletRecord *wallet;
-        std::vector<TransactionOutputInformation> outs;
-    };
-
-    typedef std::pair<
-        WalletTransfers::const_iterator,
-        WalletTransfers::const_iterator
-    > TransfersRange;
+    typedef WalletTransfers::ConstRange TransfersRange;
 
     struct AddressAmounts
     {
@@ -266,6 +263,9 @@ protected:
         const Crypto::Hash &transactionHash) override;
     void transactionDeleted(ITransfersSubscription *object, const Crypto::Hash &transactionHash);
 
+    void onTransfersLocked(ITransfersSubscription *object) override;
+    void transfersLocked(ITransfersSubscription *object);
+
     void synchronizationProgressUpdated(
         uint32_t processedBlockCount,
         uint32_t totalBlockCount) override;
@@ -292,9 +292,25 @@ protected:
         Crypto::Hash transactionHash) override;
     void transactionDeleteEnd(Crypto::Hash transactionHash);
 
-    std::vector<WalletOuts> pickWalletsWithMoney() const;
-    WalletOuts pickWallet(const std::string &address) const;
-    std::vector<WalletOuts> pickWallets(const std::vector<std::string> &addresses) const;
+    std::vector<const SpendableOutput *> pickSpendableOutputs(
+        const std::vector<std::string> &addresses) const;
+    void refreshSpendableOutputs() const;
+    void rebuildSpendableOutputs(ITransfersContainer *container) const;
+    bool updateSpendableOutputs(ITransfersContainer *container, const Crypto::Hash &transactionHash) const;
+    void scheduleSpendableUnlock(ITransfersContainer *container,
+                                 const Crypto::Hash &transactionHash,
+                                 bool safe) const;
+    void deleteSpendableUnlockJobs(ITransfersContainer *container) const;
+    void unlockSpendableOutputs(uint32_t height) const;
+    uint32_t getUnlockHeight(uint32_t blockHeight, uint64_t unlockTime, bool safe) const;
+    bool isSafeTransaction(const ITransfersContainer *container,
+                           const Crypto::Hash &transactionHash) const;
+    void removeSpendableOutputs(const std::vector<OutputToTransfer> &spentOutputs);
+    OutputToTransfer makeOutputToTransfer(const SpendableOutput &output) const;
+    size_t getFusionBucketSizes(
+        const std::vector<std::string> &addresses,
+        uint64_t threshold,
+        std::array<size_t, std::numeric_limits<uint64_t>::digits10 + 1> &bucketSizes) const;
 
     void updateBalance(CryptoNote::ITransfersContainer *container);
     void unlockBalances(uint32_t height);
@@ -317,12 +333,13 @@ protected:
     {
         std::unique_ptr<ITransaction> transaction;
         std::vector<WalletTransfer> destinations;
+        std::vector<OutputToTransfer> selectedTransfers;
         uint64_t neededMoney;
         uint64_t changeAmount;
     };
 
     void prepareTransaction(
-        std::vector<WalletOuts> &&wallets,
+        const std::vector<std::string> &sourceAddresses,
         const std::vector<WalletOrder> &orders,
         uint64_t fee,
         uint64_t mixIn,
@@ -376,7 +393,7 @@ protected:
         uint64_t needeMoney,
         bool dust,
         uint64_t dustThreshold,
-        std::vector<WalletOuts> &&wallets,
+        const std::vector<std::string> &sourceAddresses,
         std::vector<OutputToTransfer> &selectedTransfers);
 
     std::vector<ReceiverAmounts> splitDestinations(
@@ -419,16 +436,14 @@ protected:
         const std::vector<ContainerAmounts> &containerAmountsList,
         int64_t allInputsAmount,
         int64_t allOutputsAmount);
-    TransfersMap getKnownTransfersMap(size_t transactionId, size_t firstTransferIdx) const;
+    TransfersMap getKnownTransfersMap(size_t transactionId) const;
     bool updateAddressTransfers(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::string &address,
         int64_t knownAmount,
         int64_t targetAmount);
     bool updateUnknownTransfers(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::unordered_set<std::string> &myAddresses,
         int64_t knownAmount,
         int64_t myAmount,
@@ -436,26 +451,21 @@ protected:
         bool isOutput);
     void appendTransfer(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::string &address,
         int64_t amount);
     bool adjustTransfer(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::string &address,
         int64_t amount);
     bool eraseTransfers(
         size_t transactionId,
-        size_t firstTransferIdx,
         std::function<bool(bool, const std::string &)> &&predicate);
     bool eraseTransfersByAddress(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::string &address,
         bool eraseOutputTransfers);
     bool eraseForeignTransfers(
         size_t transactionId,
-        size_t firstTransferIdx,
         const std::unordered_set<std::string> &knownAddresses,
         bool eraseOutputTransfers);
     void pushBackOutgoingTransfers(size_t txId, const std::vector<WalletTransfer> &destinations);
@@ -500,7 +510,14 @@ protected:
         ContainerStorage &storage,
         const Crypto::chacha8_key &key,
         WalletSaveLevel saveLevel,
-        const std::string &extra);
+        const std::string &extra,
+        const std::string &transfersSynchronizerState);
+    std::string getTransfersSynchronizerState();
+    void compactContainer(WalletSaveLevel saveLevel, const std::string &extra);
+    void appendToJournal(const std::string &extra);
+    void clearJournalChanges();
+    void loadJournal(const std::string &baseTransfersSynchronizerState, std::string &extra);
+    static Crypto::chacha8_iv getContainerDataIv(ContainerStorage &storage);
     void subscribeWallets();
 
     std::vector<OutputToTransfer> pickRandomFusionInputs(
@@ -561,10 +578,27 @@ private:
     ContainerStorage m_containerStorage;
     UnlockTransactionJobs m_unlockTransactionsJob;
     WalletTransactions m_transactions;
-    WalletTransfers m_transfers; // sorted
+    WalletTransfers m_transfers;
+    mutable SpendableOutputs m_spendableOutputs;
+    mutable std::unordered_set<ITransfersContainer *> m_staleSpendableContainers;
+    // transactions with locked outputs, by the height or the time their containers unlock them
+    mutable SpendableUnlockJobs m_spendableUnlocksByHeight;
+    mutable SpendableUnlockJobs m_spendableUnlocksByTime;
+    // containers that gained spendable outputs since their balance was updated
+    mutable std::unordered_set<ITransfersContainer *> m_unlockedSpendableContainers;
     mutable std::unordered_map<size_t, bool> m_fusionTxsCache; // txIndex -> isFusion
     UncommitedTransactions m_uncommitedTransactions;
 
+    WalletJournal m_journal;
+    WalletChunkStore m_journalChunks;
+    // records changed since the last save
+    std::set<size_t> m_journalTransactions;
+    std::unordered_set<Crypto::PublicKey> m_journalWallets;
+    std::unordered_set<Crypto::Hash> m_journalUnlockJobs;
+    std::set<size_t> m_journalUncommitedTransactions;
+    bool m_journalSynchronizerStateChanged;
+    bool m_journalCompactionRequired;
+
     bool m_blockchainSynchronizerStarted;
     BlockchainSynchronizer m_blockchainSynchronizer;
     TransfersSynchronizer m_synchronizer;
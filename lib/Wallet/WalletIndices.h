@@ -24,12 +24,15 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/random_access_index.hpp>
+#include <boost/multi_index/ranked_index.hpp>
+#include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/member.hpp>
 #include <Common/FileMappedVector.h>
 #include <crypto/chacha8.h>
 #include <Wallet/IWallet.h>
+#include <Wallet/WalletTransfers.h>
 #include <ITransfersContainer.h>
 
 namespace CryptoNote {
@@ -67,6 +70,9 @@ struct TransactionHashIndex {};
 struct TransactionIndex {};
 struct BlockHashIndex {};
 
+struct SpendableAmountIndex {};
+struct UnlockIndex {};
+
 typedef boost::multi_index_container <
     WalletRecord,
     boost::multi_index::indexed_by <
@@ -130,9 +136,66 @@ typedef boost::multi_index_container <
     >
 > WalletTransactions;
 
+// Unlocked key output of one of the container wallets, ready to be used as a transaction input
+struct SpendableOutput
+{
+    CryptoNote::ITransfersContainer *container;
+    CryptoNote::TransactionOutputInformation out;
+
+    uint64_t getAmount() const { return out.amount; }
+    const Crypto::Hash &getTransactionHash() const { return out.transactionHash; }
+    uint32_t getOutputInTransaction() const { return out.outputInTransaction; }
+};
+
+typedef boost::multi_index_container <
+    SpendableOutput,
+    boost::multi_index::indexed_by <
+        boost::multi_index::ranked_non_unique <
+            boost::multi_index::tag <SpendableAmountIndex>,
+            BOOST_MULTI_INDEX_CONST_MEM_FUN(SpendableOutput, uint64_t, getAmount)
+        >,
+        boost::multi_index::hashed_unique <
+            boost::multi_index::tag <TransactionOutputIndex>,
+            boost::multi_index::composite_key <
+                SpendableOutput,
+                BOOST_MULTI_INDEX_CONST_MEM_FUN(
+                    SpendableOutput,
+                    const Crypto::Hash &,
+                    getTransactionHash
+                ),
+                BOOST_MULTI_INDEX_CONST_MEM_FUN(SpendableOutput, uint32_t, getOutputInTransaction)
+            >
+        >,
+        boost::multi_index::hashed_non_unique <
+            boost::multi_index::tag <TransfersContainerIndex>,
+            BOOST_MULTI_INDEX_MEMBER(SpendableOutput, CryptoNote::ITransfersContainer *, container)
+        >
+    >
+> SpendableOutputs;
+
+// Transaction with locked outputs, unlocked at a block height or a time depending on the queue
+struct SpendableUnlockJob
+{
+    uint64_t unlockAt;
+    CryptoNote::ITransfersContainer *container;
+    Crypto::Hash transactionHash;
+};
+
+typedef boost::multi_index_container <
+    SpendableUnlockJob,
+    boost::multi_index::indexed_by <
+        boost::multi_index::ordered_non_unique <
+            boost::multi_index::tag <UnlockIndex>,
+            BOOST_MULTI_INDEX_MEMBER(SpendableUnlockJob, uint64_t, unlockAt)
+        >,
+        boost::multi_index::hashed_non_unique <
+            boost::multi_index::tag <TransfersContainerIndex>,
+            BOOST_MULTI_INDEX_MEMBER(SpendableUnlockJob, CryptoNote::ITransfersContainer *, container)
+        >
+    >
+> SpendableUnlockJobs;
+
 typedef Common::FileMappedVector<EncryptedWalletRecord> ContainerStorage;
-typedef std::pair<size_t, CryptoNote::WalletTransfer> TransactionTransferPair;
-typedef std::vector<TransactionTransferPair> WalletTransfers;
 typedef std::map<size_t, CryptoNote::Transaction> UncommitedTransactions;
 
 typedef boost::multi_index_container<
@@ -0,0 +1,367 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <boost/filesystem/operations.hpp>
+#include <Common/MemoryInputStream.h>
+#include <Common/StringOutputStream.h>
+#include <crypto/Crypto.h>
+#include <crypto/hash.h>
+#include <CryptoNoteCore/CryptoNoteSerialization.h>
+#include <Serialization/BinaryInputStreamSerializer.h>
+#include <Serialization/BinaryOutputStreamSerializer.h>
+#include <Wallet/WalletJournal.h>
+
+namespace CryptoNote {
+
+namespace {
+
+const uint8_t JOURNAL_VERSION = 2;
+
+const size_t MIN_CHUNK_SIZE = 2 * 1024;
+const size_t MAX_CHUNK_SIZE = 64 * 1024;
+// 13 bits give chunks of about 8 KiB past the minimum size
+const uint64_t CHUNK_BOUNDARY_MASK = 0xfff8000000000000;
+
+// Chunk boundaries depend on this table, so it must never change
+const std::array<uint64_t, 256> &gearTable()
+{
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> result;
+        uint64_t state = 0;
+        for (auto &value : result) {
+            // splitmix64
+            state += 0x9e3779b97f4a7c15;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            value = z ^ (z >> 31);
+        }
+
+        return result;
+    }();
+
+    return table;
+}
+
+template<typename F>
+void forEachChunk(const std::string &data, F &&f)
+{
+    const auto &table = gearTable();
+
+    size_t start = 0;
+    uint64_t fingerprint = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        fingerprint = (fingerprint << 1) + table[static_cast<uint8_t>(data[i])];
+
+        size_t size = i + 1 - start;
+        if ((size >= MIN_CHUNK_SIZE && (fingerprint & CHUNK_BOUNDARY_MASK) == 0)
+            || size >= MAX_CHUNK_SIZE) {
+            f(data.data() + start, size);
+            start = i + 1;
+            fingerprint = 0;
+        }
+    }
+
+    if (start < data.size()) {
+        f(data.data() + start, data.size() - start);
+    }
+}
+
+} // namespace
+
+WalletJournal::WalletJournal()
+    : m_file(nullptr),
+      m_size(0),
+      m_chunkCount(0)
+{
+}
+
+WalletJournal::~WalletJournal()
+{
+    close();
+}
+
+bool WalletJournal::open(const std::string &path,
+                         const Crypto::chacha8_iv &baseIv,
+                         const Crypto::chacha8_key &key,
+                         std::vector<BinaryArray> &chunks)
+{
+    close();
+
+    std::ifstream input(path, std::ios_base::binary);
+    if (!input) {
+        return false;
+    }
+
+    std::string contents{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    input.close();
+
+    Common::MemoryInputStream stream(contents.data(), contents.size());
+    BinaryInputStreamSerializer s(stream);
+
+    try {
+        uint8_t version = 0;
+        Crypto::chacha8_iv iv;
+        s(version, "version");
+        s(iv, "baseIv");
+
+        if (version != JOURNAL_VERSION || std::memcmp(&iv, &baseIv, sizeof(iv)) != 0) {
+            return false;
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    size_t validSize = stream.getPosition();
+    size_t chunkCount = 0;
+    while (!stream.endOfStream()) {
+        Crypto::chacha8_iv chunkIv;
+        std::string encryptedChunk;
+        Crypto::Hash checksum;
+
+        try {
+            s(chunkIv, "iv");
+            s(encryptedChunk, "chunk");
+            s(checksum, "checksum");
+        } catch (const std::exception &) {
+            break;
+        }
+
+        if (Crypto::cn_fast_hash(encryptedChunk.data(), encryptedChunk.size()) != checksum) {
+            break;
+        }
+
+        BinaryArray chunk(encryptedChunk.size());
+        Crypto::chacha8(
+            encryptedChunk.data(),
+            encryptedChunk.size(),
+            key,
+            chunkIv,
+            reinterpret_cast<char *>(chunk.data())
+        );
+        chunks.push_back(std::move(chunk));
+
+        validSize = stream.getPosition();
+        ++chunkCount;
+    }
+
+    // drop the chunk torn by an interrupted append
+    if (validSize < contents.size()) {
+        boost::filesystem::resize_file(path, validSize);
+    }
+
+    m_file = std::fopen(path.c_str(), "ab");
+    if (m_file == nullptr) {
+        throw std::runtime_error("Failed to open wallet journal " + path);
+    }
+
+    m_size = validSize;
+    m_chunkCount = chunkCount;
+
+    return true;
+}
+
+void WalletJournal::create(const std::string &path, const Crypto::chacha8_iv &baseIv)
+{
+    close();
+
+    std::string header;
+    Common::StringOutputStream headerStream(header);
+    BinaryOutputStreamSerializer s(headerStream);
+    s(const_cast<uint8_t &>(JOURNAL_VERSION), "version");
+    s(const_cast<Crypto::chacha8_iv &>(baseIv), "baseIv");
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (m_file == nullptr || !write(header)) {
+        close();
+        throw std::runtime_error("Failed to create wallet journal " + path);
+    }
+
+    m_size = header.size();
+}
+
+void WalletJournal::append(const Crypto::chacha8_key &key, const std::string &data)
+{
+    if (!isOpened()) {
+        throw std::runtime_error("Wallet journal is not opened");
+    }
+
+    Crypto::chacha8_iv chunkIv = Crypto::rand<Crypto::chacha8_iv>();
+    std::string encryptedChunk(data.size(), '\0');
+    Crypto::chacha8(data.data(), data.size(), key, chunkIv, &encryptedChunk[0]);
+    Crypto::Hash checksum = Crypto::cn_fast_hash(encryptedChunk.data(), encryptedChunk.size());
+
+    std::string record;
+    Common::StringOutputStream recordStream(record);
+    BinaryOutputStreamSerializer s(recordStream);
+    s(chunkIv, "iv");
+    s(encryptedChunk, "chunk");
+    s(checksum, "checksum");
+
+    if (!write(record)) {
+        // whatever follows a partially written chunk would be unreadable
+        close();
+        throw std::runtime_error("Failed to append to wallet journal");
+    }
+
+    m_size += record.size();
+    ++m_chunkCount;
+}
+
+void WalletJournal::close()
+{
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    m_size = 0;
+    m_chunkCount = 0;
+}
+
+// Writes data and syncs it to the disk
+bool WalletJournal::write(const std::string &data)
+{
+    if (std::fwrite(data.data(), 1, data.size(), m_file) != data.size()
+        || std::fflush(m_file) != 0) {
+        return false;
+    }
+
+#ifdef _WIN32
+    return _commit(_fileno(m_file)) == 0;
+#else
+    return fsync(fileno(m_file)) == 0;
+#endif
+}
+
+void WalletJournal::remove(const std::string &path)
+{
+    boost::system::error_code ignore;
+    boost::filesystem::remove(path, ignore);
+}
+
+void WalletChunkStore::clear()
+{
+    m_knownChunks.clear();
+    m_decodedChunks.clear();
+}
+
+void WalletChunkStore::add(const std::string &data)
+{
+    forEachChunk(data, [this](const char *chunk, size_t size) {
+        m_knownChunks.insert(Crypto::cn_fast_hash(chunk, size));
+    });
+}
+
+std::string WalletChunkStore::encode(const std::string &data,
+                                     std::vector<Crypto::Hash> &newChunks) const
+{
+    newChunks.clear();
+    std::unordered_set<Crypto::Hash> encodedChunks;
+    std::vector<std::pair<Crypto::Hash, std::string>> chunks;
+    forEachChunk(data, [this, &newChunks, &encodedChunks, &chunks](const char *chunk, size_t size) {
+        Crypto::Hash hash = Crypto::cn_fast_hash(chunk, size);
+        if (m_knownChunks.count(hash) == 0 && encodedChunks.insert(hash).second) {
+            newChunks.push_back(hash);
+            chunks.emplace_back(hash, std::string(chunk, size));
+        } else {
+            chunks.emplace_back(hash, std::string());
+        }
+    });
+
+    std::string encoded;
+    Common::StringOutputStream stream(encoded);
+    BinaryOutputStreamSerializer s(stream);
+
+    uint64_t chunkCount = chunks.size();
+    s(chunkCount, "chunkCount");
+    for (auto &chunk : chunks) {
+        // chunks are never empty, an empty one refers to a chunk encoded before
+        s(chunk.first, "hash");
+        s(chunk.second, "data");
+    }
+
+    return encoded;
+}
+
+void WalletChunkStore::commit(const std::vector<Crypto::Hash> &chunks)
+{
+    m_knownChunks.insert(chunks.begin(), chunks.end());
+}
+
+void WalletChunkStore::addDecoded(const std::string &data)
+{
+    forEachChunk(data, [this](const char *chunk, size_t size) {
+        m_decodedChunks.emplace(Crypto::cn_fast_hash(chunk, size), std::string(chunk, size));
+    });
+}
+
+std::string WalletChunkStore::decode(const std::string &encoded)
+{
+    Common::MemoryInputStream stream(encoded.data(), encoded.size());
+    BinaryInputStreamSerializer s(stream);
+
+    uint64_t chunkCount = 0;
+    s(chunkCount, "chunkCount");
+
+    std::string data;
+    for (uint64_t i = 0; i < chunkCount; ++i) {
+        Crypto::Hash hash;
+        std::string chunk;
+        s(hash, "hash");
+        s(chunk, "data");
+
+        if (!chunk.empty()) {
+            data += chunk;
+            m_decodedChunks[hash] = std::move(chunk);
+            continue;
+        }
+
+        auto it = m_decodedChunks.find(hash);
+        if (it == m_decodedChunks.end()) {
+            throw std::runtime_error("Wallet journal refers to an unknown chunk");
+        }
+
+        data += it->second;
+    }
+
+    return data;
+}
+
+void WalletChunkStore::releaseDecodedChunks()
+{
+    for (const auto &chunk : m_decodedChunks) {
+        m_knownChunks.insert(chunk.first);
+    }
+
+    m_decodedChunks.clear();
+}
+
+} // namespace CryptoNote
@@ -0,0 +1,107 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <crypto/chacha8.h>
+#include <crypto/hash.h>
+#include <CryptoNote.h>
+
+namespace CryptoNote {
+
+/*!
+    \class WalletJournal
+    \brief Append-only encrypted journal that extends the cache stored in a wallet container.
+
+    The journal starts with a header binding it to the container cache it extends, identified
+    by the IV the cache was encrypted with. Each appended chunk is encrypted with a fresh IV and
+    carries a checksum, so a chunk torn by an interrupted write is detected and dropped on open.
+    Appends are synced to the disk before they return.
+    Once the container cache is rewritten the journal no longer matches it and is discarded.
+*/
+class WalletJournal
+{
+public:
+    WalletJournal();
+    WalletJournal(const WalletJournal &) = delete;
+    ~WalletJournal();
+
+    WalletJournal &operator=(const WalletJournal &) = delete;
+
+    bool isOpened() const { return m_file != nullptr; }
+    uint64_t size() const { return m_size; }
+    bool empty() const { return m_chunkCount == 0; }
+
+    // Returns false if there is no journal for the cache encrypted with baseIv
+    bool open(
+        const std::string &path,
+        const Crypto::chacha8_iv &baseIv,
+        const Crypto::chacha8_key &key,
+        std::vector<BinaryArray> &chunks);
+    void create(const std::string &path, const Crypto::chacha8_iv &baseIv);
+    void append(const Crypto::chacha8_key &key, const std::string &data);
+    void close();
+
+    static void remove(const std::string &path);
+
+private:
+    bool write(const std::string &data);
+
+    std::FILE *m_file;
+    uint64_t m_size;
+    size_t m_chunkCount;
+};
+
+/*!
+    \class WalletChunkStore
+    \brief Content-defined chunks of large journal records.
+
+    Records that change in place, such as the synchronizer state, are split at positions chosen
+    by a rolling hash of their content, so a local change only affects the chunks around it.
+    An encoded record lists its chunk hashes and carries only the chunks not encoded before.
+*/
+class WalletChunkStore
+{
+public:
+    void clear();
+
+    // Marks the chunks of data as known without keeping them
+    void add(const std::string &data);
+    // The chunks not known yet go to newChunks, they become known with commit() once the
+    // record is written
+    std::string encode(const std::string &data, std::vector<Crypto::Hash> &newChunks) const;
+    void commit(const std::vector<Crypto::Hash> &chunks);
+    // Keeps the chunks of data, so that later records referring to them can be decoded
+    void addDecoded(const std::string &data);
+    std::string decode(const std::string &encoded);
+    void releaseDecodedChunks();
+
+private:
+    std::unordered_set<Crypto::Hash> m_knownChunks;
+    std::unordered_map<Crypto::Hash, std::string> m_decodedChunks;
+};
+
+} // namespace CryptoNote
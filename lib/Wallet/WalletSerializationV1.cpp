@@ -690,13 +690,17 @@ void WalletSerializerV1::updateTransactionsBaseStatus()
 
 void WalletSerializerV1::updateTransfersSign()
 {
-    auto it = m_transfers.begin();
-    while (it != m_transfers.end()) {
-        if (it->second.amount < 0) {
-            it->second.amount = -it->second.amount;
-            ++it;
-        } else {
-            it = m_transfers.erase(it);
+    for (size_t txId = 0; txId < m_transfers.transactionCount(); ++txId) {
+        auto range = m_transfers.getTransfers(txId);
+        auto it = range.first;
+        while (it != range.second) {
+            if (it->amount < 0) {
+                it->amount = -it->amount;
+                ++it;
+            } else {
+                it = m_transfers.erase(txId, it);
+                --range.second;
+            }
         }
     }
 }
@@ -763,7 +767,7 @@ void WalletSerializerV1::loadTransfers(Common::IInputStream &source,
             tr.type = WalletTransferType::USUAL;
         }
 
-        m_transfers.push_back(std::make_pair(txId, tr));
+        m_transfers.push_back(txId, std::move(tr));
     }
 }
 
@@ -786,8 +790,7 @@ void WalletSerializerV1::addWalletV1Details(const std::vector<WalletLegacyTransa
             }
 
             for (; firstTr < lastTr; firstTr++) {
-                WalletTransfer tr = convert(trs[firstTr]);
-                m_transfers.push_back(std::make_pair(txId, tr));
+                m_transfers.push_back(txId, convert(trs[firstTr]));
             }
         }
 
@@ -127,6 +127,51 @@ void serialize(WalletTransferDtoV2 &value, CryptoNote::ISerializer &serializer)
     serializer(value.type, "type");
 }
 
+CryptoNote::WalletTransaction convert(const WalletTransactionDtoV2 &dto)
+{
+    CryptoNote::WalletTransaction tx;
+    tx.state = dto.state;
+    tx.timestamp = dto.timestamp;
+    tx.blockHeight = dto.blockHeight;
+    tx.hash = dto.hash;
+    tx.totalAmount = dto.totalAmount;
+    tx.fee = dto.fee;
+    tx.creationTime = dto.creationTime;
+    tx.unlockTime = dto.unlockTime;
+    tx.extra = dto.extra;
+    tx.isBase = dto.isBase;
+    if (dto.secretKey) {
+        tx.secretKey = reinterpret_cast<const Crypto::SecretKey &>(dto.secretKey.get());
+    }
+
+    return tx;
+}
+
+CryptoNote::WalletTransfer convert(const WalletTransferDtoV2 &dto)
+{
+    CryptoNote::WalletTransfer tr;
+    tr.address = dto.address;
+    tr.amount = dto.amount;
+    tr.type = static_cast<CryptoNote::WalletTransferType>(dto.type);
+
+    return tr;
+}
+
+UnlockTransactionJobDtoV2 convert(const CryptoNote::UnlockTransactionJob &job,
+                                  const CryptoNote::WalletsContainer &walletsContainer)
+{
+    auto &wallets = walletsContainer.get<CryptoNote::TransfersContainerIndex>();
+    auto containerIt = wallets.find(job.container);
+    assert(containerIt != wallets.end());
+
+    UnlockTransactionJobDtoV2 dto;
+    dto.blockHeight = job.blockHeight;
+    dto.transactionHash = job.transactionHash;
+    dto.walletSpendPublicKey = containerIt->spendPublicKey;
+
+    return dto;
+}
+
 } // namespace
 
 namespace CryptoNote {
@@ -207,6 +252,207 @@ void WalletSerializerV2::save(Common::IOutputStream &destination, WalletSaveLeve
     s(m_extra, "extra");
 }
 
+void WalletSerializerV2::saveJournalEntry(Common::IOutputStream &destination,
+                                          const std::vector<size_t> &transactionIds,
+                                          const std::vector<Crypto::PublicKey> &walletKeys,
+                                          const std::vector<Crypto::Hash> &unlockJobTransactions,
+                                          const std::vector<size_t> &uncommitedTransactionIds,
+                                          bool saveExtra,
+                                          const std::string &transfersSynchronizerState)
+{
+    CryptoNote::BinaryOutputStreamSerializer s(destination);
+
+    uint64_t transactionCount = transactionIds.size();
+    s(transactionCount, "transactionCount");
+
+    auto &index = m_transactions.get<RandomAccessIndex>();
+    for (size_t transactionId : transactionIds) {
+        WalletTransactionDtoV2 dto(index[transactionId]);
+        s(dto, "transaction");
+
+        auto range = m_transfers.getTransfers(transactionId);
+        uint64_t transferCount = std::distance(range.first, range.second);
+        s(transferCount, "transferCount");
+
+        for (auto it = range.first; it != range.second; ++it) {
+            WalletTransferDtoV2 tr(*it);
+            s(tr, "transfer");
+        }
+    }
+
+    auto &wallets = m_walletsContainer.get<KeysIndex>();
+    uint64_t walletCount = walletKeys.size();
+    s(walletCount, "walletCount");
+    for (const auto &spendPublicKey : walletKeys) {
+        auto it = wallets.find(spendPublicKey);
+        assert(it != wallets.end());
+
+        s(const_cast<Crypto::PublicKey &>(spendPublicKey), "spendPublicKey");
+        s(const_cast<uint64_t &>(it->actualBalance), "actualBalance");
+        s(const_cast<uint64_t &>(it->pendingBalance), "pendingBalance");
+    }
+
+    s(const_cast<std::string &>(transfersSynchronizerState), "transfersSynchronizer");
+
+    // every unlock job of a listed transaction, none if they are all gone
+    auto &jobs = m_unlockTransactions.get<TransactionHashIndex>();
+    uint64_t jobTransactionCount = unlockJobTransactions.size();
+    s(jobTransactionCount, "unlockTransactionsCount");
+    for (const auto &transactionHash : unlockJobTransactions) {
+        s(const_cast<Crypto::Hash &>(transactionHash), "transactionHash");
+
+        auto range = jobs.equal_range(transactionHash);
+        uint64_t jobsCount = std::distance(range.first, range.second);
+        s(jobsCount, "unlockTransactionsJobsCount");
+        for (auto it = range.first; it != range.second; ++it) {
+            UnlockTransactionJobDtoV2 dto = convert(*it, m_walletsContainer);
+            s(dto, "unlockTransactionsJob");
+        }
+    }
+
+    // a listed transaction that is not stored any more has been committed or deleted
+    uint64_t uncommitedCount = uncommitedTransactionIds.size();
+    s(uncommitedCount, "uncommitedTransactionsCount");
+    for (size_t transactionId : uncommitedTransactionIds) {
+        uint64_t id = transactionId;
+        s(id, "transactionId");
+
+        auto it = m_uncommitedTransactions.find(transactionId);
+        bool stored = it != m_uncommitedTransactions.end();
+        s(stored, "stored");
+        if (stored) {
+            s(it->second, "transaction");
+        }
+    }
+
+    s(saveExtra, "hasExtra");
+    if (saveExtra) {
+        s(m_extra, "extra");
+    }
+}
+
+void WalletSerializerV2::loadJournalEntry(Common::IInputStream &source,
+                                          std::string &transfersSynchronizerState)
+{
+    CryptoNote::BinaryInputStreamSerializer s(source);
+
+    uint64_t transactionCount = 0;
+    s(transactionCount, "transactionCount");
+
+    auto &index = m_transactions.get<RandomAccessIndex>();
+    auto &hashIndex = m_transactions.get<TransactionIndex>();
+    for (uint64_t i = 0; i < transactionCount; ++i) {
+        WalletTransactionDtoV2 dto;
+        s(dto, "transaction");
+
+        // Entries don't carry transaction ids. The cache only appends transactions and entries
+        // list them in id order, so an unknown hash takes the next id and a known one is updated.
+        size_t transactionId;
+        auto it = hashIndex.find(dto.hash);
+        if (it == hashIndex.end()) {
+            transactionId = index.size();
+            index.push_back(convert(dto));
+        } else {
+            auto indexIt = m_transactions.project<RandomAccessIndex>(it);
+            transactionId = static_cast<size_t>(std::distance(index.begin(), indexIt));
+            hashIndex.replace(it, convert(dto));
+        }
+
+        auto range = m_transfers.getTransfers(transactionId);
+        while (range.first != range.second) {
+            m_transfers.erase(transactionId, --range.second);
+        }
+
+        uint64_t transferCount = 0;
+        s(transferCount, "transferCount");
+
+        for (uint64_t j = 0; j < transferCount; ++j) {
+            WalletTransferDtoV2 tr;
+            s(tr, "transfer");
+
+            m_transfers.push_back(transactionId, convert(tr));
+        }
+    }
+
+    auto &wallets = m_walletsContainer.get<KeysIndex>();
+    uint64_t walletCount = 0;
+    s(walletCount, "walletCount");
+    for (uint64_t i = 0; i < walletCount; ++i) {
+        Crypto::PublicKey spendPublicKey;
+        uint64_t actualBalance;
+        uint64_t pendingBalance;
+        s(spendPublicKey, "spendPublicKey");
+        s(actualBalance, "actualBalance");
+        s(pendingBalance, "pendingBalance");
+
+        auto it = wallets.find(spendPublicKey);
+        if (it != wallets.end()) {
+            m_actualBalance += actualBalance - it->actualBalance;
+            m_pendingBalance += pendingBalance - it->pendingBalance;
+
+            wallets.modify(it, [actualBalance, pendingBalance](WalletRecord &wallet) {
+                wallet.actualBalance = actualBalance;
+                wallet.pendingBalance = pendingBalance;
+            });
+        }
+    }
+
+    s(transfersSynchronizerState, "transfersSynchronizer");
+
+    auto &jobs = m_unlockTransactions.get<TransactionHashIndex>();
+    uint64_t jobTransactionCount = 0;
+    s(jobTransactionCount, "unlockTransactionsCount");
+    for (uint64_t i = 0; i < jobTransactionCount; ++i) {
+        Crypto::Hash transactionHash;
+        s(transactionHash, "transactionHash");
+        jobs.erase(transactionHash);
+
+        uint64_t jobsCount = 0;
+        s(jobsCount, "unlockTransactionsJobsCount");
+        for (uint64_t j = 0; j < jobsCount; ++j) {
+            UnlockTransactionJobDtoV2 dto;
+            s(dto, "unlockTransactionsJob");
+
+            auto walletIt = wallets.find(dto.walletSpendPublicKey);
+            if (walletIt != wallets.end()) {
+                jobs.insert({ dto.blockHeight, walletIt->container, dto.transactionHash });
+            }
+        }
+    }
+
+    uint64_t uncommitedCount = 0;
+    s(uncommitedCount, "uncommitedTransactionsCount");
+    for (uint64_t i = 0; i < uncommitedCount; ++i) {
+        uint64_t id = 0;
+        bool stored = false;
+        s(id, "transactionId");
+        s(stored, "stored");
+
+        size_t transactionId = static_cast<size_t>(id);
+        if (stored) {
+            s(m_uncommitedTransactions[transactionId], "transaction");
+        } else {
+            m_uncommitedTransactions.erase(transactionId);
+        }
+    }
+
+    bool hasExtra = false;
+    s(hasExtra, "hasExtra");
+    if (hasExtra) {
+        s(m_extra, "extra");
+    }
+}
+
+void WalletSerializerV2::setTransfersSynchronizerState(const std::string &state)
+{
+    m_transfersSynchronizerState = state;
+}
+
+const std::string &WalletSerializerV2::transfersSynchronizerState() const
+{
+    return m_transfersSynchronizerState;
+}
+
 std::unordered_set<Crypto::PublicKey> &WalletSerializerV2::addedKeys()
 {
     return m_addedKeys;
@@ -287,22 +533,7 @@ void WalletSerializerV2::loadTransactions(CryptoNote::ISerializer &serializer)
         WalletTransactionDtoV2 dto;
         serializer(dto, "transaction");
 
-        WalletTransaction tx;
-        tx.state = dto.state;
-        tx.timestamp = dto.timestamp;
-        tx.blockHeight = dto.blockHeight;
-        tx.hash = dto.hash;
-        tx.totalAmount = dto.totalAmount;
-        tx.fee = dto.fee;
-        tx.creationTime = dto.creationTime;
-        tx.unlockTime = dto.unlockTime;
-        tx.extra = dto.extra;
-        tx.isBase = dto.isBase;
-        if (dto.secretKey) {
-            tx.secretKey = reinterpret_cast<const Crypto::SecretKey &>(dto.secretKey.get());
-        }
-
-        m_transactions.get<RandomAccessIndex>().emplace_back(std::move(tx));
+        m_transactions.get<RandomAccessIndex>().emplace_back(convert(dto));
     }
 }
 
@@ -331,14 +562,7 @@ void WalletSerializerV2::loadTransfers(CryptoNote::ISerializer &serializer)
         WalletTransferDtoV2 dto;
         serializer(dto, "transfer");
 
-        WalletTransfer tr;
-        tr.address = dto.address;
-        tr.amount = dto.amount;
-        tr.type = static_cast<WalletTransferType>(dto.type);
-
-        m_transfers.emplace_back(std::piecewise_construct,
-                                 std::forward_as_tuple(txId),
-                                 std::forward_as_tuple(std::move(tr)));
+        m_transfers.push_back(static_cast<size_t>(txId), convert(dto));
     }
 }
 
@@ -347,14 +571,14 @@ void WalletSerializerV2::saveTransfers(CryptoNote::ISerializer &serializer)
     uint64_t count = m_transfers.size();
     serializer(count, "transferCount");
 
-    for (const auto &kv : m_transfers) {
-        uint64_t txId = kv.first;
+    m_transfers.forEach([&serializer](size_t transactionId, const WalletTransfer &transfer) {
+        uint64_t txId = transactionId;
 
-        WalletTransferDtoV2 tr(kv.second);
+        WalletTransferDtoV2 tr(transfer);
 
         serializer(txId, "transactionId");
         serializer(tr, "transfer");
-    }
+    });
 }
 
 void WalletSerializerV2::loadTransfersSynchronizer(CryptoNote::ISerializer &serializer)
@@ -364,10 +588,17 @@ void WalletSerializerV2::loadTransfersSynchronizer(CryptoNote::ISerializer &seri
 
     std::stringstream stream(transfersSynchronizerData);
     m_synchronizer.load(stream);
+
+    m_transfersSynchronizerState = std::move(transfersSynchronizerData);
 }
 
 void WalletSerializerV2::saveTransfersSynchronizer(CryptoNote::ISerializer &serializer)
 {
+    if (!m_transfersSynchronizerState.empty()) {
+        serializer(m_transfersSynchronizerState, "transfersSynchronizer");
+        return;
+    }
+
     std::stringstream stream;
     m_synchronizer.save(stream);
     stream.flush();
@@ -403,23 +634,12 @@ void WalletSerializerV2::loadUnlockTransactionsJobs(CryptoNote::ISerializer &ser
 void WalletSerializerV2::saveUnlockTransactionsJobs(CryptoNote::ISerializer &serializer)
 {
     auto &index = m_unlockTransactions.get<TransactionHashIndex>();
-    auto &wallets = m_walletsContainer.get<TransfersContainerIndex>();
 
     uint64_t jobsCount = index.size();
     serializer(jobsCount, "unlockTransactionsJobsCount");
 
     for (const auto &j : index) {
-        auto containerIt = wallets.find(j.container);
-        assert(containerIt != wallets.end());
-
-        auto keyIt = m_walletsContainer.project<KeysIndex>(containerIt);
-        assert(keyIt != m_walletsContainer.get<KeysIndex>().end());
-
-        UnlockTransactionJobDtoV2 dto;
-        dto.blockHeight = j.blockHeight;
-        dto.transactionHash = j.transactionHash;
-        dto.walletSpendPublicKey = keyIt->spendPublicKey;
-
+        UnlockTransactionJobDtoV2 dto = convert(j, m_walletsContainer);
         serializer(dto, "unlockTransactionsJob");
     }
 }
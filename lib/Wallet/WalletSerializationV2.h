@@ -49,6 +49,26 @@ public:
     void load(Common::IInputStream &source, uint8_t version);
     void save(Common::IOutputStream &destination, WalletSaveLevel saveLevel);
 
+    // Journal entries carry the records changed since the previous entry on top of a cache saved
+    // with SAVE_ALL: the given transactions with their transfers, wallet balances, unlock jobs of
+    // transactions and uncommited transactions, and the extra if saveExtra is set. The wallet list
+    // itself doesn't change within a journal. The synchronizer state is passed through as is and
+    // is not applied on load, an empty one means it is unchanged.
+    void saveJournalEntry(
+        Common::IOutputStream &destination,
+        const std::vector<size_t> &transactionIds,
+        const std::vector<Crypto::PublicKey> &walletKeys,
+        const std::vector<Crypto::Hash> &unlockJobTransactions,
+        const std::vector<size_t> &uncommitedTransactionIds,
+        bool saveExtra,
+        const std::string &transfersSynchronizerState);
+    void loadJournalEntry(Common::IInputStream &source, std::string &transfersSynchronizerState);
+
+    // Saves the given synchronizer state instead of taking it from the synchronizer
+    void setTransfersSynchronizerState(const std::string &state);
+    // The synchronizer state that was loaded or set
+    const std::string &transfersSynchronizerState() const;
+
     std::unordered_set<Crypto::PublicKey> &addedKeys();
     std::unordered_set<Crypto::PublicKey> &deletedKeys();
 
@@ -83,6 +103,7 @@ private:
     UncommitedTransactions &m_uncommitedTransactions;
     std::string &m_extra;
     uint32_t m_transactionSoftLockTime;
+    std::string m_transfersSynchronizerState;
 
     std::unordered_set<Crypto::PublicKey> m_addedKeys;
     std::unordered_set<Crypto::PublicKey> m_deletedKeys;
@@ -0,0 +1,162 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <Wallet/WalletTransfers.h>
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t MIN_COMPACTION_SIZE = 1024;
+
+} // namespace
+
+WalletTransfers::WalletTransfers()
+    : m_size(0),
+      m_abandoned(0)
+{
+}
+
+void WalletTransfers::clear()
+{
+    m_arena.clear();
+    m_slots.clear();
+    m_size = 0;
+    m_abandoned = 0;
+}
+
+void WalletTransfers::reserve(size_t transferCount)
+{
+    m_arena.reserve(transferCount);
+}
+
+WalletTransfers::Range WalletTransfers::getTransfers(size_t transactionId)
+{
+    if (transactionId >= m_slots.size()) {
+        return Range(m_arena.end(), m_arena.end());
+    }
+
+    const Slot &slot = m_slots[transactionId];
+    auto first = std::next(m_arena.begin(), slot.offset);
+
+    return Range(first, std::next(first, slot.count));
+}
+
+WalletTransfers::ConstRange WalletTransfers::getTransfers(size_t transactionId) const
+{
+    if (transactionId >= m_slots.size()) {
+        return ConstRange(m_arena.end(), m_arena.end());
+    }
+
+    const Slot &slot = m_slots[transactionId];
+    auto first = std::next(m_arena.cbegin(), slot.offset);
+
+    return ConstRange(first, std::next(first, slot.count));
+}
+
+void WalletTransfers::push_back(size_t transactionId, WalletTransfer transfer)
+{
+    Slot &slot = getSlot(transactionId);
+    if (slot.count == slot.capacity) {
+        grow(transactionId);
+    }
+
+    assert(slot.count < slot.capacity);
+    m_arena[slot.offset + slot.count] = std::move(transfer);
+    ++slot.count;
+    ++m_size;
+}
+
+WalletTransfers::iterator WalletTransfers::erase(size_t transactionId, iterator it)
+{
+    assert(transactionId < m_slots.size());
+
+    Slot &slot = m_slots[transactionId];
+    auto first = std::next(m_arena.begin(), slot.offset);
+    auto last = std::next(first, slot.count);
+    assert(it >= first && it < last);
+
+    std::move(std::next(it), last, it);
+    *std::prev(last) = WalletTransfer();
+    --slot.count;
+    --m_size;
+
+    return it;
+}
+
+WalletTransfers::Slot &WalletTransfers::getSlot(size_t transactionId)
+{
+    // Transaction indices are dense, new transactions are appended to the end
+    while (m_slots.size() <= transactionId) {
+        m_slots.push_back(Slot{ m_arena.size(), 0, 0 });
+    }
+
+    return m_slots[transactionId];
+}
+
+void WalletTransfers::grow(size_t transactionId)
+{
+    if (m_abandoned > MIN_COMPACTION_SIZE && m_abandoned * 2 > m_arena.size()) {
+        compact();
+    }
+
+    Slot &slot = m_slots[transactionId];
+
+    if (slot.offset + slot.capacity == m_arena.size()) {
+        // The group is the tail of the arena, extend it in place
+        m_arena.emplace_back();
+        ++slot.capacity;
+        return;
+    }
+
+    size_t capacity = std::max<size_t>(slot.capacity * 2, 1);
+    size_t offset = m_arena.size();
+    m_arena.resize(offset + capacity);
+
+    auto first = std::next(m_arena.begin(), slot.offset);
+    std::move(first, std::next(first, slot.count), std::next(m_arena.begin(), offset));
+    std::fill(first, std::next(first, slot.capacity), WalletTransfer());
+
+    m_abandoned += slot.capacity;
+    slot.offset = offset;
+    slot.capacity = capacity;
+}
+
+void WalletTransfers::compact()
+{
+    std::vector<WalletTransfer> arena;
+    arena.reserve(m_size);
+
+    for (auto &slot : m_slots) {
+        auto first = std::next(m_arena.begin(), slot.offset);
+        size_t offset = arena.size();
+        std::move(first, std::next(first, slot.count), std::back_inserter(arena));
+
+        slot.offset = offset;
+        slot.capacity = slot.count;
+    }
+
+    m_arena.swap(arena);
+    m_abandoned = 0;
+}
+
+} // namespace CryptoNote
@@ -0,0 +1,93 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <Wallet/IWallet.h>
+
+namespace CryptoNote {
+
+/*!
+    \class WalletTransfers
+    \brief Transfers of wallet transactions grouped by transaction index.
+
+    Transfers of every transaction are kept contiguously in one append-only arena and are
+    addressed through an offset table indexed by transaction, so reading or updating the
+    transfers of a transaction costs O(transfers in the transaction). A group that outgrows
+    its place is moved to the end of the arena, and the arena is compacted once more than
+    half of it is abandoned.
+*/
+class WalletTransfers
+{
+public:
+    typedef std::vector<WalletTransfer>::iterator iterator;
+    typedef std::vector<WalletTransfer>::const_iterator const_iterator;
+    typedef std::pair<iterator, iterator> Range;
+    typedef std::pair<const_iterator, const_iterator> ConstRange;
+
+    WalletTransfers();
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t transactionCount() const { return m_slots.size(); }
+
+    void clear();
+    void reserve(size_t transferCount);
+
+    Range getTransfers(size_t transactionId);
+    ConstRange getTransfers(size_t transactionId) const;
+
+    // Appends the transfer to the end of the transaction group
+    void push_back(size_t transactionId, WalletTransfer transfer);
+    // Returns the iterator following the erased transfer within the transaction group
+    iterator erase(size_t transactionId, iterator it);
+
+    // Visits all transfers in transaction order as f(transactionId, transfer)
+    template<typename F>
+    void forEach(F &&f) const
+    {
+        for (size_t transactionId = 0; transactionId < m_slots.size(); ++transactionId) {
+            const Slot &slot = m_slots[transactionId];
+            for (size_t i = slot.offset; i < slot.offset + slot.count; ++i) {
+                f(transactionId, m_arena[i]);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        size_t offset;
+        size_t count;
+        size_t capacity;
+    };
+
+    Slot &getSlot(size_t transactionId);
+    void grow(size_t transactionId);
+    void compact();
+
+    std::vector<WalletTransfer> m_arena;
+    std::vector<Slot> m_slots;
+    size_t m_size;
+    size_t m_abandoned;
+};
+
+} // namespace CryptoNote
@@ -130,9 +130,9 @@ TransferListFormatter::TransferListFormatter(const CryptoNote::Currency &currenc
 void TransferListFormatter::print(std::ostream &os) const
 {
     for (auto it = m_range.first; it != m_range.second; ++it) {
-        os << '\n' << std::setw(21) << m_currency.formatAmount(it->second.amount)
-            << ' ' << (it->second.address.empty() ? "<UNKNOWN>" : it->second.address)
-            << ' ' << it->second.type;
+        os << '\n' << std::setw(21) << m_currency.formatAmount(it->amount)
+            << ' ' << (it->address.empty() ? "<UNKNOWN>" : it->address)
+            << ' ' << it->type;
     }
 }
 
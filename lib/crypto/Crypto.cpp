@@ -28,7 +28,6 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
-#include <mutex>
 
 #include "Common/Varint.h"
 #include "Crypto.h"
@@ -38,16 +37,12 @@ namespace Crypto {
 
 using std::abort;
 using std::int32_t;
-using std::lock_guard;
-using std::mutex;
 
 extern "C" {
 #include "crypto-ops.h"
 #include "random.h"
 }
 
-mutex random_lock;
-
 static inline unsigned char *operator&(EllipticCurvePoint &point)
 {
     return &reinterpret_cast<unsigned char &>(point);
@@ -84,7 +79,6 @@ static inline void hashToScalar(const void *data, size_t length, EllipticCurveSc
 
 void crypto_ops::generateKeys(PublicKey &pub, SecretKey &sec)
 {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 point;
     randomScalar(reinterpret_cast<EllipticCurveScalar &>(sec));
     ge_scalarmult_base(&point, reinterpret_cast<unsigned char *>(&sec));
@@ -93,7 +87,6 @@ void crypto_ops::generateKeys(PublicKey &pub, SecretKey &sec)
 
 void crypto_ops::generateDeterministicKeys(PublicKey &pub, SecretKey &sec, SecretKey &second)
 {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 point;
     sec = second;
     sc_reduce32(reinterpret_cast<unsigned char *>(
@@ -105,7 +98,6 @@ void crypto_ops::generateDeterministicKeys(PublicKey &pub, SecretKey &sec, Secre
 SecretKey crypto_ops::generateMKeys(PublicKey &pub, SecretKey &sec, const SecretKey &recovery_key,
                                     bool recover)
 {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 point;
     SecretKey rng;
     if (recover) {
@@ -333,7 +325,6 @@ struct sComm2 {
 void crypto_ops::generateSignature(const Hash &prefixHash, const PublicKey &publicKey,
                                    const SecretKey &secretKey, Signature &signature)
 {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 tmp3;
     EllipticCurveScalar k;
     sComm buf;
@@ -609,7 +600,6 @@ void crypto_ops::generateRingSignature(const Hash &prefixHash, const KeyImage &k
                                        const SecretKey &secretKey, size_t secIndex,
                                        Signature *signature)
 {
-    lock_guard<mutex> lock(random_lock);
     size_t i;
     ge_p3 image_unp;
     ge_dsmp image_pre;
@@ -38,8 +38,6 @@ extern "C" {
 #include "random.h"
 }
 
-extern std::mutex random_lock;
-
 struct EllipticCurvePoint {
     uint8_t data[32];
 };
@@ -126,12 +124,12 @@ class crypto_ops
 };
 
 /* Generate a value filled with random bytes.
+ * The generator is thread local, concurrent callers don't wait for each other.
  */
 template<typename T>
 typename std::enable_if<std::is_pod<T>::value, T>::type rand()
 {
     typename std::remove_cv<T>::type res;
-    std::lock_guard<std::mutex> lock(random_lock);
     generate_random_bytes(sizeof(T), &res);
     return res;
 }
@@ -19,10 +19,10 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "hash-ops.h"
-#include "initializer.h"
 #include "random.h"
 
 static void generate_system_random_bytes(size_t n, void *result);
@@ -79,54 +79,63 @@ static void generate_system_random_bytes(size_t n, void *result) {
 
 #endif
 
-static union hash_state state;
-
-#if !defined(NDEBUG)
-static volatile int curstate; /* To catch thread safety problems. */
+#if defined(_MSC_VER)
+#define THREADV __declspec(thread)
+#else
+#define THREADV __thread
 #endif
 
-FINALIZER(deinit_random) {
-#if !defined(NDEBUG)
-  assert(curstate == 1);
-  curstate = 0;
-#endif
-  memset(&state, 0, sizeof(union hash_state));
-}
+/*
+ * Every thread runs its own generator, seeded from the system on first use, so that threads
+ * building transactions or sampling outputs don't contend on a shared state. Each permutation
+ * yields HASH_DATA_AREA bytes which are handed out in order; available is the number of bytes
+ * not handed out yet.
+ */
+static THREADV union hash_state state;
+static THREADV int seeded = 0;
+static THREADV size_t available = 0;
+static THREADV size_t bytes_since_reseed = 0;
 
-INITIALIZER(init_random) {
-  generate_system_random_bytes(32, &state);
-  REGISTER_FINALIZER(deinit_random);
-#if !defined(NDEBUG)
-  assert(curstate == 0);
-  curstate = 1;
-#endif
+static void reseed(void) {
+  uint8_t entropy[32];
+  size_t i;
+  generate_system_random_bytes(sizeof(entropy), entropy);
+  for (i = 0; i < sizeof(entropy); i++) {
+    state.b[i] ^= entropy[i];
+  }
+  memset(entropy, 0, sizeof(entropy));
+  hash_permutation(&state);
+  available = 0;
+  bytes_since_reseed = 0;
+  seeded = 1;
 }
 
 void generate_random_bytes(size_t n, void *result) {
-#if !defined(NDEBUG)
-  assert(curstate == 1);
-  curstate = 2;
-#endif
-  if (n == 0) {
-#if !defined(NDEBUG)
-    assert(curstate == 2);
-    curstate = 1;
-#endif
-    return;
+  if (!seeded || bytes_since_reseed >= RANDOM_RESEED_INTERVAL) {
+    reseed();
   }
-  for (;;) {
-    hash_permutation(&state);
-    if (n <= HASH_DATA_AREA) {
-      memcpy(result, &state, n);
-#if !defined(NDEBUG)
-      assert(curstate == 2);
-      curstate = 1;
-#endif
-      return;
-    } else {
-      memcpy(result, &state, HASH_DATA_AREA);
-      result = padd(result, HASH_DATA_AREA);
-      n -= HASH_DATA_AREA;
+  bytes_since_reseed += n;
+  while (n > 0) {
+    size_t chunk;
+    if (available == 0) {
+      hash_permutation(&state);
+      available = HASH_DATA_AREA;
     }
+    chunk = n < available ? n : available;
+    memcpy(result, state.b + HASH_DATA_AREA - available, chunk);
+    /* Bytes handed out are wiped, the state is left with no trace of them once permuted again. */
+    memset(state.b + HASH_DATA_AREA - available, 0, chunk);
+    available -= chunk;
+    result = padd(result, chunk);
+    n -= chunk;
   }
 }
+
+void seed_random(const void *seed, size_t n) {
+  memset(&state, 0, sizeof(union hash_state));
+  memcpy(&state, seed, n < sizeof(union hash_state) ? n : sizeof(union hash_state));
+  hash_permutation(&state);
+  available = 0;
+  bytes_since_reseed = 0;
+  seeded = 1;
+}
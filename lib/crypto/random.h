@@ -23,4 +23,10 @@
 #include <stddef.h>
 #endif
 
+/* Fresh system entropy is mixed into the state after this many bytes of output. */
+#define RANDOM_RESEED_INTERVAL (1 << 20)
+
 void generate_random_bytes(size_t n, void *result);
+/* Seeds the generator of the calling thread from seed instead of the system, so that tests can
+ * replay its output up to the next reseed. */
+void seed_random(const void *seed, size_t n);
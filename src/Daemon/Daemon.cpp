@@ -24,6 +24,7 @@
 #include <boost/program_options.hpp>
 #include <Common/SignalHandler.h>
 #include <Common/StringTools.h>
+#include <Common/Trace.h>
 #include <Common/PathTools.h>
 #include <crypto/hash.h>
 #include <Breakpad/Breakpad.h>
@@ -32,6 +33,7 @@
 #include <CryptoNoteCore/CoreConfig.h>
 #include <CryptoNoteCore/Currency.h>
 #include <CryptoNoteCore/MinerConfig.h>
+#include <CryptoNoteCore/ViewKeyScanner.h>
 #include <CryptoNoteProtocol/CryptoNoteProtocolHandler.h>
 #include <CryptoNoteProtocol/ICryptoNoteProtocolQuery.h>
 #include <Global/Checkpoints.h>
@@ -79,6 +81,11 @@ const command_line::arg_descriptor<int> arg_log_level = {
     2
 }; // info level
 
+const command_line::arg_descriptor<bool> arg_log_async = {
+    "log-async",
+    "Write the log file from a background thread, dropping messages it can't keep up with"
+};
+
 const command_line::arg_descriptor<bool> arg_console = {
     "no-console",
     "Disable daemon console commands"
@@ -95,6 +102,12 @@ const command_line::arg_descriptor<bool> arg_enable_blockchain_indexes = {
     false
 };
 
+const command_line::arg_descriptor<bool> arg_enable_trace = {
+    "enable-trace",
+    "Record block processing spans from the start, see the save_trace command",
+    false
+};
+
 const command_line::arg_descriptor<bool> arg_print_genesis_tx = {
     "print-genesis-tx",
     "Prints genesis' block tx hex to insert it to config and exits"
@@ -125,6 +138,24 @@ const command_line::arg_descriptor<std::string> arg_set_view_key = {
     ""
 };
 
+const command_line::arg_descriptor<bool> arg_enable_view_key_scanner = {
+    "enable-view-key-scanner",
+    "Let light wallets register their view keys over RPC and scan new blocks for their outputs",
+    false
+};
+
+const command_line::arg_descriptor<uint32_t> arg_view_key_scanner_max_accounts = {
+    "view-key-scanner-max-accounts",
+    "Maximum number of view keys light wallets may register with the view key scanner",
+    static_cast<uint32_t>(CryptoNote::ViewKeyScanner::DEFAULT_MAX_ACCOUNTS)
+};
+
+const command_line::arg_descriptor<uint32_t> arg_view_key_scanner_max_depth = {
+    "view-key-scanner-max-depth",
+    "Maximum number of blocks behind the top block a registered view key may start scanning from",
+    CryptoNote::ViewKeyScanner::DEFAULT_MAX_SCAN_DEPTH
+};
+
 const command_line::arg_descriptor<bool> arg_testnet_on  = {
     "testnet",
     "Used to deploy test nets. Checkpoints and hardcoded seeds are ignored, "
@@ -156,6 +187,16 @@ const command_line::arg_descriptor<std::string> arg_rollback = {
     "Rollback blockchain to <height>"
 };
 
+const command_line::arg_descriptor<std::string> arg_export_blockchain = {
+    "export-blockchain",
+    "Export the blockchain to a bootstrap <file> and exit"
+};
+
+const command_line::arg_descriptor<std::string> arg_import_blockchain = {
+    "import-blockchain",
+    "Import the blockchain from a bootstrap <file> and exit"
+};
+
 } // namespace
 
 bool command_line_preprocessor(const boost::program_options::variables_map &vm, LoggerRef &logger);
@@ -171,7 +212,7 @@ void print_genesis_tx_hex(const po::variables_map &vm, LoggerManager &logManager
         << "const char GENESIS_COINBASE_TX_HEX[] = \"" << tx_hex << "\";" << std::endl;
 }
 
-JsonValue buildLoggerConfiguration(Level level, const std::string &logfile)
+JsonValue buildLoggerConfiguration(Level level, const std::string &logfile, bool async)
 {
     JsonValue loggerConfiguration(JsonValue::OBJECT);
     loggerConfiguration.insert("globalLevel", static_cast<int64_t>(level));
@@ -182,6 +223,7 @@ JsonValue buildLoggerConfiguration(Level level, const std::string &logfile)
     fileLogger.insert("type", "file");
     fileLogger.insert("filename", logfile);
     fileLogger.insert("level", static_cast<int64_t>(TRACE));
+    fileLogger.insert("async", async);
 
     JsonValue& consoleLogger = cfgLoggers.pushBack(JsonValue::OBJECT);
     consoleLogger.insert("type", "console");
@@ -232,6 +274,7 @@ int main(int argc, char *argv[])
 
         command_line::add_arg(desc_cmd_sett, arg_log_file);
         command_line::add_arg(desc_cmd_sett, arg_log_level);
+        command_line::add_arg(desc_cmd_sett, arg_log_async);
         command_line::add_arg(desc_cmd_sett, arg_console);
         command_line::add_arg(desc_cmd_sett, arg_restricted_rpc);
         command_line::add_arg(desc_cmd_sett, arg_testnet_on);
@@ -239,11 +282,17 @@ int main(int argc, char *argv[])
         command_line::add_arg(desc_cmd_sett, arg_enable_cors);
         command_line::add_arg(desc_cmd_sett, arg_set_fee_address);
         command_line::add_arg(desc_cmd_sett, arg_set_view_key);
+        command_line::add_arg(desc_cmd_sett, arg_enable_view_key_scanner);
+        command_line::add_arg(desc_cmd_sett, arg_view_key_scanner_max_accounts);
+        command_line::add_arg(desc_cmd_sett, arg_view_key_scanner_max_depth);
         command_line::add_arg(desc_cmd_sett, arg_enable_blockchain_indexes);
+        command_line::add_arg(desc_cmd_sett, arg_enable_trace);
         command_line::add_arg(desc_cmd_sett, arg_print_genesis_tx);
         command_line::add_arg(desc_cmd_sett, arg_load_checkpoints);
         command_line::add_arg(desc_cmd_sett, arg_disable_checkpoints);
         command_line::add_arg(desc_cmd_sett, arg_rollback);
+        command_line::add_arg(desc_cmd_sett, arg_export_blockchain);
+        command_line::add_arg(desc_cmd_sett, arg_import_blockchain);
         command_line::add_arg(desc_cmd_sett, arg_set_contact);
 
         RpcServerConfig::initOptions(desc_cmd_sett);
@@ -310,7 +359,9 @@ int main(int argc, char *argv[])
         );
 
         // configure logging
-        logManager.configure(buildLoggerConfiguration(cfgLogLevel, cfgLogFile));
+        logManager.configure(buildLoggerConfiguration(cfgLogLevel,
+                                                      cfgLogFile,
+                                                      command_line::get_arg(vm, arg_log_async)));
 
         if (command_line_preprocessor(vm, logger)) {
             return 0;
@@ -384,6 +435,8 @@ int main(int argc, char *argv[])
             }
         }
 
+        Tracing::setEnabled(command_line::get_arg(vm, arg_enable_trace));
+
         CoreConfig coreConfig;
         coreConfig.init(vm);
         NetNodeConfig netNodeConfig;
@@ -442,6 +495,18 @@ int main(int argc, char *argv[])
             }
         }
 
+        if (command_line::has_arg(vm, arg_export_blockchain)
+            || command_line::has_arg(vm, arg_import_blockchain)) {
+            bool r = command_line::has_arg(vm, arg_export_blockchain)
+                ? ccore.exportBlockchain(command_line::get_arg(vm, arg_export_blockchain))
+                : ccore.importBlockchain(command_line::get_arg(vm, arg_import_blockchain));
+
+            ccore.deinit();
+            p2psrv.deinit();
+
+            return r ? 0 : 1;
+        }
+
         // start components
         if (!command_line::has_arg(vm, arg_console)) {
             dch.start_handling();
@@ -473,6 +538,17 @@ int main(int argc, char *argv[])
                 rpcServer.setContactInfo(contact_str);
             }
         }
+        std::unique_ptr<CryptoNote::ViewKeyScanner> viewKeyScanner;
+        if (command_line::get_arg(vm, arg_enable_view_key_scanner)) {
+            viewKeyScanner.reset(new CryptoNote::ViewKeyScanner(
+                ccore,
+                logManager,
+                std::thread::hardware_concurrency(),
+                CryptoNote::ViewKeyScanner::DEFAULT_BATCH_SIZE,
+                command_line::get_arg(vm, arg_view_key_scanner_max_accounts),
+                command_line::get_arg(vm, arg_view_key_scanner_max_depth)));
+            rpcServer.setViewKeyScanner(viewKeyScanner.get());
+        }
         logger(INFO) << "Core rpc server started ok";
 
         Tools::SignalHandler::install([&dch, &p2psrv]() {
@@ -489,6 +565,8 @@ int main(int argc, char *argv[])
         // stop components
         logger(INFO) << "Stopping core rpc server...";
         rpcServer.stop();
+        rpcServer.setViewKeyScanner(nullptr);
+        viewKeyScanner.reset();
 
         // deinitialize components
         logger(INFO) << "Deinitializing core...";
@@ -23,10 +23,12 @@
 
 
 #include <ctime>
+#include <fstream>
 #include <math.h>
 #include <boost/format.hpp>
 #include <P2p/NetNode.h>
 #include <Common/ColouredMsg.h>
+#include <Common/Trace.h>
 #include <CryptoNoteCore/Miner.h>
 #include <CryptoNoteCore/Core.h>
 #include <CryptoNoteProtocol/CryptoNoteProtocolHandler.h>
@@ -195,6 +197,24 @@ DaemonCommandsHandler::DaemonCommandsHandler(
         boost::bind(&DaemonCommandsHandler::status, this, _1),
         "Show daemon status"
     );
+
+    m_consoleHandler.setHandler(
+        "start_trace",
+        boost::bind(&DaemonCommandsHandler::start_trace, this, _1),
+        "Start recording block processing spans"
+    );
+
+    m_consoleHandler.setHandler(
+        "stop_trace",
+        boost::bind(&DaemonCommandsHandler::stop_trace, this, _1),
+        "Stop recording block processing spans"
+    );
+
+    m_consoleHandler.setHandler(
+        "save_trace",
+        boost::bind(&DaemonCommandsHandler::save_trace, this, _1),
+        "Save the latest recorded block processing spans in Chrome trace format, save_trace <file>"
+    );
 }
 
 std::string DaemonCommandsHandler::get_commands_str()
@@ -376,6 +396,39 @@ bool DaemonCommandsHandler::print_bc_outs(const std::vector<std::string> &args)
     return true;
 }
 
+bool DaemonCommandsHandler::start_trace(const std::vector<std::string> &args)
+{
+    Tracing::setEnabled(true);
+
+    return true;
+}
+
+bool DaemonCommandsHandler::stop_trace(const std::vector<std::string> &args)
+{
+    Tracing::setEnabled(false);
+
+    return true;
+}
+
+bool DaemonCommandsHandler::save_trace(const std::vector<std::string> &args)
+{
+    if (args.size() != 1) {
+        std::cout << "need file path as parameter" << ENDL;
+        return true;
+    }
+
+    std::ofstream file(args[0], std::ios::trunc);
+    file << Tracing::recorder().toChromeTrace();
+    if (!file) {
+        std::cout << "failed to write " << args[0] << ENDL;
+        return true;
+    }
+
+    std::cout << "saved the trace to " << args[0] << ", open it in chrome://tracing" << ENDL;
+
+    return true;
+}
+
 bool DaemonCommandsHandler::print_cn(const std::vector<std::string> &args)
 {
     m_srv.get_payload_object().log_connections();
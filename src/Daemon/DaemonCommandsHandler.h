@@ -73,6 +73,9 @@ private:
     bool show_hr(const std::vector<std::string> &args);
     bool hide_hr(const std::vector<std::string> &args);
     bool print_bc_outs(const std::vector<std::string> &args);
+    bool start_trace(const std::vector<std::string> &args);
+    bool stop_trace(const std::vector<std::string> &args);
+    bool save_trace(const std::vector<std::string> &args);
     bool print_cn(const std::vector<std::string> &args);
     bool print_bc(const std::vector<std::string> &args);
     bool print_bci(const std::vector<std::string> &args);
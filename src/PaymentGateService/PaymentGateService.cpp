@@ -264,7 +264,8 @@ void PaymentGateService::runRpcProxy(Logging::LoggerRef &log)
     std::unique_ptr<CryptoNote::INode> node(
         PaymentService::NodeFactory::createNode(
             config.remoteNodeConfig.daemonHost,
-            config.remoteNodeConfig.daemonPort
+            config.remoteNodeConfig.daemonPort,
+            config.remoteNodeConfig.daemonConnections
         )
     );
 
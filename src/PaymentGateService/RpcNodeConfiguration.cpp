@@ -27,13 +27,17 @@ RpcNodeConfiguration::RpcNodeConfiguration()
 {
     daemonHost = "";
     daemonPort = 0;
+    daemonConnections = 0;
 }
 
 void RpcNodeConfiguration::initOptions(boost::program_options::options_description &desc)
 {
     desc.add_options()
         ("daemon-address", po::value<std::string>()->default_value("127.0.0.1"), "daemon address")
-        ("daemon-port", po::value<uint16_t>()->default_value(8197), "daemon port");
+        ("daemon-port", po::value<uint16_t>()->default_value(8197), "daemon port")
+        ("daemon-connections",
+         po::value<size_t>()->default_value(4),
+         "number of concurrent connections to daemon");
 }
 
 void RpcNodeConfiguration::init(const boost::program_options::variables_map &options)
@@ -47,6 +51,11 @@ void RpcNodeConfiguration::init(const boost::program_options::variables_map &opt
         && (!options["daemon-port"].defaulted() || daemonPort == 0)) {
         daemonPort = options["daemon-port"].as<uint16_t>();
     }
+
+    if (options.count("daemon-connections") != 0
+        && (!options["daemon-connections"].defaulted() || daemonConnections == 0)) {
+        daemonConnections = options["daemon-connections"].as<size_t>();
+    }
 }
 
 } // namespace PaymentService
@@ -34,6 +34,7 @@ public:
 
     std::string daemonHost;
     uint16_t daemonPort;
+    size_t daemonConnections;
 };
 
 } // namespace PaymentService
@@ -0,0 +1,153 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlockTemplate.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace CryptoNote;
+
+namespace
+{
+  bool get_template(core& c, Block& b, uint64_t& template_version)
+  {
+    AccountBase account;
+    account.generate();
+
+    difficulty_type diff;
+    uint32_t height;
+    return c.get_block_template(b, account.getAccountKeys().address, diff, height, BinaryArray(), template_version);
+  }
+}
+
+//-----------------------------------------------------------------------------------------------------
+gen_block_template_rebuilt::gen_block_template_rebuilt()
+{
+  // lets the last transaction expire from the pool within the test
+  CryptoNote::CurrencyBuilder currencyBuilder(m_logger);
+  currencyBuilder.mempoolTxLiveTime(2);
+  m_currency = currencyBuilder.currency();
+
+  REGISTER_CALLBACK("check_template_kept", gen_block_template_rebuilt::check_template_kept);
+  REGISTER_CALLBACK("check_rebuilt_after_pool_change", gen_block_template_rebuilt::check_rebuilt_after_pool_change);
+  REGISTER_CALLBACK("check_rebuilt_after_new_tip", gen_block_template_rebuilt::check_rebuilt_after_new_tip);
+  REGISTER_CALLBACK("check_rebuilt_after_tx_left_pool", gen_block_template_rebuilt::check_rebuilt_after_tx_left_pool);
+}
+
+bool gen_block_template_rebuilt::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  // the core keeps coinbase outputs locked for longer than the test currency does, the
+  // transactions spend the outputs of the first blocks
+  REWIND_BLOCKS(events, blk_0a, blk_0, miner_account);
+  REWIND_BLOCKS_N(events, blk_0r, blk_0a, miner_account, CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+  DO_CALLBACK(events, "check_template_kept");
+
+  Transaction tx_1 = construct_decomposed_tx(m_logger, events, blk_0a, miner_account, alice_account, MK_COINS(5), m_currency.minimumFee());
+  DO_CALLBACK(events, "check_rebuilt_after_pool_change");
+
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_1);
+  DO_CALLBACK(events, "check_rebuilt_after_new_tip");
+
+  construct_decomposed_tx(m_logger, events, blk_0a, miner_account, alice_account, MK_COINS(7), m_currency.minimumFee());
+  DO_CALLBACK(events, "check_rebuilt_after_tx_left_pool");
+
+  return true;
+}
+
+bool gen_block_template_rebuilt::check_template_kept(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_rebuilt::check_template_kept");
+
+  Block b;
+  CHECK_TEST_CONDITION(get_template(c, b, m_template_version));
+  CHECK_TEST_CONDITION(b.previousBlockHash == getBlockHash(boost::get<Block>(events[ev_index - 1])));
+  CHECK_TEST_CONDITION(b.transactionHashes.empty());
+
+  uint64_t template_version;
+  CHECK_TEST_CONDITION(get_template(c, b, template_version));
+  CHECK_EQ(m_template_version, template_version);
+
+  return true;
+}
+
+bool gen_block_template_rebuilt::check_rebuilt_after_pool_change(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_rebuilt::check_rebuilt_after_pool_change");
+
+  Block b;
+  uint64_t template_version;
+  CHECK_TEST_CONDITION(get_template(c, b, template_version));
+  CHECK_TEST_CONDITION(template_version > m_template_version);
+  CHECK_EQ(1, b.transactionHashes.size());
+  CHECK_TEST_CONDITION(b.transactionHashes.front() == getObjectHash(boost::get<Transaction>(events[ev_index - 1])));
+
+  m_template_version = template_version;
+  return true;
+}
+
+bool gen_block_template_rebuilt::check_rebuilt_after_new_tip(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_rebuilt::check_rebuilt_after_new_tip");
+
+  Crypto::Hash tip = getBlockHash(boost::get<Block>(events[ev_index - 1]));
+  CHECK_TEST_CONDITION(c.get_tail_id() == tip);
+
+  Block b;
+  uint64_t template_version;
+  CHECK_TEST_CONDITION(get_template(c, b, template_version));
+  CHECK_TEST_CONDITION(template_version > m_template_version);
+  CHECK_TEST_CONDITION(b.previousBlockHash == tip);
+  // the mined transaction left the pool with the new block
+  CHECK_TEST_CONDITION(b.transactionHashes.empty());
+
+  m_template_version = template_version;
+  return true;
+}
+
+bool gen_block_template_rebuilt::check_rebuilt_after_tx_left_pool(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_rebuilt::check_rebuilt_after_tx_left_pool");
+
+  Crypto::Hash tx_hash = getObjectHash(boost::get<Transaction>(events[ev_index - 1]));
+
+  Block b;
+  uint64_t template_version;
+  CHECK_TEST_CONDITION(get_template(c, b, template_version));
+  CHECK_EQ(1, b.transactionHashes.size());
+  CHECK_TEST_CONDITION(b.transactionHashes.front() == tx_hash);
+  m_template_version = template_version;
+
+  // the pool drops the transaction once it is older than its live time
+  std::this_thread::sleep_for(std::chrono::seconds(m_currency.mempoolTxLiveTime() + 1));
+  c.on_idle();
+  CHECK_EQ(0, c.get_pool_transactions_count());
+
+  CHECK_TEST_CONDITION(get_template(c, b, template_version));
+  CHECK_TEST_CONDITION(template_version > m_template_version);
+  CHECK_TEST_CONDITION(b.transactionHashes.empty());
+
+  return true;
+}
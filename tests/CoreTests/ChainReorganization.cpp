@@ -0,0 +1,256 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ChainReorganization.h"
+
+#include <unordered_set>
+
+using namespace CryptoNote;
+
+namespace
+{
+  // transactions of the test in the order they were generated, coinbase
+  // transactions only appear inside blocks
+  std::vector<Transaction> get_transactions(const std::vector<test_event_entry>& events)
+  {
+    std::vector<Transaction> txs;
+    for (const auto& e : events)
+    {
+      if (typeid(Transaction) == e.type())
+        txs.push_back(boost::get<Transaction>(e));
+    }
+
+    return txs;
+  }
+
+  bool are_key_images_spent(core& c, const Transaction& tx, bool spent)
+  {
+    for (const auto& in : tx.inputs)
+    {
+      if (c.is_key_image_spent(boost::get<KeyInput>(in).keyImage) != spent)
+        return false;
+    }
+
+    return true;
+  }
+
+  std::unordered_set<Crypto::Hash> get_hashes(const std::vector<Transaction>& txs)
+  {
+    std::unordered_set<Crypto::Hash> hashes;
+    for (const auto& tx : txs)
+      hashes.insert(getObjectHash(tx));
+
+    return hashes;
+  }
+
+  std::unordered_set<Crypto::Hash> get_pool_hashes(core& c)
+  {
+    return get_hashes(c.getPoolTransactions());
+  }
+}
+
+//-----------------------------------------------------------------------------------------------------
+gen_chain_switch_and_back::gen_chain_switch_and_back()
+{
+  REGISTER_CALLBACK("check_main_chain", gen_chain_switch_and_back::check_main_chain);
+  REGISTER_CALLBACK("check_switched_to_alt_chain", gen_chain_switch_and_back::check_switched_to_alt_chain);
+  REGISTER_CALLBACK("check_switched_back", gen_chain_switch_and_back::check_switched_back);
+}
+
+bool gen_chain_switch_and_back::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0r)-(1 )     -(2 )-(3 )|   <- main chain, alternative after (a2), main again after (3)
+      \-(a1)-(a2)|            <- alt chain
+
+  A chain is only switched to if it has all transactions of the chain it replaces.
+
+  (1) : tx_1
+  (a1): tx_1, tx_2
+  (a2): tx_3
+  (2) : tx_2, tx_3
+  tx_4 stays in the pool
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  MAKE_ACCOUNT(events, bob_account);
+  // alternative blocks are only accepted once the chain is deeper than the
+  // unlock window, the transactions spend the outputs of the first blocks
+  REWIND_BLOCKS(events, blk_0a, blk_0, miner_account);
+  REWIND_BLOCKS_N(events, blk_0r, blk_0a, miner_account, CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+  uint64_t fee = m_currency.minimumFee();
+  Transaction tx_1 = construct_decomposed_tx(m_logger, events, blk_0a, miner_account, alice_account, MK_COINS(5), fee);
+  Transaction tx_2 = construct_decomposed_tx(m_logger, events, blk_0a, miner_account, alice_account, MK_COINS(7), fee);
+  Transaction tx_3 = construct_decomposed_tx(m_logger, events, blk_0a, miner_account, bob_account, MK_COINS(11), fee);
+  construct_decomposed_tx(m_logger, events, blk_0a, miner_account, bob_account, MK_COINS(13), fee);
+
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_1);
+  DO_CALLBACK(events, "check_main_chain");
+
+  std::list<Transaction> txs_blk_a1;
+  txs_blk_a1.push_back(tx_1);
+  txs_blk_a1.push_back(tx_2);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_a1, blk_0r, miner_account, txs_blk_a1);
+  MAKE_NEXT_BLOCK_TX1(events, blk_a2, blk_a1, miner_account, tx_3);
+  DO_CALLBACK(events, "check_switched_to_alt_chain");
+
+  std::list<Transaction> txs_blk_2;
+  txs_blk_2.push_back(tx_2);
+  txs_blk_2.push_back(tx_3);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_2, blk_1, miner_account, txs_blk_2);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  DO_CALLBACK(events, "check_switched_back");
+
+  return true;
+}
+
+bool gen_chain_switch_and_back::check_main_chain(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_chain_switch_and_back::check_main_chain");
+
+  std::vector<Transaction> txs = get_transactions(events);
+  CHECK_EQ(4, txs.size());
+
+  CHECK_TEST_CONDITION(c.get_tail_id() == getBlockHash(boost::get<Block>(events[ev_index - 1])));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[0], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[1], false));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[2], false));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[3], false));
+
+  CHECK_TEST_CONDITION(c.getTxOutputsGlobalIndexes(getObjectHash(txs[0]), m_tx_1_global_indexes));
+  CHECK_EQ(txs[0].outputs.size(), m_tx_1_global_indexes.size());
+  std::vector<uint32_t> indexes;
+  CHECK_TEST_CONDITION(!c.getTxOutputsGlobalIndexes(getObjectHash(txs[1]), indexes));
+
+  CHECK_TEST_CONDITION(get_pool_hashes(c) == get_hashes({ txs[1], txs[2], txs[3] }));
+
+  return true;
+}
+
+bool gen_chain_switch_and_back::check_switched_to_alt_chain(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_chain_switch_and_back::check_switched_to_alt_chain");
+
+  std::vector<Transaction> txs = get_transactions(events);
+
+  CHECK_TEST_CONDITION(c.get_tail_id() == getBlockHash(boost::get<Block>(events[ev_index - 1])));
+  CHECK_EQ(1, c.getAlternativeBlocksCount());
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[0], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[1], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[2], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[3], false));
+
+  for (size_t i = 0; i < 3; ++i)
+  {
+    std::vector<uint32_t> indexes;
+    CHECK_TEST_CONDITION(c.getTxOutputsGlobalIndexes(getObjectHash(txs[i]), indexes));
+    CHECK_EQ(txs[i].outputs.size(), indexes.size());
+  }
+
+  CHECK_TEST_CONDITION(get_pool_hashes(c) == get_hashes({ txs[3] }));
+
+  return true;
+}
+
+bool gen_chain_switch_and_back::check_switched_back(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_chain_switch_and_back::check_switched_back");
+
+  std::vector<Transaction> txs = get_transactions(events);
+
+  CHECK_TEST_CONDITION(c.get_tail_id() == getBlockHash(boost::get<Block>(events[ev_index - 1])));
+  CHECK_EQ(2, c.getAlternativeBlocksCount());
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[0], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[1], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[2], true));
+  CHECK_TEST_CONDITION(are_key_images_spent(c, txs[3], false));
+
+  // (1) is connected again at the same place, so its outputs get the same indexes
+  std::vector<uint32_t> indexes;
+  CHECK_TEST_CONDITION(c.getTxOutputsGlobalIndexes(getObjectHash(txs[0]), indexes));
+  CHECK_TEST_CONDITION(indexes == m_tx_1_global_indexes);
+  CHECK_TEST_CONDITION(c.getTxOutputsGlobalIndexes(getObjectHash(txs[1]), indexes));
+  CHECK_EQ(txs[1].outputs.size(), indexes.size());
+  CHECK_TEST_CONDITION(c.getTxOutputsGlobalIndexes(getObjectHash(txs[2]), indexes));
+  CHECK_EQ(txs[2].outputs.size(), indexes.size());
+
+  CHECK_TEST_CONDITION(get_pool_hashes(c) == get_hashes({ txs[3] }));
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+gen_alt_chains_pruned::gen_alt_chains_pruned()
+{
+  REGISTER_CALLBACK("check_alt_chain_kept", gen_alt_chains_pruned::check_alt_chain_kept);
+  REGISTER_CALLBACK("check_alt_chain_pruned", gen_alt_chains_pruned::check_alt_chain_pruned);
+}
+
+bool gen_alt_chains_pruned::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0r)-(1 )-(2 )-(3 )-(4 )-<W - 2 blocks>-(4r)-(5 )|   <- main chain, W is the mined money unlock window
+      \-(a1)-(a2)-(a3)|                                 <- alt chain, shorter than the main one
+
+  Once (4r) is the top, (a3) is the last alternative block that can still be
+  extended and (a1), (a2) are kept for it. Once (5) is the top, none are left.
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  REWIND_BLOCKS_N(events, blk_0r, blk_0, miner_account, CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0r, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_a1, blk_0r, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_a2, blk_a1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_a3, blk_a2, miner_account);
+  REWIND_BLOCKS_N(events, blk_4r, blk_4, miner_account, CryptoNote::parameters::CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW - 2);
+  DO_CALLBACK(events, "check_alt_chain_kept");
+  MAKE_NEXT_BLOCK(events, blk_5, blk_4r, miner_account);
+  DO_CALLBACK(events, "check_alt_chain_pruned");
+
+  return true;
+}
+
+bool gen_alt_chains_pruned::check_alt_chain_kept(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_alt_chains_pruned::check_alt_chain_kept");
+
+  CHECK_EQ(get_block_height(boost::get<Block>(events[ev_index - 1])) + 1, c.getCurrentBlockchainHeight());
+  CHECK_EQ(3, c.getAlternativeBlocksCount());
+
+  return true;
+}
+
+bool gen_alt_chains_pruned::check_alt_chain_pruned(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_alt_chains_pruned::check_alt_chain_pruned");
+
+  CHECK_EQ(0, c.getAlternativeBlocksCount());
+
+  return true;
+}
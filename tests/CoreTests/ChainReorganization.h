@@ -0,0 +1,50 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include "Chaingen.h"
+
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+class gen_chain_switch_and_back : public test_chain_unit_base
+{
+public:
+  gen_chain_switch_and_back();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_main_chain(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_switched_to_alt_chain(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_switched_back(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+private:
+  std::vector<uint32_t> m_tx_1_global_indexes;
+};
+
+class gen_alt_chains_pruned : public test_chain_unit_base
+{
+public:
+  gen_alt_chains_pruned();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_alt_chain_kept(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_alt_chain_pruned(CryptoNote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -312,6 +312,36 @@ Transaction construct_tx_with_fee(Logging::ILogger& logger, std::vector<test_eve
   return tx;
 }
 
+Transaction construct_decomposed_tx(Logging::ILogger& logger, std::vector<test_event_entry>& events, const Block& blk_head,
+                                    const AccountBase& from, const AccountBase& to, uint64_t amount, uint64_t fee,
+                                    const std::vector<uint8_t>& extra)
+{
+  vector<TransactionSourceEntry> sources;
+  vector<TransactionDestinationEntry> destinations;
+  fill_tx_sources_and_destinations(events, blk_head, from, to, amount, fee, 0, sources, destinations);
+
+  vector<TransactionDestinationEntry> decomposed;
+  for (const auto& de : destinations)
+  {
+    vector<uint64_t> amounts;
+    decomposeAmount(de.amount, 0, amounts);
+    for (uint64_t a : amounts)
+    {
+      TransactionDestinationEntry entry = de;
+      entry.amount = a;
+      decomposed.push_back(entry);
+    }
+  }
+
+  Transaction tx;
+  Crypto::SecretKey tx_key = from.getAccountKeys().spendSecretKey;
+  if (!constructTransaction(from.getAccountKeys(), sources, decomposed, extra, tx, 0, tx_key, logger))
+    throw std::runtime_error("couldn't construct transaction");
+
+  events.push_back(tx);
+  return tx;
+}
+
 uint64_t get_balance(const CryptoNote::AccountBase& addr, const std::vector<CryptoNote::Block>& blockchain, const map_hash2tx_t& mtx) {
     uint64_t res = 0;
     std::map<uint64_t, std::vector<output_index> > outs;
@@ -196,6 +196,10 @@ bool construct_tx_to_key(Logging::ILogger& logger, const std::vector<test_event_
 CryptoNote::Transaction construct_tx_with_fee(Logging::ILogger& logger, std::vector<test_event_entry>& events, const CryptoNote::Block& blk_head,
                                             const CryptoNote::AccountBase& acc_from, const CryptoNote::AccountBase& acc_to,
                                             uint64_t amount, uint64_t fee);
+// the core only accepts outputs with decomposed amounts
+CryptoNote::Transaction construct_decomposed_tx(Logging::ILogger& logger, std::vector<test_event_entry>& events, const CryptoNote::Block& blk_head,
+                                                const CryptoNote::AccountBase& from, const CryptoNote::AccountBase& to,
+                                                uint64_t amount, uint64_t fee, const std::vector<uint8_t>& extra = std::vector<uint8_t>());
 
 void get_confirmed_txs(const std::vector<CryptoNote::Block>& blockchain, const map_hash2tx_t& mtx, map_hash2tx_t& confirmed_txs);
 bool find_block_chain(const std::vector<test_event_entry>& events, std::vector<CryptoNote::Block>& blockchain, map_hash2tx_t& mtx, const Crypto::Hash& head);
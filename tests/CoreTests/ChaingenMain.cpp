@@ -22,7 +22,9 @@
 #include "Common/CommandLine.h"
 
 #include "BlockReward.h"
+#include "BlockTemplate.h"
 #include "BlockValidation.h"
+#include "ChainReorganization.h"
 #include "ChainSplit1.h"
 #include "ChainSwitch1.h"
 #include "Chaingen001.h"
@@ -94,6 +96,9 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(gen_simple_chain_split_1);
     GENERATE_AND_PLAY(one_block);
     GENERATE_AND_PLAY(gen_chain_switch_1);
+    GENERATE_AND_PLAY(gen_chain_switch_and_back);
+    GENERATE_AND_PLAY(gen_alt_chains_pruned);
+    GENERATE_AND_PLAY(gen_block_template_rebuilt);
     GENERATE_AND_PLAY(gen_ring_signature_1);
     GENERATE_AND_PLAY(gen_ring_signature_2);
     //GENERATE_AND_PLAY(gen_ring_signature_big); // Takes up to XXX hours (if CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW == 10)
@@ -23,4 +23,7 @@
 
 void setup_random(void) {
     memset(&state, 42, sizeof(union hash_state));
+    available = 0;
+    bytes_since_reseed = 0;
+    seeded = 1;
 }
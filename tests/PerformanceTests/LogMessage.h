@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <streambuf>
+
+#include "crypto/Crypto.h"
+#include "CryptoNoteCore/CryptoNoteBasicImpl.h"
+#include "Logging/AsyncLogger.h"
+#include "Logging/LoggerRef.h"
+#include "Logging/StreamLogger.h"
+
+class null_streambuf : public std::streambuf
+{
+protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *s, std::streamsize n) override { return n; }
+};
+
+// A typical per transaction message, logged below (DEBUGGING) and at (INFO) the logger level
+template <Logging::Level level>
+class test_log_message
+{
+public:
+  static const size_t loop_count = 1000000;
+
+  test_log_message()
+    : m_stream(&m_buffer),
+      m_logger(m_stream, Logging::INFO),
+      m_ref(m_logger, "test")
+  {
+  }
+
+  bool init()
+  {
+    m_hash = Crypto::rand<Crypto::Hash>();
+    return true;
+  }
+
+  bool test()
+  {
+    m_ref(level) << "Transaction " << m_hash << " included to block template, size " << 1024;
+    return true;
+  }
+
+private:
+  null_streambuf m_buffer;
+  std::ostream m_stream;
+  Logging::StreamLogger m_logger;
+  Logging::LoggerRef m_ref;
+  Crypto::Hash m_hash;
+};
+
+// The same message at the logger level, written from the background thread of an AsyncLogger.
+// Messages the writer can't keep up with are dropped, so this is the cost seen by the caller.
+class test_async_log_message
+{
+public:
+  static const size_t loop_count = 1000000;
+
+  test_async_log_message()
+    : m_stream(&m_buffer),
+      m_logger(m_stream, Logging::INFO),
+      m_asyncLogger(m_logger),
+      m_ref(m_asyncLogger, "test")
+  {
+  }
+
+  bool init()
+  {
+    m_hash = Crypto::rand<Crypto::Hash>();
+    return true;
+  }
+
+  bool test()
+  {
+    m_ref(Logging::INFO) << "Transaction " << m_hash << " included to block template, size " << 1024;
+    return true;
+  }
+
+private:
+  null_streambuf m_buffer;
+  std::ostream m_stream;
+  Logging::StreamLogger m_logger;
+  Logging::AsyncLogger m_asyncLogger;
+  Logging::LoggerRef m_ref;
+  Crypto::Hash m_hash;
+};
@@ -0,0 +1,80 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionView.h"
+
+#include "MultiTransactionTestBase.h"
+
+// Parses a transaction with a_ring_size ring members and ten outputs, either into a Transaction
+// or into a TransactionView.
+template<size_t a_ring_size, bool a_use_view>
+class test_parse_transaction : private multi_tx_test_base<a_ring_size>
+{
+public:
+  static const size_t loop_count = 100000;
+  static const size_t out_count = 10;
+
+  typedef multi_tx_test_base<a_ring_size> base_class;
+
+  bool init()
+  {
+    using namespace CryptoNote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<TransactionDestinationEntry> destinations;
+    for (size_t i = 0; i < out_count; ++i)
+    {
+      destinations.push_back(TransactionDestinationEntry(this->m_source_amount / out_count, m_alice.getAccountKeys().address));
+    }
+
+    Transaction tx;
+    Crypto::SecretKey key = this->m_miners[this->real_source_idx].getAccountKeys().spendSecretKey;
+    if (!constructTransaction(this->m_miners[this->real_source_idx].getAccountKeys(), this->m_sources, destinations,
+                              std::vector<uint8_t>(), tx, 0, key, this->m_logger))
+      return false;
+
+    return toBinaryArray(tx, m_blob);
+  }
+
+  bool test()
+  {
+    if (a_use_view)
+    {
+      return m_view.parse(m_blob);
+    }
+
+    CryptoNote::Transaction tx;
+    return CryptoNote::fromBinaryArray(tx, m_blob);
+  }
+
+private:
+  CryptoNote::AccountBase m_alice;
+  CryptoNote::BinaryArray m_blob;
+  CryptoNote::TransactionView m_view;
+};
@@ -30,6 +30,8 @@
 #include "GenerateKeyImage.h"
 #include "GenerateKeyImageHelper.h"
 #include "IsOutToAccount.h"
+#include "LogMessage.h"
+#include "ParseTransaction.h"
 
 int main(int argc, char** argv)
 {
@@ -74,6 +76,17 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE0(test_cn_slow_hash);
 
+  TEST_PERFORMANCE2(test_parse_transaction, 1, false);
+  TEST_PERFORMANCE2(test_parse_transaction, 1, true);
+  TEST_PERFORMANCE2(test_parse_transaction, 10, false);
+  TEST_PERFORMANCE2(test_parse_transaction, 10, true);
+  TEST_PERFORMANCE2(test_parse_transaction, 100, false);
+  TEST_PERFORMANCE2(test_parse_transaction, 100, true);
+
+  TEST_PERFORMANCE1(test_log_message, Logging::DEBUGGING);
+  TEST_PERFORMANCE1(test_log_message, Logging::INFO);
+  TEST_PERFORMANCE0(test_async_log_message);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
@@ -0,0 +1,488 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+// Starts an in-process core on a generated chain with the daemon's RpcServer and drives it over
+// loopback from many concurrent clients with a configurable mix of JSON and binary requests.
+// Every client sends its next request as soon as the previous one is answered; the report has
+// the throughput and the latency percentiles of every request kind.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/CommandLine.h"
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
+#include "Logging/ConsoleLogger.h"
+#include "P2p/NetNode.h"
+#include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Rpc/HttpClient.h"
+#include "Rpc/RpcServer.h"
+#include "System/ContextGroup.h"
+#include "System/Dispatcher.h"
+#include "System/Event.h"
+#include "TestGenerator/ChainGenerator.h"
+
+namespace po = boost::program_options;
+
+using namespace CryptoNote;
+
+namespace {
+
+const command_line::arg_descriptor<std::string> arg_data_dir = {"data-dir", "Empty directory for the chain, a temporary one by default", "", true};
+const command_line::arg_descriptor<uint32_t> arg_blocks = {"blocks", "Number of blocks to generate", 300};
+const command_line::arg_descriptor<uint32_t> arg_transactions = {"transactions", "Transactions per generated block", 5};
+const command_line::arg_descriptor<uint32_t> arg_mixin = {"mixin", "Ring size - 1 of the generated transactions", 3};
+const command_line::arg_descriptor<uint32_t> arg_send_transactions = {"send-transactions", "Transactions prepared for sendrawtransaction", 500};
+const command_line::arg_descriptor<uint16_t> arg_port = {"port", "Loopback port of the RPC server", RPC_DEFAULT_PORT + 100};
+const command_line::arg_descriptor<uint32_t> arg_clients = {"clients", "Concurrent clients", 16};
+const command_line::arg_descriptor<uint32_t> arg_threads = {"threads", "Threads the clients run on", 2};
+const command_line::arg_descriptor<uint32_t> arg_duration = {"duration", "Seconds to run the load", 10};
+const command_line::arg_descriptor<std::string> arg_mix = {"mix", "Relative weights of the requests",
+  "getblocktemplate:1,getrandom_outs:4,queryblockslite:2,gettransactions:2,sendrawtransaction:1"};
+
+typedef std::chrono::steady_clock Clock;
+
+enum Request {
+  GET_BLOCK_TEMPLATE,
+  GET_RANDOM_OUTS,
+  QUERY_BLOCKS_LITE,
+  GET_TRANSACTIONS,
+  SEND_RAW_TRANSACTION,
+  REQUEST_COUNT
+};
+
+const char* const requestNames[REQUEST_COUNT] = {
+  "getblocktemplate",
+  "getrandom_outs",
+  "queryblockslite",
+  "gettransactions",
+  "sendrawtransaction"
+};
+
+bool parseMix(const std::string& mix, std::vector<uint32_t>& weights) {
+  weights.assign(REQUEST_COUNT, 0);
+  std::istringstream stream(mix);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    size_t separator = entry.find(':');
+    auto name = std::find(std::begin(requestNames), std::end(requestNames), entry.substr(0, separator));
+    if (separator == std::string::npos || name == std::end(requestNames)) {
+      std::cout << "Unknown request in the mix: " << entry << std::endl;
+      return false;
+    }
+
+    try {
+      weights[name - std::begin(requestNames)] = std::stoul(entry.substr(separator + 1));
+    } catch (const std::exception&) {
+      std::cout << "Wrong weight in the mix: " << entry << std::endl;
+      return false;
+    }
+  }
+
+  if (std::all_of(weights.begin(), weights.end(), [](uint32_t weight) { return weight == 0; })) {
+    std::cout << "The mix has no requests" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// what the chain offers to build requests from
+struct Workload {
+  std::string minerAddress;
+  std::vector<Crypto::Hash> blockHashes;
+  std::vector<Crypto::Hash> transactionHashes;
+  std::vector<uint64_t> amounts;
+  uint64_t outputCount;
+  std::vector<std::string> transactions;
+  std::atomic<size_t> nextTransaction;
+};
+
+struct ClientResults {
+  ClientResults() : latencies(REQUEST_COUNT), failures(REQUEST_COUNT, 0) {
+  }
+
+  std::vector<std::vector<Clock::duration>> latencies;
+  std::vector<size_t> failures;
+};
+
+class Client {
+public:
+  Client(System::Dispatcher& dispatcher, uint16_t port, Workload& workload, unsigned seed)
+    : m_client(dispatcher, "127.0.0.1", port), m_workload(workload), m_random(seed) {
+  }
+
+  void run(const std::vector<uint32_t>& weights, Clock::time_point deadline, ClientResults& results) {
+    std::discrete_distribution<int> requests(weights.begin(), weights.end());
+    while (Clock::now() < deadline) {
+      int request = requests(m_random);
+      auto start = Clock::now();
+      bool success;
+      try {
+        success = send(static_cast<Request>(request));
+      } catch (const std::exception&) {
+        success = false;
+      }
+
+      if (success) {
+        results.latencies[request].push_back(Clock::now() - start);
+      } else {
+        ++results.failures[request];
+      }
+    }
+  }
+
+private:
+  template<typename T>
+  const T& pick(const std::vector<T>& values) {
+    return values[std::uniform_int_distribution<size_t>(0, values.size() - 1)(m_random)];
+  }
+
+  bool send(Request request) {
+    switch (request) {
+    case GET_BLOCK_TEMPLATE: {
+      COMMAND_RPC_GET_BLOCK_TEMPLATE::request req;
+      COMMAND_RPC_GET_BLOCK_TEMPLATE::response res;
+      req.reserve_size = 8;
+      req.wallet_address = m_workload.minerAddress;
+      invokeJsonRpcCommand(m_client, "getblocktemplate", req, res);
+      return res.status == CORE_RPC_STATUS_OK;
+    }
+    case GET_RANDOM_OUTS: {
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req;
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response res;
+      req.amounts = m_workload.amounts;
+      req.outs_count = m_workload.outputCount;
+      invokeBinaryCommand(m_client, "/getrandom_outs.bin", req, res);
+      return res.status == CORE_RPC_STATUS_OK;
+    }
+    case QUERY_BLOCKS_LITE: {
+      // a light wallet that knows the chain up to a random block
+      COMMAND_RPC_QUERY_BLOCKS_LITE::request req;
+      COMMAND_RPC_QUERY_BLOCKS_LITE::response res;
+      req.blockIds = { pick(m_workload.blockHashes), m_workload.blockHashes.front() };
+      req.timestamp = 0;
+      invokeBinaryCommand(m_client, "/queryblockslite.bin", req, res);
+      return res.status == CORE_RPC_STATUS_OK;
+    }
+    case GET_TRANSACTIONS: {
+      COMMAND_RPC_GET_TRANSACTIONS::request req;
+      COMMAND_RPC_GET_TRANSACTIONS::response res;
+      for (size_t i = 0; i < 10 && !m_workload.transactionHashes.empty(); ++i) {
+        req.txs_hashes.push_back(Common::podToHex(pick(m_workload.transactionHashes)));
+      }
+
+      invokeJsonCommand(m_client, "/gettransactions", req, res);
+      return res.status == CORE_RPC_STATUS_OK && res.missed_tx.empty();
+    }
+    case SEND_RAW_TRANSACTION: {
+      // once the prepared transactions are used up the pool rejects the repeats as failures
+      COMMAND_RPC_SEND_RAW_TX::request req;
+      COMMAND_RPC_SEND_RAW_TX::response res;
+      if (m_workload.transactions.empty()) {
+        return false;
+      }
+
+      size_t index = m_workload.nextTransaction++;
+      req.tx_as_hex = m_workload.transactions[index % m_workload.transactions.size()];
+      invokeJsonCommand(m_client, "/sendrawtransaction", req, res);
+      return res.status == CORE_RPC_STATUS_OK;
+    }
+    default:
+      return false;
+    }
+  }
+
+  HttpClient m_client;
+  Workload& m_workload;
+  std::mt19937 m_random;
+};
+
+bool prepareChain(const Currency& currency, Logging::ILogger& logger, core& node, const po::variables_map& vm,
+  Workload& workload) {
+  uint32_t mixin = command_line::get_arg(vm, arg_mixin);
+  ChainGenerator generator(currency, logger);
+  bool generated = generator.generate(command_line::get_arg(vm, arg_blocks), command_line::get_arg(vm, arg_transactions),
+    mixin, [&](const ChainBlock& block) {
+    workload.blockHashes.push_back(getBlockHash(block.block));
+    for (const Transaction& transaction : block.transactions) {
+      workload.transactionHashes.push_back(getObjectHash(transaction));
+    }
+
+    // the core starts with the genesis block
+    if (block.block.previousBlockHash == NULL_HASH) {
+      return true;
+    }
+
+    if (node.addChain({ &block }) != 1) {
+      std::cout << "Failed to add block " << workload.blockHashes.size() - 1 << std::endl;
+      return false;
+    }
+
+    return true;
+  });
+
+  if (!generated) {
+    return false;
+  }
+
+  Transaction transaction;
+  while (workload.transactions.size() < command_line::get_arg(vm, arg_send_transactions) &&
+    generator.spendNextOutput(mixin, transaction)) {
+    workload.transactions.push_back(Common::toHex(toBinaryArray(transaction)));
+  }
+
+  // the amounts with the most outputs, as a wallet asks for ring members
+  std::vector<std::pair<uint32_t, uint64_t>> amounts;
+  for (const auto& outputCount : generator.outputCounts()) {
+    amounts.emplace_back(outputCount.second, outputCount.first);
+  }
+
+  std::sort(amounts.rbegin(), amounts.rend());
+  for (size_t i = 0; i < amounts.size() && i < 4; ++i) {
+    workload.amounts.push_back(amounts[i].second);
+  }
+
+  workload.outputCount = mixin + 1;
+  workload.minerAddress = currency.accountAddressAsString(generator.miner());
+  workload.nextTransaction = 0;
+  std::cout << "Generated " << workload.blockHashes.size() - 1 << " blocks with " << workload.transactionHashes.size()
+    << " transactions, prepared " << workload.transactions.size() << " transactions to send" << std::endl;
+  return true;
+}
+
+double toMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// the nearest rank percentile of sorted latencies
+Clock::duration percentile(const std::vector<Clock::duration>& latencies, double fraction) {
+  if (latencies.empty()) {
+    return Clock::duration::zero();
+  }
+
+  size_t rank = static_cast<size_t>(std::ceil(fraction * latencies.size()));
+  return latencies[std::max<size_t>(rank, 1) - 1];
+}
+
+void printReport(std::vector<ClientResults>& clients, Clock::duration duration) {
+  double seconds = std::chrono::duration<double>(duration).count();
+  std::vector<Clock::duration> all;
+  size_t allFailures = 0;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "  " << std::left << std::setw(20) << "request" << std::right << std::setw(10) << "requests"
+    << std::setw(10) << "failed" << std::setw(10) << "req/s" << std::setw(10) << "p50 ms" << std::setw(10)
+    << "p99 ms" << std::setw(10) << "p999 ms" << std::setw(10) << "max ms" << std::endl;
+
+  auto printLine = [&](const char* name, std::vector<Clock::duration>& latencies, size_t failures) {
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "  " << std::left << std::setw(20) << name << std::right << std::setw(10) << latencies.size()
+      << std::setw(10) << failures << std::setw(10) << latencies.size() / seconds
+      << std::setw(10) << toMilliseconds(percentile(latencies, 0.5))
+      << std::setw(10) << toMilliseconds(percentile(latencies, 0.99))
+      << std::setw(10) << toMilliseconds(percentile(latencies, 0.999))
+      << std::setw(10) << toMilliseconds(percentile(latencies, 1.0)) << std::endl;
+  };
+
+  for (size_t request = 0; request < REQUEST_COUNT; ++request) {
+    std::vector<Clock::duration> latencies;
+    size_t failures = 0;
+    for (const ClientResults& client : clients) {
+      latencies.insert(latencies.end(), client.latencies[request].begin(), client.latencies[request].end());
+      failures += client.failures[request];
+    }
+
+    if (latencies.empty() && failures == 0) {
+      continue;
+    }
+
+    all.insert(all.end(), latencies.begin(), latencies.end());
+    allFailures += failures;
+    printLine(requestNames[request], latencies, failures);
+  }
+
+  printLine("all", all, allFailures);
+}
+
+bool runBenchmark(const Currency& currency, Logging::ILogger& logger, const po::variables_map& vm,
+  const std::vector<uint32_t>& weights, const std::string& dataDir) {
+  CoreConfig coreConfig;
+  coreConfig.configFolder = dataDir;
+  MinerConfig minerConfig;
+  core node(currency, nullptr, logger, false);
+  if (!node.init(coreConfig, minerConfig, false)) {
+    std::cout << "Failed to initialize the core in " << dataDir << std::endl;
+    return false;
+  }
+
+  Workload workload;
+  if (!prepareChain(currency, logger, node, vm, workload)) {
+    node.deinit();
+    return false;
+  }
+
+  System::Dispatcher dispatcher;
+  CryptoNoteProtocolHandler protocol(currency, dispatcher, node, nullptr, logger);
+  NodeServer p2p(dispatcher, protocol, logger);
+  protocol.set_p2p_endpoint(&p2p);
+  node.set_cryptonote_protocol(&protocol);
+
+  // a handshake with a peer at the same height marks the node synchronized, the RPC server
+  // refuses most requests before that
+  CORE_SYNC_DATA syncData;
+  CryptoNoteConnectionContext context;
+  protocol.get_payload_sync_data(syncData);
+  protocol.process_payload_sync_data(syncData, context, true);
+
+  uint16_t port = command_line::get_arg(vm, arg_port);
+  RpcServer server(dispatcher, logger, node, p2p, protocol);
+  server.start("127.0.0.1", port);
+
+  uint32_t clientCount = std::max<uint32_t>(command_line::get_arg(vm, arg_clients), 1);
+  uint32_t threadCount = std::min(std::max<uint32_t>(command_line::get_arg(vm, arg_threads), 1), clientCount);
+  std::vector<ClientResults> results(clientCount);
+  System::Event finished(dispatcher);
+  uint32_t runningThreads = threadCount;
+
+  std::cout << "Running " << clientCount << " clients on " << threadCount << " threads for "
+    << command_line::get_arg(vm, arg_duration) << " s" << std::endl;
+  auto start = Clock::now();
+  auto deadline = start + std::chrono::seconds(command_line::get_arg(vm, arg_duration));
+  std::vector<std::thread> threads;
+  for (uint32_t thread = 0; thread < threadCount; ++thread) {
+    threads.emplace_back([&, thread] {
+      {
+        System::Dispatcher clientDispatcher;
+        System::ContextGroup clients(clientDispatcher);
+        for (uint32_t client = thread; client < clientCount; client += threadCount) {
+          clients.spawn([&, client] {
+            Client(clientDispatcher, port, workload, client).run(weights, deadline, results[client]);
+          });
+        }
+
+        clients.wait();
+      }
+
+      dispatcher.remoteSpawn([&] {
+        if (--runningThreads == 0) {
+          finished.set();
+        }
+      });
+    });
+  }
+
+  finished.wait();
+  auto duration = Clock::now() - start;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  server.stop();
+  node.set_cryptonote_protocol(nullptr);
+  protocol.set_p2p_endpoint(nullptr);
+
+  printReport(results, duration);
+  node.deinit();
+  return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    po::options_description desc("Allowed options");
+    command_line::add_arg(desc, command_line::arg_help);
+    command_line::add_arg(desc, arg_data_dir);
+    command_line::add_arg(desc, arg_blocks);
+    command_line::add_arg(desc, arg_transactions);
+    command_line::add_arg(desc, arg_mixin);
+    command_line::add_arg(desc, arg_send_transactions);
+    command_line::add_arg(desc, arg_port);
+    command_line::add_arg(desc, arg_clients);
+    command_line::add_arg(desc, arg_threads);
+    command_line::add_arg(desc, arg_duration);
+    command_line::add_arg(desc, arg_mix);
+
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc, [&]() {
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      po::notify(vm);
+      return true;
+    });
+
+    if (!r) {
+      return 1;
+    }
+
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << "Usage: rpc_benchmark [options]" << std::endl << desc << std::endl;
+      return 0;
+    }
+
+    std::vector<uint32_t> weights;
+    if (!parseMix(command_line::get_arg(vm, arg_mix), weights)) {
+      return 1;
+    }
+
+    Logging::ConsoleLogger logger(Logging::ERROR);
+    Currency currency = CurrencyBuilder(logger).currency();
+
+    boost::filesystem::path dataDir;
+    bool temporary = !command_line::has_arg(vm, arg_data_dir);
+    if (temporary) {
+      dataDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("rpc_benchmark-%%%%-%%%%-%%%%");
+    } else {
+      dataDir = command_line::get_arg(vm, arg_data_dir);
+      if (boost::filesystem::exists(dataDir) && !boost::filesystem::is_empty(dataDir)) {
+        std::cout << "The data directory " << dataDir.string() << " isn't empty" << std::endl;
+        return 1;
+      }
+    }
+
+    bool success = runBenchmark(currency, logger, vm, weights, dataDir.string());
+    if (temporary) {
+      boost::filesystem::remove_all(dataDir);
+    }
+
+    if (!success) {
+      return 1;
+    }
+  } catch (std::exception& e) {
+    std::cout << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
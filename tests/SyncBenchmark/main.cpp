@@ -0,0 +1,273 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+// Replays a chain from a bootstrap file (see BlockchainBootstrap.h) into a fresh data directory
+// through core::addChain, the path blocks from P2P sync take, and reports the throughput and
+// where the time went. A file comes either from exportBlockchain of a synced node or from
+// --generate, which builds a chain of blocks with ring signature transactions.
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/CommandLine.h"
+#include "CryptoNoteCore/BlockchainBootstrap.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "Logging/ConsoleLogger.h"
+#include "TestGenerator/ChainGenerator.h"
+
+namespace po = boost::program_options;
+
+using namespace CryptoNote;
+
+namespace {
+
+const command_line::arg_descriptor<std::string> arg_generate = {"generate", "Write a generated chain to this bootstrap file", "", true};
+const command_line::arg_descriptor<std::string> arg_replay = {"replay", "Replay the chain of this bootstrap file", "", true};
+const command_line::arg_descriptor<std::string> arg_data_dir = {"data-dir", "Empty directory to replay into, a temporary one by default", "", true};
+const command_line::arg_descriptor<uint32_t> arg_blocks = {"blocks", "Number of blocks to generate", 1000};
+const command_line::arg_descriptor<uint32_t> arg_transactions = {"transactions", "Transactions per generated block", 10};
+const command_line::arg_descriptor<uint32_t> arg_mixin = {"mixin", "Ring size - 1 of the generated transactions", 3};
+
+typedef std::chrono::steady_clock Clock;
+
+double toMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool generateChain(const Currency& currency, Logging::ILogger& logger, const std::string& fileName,
+  uint32_t blockCount, size_t transactionsPerBlock, size_t mixin) {
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    std::cout << "Failed to open " << fileName << std::endl;
+    return false;
+  }
+
+  BlockchainBootstrapWriter writer(file);
+  ChainGenerator generator(currency, logger);
+  size_t transactionCount = 0;
+  bool generated = generator.generate(blockCount, transactionsPerBlock, mixin, [&](const ChainBlock& block) {
+    RawBlock rawBlock;
+    rawBlock.block = toBinaryArray(block.block);
+    for (const Transaction& transaction : block.transactions) {
+      rawBlock.transactions.push_back(toBinaryArray(transaction));
+    }
+
+    writer.write(rawBlock);
+    transactionCount += block.transactions.size();
+    return true;
+  });
+
+  if (!generated) {
+    return false;
+  }
+
+  file.flush();
+  if (!file) {
+    std::cout << "Failed to write " << fileName << std::endl;
+    return false;
+  }
+
+  std::cout << "Generated " << blockCount << " blocks with " << transactionCount << " transactions" << std::endl;
+  return true;
+}
+
+Blockchain::PushBlockTimings operator-(Blockchain::PushBlockTimings a, const Blockchain::PushBlockTimings& b) {
+  a.blocks -= b.blocks;
+  a.transactions -= b.transactions;
+  a.total -= b.total;
+  a.difficulty -= b.difficulty;
+  a.proofOfWork -= b.proofOfWork;
+  a.transactionInputs -= b.transactionInputs;
+  a.indices -= b.indices;
+  a.storage -= b.storage;
+  return a;
+}
+
+void printStage(const char* name, Clock::duration duration, Clock::duration total) {
+  std::cout << "  " << std::left << std::setw(24) << name << std::right << std::setw(12)
+    << toMilliseconds(duration) << " ms" << std::setw(8)
+    << (total.count() == 0 ? 0.0 : 100.0 * duration.count() / total.count()) << " %" << std::endl;
+}
+
+bool replayChain(const Currency& currency, Logging::ILogger& logger, const std::string& fileName,
+  const std::string& dataDir) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file) {
+    std::cout << "Failed to open " << fileName << std::endl;
+    return false;
+  }
+
+  BlockchainBootstrapReader reader(file);
+  CoreConfig coreConfig;
+  coreConfig.configFolder = dataDir;
+  MinerConfig minerConfig;
+  core node(currency, nullptr, logger, false);
+  if (!node.init(coreConfig, minerConfig, false)) {
+    std::cout << "Failed to initialize the core in " << dataDir << std::endl;
+    return false;
+  }
+
+  Blockchain::PushBlockTimings initialTimings = node.get_blockchain_storage().getPushBlockTimings();
+  Clock::duration deserialization = Clock::duration::zero();
+  Clock::duration addChain = Clock::duration::zero();
+  uint32_t blockCount = 0;
+  size_t transactionCount = 0;
+  bool success = true;
+
+  RawBlock rawBlock;
+  ChainBlock block;
+  auto start = Clock::now();
+  while (reader.read(rawBlock)) {
+    auto stageStart = Clock::now();
+    block.transactions.resize(rawBlock.transactions.size());
+    bool parsed = fromBinaryArray(block.block, rawBlock.block);
+    for (size_t i = 0; parsed && i < rawBlock.transactions.size(); ++i) {
+      Crypto::Hash hash;
+      Crypto::Hash prefixHash;
+      parsed = parseAndValidateTransactionFromBinaryArray(rawBlock.transactions[i], block.transactions[i], hash, prefixHash);
+    }
+
+    deserialization += Clock::now() - stageStart;
+    if (!parsed) {
+      std::cout << "Failed to parse block " << blockCount << std::endl;
+      success = false;
+      break;
+    }
+
+    // the fresh chain already has the genesis block
+    if (block.block.previousBlockHash == NULL_HASH && getBlockHash(block.block) == currency.genesisBlockHash()) {
+      continue;
+    }
+
+    stageStart = Clock::now();
+    size_t added = node.addChain({ &block });
+    addChain += Clock::now() - stageStart;
+    if (added != 1) {
+      std::cout << "Failed to add block " << get_block_height(block.block) << std::endl;
+      success = false;
+      break;
+    }
+
+    ++blockCount;
+    transactionCount += block.transactions.size();
+  }
+
+  auto total = Clock::now() - start;
+  Blockchain::PushBlockTimings timings = node.get_blockchain_storage().getPushBlockTimings() - initialTimings;
+  node.deinit();
+
+  double seconds = std::chrono::duration<double>(total).count();
+  Clock::duration stages = timings.difficulty + timings.proofOfWork + timings.transactionInputs +
+    timings.indices + timings.storage;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Replayed " << blockCount << " blocks with " << transactionCount << " transactions in "
+    << seconds << " s" << std::endl;
+  std::cout << "  " << blockCount / seconds << " blocks/s, " << transactionCount / seconds << " transactions/s" << std::endl;
+  printStage("deserialization", deserialization, total);
+  printStage("pool admission", addChain - timings.total, total);
+  printStage("difficulty", timings.difficulty, total);
+  printStage("proof of work", timings.proofOfWork, total);
+  printStage("transaction inputs", timings.transactionInputs, total);
+  printStage("indices", timings.indices, total);
+  printStage("storage", timings.storage, total);
+  printStage("other block checks", timings.total - stages, total);
+  printStage("replay loop", total - deserialization - addChain, total);
+
+  return success;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    po::options_description desc("Allowed options");
+    command_line::add_arg(desc, command_line::arg_help);
+    command_line::add_arg(desc, arg_generate);
+    command_line::add_arg(desc, arg_replay);
+    command_line::add_arg(desc, arg_data_dir);
+    command_line::add_arg(desc, arg_blocks);
+    command_line::add_arg(desc, arg_transactions);
+    command_line::add_arg(desc, arg_mixin);
+
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc, [&]() {
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      po::notify(vm);
+      return true;
+    });
+
+    if (!r) {
+      return 1;
+    }
+
+    if (command_line::get_arg(vm, command_line::arg_help) ||
+      (!command_line::has_arg(vm, arg_generate) && !command_line::has_arg(vm, arg_replay))) {
+      std::cout << "Usage: sync_benchmark [--generate <file>] [--replay <file>]" << std::endl << desc << std::endl;
+      return 0;
+    }
+
+    Logging::ConsoleLogger logger(Logging::ERROR);
+    Currency currency = CurrencyBuilder(logger).currency();
+
+    if (command_line::has_arg(vm, arg_generate)) {
+      if (!generateChain(currency, logger, command_line::get_arg(vm, arg_generate),
+        command_line::get_arg(vm, arg_blocks), command_line::get_arg(vm, arg_transactions),
+        command_line::get_arg(vm, arg_mixin))) {
+        return 1;
+      }
+    }
+
+    if (command_line::has_arg(vm, arg_replay)) {
+      boost::filesystem::path dataDir;
+      bool temporary = !command_line::has_arg(vm, arg_data_dir);
+      if (temporary) {
+        dataDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("sync_benchmark-%%%%-%%%%-%%%%");
+      } else {
+        dataDir = command_line::get_arg(vm, arg_data_dir);
+        if (boost::filesystem::exists(dataDir) && !boost::filesystem::is_empty(dataDir)) {
+          std::cout << "The data directory " << dataDir.string() << " isn't empty" << std::endl;
+          return 1;
+        }
+      }
+
+      bool success = replayChain(currency, logger, command_line::get_arg(vm, arg_replay), dataDir.string());
+      if (temporary) {
+        boost::filesystem::remove_all(dataDir);
+      }
+
+      if (!success) {
+        return 1;
+      }
+    }
+  } catch (std::exception& e) {
+    std::cout << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
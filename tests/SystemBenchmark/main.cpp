@@ -0,0 +1,363 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures what the coroutines of System cost the networked components on top of them: spawning
+// a context, switching between two contexts, waking a context with an Event, sleeping on a Timer,
+// spawning from another thread and moving bytes and connections over loopback TCP. The numbers
+// are the baseline for changes to the context switch or the dispatcher.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Common/CommandLine.h"
+#include "System/ContextGroup.h"
+#include "System/Dispatcher.h"
+#include "System/Event.h"
+#include "System/Ipv4Address.h"
+#include "System/TcpConnection.h"
+#include "System/TcpConnector.h"
+#include "System/TcpListener.h"
+#include "System/Timer.h"
+
+namespace po = boost::program_options;
+
+using namespace System;
+
+namespace {
+
+const command_line::arg_descriptor<std::string> arg_benchmark = {"benchmark", "Run only this benchmark", "", true};
+const command_line::arg_descriptor<uint32_t> arg_scale = {"scale", "Multiply the iterations of every benchmark", 1};
+const command_line::arg_descriptor<uint16_t> arg_port = {"port", "First of the two loopback ports of the TCP benchmarks", 6680};
+
+const Ipv4Address LOOPBACK("127.0.0.1");
+// contexts spawned at a time, they have a stack each
+const size_t SPAWN_BATCH = 64;
+const size_t TIMER_CONTEXTS = 16;
+const size_t ECHO_CHUNK_SIZE = 64 * 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+  uint64_t operations;
+  Clock::duration duration;
+  // what an operation is and the figures beyond the rate
+  std::string note;
+};
+
+double toMicroseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// the nearest rank percentile of sorted latencies
+Clock::duration percentile(const std::vector<Clock::duration>& latencies, double fraction) {
+  if (latencies.empty()) {
+    return Clock::duration::zero();
+  }
+
+  size_t rank = static_cast<size_t>(fraction * latencies.size() + 0.5);
+  return latencies[std::min(latencies.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+void writeAll(TcpConnection& connection, const uint8_t* data, size_t size) {
+  while (size > 0) {
+    size_t written = connection.write(data, size);
+    data += written;
+    size -= written;
+  }
+}
+
+bool readAll(TcpConnection& connection, uint8_t* data, size_t size) {
+  while (size > 0) {
+    size_t read = connection.read(data, size);
+    if (read == 0) {
+      return false;
+    }
+
+    data += read;
+    size -= read;
+  }
+
+  return true;
+}
+
+// spawns empty contexts in batches and waits for them, a spawn includes running the context
+Result benchmarkSpawn(Dispatcher& dispatcher, uint64_t count) {
+  ContextGroup group(dispatcher);
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < count; i += SPAWN_BATCH) {
+    for (uint64_t j = i; j < std::min(count, i + SPAWN_BATCH); ++j) {
+      group.spawn([] {});
+    }
+
+    group.wait();
+  }
+
+  return { count, Clock::now() - start, "spawn, run and finish a context" };
+}
+
+// hands the dispatcher back and forth between the main context and a peer, nothing else runs
+Result benchmarkContextSwitch(Dispatcher& dispatcher, uint64_t count) {
+  NativeContext* mainContext = dispatcher.getCurrentContext();
+  NativeContext* peerContext = nullptr;
+  ContextGroup group(dispatcher);
+  group.spawn([&] {
+    peerContext = dispatcher.getCurrentContext();
+    for (uint64_t i = 0; i < count; ++i) {
+      dispatcher.pushContext(mainContext);
+      dispatcher.dispatch();
+    }
+  });
+
+  // the peer starts, takes its first turn and hands back
+  dispatcher.pushContext(mainContext);
+  dispatcher.dispatch();
+
+  auto start = Clock::now();
+  for (uint64_t i = 1; i < count; ++i) {
+    dispatcher.pushContext(peerContext);
+    dispatcher.dispatch();
+  }
+
+  auto duration = Clock::now() - start;
+  // the peer leaves its loop and the group resumes the main context
+  dispatcher.pushContext(peerContext);
+  group.wait();
+
+  return { 2 * (count - 1), duration, "one switch" };
+}
+
+// two contexts wake each other through a pair of events
+Result benchmarkEvent(Dispatcher& dispatcher, uint64_t count) {
+  Event ping(dispatcher);
+  Event pong(dispatcher);
+  ContextGroup group(dispatcher);
+  group.spawn([&] {
+    for (uint64_t i = 0; i < count; ++i) {
+      ping.wait();
+      ping.clear();
+      pong.set();
+    }
+  });
+
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    ping.set();
+    pong.wait();
+    pong.clear();
+  }
+
+  auto duration = Clock::now() - start;
+  group.wait();
+
+  return { 2 * count, duration, "set an event and resume its waiter" };
+}
+
+// many contexts sleeping a microsecond at a time
+Result benchmarkTimer(Dispatcher& dispatcher, uint64_t count) {
+  uint64_t sleepsPerContext = std::max<uint64_t>(1, count / TIMER_CONTEXTS);
+  ContextGroup group(dispatcher);
+  auto start = Clock::now();
+  for (size_t i = 0; i < TIMER_CONTEXTS; ++i) {
+    group.spawn([&] {
+      Timer timer(dispatcher);
+      for (uint64_t j = 0; j < sleepsPerContext; ++j) {
+        timer.sleep(std::chrono::microseconds(1));
+      }
+    });
+  }
+
+  group.wait();
+
+  std::ostringstream note;
+  note << "1 us sleep in one of " << TIMER_CONTEXTS << " contexts";
+  return { sleepsPerContext * TIMER_CONTEXTS, Clock::now() - start, note.str() };
+}
+
+// another thread spawns one procedure at a time and waits until it has run
+Result benchmarkRemoteSpawn(Dispatcher& dispatcher, uint64_t count) {
+  std::vector<Clock::duration> latencies;
+  latencies.reserve(count);
+  std::atomic<uint64_t> completed(0);
+  Event finished(dispatcher);
+  auto start = Clock::now();
+  std::thread sender([&] {
+    for (uint64_t i = 0; i < count; ++i) {
+      auto sent = Clock::now();
+      dispatcher.remoteSpawn([&, sent] {
+        latencies.push_back(Clock::now() - sent);
+        if (completed.fetch_add(1) + 1 == count) {
+          finished.set();
+        }
+      });
+
+      while (completed.load() <= i) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  finished.wait();
+  auto duration = Clock::now() - start;
+  sender.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  std::ostringstream note;
+  note << std::fixed << std::setprecision(1) << "spawn to run latency p50 "
+    << toMicroseconds(percentile(latencies, 0.5)) << " us, p99 " << toMicroseconds(percentile(latencies, 0.99))
+    << " us, max " << toMicroseconds(percentile(latencies, 1.0)) << " us";
+  return { count, duration, note.str() };
+}
+
+// a client writes chunks that an echo context sends back on the same dispatcher
+Result benchmarkTcpEcho(Dispatcher& dispatcher, uint16_t port, uint64_t count) {
+  TcpListener listener(dispatcher, LOOPBACK, port);
+  ContextGroup group(dispatcher);
+  group.spawn([&] {
+    TcpConnection connection = listener.accept();
+    std::vector<uint8_t> buffer(ECHO_CHUNK_SIZE);
+    for (;;) {
+      size_t size = connection.read(buffer.data(), buffer.size());
+      if (size == 0) {
+        break;
+      }
+
+      writeAll(connection, buffer.data(), size);
+    }
+  });
+
+  TcpConnection connection = TcpConnector(dispatcher).connect(LOOPBACK, port);
+  std::vector<uint8_t> out(ECHO_CHUNK_SIZE, 0x5a);
+  std::vector<uint8_t> in(ECHO_CHUNK_SIZE);
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    writeAll(connection, out.data(), out.size());
+    if (!readAll(connection, in.data(), in.size())) {
+      throw std::runtime_error("The echo connection was closed");
+    }
+  }
+
+  auto duration = Clock::now() - start;
+  connection = TcpConnection();
+  group.wait();
+
+  double seconds = std::chrono::duration<double>(duration).count();
+  std::ostringstream note;
+  note << std::fixed << std::setprecision(1) << ECHO_CHUNK_SIZE / 1024 << " KiB round trip, "
+    << 2.0 * count * ECHO_CHUNK_SIZE / seconds / (1024 * 1024) << " MiB/s both ways";
+  return { count, duration, note.str() };
+}
+
+// connects and closes connections that a context accepts and closes
+Result benchmarkTcpAccept(Dispatcher& dispatcher, uint16_t port, uint64_t count) {
+  TcpListener listener(dispatcher, LOOPBACK, port);
+  ContextGroup group(dispatcher);
+  group.spawn([&] {
+    for (uint64_t i = 0; i < count; ++i) {
+      TcpConnection connection = listener.accept();
+    }
+  });
+
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    TcpConnection connection = TcpConnector(dispatcher).connect(LOOPBACK, port);
+  }
+
+  group.wait();
+
+  return { count, Clock::now() - start, "connect and accept" };
+}
+
+void printResult(const std::string& name, const Result& result) {
+  double seconds = std::chrono::duration<double>(result.duration).count();
+  double nanoseconds = std::chrono::duration<double, std::nano>(result.duration).count();
+  std::cout << "  " << std::left << std::setw(16) << name << std::right << std::setw(12) << result.operations
+    << std::setw(12) << (result.operations == 0 ? 0.0 : nanoseconds / result.operations)
+    << std::setw(14) << (seconds == 0 ? 0.0 : result.operations / seconds) << "  " << result.note << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    po::options_description desc("Allowed options");
+    command_line::add_arg(desc, command_line::arg_help);
+    command_line::add_arg(desc, arg_benchmark);
+    command_line::add_arg(desc, arg_scale);
+    command_line::add_arg(desc, arg_port);
+
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc, [&]() {
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      po::notify(vm);
+      return true;
+    });
+
+    if (!r) {
+      return 1;
+    }
+
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << "Usage: system_benchmark [options]" << std::endl << desc << std::endl;
+      return 0;
+    }
+
+    uint64_t scale = std::max<uint32_t>(1, command_line::get_arg(vm, arg_scale));
+    uint16_t port = command_line::get_arg(vm, arg_port);
+    Dispatcher dispatcher;
+
+    typedef std::function<Result()> Benchmark;
+    const std::vector<std::pair<std::string, Benchmark>> benchmarks = {
+      { "spawn", [&] { return benchmarkSpawn(dispatcher, 100000 * scale); } },
+      { "context_switch", [&] { return benchmarkContextSwitch(dispatcher, 1000000 * scale); } },
+      { "event", [&] { return benchmarkEvent(dispatcher, 500000 * scale); } },
+      { "timer", [&] { return benchmarkTimer(dispatcher, 100000 * scale); } },
+      { "remote_spawn", [&] { return benchmarkRemoteSpawn(dispatcher, 20000 * scale); } },
+      { "tcp_echo", [&] { return benchmarkTcpEcho(dispatcher, port, 20000 * scale); } },
+      { "tcp_accept", [&] { return benchmarkTcpAccept(dispatcher, port + 1, 2000 * scale); } }
+    };
+
+    std::string only = command_line::has_arg(vm, arg_benchmark) ? command_line::get_arg(vm, arg_benchmark) : "";
+    if (!only.empty() && std::none_of(benchmarks.begin(), benchmarks.end(),
+      [&](const std::pair<std::string, Benchmark>& benchmark) { return benchmark.first == only; })) {
+      std::cout << "Unknown benchmark " << only << std::endl;
+      return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  " << std::left << std::setw(16) << "benchmark" << std::right << std::setw(12) << "operations"
+      << std::setw(12) << "ns/op" << std::setw(14) << "op/s" << "  operation" << std::endl;
+    for (const auto& benchmark : benchmarks) {
+      if (only.empty() || benchmark.first == only) {
+        printResult(benchmark.first, benchmark.second());
+      }
+    }
+  } catch (std::exception& e) {
+    std::cout << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
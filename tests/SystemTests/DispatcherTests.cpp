@@ -19,6 +19,7 @@
 
 #include <future>
 #include <System/Context.h>
+#include <System/ContextGroup.h>
 #include <System/Dispatcher.h>
 #include <System/Event.h>
 #include <System/Timer.h>
@@ -350,6 +351,102 @@ TEST_F(DispatcherTests, spawnJustSpawns) {
   ASSERT_TRUE(spawnDone);
 }
 
+#ifdef __linux__
+TEST_F(DispatcherTests, idleStacksAreReleasedBeyondHotContexts) {
+  const size_t CONTEXT_COUNT = 64;
+  {
+    ContextGroup group(dispatcher);
+    for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+      group.spawn([]() {});
+    }
+
+    group.wait();
+  }
+
+  ASSERT_EQ(CONTEXT_COUNT, dispatcher.getReusableContextCount());
+  ASSERT_EQ(0, dispatcher.getReleasedContextCount());
+
+  // the dispatcher releases stacks when it runs out of work
+  Timer(dispatcher).sleep(std::chrono::milliseconds(1));
+  ASSERT_EQ(CONTEXT_COUNT, dispatcher.getReusableContextCount());
+  size_t released = dispatcher.getReleasedContextCount();
+  ASSERT_LT(0, released);
+  ASSERT_GT(CONTEXT_COUNT, released);
+
+  // contexts reuse the hot stacks first, the released ones run as well
+  {
+    ContextGroup group(dispatcher);
+    size_t done = 0;
+    for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+      group.spawn([&]() { ++done; });
+    }
+
+    group.wait();
+    ASSERT_EQ(CONTEXT_COUNT, done);
+  }
+
+  ASSERT_EQ(CONTEXT_COUNT, dispatcher.getReusableContextCount());
+}
+
+TEST_F(DispatcherTests, releasingIdleStacksKeepsStacksOfRunningContexts) {
+  const size_t CONTEXT_COUNT = 64;
+  {
+    ContextGroup group(dispatcher);
+    for (size_t i = 0; i < 2 * CONTEXT_COUNT; ++i) {
+      group.spawn([]() {});
+    }
+
+    group.wait();
+  }
+
+  // half of the contexts run and sleep on their filled stacks, while the idle half is released
+  ContextGroup group(dispatcher);
+  size_t verified = 0;
+  for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+    group.spawn([&, i]() {
+      volatile uint8_t buffer[64 * 1024];
+      for (size_t j = 0; j < sizeof buffer; ++j) {
+        buffer[j] = static_cast<uint8_t>(i + j);
+      }
+
+      Timer(dispatcher).sleep(std::chrono::milliseconds(1));
+      for (size_t j = 0; j < sizeof buffer; ++j) {
+        if (buffer[j] != static_cast<uint8_t>(i + j)) {
+          return;
+        }
+      }
+
+      ++verified;
+    });
+  }
+
+  group.wait();
+  ASSERT_EQ(CONTEXT_COUNT, verified);
+  ASSERT_LT(0, dispatcher.getReleasedContextCount());
+}
+#endif
+
+TEST_F(DispatcherTests, contextSwitchKeepsFloatingPointValues) {
+  auto compute = [&](double value, bool yield) {
+    for (int i = 0; i < 100; ++i) {
+      value = value * 1.5 + 0.25;
+      if (yield) {
+        dispatcher.yield();
+      }
+    }
+
+    return value;
+  };
+
+  double results[2];
+  ContextGroup group(dispatcher);
+  group.spawn([&]() { results[0] = compute(1, true); });
+  group.spawn([&]() { results[1] = compute(2, true); });
+  group.wait();
+  ASSERT_EQ(compute(1, false), results[0]);
+  ASSERT_EQ(compute(2, false), results[1]);
+}
+
 TEST_F(DispatcherTests, yieldReturnsIfNothingToSpawn) {
   dispatcher.yield();
 }
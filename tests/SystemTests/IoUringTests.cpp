@@ -0,0 +1,326 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+// The dispatcher waits in io_uring where the kernel has it, these tests check that it does and
+// cover what only the ring path does: timeouts, cancels, RECV, SEND and ACCEPT.
+#ifdef __linux__
+
+#include <thread>
+#include <System/Dispatcher.h>
+#include <System/ContextGroup.h>
+#include <System/InterruptedException.h>
+#include <System/Ipv4Address.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/TcpListener.h>
+#include <System/Timer.h>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+namespace {
+
+const Ipv4Address LISTEN_ADDRESS("127.0.0.1");
+const uint16_t LISTEN_PORT = 6666;
+
+}
+
+class IoUringTests : public testing::Test {
+public:
+  IoUringTests() : contextGroup(dispatcher) {
+  }
+
+  // false where the kernel lacks io_uring, the dispatcher then waits with epoll alone
+  bool hasRing() const {
+    return dispatcher.getIoUring() != nullptr;
+  }
+
+  Dispatcher dispatcher;
+  ContextGroup contextGroup;
+};
+
+TEST_F(IoUringTests, timerExpiresInRing) {
+  if (!hasRing()) {
+    return;
+  }
+
+  auto timepoint1 = std::chrono::steady_clock::now();
+  Timer(dispatcher).sleep(std::chrono::milliseconds(50));
+  auto timepoint2 = std::chrono::steady_clock::now();
+  ASSERT_LE(45, std::chrono::duration_cast<std::chrono::milliseconds>(timepoint2 - timepoint1).count());
+}
+
+TEST_F(IoUringTests, timerIsRemovedOnInterrupt) {
+  if (!hasRing()) {
+    return;
+  }
+
+  bool interrupted = false;
+  contextGroup.spawn([&] {
+    try {
+      Timer(dispatcher).sleep(std::chrono::seconds(10));
+    } catch (InterruptedException &) {
+      interrupted = true;
+    }
+  });
+
+  auto timepoint1 = std::chrono::steady_clock::now();
+  dispatcher.yield();
+  contextGroup.interrupt();
+  contextGroup.wait();
+  auto timepoint2 = std::chrono::steady_clock::now();
+  ASSERT_TRUE(interrupted);
+  ASSERT_GT(1000, std::chrono::duration_cast<std::chrono::milliseconds>(timepoint2 - timepoint1).count());
+}
+
+TEST_F(IoUringTests, expiredTimerIgnoresInterruptThatCameWithIt) {
+  if (!hasRing()) {
+    return;
+  }
+
+  bool slept = false;
+  bool interruptKept = true;
+  contextGroup.spawn([&] {
+    Timer(dispatcher).sleep(std::chrono::milliseconds(1));
+    slept = true;
+    interruptKept = dispatcher.interrupted();
+  });
+
+  // the timeout completes with -ETIME in the kernel before the interrupt removes it
+  dispatcher.yield();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  contextGroup.interrupt();
+  contextGroup.wait();
+  ASSERT_TRUE(slept);
+  ASSERT_FALSE(interruptKept);
+}
+
+TEST_F(IoUringTests, acceptCompletesInRing) {
+  if (!hasRing()) {
+    return;
+  }
+
+  TcpListener listener(dispatcher, LISTEN_ADDRESS, LISTEN_PORT);
+  TcpConnection accepted;
+  contextGroup.spawn([&] {
+    accepted = listener.accept();
+  });
+
+  dispatcher.yield();
+  TcpConnection connection = TcpConnector(dispatcher).connect(LISTEN_ADDRESS, LISTEN_PORT);
+  contextGroup.wait();
+  ASSERT_EQ(4, connection.write(reinterpret_cast<const uint8_t *>("Test"), 4));
+  uint8_t data[4];
+  ASSERT_EQ(4, accepted.read(data, 4));
+  ASSERT_EQ(0, memcmp(data, "Test", 4));
+}
+
+TEST_F(IoUringTests, acceptIsReusableAfterInterrupt) {
+  if (!hasRing()) {
+    return;
+  }
+
+  TcpListener listener(dispatcher, LISTEN_ADDRESS, LISTEN_PORT);
+  bool interrupted = false;
+  contextGroup.spawn([&] {
+    try {
+      listener.accept();
+    } catch (InterruptedException &) {
+      interrupted = true;
+    }
+  });
+
+  dispatcher.yield();
+  contextGroup.interrupt();
+  contextGroup.wait();
+  ASSERT_TRUE(interrupted);
+
+  contextGroup.spawn([&] {
+    ASSERT_NO_THROW(listener.accept());
+  });
+
+  dispatcher.yield();
+  TcpConnector(dispatcher).connect(LISTEN_ADDRESS, LISTEN_PORT);
+  contextGroup.wait();
+}
+
+class IoUringConnectionTests : public IoUringTests {
+public:
+  IoUringConnectionTests() : listener(dispatcher, LISTEN_ADDRESS, LISTEN_PORT) {
+  }
+
+  void connect() {
+    connection1 = TcpConnector(dispatcher).connect(LISTEN_ADDRESS, LISTEN_PORT);
+    connection2 = listener.accept();
+  }
+
+  TcpListener listener;
+  TcpConnection connection1;
+  TcpConnection connection2;
+};
+
+TEST_F(IoUringConnectionTests, readWaitsInRingForData) {
+  if (!hasRing()) {
+    return;
+  }
+
+  connect();
+  size_t transferred = 0;
+  uint8_t data[16];
+  contextGroup.spawn([&] {
+    transferred = connection2.read(data, sizeof data);
+  });
+
+  dispatcher.yield();
+  ASSERT_EQ(0, transferred);
+  connection1.write(reinterpret_cast<const uint8_t *>("Test"), 4);
+  contextGroup.wait();
+  ASSERT_EQ(4, transferred);
+  ASSERT_EQ(0, memcmp(data, "Test", 4));
+}
+
+TEST_F(IoUringConnectionTests, readReturnsZeroWhenPeerCloses) {
+  if (!hasRing()) {
+    return;
+  }
+
+  connect();
+  size_t transferred = 1;
+  contextGroup.spawn([&] {
+    uint8_t data[16];
+    transferred = connection2.read(data, sizeof data);
+  });
+
+  dispatcher.yield();
+  connection1 = TcpConnection();
+  contextGroup.wait();
+  ASSERT_EQ(0, transferred);
+}
+
+TEST_F(IoUringConnectionTests, readIsReusableAfterInterrupt) {
+  if (!hasRing()) {
+    return;
+  }
+
+  connect();
+  bool interrupted = false;
+  contextGroup.spawn([&] {
+    uint8_t data[16];
+    try {
+      connection2.read(data, sizeof data);
+    } catch (InterruptedException &) {
+      interrupted = true;
+    }
+  });
+
+  dispatcher.yield();
+  contextGroup.interrupt();
+  contextGroup.wait();
+  ASSERT_TRUE(interrupted);
+
+  size_t transferred = 0;
+  contextGroup.spawn([&] {
+    uint8_t data[16];
+    transferred = connection2.read(data, sizeof data);
+  });
+
+  dispatcher.yield();
+  connection1.write(reinterpret_cast<const uint8_t *>("Test"), 4);
+  contextGroup.wait();
+  ASSERT_EQ(4, transferred);
+}
+
+TEST_F(IoUringConnectionTests, writeWaitsInRingUntilPeerReads) {
+  if (!hasRing()) {
+    return;
+  }
+
+  connect();
+  // larger than both socket buffers, so the writer waits for the reader
+  std::vector<uint8_t> sent(16 * 1024 * 1024);
+  for (size_t i = 0; i < sent.size(); ++i) {
+    sent[i] = static_cast<uint8_t>(i * 31);
+  }
+
+  contextGroup.spawn([&] {
+    size_t offset = 0;
+    while (offset < sent.size()) {
+      offset += connection1.write(sent.data() + offset, sent.size() - offset);
+    }
+
+    connection1 = TcpConnection();
+  });
+
+  std::vector<uint8_t> received;
+  contextGroup.spawn([&] {
+    uint8_t data[64 * 1024];
+    size_t transferred;
+    while ((transferred = connection2.read(data, sizeof data)) != 0) {
+      received.insert(received.end(), data, data + transferred);
+    }
+  });
+
+  contextGroup.wait();
+  ASSERT_EQ(sent, received);
+}
+
+TEST_F(IoUringConnectionTests, writeIsReusableAfterInterrupt) {
+  if (!hasRing()) {
+    return;
+  }
+
+  connect();
+  std::vector<uint8_t> chunk(1024 * 1024);
+  size_t sent = 0;
+  bool interrupted = false;
+  contextGroup.spawn([&] {
+    try {
+      for (;;) {
+        sent += connection1.write(chunk.data(), chunk.size());
+      }
+    } catch (InterruptedException &) {
+      interrupted = true;
+    }
+  });
+
+  // the writer fills the socket buffers and waits in the ring
+  dispatcher.yield();
+  contextGroup.interrupt();
+  contextGroup.wait();
+  ASSERT_TRUE(interrupted);
+
+  size_t received = 0;
+  contextGroup.spawn([&] {
+    sent += connection1.write(chunk.data(), chunk.size());
+    connection1 = TcpConnection();
+  });
+
+  contextGroup.spawn([&] {
+    std::vector<uint8_t> data(chunk.size());
+    size_t transferred;
+    while ((transferred = connection2.read(data.data(), data.size())) != 0) {
+      received += transferred;
+    }
+  });
+
+  contextGroup.wait();
+  ASSERT_EQ(sent, received);
+}
+
+#endif
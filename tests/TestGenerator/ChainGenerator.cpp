@@ -0,0 +1,173 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ChainGenerator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+
+using namespace CryptoNote;
+
+ChainGenerator::ChainGenerator(const Currency& currency, Logging::ILogger& logger)
+  : m_currency(currency), m_logger(logger), m_generator(currency) {
+  m_miner.generate();
+}
+
+bool ChainGenerator::generate(uint32_t blockCount, size_t transactionsPerBlock, size_t mixin,
+  const BlockHandler& handler) {
+  ChainBlock chainBlock;
+  chainBlock.block = m_currency.genesisBlock();
+  std::vector<size_t> blockSizes;
+  m_generator.addBlock(chainBlock.block, 0, 0, blockSizes, 0);
+  addOutputs(chainBlock.block.baseTransaction, 0);
+  if (!handler(chainBlock)) {
+    return false;
+  }
+
+  for (uint32_t height = 1; height <= blockCount; ++height) {
+    unlockOutputs(height);
+
+    std::list<Transaction> transactions;
+    while (transactions.size() < transactionsPerBlock && !m_spendableOutputs.empty()) {
+      Transaction transaction;
+      if (!spendOutput(m_spendableOutputs.front(), mixin, transaction)) {
+        return false;
+      }
+
+      m_spendableOutputs.pop_front();
+      transactions.push_back(std::move(transaction));
+    }
+
+    Block block;
+    if (!m_generator.constructBlock(block, chainBlock.block, m_miner, transactions)) {
+      std::cout << "Failed to construct block " << height << std::endl;
+      return false;
+    }
+
+    addOutputs(block.baseTransaction, height);
+    for (const Transaction& transaction : transactions) {
+      addOutputs(transaction, height);
+    }
+
+    chainBlock.block = std::move(block);
+    chainBlock.transactions.assign(std::make_move_iterator(transactions.begin()),
+      std::make_move_iterator(transactions.end()));
+    if (!handler(chainBlock)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ChainGenerator::spendNextOutput(size_t mixin, Transaction& transaction) {
+  if (m_spendableOutputs.empty()) {
+    return false;
+  }
+
+  if (!spendOutput(m_spendableOutputs.front(), mixin, transaction)) {
+    return false;
+  }
+
+  m_spendableOutputs.pop_front();
+  return true;
+}
+
+// counts the outputs of every amount for the global indexes, keeps the coinbase outputs of the miner
+void ChainGenerator::addOutputs(const Transaction& transaction, uint32_t height) {
+  std::vector<size_t> ownOutputs;
+  uint64_t amount;
+  bool isCoinbase = transaction.inputs.size() == 1 && transaction.inputs[0].type() == typeid(BaseInput);
+  if (isCoinbase) {
+    lookup_acc_outs(m_miner.getAccountKeys(), transaction, ownOutputs, amount);
+  }
+
+  Crypto::PublicKey transactionPublicKey = getTransactionPublicKeyFromExtra(transaction.extra);
+  for (size_t i = 0; i < transaction.outputs.size(); ++i) {
+    const TransactionOutput& output = transaction.outputs[i];
+    if (output.target.type() != typeid(KeyOutput)) {
+      continue;
+    }
+
+    uint32_t globalIndex = m_outputCounts[output.amount]++;
+    if (std::find(ownOutputs.begin(), ownOutputs.end(), i) != ownOutputs.end()) {
+      Output own = { output.amount, globalIndex, boost::get<KeyOutput>(output.target).key,
+        transactionPublicKey, i, height };
+      m_lockedOutputs.push_back(own);
+    }
+  }
+}
+
+// the unlock window is kept with a block to spare, the node checks it against its own height
+void ChainGenerator::unlockOutputs(uint32_t height) {
+  while (!m_lockedOutputs.empty() &&
+    m_lockedOutputs.front().height + m_currency.minedMoneyUnlockWindow() < height) {
+    const Output& output = m_lockedOutputs.front();
+    m_ringMembers[output.amount].push_back(output);
+    if (output.amount > m_currency.minimumFee()) {
+      m_spendableOutputs.push_back(output);
+    }
+
+    m_lockedOutputs.pop_front();
+  }
+}
+
+bool ChainGenerator::spendOutput(const Output& output, size_t mixin, Transaction& transaction) {
+  TransactionSourceEntry source;
+  source.amount = output.amount;
+  source.realTransactionPublicKey = output.transactionPublicKey;
+  source.realOutputIndexInTransaction = output.indexInTransaction;
+
+  // the latest mature outputs of the amount besides the real one
+  const std::vector<Output>& members = m_ringMembers[output.amount];
+  for (auto it = members.rbegin(); it != members.rend() && source.outputs.size() < mixin; ++it) {
+    if (it->globalIndex != output.globalIndex) {
+      source.outputs.emplace_back(it->globalIndex, it->key);
+    }
+  }
+
+  source.outputs.emplace_back(output.globalIndex, output.key);
+  std::sort(source.outputs.begin(), source.outputs.end(),
+    [](const TransactionSourceEntry::OutputEntry& a, const TransactionSourceEntry::OutputEntry& b) {
+      return a.first < b.first;
+    });
+  source.realOutput = std::find_if(source.outputs.begin(), source.outputs.end(),
+    [&](const TransactionSourceEntry::OutputEntry& entry) {
+      return entry.first == output.globalIndex;
+    }) - source.outputs.begin();
+
+  std::vector<TransactionDestinationEntry> destinations;
+  decompose_amount_into_digits(output.amount - m_currency.minimumFee(), 0,
+    [&](uint64_t chunk) { destinations.emplace_back(chunk, m_miner.getAccountKeys().address); },
+    [&](uint64_t dust) { destinations.emplace_back(dust, m_miner.getAccountKeys().address); });
+
+  Crypto::SecretKey transactionKey;
+  if (!constructTransaction(m_miner.getAccountKeys(), { source }, destinations, std::vector<uint8_t>(),
+    transaction, 0, transactionKey, m_logger)) {
+    std::cout << "Failed to construct a transaction spending output " << output.globalIndex
+      << " of amount " << m_currency.formatAmount(output.amount) << std::endl;
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/IBlock.h"
+#include "Logging/ILogger.h"
+
+#include "TestGenerator.h"
+
+// A block with its transactions, the form core::addChain takes.
+class ChainBlock : public CryptoNote::IBlock {
+public:
+  const CryptoNote::Block& getBlock() const override { return block; }
+  size_t getTransactionCount() const override { return transactions.size(); }
+  const CryptoNote::Transaction& getTransaction(size_t index) const override { return transactions[index]; }
+
+  CryptoNote::Block block;
+  std::vector<CryptoNote::Transaction> transactions;
+};
+
+// Builds blocks with test_generator on top of the genesis block of the currency. Every block
+// spends mature coinbase outputs of earlier blocks, with ring members of the same amount, so that
+// a node verifies ring signatures the way a real chain needs it.
+class ChainGenerator {
+public:
+  typedef std::function<bool(const ChainBlock&)> BlockHandler;
+
+  ChainGenerator(const CryptoNote::Currency& currency, Logging::ILogger& logger);
+
+  // Passes the genesis block and blockCount new blocks to the handler, stops with false when the
+  // handler returns false. A generator builds one chain, call it once.
+  bool generate(uint32_t blockCount, size_t transactionsPerBlock, size_t mixin, const BlockHandler& handler);
+
+  // Builds a transaction for the next block on top of the generated chain that spends a mature
+  // output no other transaction spends. Returns false when there are none left.
+  bool spendNextOutput(size_t mixin, CryptoNote::Transaction& transaction);
+
+  const CryptoNote::AccountBase& miner() const { return m_miner; }
+  // the number of key outputs of every amount in the chain
+  const std::map<uint64_t, uint32_t>& outputCounts() const { return m_outputCounts; }
+
+private:
+  struct Output {
+    uint64_t amount;
+    uint32_t globalIndex;
+    Crypto::PublicKey key;
+    Crypto::PublicKey transactionPublicKey;
+    size_t indexInTransaction;
+    uint32_t height;
+  };
+
+  void addOutputs(const CryptoNote::Transaction& transaction, uint32_t height);
+  void unlockOutputs(uint32_t height);
+  bool spendOutput(const Output& output, size_t mixin, CryptoNote::Transaction& transaction);
+
+  const CryptoNote::Currency& m_currency;
+  Logging::ILogger& m_logger;
+  test_generator m_generator;
+  CryptoNote::AccountBase m_miner;
+  std::map<uint64_t, uint32_t> m_outputCounts;
+  std::deque<Output> m_lockedOutputs;
+  std::deque<Output> m_spendableOutputs;
+  std::map<uint64_t, std::vector<Output>> m_ringMembers;
+};
@@ -107,6 +107,13 @@ bool ICoreStub::handle_incoming_tx(CryptoNote::BinaryArray const &tx_blob,
     return true;
 }
 
+void ICoreStub::handleIncomingTransactions(
+    const std::vector<CryptoNote::BinaryArray> &transactions,
+    std::vector<CryptoNote::tx_verification_context> &tvcs)
+{
+    tvcs.assign(transactions.size(), CryptoNote::tx_verification_context());
+}
+
 void ICoreStub::set_blockchain_top(uint32_t height, const Crypto::Hash &top_id)
 {
     topHeight = height;
@@ -156,6 +163,18 @@ bool ICoreStub::getPoolChanges(const Crypto::Hash &tailBlockId,
     return poolChangesResult;
 }
 
+// the stub keeps no change log, so the changes are always found by diffing
+bool ICoreStub::getPoolChanges(const Crypto::Hash &tailBlockId,
+                               const std::vector<Crypto::Hash> &knownTxsIds,
+                               uint64_t knownPoolVersion,
+                               std::vector<CryptoNote::Transaction> &addedTxs,
+                               std::vector<Crypto::Hash> &deletedTxsIds,
+                               uint64_t &poolVersion)
+{
+    poolVersion = 0;
+    return getPoolChanges(tailBlockId, knownTxsIds, addedTxs, deletedTxsIds);
+}
+
 bool ICoreStub::getPoolChangesLite(const Crypto::Hash &tailBlockId,
                                    const std::vector<Crypto::Hash> &knownTxsIds,
                                    std::vector<CryptoNote::TransactionPrefixInfo> &addedTxs,
@@ -198,6 +217,14 @@ bool ICoreStub::queryBlocksLite(const std::vector<Crypto::Hash> &block_ids, uint
     return true;
 }
 
+bool ICoreStub::queryBlocksCompact(const std::vector<Crypto::Hash> &block_ids, uint64_t timestamp,
+                                   uint32_t &start_height, uint32_t &current_height,
+                                   uint32_t &full_offset, std::string &blocks)
+{
+    // stub
+    return true;
+}
+
 bool ICoreStub::queryBlocksDetailed(const std::vector<Crypto::Hash> &knownBlockHashes,
                                     uint64_t timestamp, uint32_t &startIndex,
                                     uint32_t &currentIndex, uint32_t &fullOffset,
@@ -305,6 +332,14 @@ bool ICoreStub::getTransactionsWithOutputGlobalIndexes(
         const std::vector<Crypto::Hash> &txsIds, std::list<Crypto::Hash> &missedTxs,
         std::vector<std::pair<CryptoNote::Transaction, std::vector<uint32_t>>> &txs)
 {
+    for (const Crypto::Hash &hash : txsIds) {
+        auto iter = transactions.find(hash);
+        if (iter != transactions.end()) {
+            txs.emplace_back(iter->second, globalIndices);
+        } else {
+            missedTxs.push_back(hash);
+        }
+    }
     return true;
 }
 
@@ -403,6 +438,31 @@ void ICoreStub::addBlock(const CryptoNote::Block &block)
     m_observerManager.notify(&CryptoNote::ICoreObserver::blockchainUpdated);
 }
 
+void ICoreStub::addPoolTransaction(const CryptoNote::Transaction &tx)
+{
+    transactionPool.emplace(std::make_pair(CryptoNote::getObjectHash(tx), tx));
+    m_observerManager.notify(&CryptoNote::ICoreObserver::poolUpdated);
+}
+
+void ICoreStub::removePoolTransaction(const Crypto::Hash &txHash)
+{
+    transactionPool.erase(txHash);
+    m_observerManager.notify(&CryptoNote::ICoreObserver::poolUpdated);
+}
+
+void ICoreStub::popBlocks(uint32_t height)
+{
+    assert(height > 0 && height <= topHeight);
+    for (uint32_t h = height; h <= topHeight; ++h) {
+        blockHashByHeightIndex.erase(h);
+    }
+
+    topHeight = height - 1;
+    topId = blockHashByHeightIndex[topHeight];
+
+    m_observerManager.notify(&CryptoNote::ICoreObserver::blockchainUpdated);
+}
+
 void ICoreStub::addTransaction(const CryptoNote::Transaction &tx)
 {
     Crypto::Hash hash = CryptoNote::getObjectHash(tx);
@@ -51,6 +51,8 @@ public:
     virtual bool handle_incoming_tx(const CryptoNote::BinaryArray &tx_blob,
                                     CryptoNote::tx_verification_context &tvc, bool keeped_by_block,
                                     bool loose_check) override;
+    virtual void handleIncomingTransactions(const std::vector<CryptoNote::BinaryArray> &transactions,
+                                            std::vector<CryptoNote::tx_verification_context> &tvcs) override;
     virtual std::vector<CryptoNote::Transaction> getPoolTransactions() override;
     virtual bool getPoolChanges(const Crypto::Hash &tailBlockId,
                                 const std::vector<Crypto::Hash> &knownTxsIds,
@@ -60,6 +62,12 @@ public:
                                     const std::vector<Crypto::Hash> &knownTxsIds,
                                     std::vector<CryptoNote::TransactionPrefixInfo> &addedTxs,
                                     std::vector<Crypto::Hash> &deletedTxsIds) override;
+    virtual bool getPoolChanges(const Crypto::Hash &tailBlockId,
+                                const std::vector<Crypto::Hash> &knownTxsIds,
+                                uint64_t knownPoolVersion,
+                                std::vector<CryptoNote::Transaction> &addedTxs,
+                                std::vector<Crypto::Hash> &deletedTxsIds,
+                                uint64_t &poolVersion) override;
     virtual void getPoolChanges(const std::vector<Crypto::Hash> &knownTxsIds,
                                 std::vector<CryptoNote::Transaction> &addedTxs,
                                 std::vector<Crypto::Hash> &deletedTxsIds) override;
@@ -71,6 +79,9 @@ public:
                                  uint32_t &start_height, uint32_t &current_height,
                                  uint32_t &full_offset,
                                  std::vector<CryptoNote::BlockShortInfo> &entries) override;
+    virtual bool queryBlocksCompact(const std::vector<Crypto::Hash> &block_ids, uint64_t timestamp,
+                                    uint32_t &start_height, uint32_t &current_height,
+                                    uint32_t &full_offset, std::string &blocks) override;
     virtual bool queryBlocksDetailed(const std::vector<Crypto::Hash> &knownBlockHashes,
                                      uint64_t timestamp, uint32_t &startIndex,
                                      uint32_t &currentIndex, uint32_t &fullOffset,
@@ -192,7 +203,11 @@ public:
                     bool result);
 
     void addBlock(const CryptoNote::Block &block);
+    // drops the main chain blocks from height on, as a reorganization does before the new ones
+    void popBlocks(uint32_t height);
     void addTransaction(const CryptoNote::Transaction &tx);
+    void addPoolTransaction(const CryptoNote::Transaction &tx);
+    void removePoolTransaction(const Crypto::Hash &txHash);
 
     void setPoolTxVerificationResult(bool result);
     void setPoolChangesResult(bool result);
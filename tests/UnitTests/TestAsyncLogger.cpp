@@ -0,0 +1,122 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Logging/AsyncLogger.h"
+
+using namespace Logging;
+
+namespace {
+
+struct Message {
+  std::string category;
+  Level level;
+  std::string body;
+};
+
+// collects messages, optionally holding the writer inside the first one until released
+class CollectingLogger : public ILogger {
+public:
+  explicit CollectingLogger(bool holdFirst = false) : m_hold(holdFirst) {
+  }
+
+  void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_messages.push_back({category, level, body});
+    m_cv.notify_all();
+    m_cv.wait(lk, [this] { return !m_hold; });
+  }
+
+  void waitForFirstMessage() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_cv.wait(lk, [this] { return !m_messages.empty(); });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_hold = false;
+    m_cv.notify_all();
+  }
+
+  std::vector<Message> messages() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_messages;
+  }
+
+private:
+  bool m_hold;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<Message> m_messages;
+};
+
+void log(ILogger& logger, const std::string& body) {
+  logger("Test", INFO, boost::posix_time::microsec_clock::local_time(), body);
+}
+
+}
+
+TEST(AsyncLogger, flushesQueuedMessagesAtShutdown) {
+  CollectingLogger sink;
+  {
+    AsyncLogger logger(sink, 128);
+    for (size_t i = 0; i < 100; ++i) {
+      log(logger, std::to_string(i));
+    }
+  }
+
+  std::vector<Message> messages = sink.messages();
+  ASSERT_EQ(100, messages.size());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    EXPECT_EQ("Test", messages[i].category);
+    EXPECT_EQ(INFO, messages[i].level);
+    EXPECT_EQ(std::to_string(i), messages[i].body);
+  }
+}
+
+TEST(AsyncLogger, countsMessagesDroppedWhileQueueIsFull) {
+  CollectingLogger sink(true);
+  {
+    AsyncLogger logger(sink, 4);
+    log(logger, "0");
+    // the writer holds "0" in the sink, so the queue only takes the next four
+    sink.waitForFirstMessage();
+    for (size_t i = 1; i <= 7; ++i) {
+      log(logger, std::to_string(i));
+    }
+
+    sink.release();
+  }
+
+  std::vector<Message> messages = sink.messages();
+  ASSERT_EQ(6, messages.size());
+  for (size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(std::to_string(i), messages[i].body);
+  }
+
+  EXPECT_EQ("AsyncLogger", messages[5].category);
+  EXPECT_EQ(WARNING, messages[5].level);
+  EXPECT_EQ("3 log messages dropped\n", messages[5].body);
+}
@@ -1282,15 +1282,21 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   m_node.setGetNewBlocksLimit(10);
 
   std::atomic<int> requestsCount(0);
+  std::atomic<bool> restarted(false);
   std::list<Hash> firstlyKnownBlockIdsTaken;
   std::list<Hash> secondlyKnownBlockIdsTaken;
 
   std::vector<Hash> firstlyReceivedBlocks;
   std::vector<Hash> secondlyReceivedBlocks;
 
+  // batches are requested ahead of the consumer, so the consumer counts its own calls:
+  // its second call gets the blocks of the second request
+  int consumerCallsCount = 0;
 
   c.onNewBlocksFunctor = [&](const CompleteBlock* blocks, uint32_t, size_t count) -> bool {
-    if (requestsCount == 2) {
+    ++consumerCallsCount;
+
+    if (consumerCallsCount == 2) {
       for (size_t i = 0; i < count; ++i) {
         firstlyReceivedBlocks.push_back(blocks[i].blockHash);
       }
@@ -1298,7 +1304,7 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
       return false;
     }
 
-    if (requestsCount == 3) {
+    if (consumerCallsCount == 3) {
       for (size_t i = 0; i < count; ++i) {
         secondlyReceivedBlocks.push_back(blocks[i].blockHash);
       }
@@ -1314,7 +1320,9 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
       firstlyKnownBlockIdsTaken.assign(knownBlockIds.begin(), knownBlockIds.end());
     }
 
-    if (requestsCount == 3) {
+    // batches requested ahead of the failed one are dropped, the first request after
+    // the restart asks for the failed batch again
+    if (restarted && secondlyKnownBlockIdsTaken.empty()) {
       secondlyKnownBlockIdsTaken.assign(knownBlockIds.begin(), knownBlockIds.end());
     }
 
@@ -1327,6 +1335,8 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   e.wait();
   m_sync.stop();
 
+  restarted = true;
+
   m_sync.start();
   e.wait();
   m_sync.stop();
@@ -1337,6 +1347,69 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   EXPECT_EQ(firstlyReceivedBlocks, secondlyReceivedBlocks);
 }
 
+TEST_F(BcSTest, checkNextBlocksAreRequestedWhileConsumerAddsBlocks) {
+  FunctorialBlockhainConsumerStub c(m_currency.genesisBlockHash());
+  IBlockchainSynchronizerFunctorialObserver o1;
+  EventWaiter e;
+  o1.syncFunc = [&](std::error_code) {
+    e.notify();
+  };
+
+  generator.generateEmptyBlocks(30);
+  m_node.setGetNewBlocksLimit(10);
+
+  std::mutex requestsMutex;
+  std::vector<std::vector<Hash>> knownBlockIdsTaken;
+  EventWaiter thirdRequest;
+
+  m_node.queryBlocksFunctor = [&](const std::vector<Hash>& knownBlockIds, uint64_t timestamp, std::vector<BlockShortEntry>& newBlocks, uint32_t& startHeight, const INode::Callback& callback) -> bool {
+    std::lock_guard<std::mutex> lock(requestsMutex);
+    knownBlockIdsTaken.push_back(knownBlockIds);
+    if (knownBlockIdsTaken.size() == 3) {
+      thirdRequest.notify();
+    }
+
+    return true;
+  };
+
+  bool requestedWhileAdding = false;
+  std::vector<Hash> batchTops;
+  std::vector<Hash> receivedBlocks;
+
+  c.onNewBlocksFunctor = [&](const CompleteBlock* blocks, uint32_t, size_t count) -> bool {
+    if (receivedBlocks.empty()) {
+      // the first batch isn't added until two more are requested
+      requestedWhileAdding = thirdRequest.wait_for(std::chrono::seconds(5));
+    }
+
+    batchTops.push_back(blocks[count - 1].blockHash);
+    for (size_t i = 0; i < count; ++i) {
+      receivedBlocks.push_back(blocks[i].blockHash);
+    }
+
+    return true;
+  };
+
+  m_sync.addObserver(&o1);
+  m_sync.addConsumer(&c);
+  m_sync.start();
+  e.wait();
+  m_sync.stop();
+  m_sync.removeObserver(&o1);
+  o1.syncFunc = [](std::error_code) {};
+
+  EXPECT_TRUE(requestedWhileAdding);
+  ASSERT_GE(knownBlockIdsTaken.size(), 3);
+  ASSERT_GE(batchTops.size(), 2);
+  // the requests continue from the blocks that are fetched, but not added yet
+  EXPECT_EQ(batchTops[0], knownBlockIdsTaken[1].front());
+  EXPECT_EQ(batchTops[1], knownBlockIdsTaken[2].front());
+  EXPECT_EQ(m_currency.genesisBlockHash(), knownBlockIdsTaken[2].back());
+  ASSERT_FALSE(receivedBlocks.empty());
+  EXPECT_EQ(getBlockHash(generator.getBlockchain().back()), receivedBlocks.back());
+  EXPECT_EQ(std::unordered_set<Hash>(receivedBlocks.begin(), receivedBlocks.end()).size(), receivedBlocks.size());
+}
+
 TEST_F(BcSTest, checkTxOrder) {
   FunctorialBlockhainConsumerStub c(m_currency.genesisBlockHash());
   IBlockchainSynchronizerFunctorialObserver o1;
@@ -0,0 +1,103 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "CryptoNoteCore/BlockchainBootstrap.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+RawBlock makeRawBlock(uint8_t seed, size_t transactionCount) {
+  RawBlock block;
+  block.block.assign(80 + seed, seed);
+  for (size_t i = 0; i < transactionCount; ++i) {
+    block.transactions.emplace_back(100 + i * 300, static_cast<uint8_t>(seed + i));
+  }
+
+  return block;
+}
+
+std::string writeBlocks(const std::vector<RawBlock>& blocks) {
+  std::stringstream stream;
+  BlockchainBootstrapWriter writer(stream);
+  for (const auto& block : blocks) {
+    writer.write(block);
+  }
+
+  return stream.str();
+}
+
+}
+
+TEST(BlockchainBootstrap, readReturnsWrittenBlocks) {
+  std::vector<RawBlock> blocks { makeRawBlock(1, 0), makeRawBlock(2, 1), makeRawBlock(3, 5) };
+  std::stringstream stream(writeBlocks(blocks));
+
+  BlockchainBootstrapReader reader(stream);
+  RawBlock block;
+  for (const auto& expected : blocks) {
+    ASSERT_TRUE(reader.read(block));
+    EXPECT_EQ(expected.block, block.block);
+    EXPECT_EQ(expected.transactions, block.transactions);
+  }
+
+  EXPECT_FALSE(reader.read(block));
+}
+
+TEST(BlockchainBootstrap, emptyFileHasNoBlocks) {
+  std::stringstream stream(writeBlocks({}));
+
+  BlockchainBootstrapReader reader(stream);
+  RawBlock block;
+  EXPECT_FALSE(reader.read(block));
+}
+
+TEST(BlockchainBootstrap, readerRejectsForeignFile) {
+  std::string data = writeBlocks({ makeRawBlock(1, 1) });
+  data[0] = 'X';
+  std::stringstream stream(data);
+
+  EXPECT_THROW(BlockchainBootstrapReader reader(stream), std::runtime_error);
+}
+
+TEST(BlockchainBootstrap, readerRejectsCorruptedRecord) {
+  std::string data = writeBlocks({ makeRawBlock(1, 1), makeRawBlock(2, 2) });
+  data[data.size() - 20] ^= 0x01;
+  std::stringstream stream(data);
+
+  BlockchainBootstrapReader reader(stream);
+  RawBlock block;
+  ASSERT_TRUE(reader.read(block));
+  EXPECT_THROW(reader.read(block), std::runtime_error);
+}
+
+TEST(BlockchainBootstrap, readerRejectsTruncatedRecord) {
+  std::string data = writeBlocks({ makeRawBlock(1, 2) });
+  data.resize(data.size() - 3);
+  std::stringstream stream(data);
+
+  BlockchainBootstrapReader reader(stream);
+  RawBlock block;
+  EXPECT_THROW(reader.read(block), std::runtime_error);
+}
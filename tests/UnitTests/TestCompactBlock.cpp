@@ -0,0 +1,159 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+#include "CryptoNoteCore/CompactBlock.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+Crypto::Hash makeHash(uint8_t seed) {
+  Crypto::Hash hash;
+  std::fill(std::begin(hash.data), std::end(hash.data), seed);
+  return hash;
+}
+
+Crypto::PublicKey makeKey(uint8_t seed) {
+  Crypto::PublicKey key;
+  std::fill(std::begin(key.data), std::end(key.data), seed);
+  return key;
+}
+
+Transaction makeCoinbase(uint32_t height) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = height + 60;
+  transaction.inputs.push_back(BaseInput{ height });
+  transaction.outputs.push_back(TransactionOutput{ 7000000, KeyOutput{ makeKey(1) } });
+  transaction.outputs.push_back(TransactionOutput{ 300, KeyOutput{ makeKey(2) } });
+  transaction.extra = { 1, 2, 3, 4 };
+  return transaction;
+}
+
+Transaction makeTransaction() {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = 0;
+
+  KeyInput keyInput;
+  keyInput.amount = 1000;
+  keyInput.outputIndexes = { 5, 17, 2 };
+  std::fill(std::begin(keyInput.keyImage.data), std::end(keyInput.keyImage.data), 9);
+  transaction.inputs.push_back(keyInput);
+  transaction.inputs.push_back(MultiSignatureInput{ 200, 2, 11 });
+
+  MultiSignatureOutput multisignatureOutput;
+  multisignatureOutput.keys = { makeKey(3), makeKey(4), makeKey(5) };
+  multisignatureOutput.requiredSignatureCount = 2;
+  transaction.outputs.push_back(TransactionOutput{ 900, KeyOutput{ makeKey(6) } });
+  transaction.outputs.push_back(TransactionOutput{ 100, multisignatureOutput });
+  transaction.extra = { 1, 8, 8, 8 };
+  return transaction;
+}
+
+std::string encodeTransactions(const Transaction& coinbase, const Transaction& transaction) {
+  std::string result;
+  CompactTransactionsWriter writer(result, 2);
+  writer.write(getObjectHash(coinbase), coinbase);
+  writer.write(makeHash(42), transaction);
+  return result;
+}
+
+}
+
+TEST(CompactBlock, readReturnsWrittenBlocks) {
+  Transaction coinbase = makeCoinbase(10);
+  Transaction transaction = makeTransaction();
+
+  std::string data;
+  CompactBlocksWriter writer(data);
+  writer.writeHash(makeHash(1));
+  writer.write(makeHash(2), 1000000, encodeTransactions(coinbase, transaction));
+  writer.write(makeHash(3), 999990, encodeTransactions(coinbase, transaction));
+
+  CompactBlocksReader reader(data);
+  CompactBlock block;
+  ASSERT_TRUE(reader.read(block));
+  EXPECT_EQ(makeHash(1), block.hash);
+  EXPECT_FALSE(block.hasTransactions);
+
+  ASSERT_TRUE(reader.read(block));
+  EXPECT_EQ(makeHash(2), block.hash);
+  ASSERT_TRUE(block.hasTransactions);
+  EXPECT_EQ(1000000, block.timestamp);
+  ASSERT_EQ(2, block.transactions.size());
+
+  // the coinbase is kept intact, so its hash can be recomputed
+  Transaction decodedCoinbase;
+  static_cast<TransactionPrefix&>(decodedCoinbase) = block.transactions[0].prefix;
+  EXPECT_EQ(getObjectHash(coinbase), block.transactions[0].hash);
+  EXPECT_EQ(getObjectHash(coinbase), getObjectHash(decodedCoinbase));
+
+  const TransactionPrefix& decoded = block.transactions[1].prefix;
+  EXPECT_EQ(makeHash(42), block.transactions[1].hash);
+  EXPECT_EQ(transaction.unlockTime, decoded.unlockTime);
+  EXPECT_EQ(transaction.extra, decoded.extra);
+  ASSERT_EQ(2, decoded.inputs.size());
+  const KeyInput& keyInput = boost::get<KeyInput>(decoded.inputs[0]);
+  EXPECT_EQ(1000, keyInput.amount);
+  EXPECT_EQ(boost::get<KeyInput>(transaction.inputs[0]).keyImage, keyInput.keyImage);
+  EXPECT_TRUE(keyInput.outputIndexes.empty());
+  EXPECT_EQ(11, boost::get<MultiSignatureInput>(decoded.inputs[1]).outputIndex);
+  ASSERT_EQ(2, decoded.outputs.size());
+  EXPECT_EQ(900, decoded.outputs[0].amount);
+  EXPECT_EQ(makeKey(6), boost::get<KeyOutput>(decoded.outputs[0].target).key);
+  const MultiSignatureOutput& multisignatureOutput =
+    boost::get<MultiSignatureOutput>(decoded.outputs[1].target);
+  EXPECT_EQ(3, multisignatureOutput.keys.size());
+  EXPECT_EQ(2, multisignatureOutput.requiredSignatureCount);
+
+  ASSERT_TRUE(reader.read(block));
+  EXPECT_EQ(makeHash(3), block.hash);
+  EXPECT_EQ(999990, block.timestamp);
+
+  EXPECT_FALSE(reader.read(block));
+}
+
+TEST(CompactBlock, readerRejectsTruncatedData) {
+  std::string data;
+  CompactBlocksWriter writer(data);
+  writer.write(makeHash(2), 1000000, encodeTransactions(makeCoinbase(10), makeTransaction()));
+  data.resize(data.size() - 3);
+
+  CompactBlocksReader reader(data);
+  CompactBlock block;
+  EXPECT_THROW(reader.read(block), std::runtime_error);
+}
+
+TEST(CompactBlock, readerRejectsUnknownEntry) {
+  std::string data;
+  CompactBlocksWriter writer(data);
+  writer.writeHash(makeHash(1));
+  data[0] = 7;
+
+  CompactBlocksReader reader(data);
+  CompactBlock block;
+  EXPECT_THROW(reader.read(block), std::runtime_error);
+}
@@ -128,6 +128,49 @@ TEST(parseTransactionExtra, handles_pub_key_and_padding)
   ASSERT_EQ(typeid(CryptoNote::TransactionExtraPadding), tx_extra_fields[1].type());
 }
 
+TEST(parseTransactionExtra, info_takes_first_field_of_each_kind)
+{
+  Crypto::PublicKey pub_key;
+  std::fill(std::begin(pub_key.data), std::end(pub_key.data), 7);
+  Crypto::Hash payment_id;
+  std::fill(std::begin(payment_id.data), std::end(payment_id.data), 9);
+  CryptoNote::BinaryArray extra_nonce;
+  CryptoNote::setPaymentIdToTransactionExtraNonce(extra_nonce, payment_id);
+
+  std::vector<uint8_t> extra;
+  ASSERT_TRUE(CryptoNote::addTransactionPublicKeyToExtra(extra, pub_key));
+  ASSERT_TRUE(CryptoNote::addExtraNonceToTransactionExtra(extra, extra_nonce));
+  ASSERT_TRUE(CryptoNote::addExtraNonceToTransactionExtra(extra, CryptoNote::BinaryArray{ 1, 2 }));
+  CryptoNote::appendTTLToExtra(extra, 1234);
+
+  CryptoNote::TransactionExtraInfo info;
+  CryptoNote::parseTransactionExtra(extra, info);
+  ASSERT_TRUE(info.complete);
+  ASSERT_TRUE(info.hasPublicKey);
+  ASSERT_EQ(pub_key, info.publicKey);
+  ASSERT_TRUE(info.hasNonce);
+  ASSERT_EQ(extra_nonce, info.nonce);
+  ASSERT_TRUE(info.hasPaymentId);
+  ASSERT_EQ(payment_id, info.paymentId);
+  ASSERT_TRUE(info.hasTtl);
+  ASSERT_EQ(1234, info.ttl);
+  ASSERT_FALSE(info.hasMergeMiningTag);
+
+  std::vector<CryptoNote::TransactionExtraField> tx_extra_fields;
+  ASSERT_TRUE(CryptoNote::parseTransactionExtra(extra, tx_extra_fields));
+  CryptoNote::TransactionExtraInfo fields_info;
+  CryptoNote::getTransactionExtraInfo(tx_extra_fields, fields_info);
+  ASSERT_EQ(pub_key, fields_info.publicKey);
+  ASSERT_EQ(extra_nonce, fields_info.nonce);
+  ASSERT_EQ(payment_id, fields_info.paymentId);
+  ASSERT_EQ(1234, fields_info.ttl);
+
+  extra.push_back(TX_EXTRA_NONCE);
+  CryptoNote::parseTransactionExtra(extra, info);
+  ASSERT_FALSE(info.complete);
+  ASSERT_TRUE(info.hasPaymentId);
+}
+
 TEST(parse_and_validate_tx_extra, is_valid_tx_extra_parsed)
 {
   Logging::LoggerGroup logger;
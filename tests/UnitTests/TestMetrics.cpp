@@ -0,0 +1,132 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "Common/Metrics.h"
+
+using namespace Metrics;
+
+TEST(Metrics, histogramIsEmptyAtStart) {
+  Histogram histogram;
+  ASSERT_EQ(0, histogram.count());
+  ASSERT_EQ(0, histogram.sum().count());
+  ASSERT_EQ(0, histogram.quantile(0.5).count());
+}
+
+TEST(Metrics, histogramKeepsSmallValuesExact) {
+  Histogram histogram;
+  for (int i = 1; i <= 10; ++i) {
+    histogram.record(std::chrono::nanoseconds(i));
+  }
+
+  ASSERT_EQ(10, histogram.count());
+  ASSERT_EQ(55, histogram.sum().count());
+  ASSERT_EQ(1, histogram.quantile(0).count());
+  ASSERT_EQ(5, histogram.quantile(0.5).count());
+  ASSERT_EQ(9, histogram.quantile(0.9).count());
+  ASSERT_EQ(10, histogram.quantile(1).count());
+}
+
+TEST(Metrics, histogramQuantilesAreWithinSixteenth) {
+  Histogram histogram;
+  for (int64_t i = 1; i <= 100000; ++i) {
+    histogram.record(std::chrono::microseconds(i));
+  }
+
+  const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+  for (double fraction : fractions) {
+    double exact = fraction * 100000 * 1000;
+    double estimate = static_cast<double>(histogram.quantile(fraction).count());
+    ASSERT_GE(estimate, exact * (1 - 1.0 / 16)) << fraction;
+    ASSERT_LE(estimate, exact * (1 + 1.0 / 16)) << fraction;
+  }
+}
+
+TEST(Metrics, histogramClampsHugeValues) {
+  Histogram histogram;
+  histogram.record(std::chrono::hours(24 * 365));
+  histogram.record(std::chrono::nanoseconds(-5));
+
+  ASSERT_EQ(2, histogram.count());
+  ASSERT_EQ(0, histogram.quantile(0.5).count());
+  ASSERT_GT(histogram.quantile(1), std::chrono::minutes(15));
+}
+
+TEST(Metrics, countersAddUpAcrossThreads) {
+  Counter counter;
+  Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 10000; ++j) {
+        counter.add();
+        histogram.record(std::chrono::nanoseconds(j));
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(40000, counter.value());
+  ASSERT_EQ(40000, histogram.count());
+}
+
+TEST(Metrics, timedMutexRecordsEveryLock) {
+  Histogram waits;
+  TimedMutex<std::recursive_mutex> mutex(waits);
+  {
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    std::lock_guard<decltype(mutex)> nested(mutex);
+  }
+
+  ASSERT_EQ(2, waits.count());
+  ASSERT_EQ(0, waits.sum().count());
+}
+
+TEST(Metrics, registryReturnsSameMetricForSameLabels) {
+  Registry registry;
+  Counter& a = registry.counter("requests_total", "Requests", { { "method", "a" } });
+  Counter& b = registry.counter("requests_total", "Requests", { { "method", "b" } });
+  ASSERT_NE(&a, &b);
+  ASSERT_EQ(&a, &registry.counter("requests_total", "Requests", { { "method", "a" } }));
+  ASSERT_THROW(registry.gauge("requests_total", "Requests"), std::invalid_argument);
+}
+
+TEST(Metrics, registryFormatsPrometheusText) {
+  Registry registry;
+  registry.counter("requests_total", "Handled requests", { { "method", "get\"info\"" } }).add(3);
+  registry.gauge("height", "Chain height").set(42);
+  registry.histogram("latency_seconds", "Latency").record(std::chrono::milliseconds(2));
+
+  std::string text = registry.format();
+  ASSERT_NE(std::string::npos, text.find("# HELP requests_total Handled requests\n# TYPE requests_total counter\n"));
+  ASSERT_NE(std::string::npos, text.find("requests_total{method=\"get\\\"info\\\"\"} 3\n"));
+  ASSERT_NE(std::string::npos, text.find("# TYPE height gauge\nheight 42\n"));
+  ASSERT_NE(std::string::npos, text.find("# TYPE latency_seconds summary\n"));
+  ASSERT_NE(std::string::npos, text.find("latency_seconds{quantile=\"0.5\"} 0.002"));
+  ASSERT_NE(std::string::npos, text.find("latency_seconds_sum 0.002\n"));
+  ASSERT_NE(std::string::npos, text.find("latency_seconds_count 1\n"));
+}
@@ -0,0 +1,310 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "Logging/ConsoleLogger.h"
+#include "NodeRpcProxy/NodeErrors.h"
+#include "NodeRpcProxy/NodeRpcProxy.h"
+#include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Rpc/HttpServer.h"
+#include "Serialization/SerializationTools.h"
+#include "System/Dispatcher.h"
+#include "System/Event.h"
+#include "System/Timer.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint16_t DAEMON_PORT = 18391;
+
+// answers the commands under test after a delay, and counts how many it serves at once
+class SlowDaemon : public HttpServer {
+public:
+  SlowDaemon(System::Dispatcher& dispatcher, Logging::ILogger& log) : HttpServer(dispatcher, log) {
+  }
+
+  std::atomic<unsigned int> delay{0};
+  std::atomic<size_t> inFlight{0};
+  std::atomic<size_t> maxInFlight{0};
+  // like an older daemon, answers the compact block queries with 404
+  std::atomic<bool> compactBlocksSupported{true};
+  // closes the connection instead of answering this many compact block queries
+  std::atomic<size_t> compactQueriesToDrop{0};
+  std::atomic<size_t> compactQueries{0};
+  std::atomic<size_t> liteQueries{0};
+
+  void processRequest(const HttpRequest& request, HttpResponse& response) override {
+    if (request.getUrl() == "/get_o_indexes.bin") {
+      COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response rsp;
+      rsp.o_indexes = {1, 2, 3};
+      rsp.status = CORE_RPC_STATUS_OK;
+      respondSlowly(storeToBinaryKeyValue(rsp), response);
+    } else if (request.getUrl() == "/queryblockscompact.bin" && compactBlocksSupported) {
+      ++compactQueries;
+      size_t toDrop = compactQueriesToDrop;
+      while (toDrop != 0 && !compactQueriesToDrop.compare_exchange_weak(toDrop, toDrop - 1)) {
+      }
+
+      if (toDrop != 0) {
+        throw std::runtime_error("connection dropped");
+      }
+
+      COMMAND_RPC_QUERY_BLOCKS_COMPACT::response rsp;
+      rsp.status = CORE_RPC_STATUS_OK;
+      rsp.startHeight = 0;
+      rsp.currentHeight = 0;
+      rsp.fullOffset = 0;
+      respondSlowly(storeToBinaryKeyValue(rsp), response);
+    } else if (request.getUrl() == "/queryblockslite.bin") {
+      ++liteQueries;
+      COMMAND_RPC_QUERY_BLOCKS_LITE::response rsp;
+      rsp.status = CORE_RPC_STATUS_OK;
+      rsp.startHeight = 0;
+      rsp.currentHeight = 0;
+      rsp.fullOffset = 0;
+      respondSlowly(storeToBinaryKeyValue(rsp), response);
+    } else {
+      response.setStatus(HttpResponse::STATUS_404);
+    }
+  }
+
+private:
+  void respondSlowly(const std::string& body, HttpResponse& response) {
+    size_t current = ++inFlight;
+    size_t max = maxInFlight;
+    while (current > max && !maxInFlight.compare_exchange_weak(max, current)) {
+    }
+
+    System::Timer(m_dispatcher).sleep(std::chrono::milliseconds(delay.load()));
+    --inFlight;
+    response.setBody(body);
+  }
+};
+
+class ConnectionObserver : public INodeRpcProxyObserver {
+public:
+  std::atomic<bool> connected{true};
+
+  void connectionStatusUpdated(bool status) override {
+    connected = status;
+  }
+};
+
+class NodeRpcProxyTest : public ::testing::Test {
+public:
+  NodeRpcProxyTest() : m_logger(Logging::ERROR), m_proxy("127.0.0.1", DAEMON_PORT) {
+  }
+
+protected:
+  void SetUp() override {
+    m_daemonThread = std::thread([this] {
+      System::Dispatcher dispatcher;
+      SlowDaemon daemon(dispatcher, m_logger);
+      System::Event stopEvent(dispatcher);
+      daemon.start("127.0.0.1", DAEMON_PORT);
+
+      {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_dispatcher = &dispatcher;
+        m_daemon = &daemon;
+        m_stopEvent = &stopEvent;
+      }
+      m_cv.notify_all();
+
+      stopEvent.wait();
+      daemon.stop();
+
+      std::lock_guard<std::mutex> lk(m_mutex);
+      m_dispatcher = nullptr;
+      m_daemon = nullptr;
+    });
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_cv.wait(lk, [this] { return m_daemon != nullptr; });
+  }
+
+  void TearDown() override {
+    m_proxy.shutdown();
+    stopDaemon();
+  }
+
+  void stopDaemon() {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (m_dispatcher != nullptr) {
+        System::Event* stopEvent = m_stopEvent;
+        m_dispatcher->remoteSpawn([stopEvent] { stopEvent->set(); });
+      }
+    }
+
+    if (m_daemonThread.joinable()) {
+      m_daemonThread.join();
+    }
+  }
+
+  std::error_code initProxy() {
+    std::promise<std::error_code> initialized;
+    m_proxy.init([&initialized](std::error_code ec) { initialized.set_value(ec); });
+    return initialized.get_future().get();
+  }
+
+  std::error_code getOutsGlobalIndices(std::vector<uint32_t>& indices) {
+    std::promise<std::error_code> done;
+    m_proxy.getTransactionOutsGlobalIndices(Crypto::Hash(), indices, [&done](std::error_code ec) { done.set_value(ec); });
+    return done.get_future().get();
+  }
+
+  std::error_code queryBlocks() {
+    std::vector<BlockShortEntry> newBlocks;
+    uint32_t startHeight;
+    std::promise<std::error_code> done;
+    m_proxy.queryBlocks({}, 0, newBlocks, startHeight, [&done](std::error_code ec) { done.set_value(ec); });
+    return done.get_future().get();
+  }
+
+  Logging::ConsoleLogger m_logger;
+  NodeRpcProxy m_proxy;
+  SlowDaemon* m_daemon = nullptr;
+
+private:
+  std::thread m_daemonThread;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  System::Dispatcher* m_dispatcher = nullptr;
+  System::Event* m_stopEvent = nullptr;
+};
+
+TEST_F(NodeRpcProxyTest, requestsRunConcurrentlyUpToConnectionCount) {
+  m_daemon->delay = 300;
+  m_proxy.connectionCount(2);
+  ASSERT_FALSE(initProxy());
+
+  const size_t REQUEST_COUNT = 4;
+  std::vector<std::vector<uint32_t>> indices(REQUEST_COUNT);
+  std::vector<std::promise<std::error_code>> done(REQUEST_COUNT);
+  for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+    std::promise<std::error_code>& requestDone = done[i];
+    m_proxy.getTransactionOutsGlobalIndices(Crypto::Hash(), indices[i], [&requestDone](std::error_code ec) {
+      requestDone.set_value(ec);
+    });
+  }
+
+  for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+    EXPECT_FALSE(done[i].get_future().get());
+    EXPECT_EQ(std::vector<uint32_t>({1, 2, 3}), indices[i]);
+  }
+
+  EXPECT_EQ(2, m_daemon->maxInFlight);
+}
+
+TEST_F(NodeRpcProxyTest, singleConnectionServesRequestsOneByOne) {
+  m_daemon->delay = 100;
+  m_proxy.connectionCount(1);
+  ASSERT_FALSE(initProxy());
+
+  std::vector<uint32_t> indices1;
+  std::vector<uint32_t> indices2;
+  std::promise<std::error_code> done1;
+  std::promise<std::error_code> done2;
+  m_proxy.getTransactionOutsGlobalIndices(Crypto::Hash(), indices1, [&done1](std::error_code ec) { done1.set_value(ec); });
+  m_proxy.getTransactionOutsGlobalIndices(Crypto::Hash(), indices2, [&done2](std::error_code ec) { done2.set_value(ec); });
+
+  EXPECT_FALSE(done1.get_future().get());
+  EXPECT_FALSE(done2.get_future().get());
+  EXPECT_EQ(1, m_daemon->maxInFlight);
+}
+
+TEST_F(NodeRpcProxyTest, requestOverrunningTimeoutFails) {
+  m_daemon->delay = 1000;
+  m_proxy.rpcTimeout(100);
+  ASSERT_FALSE(initProxy());
+
+  std::vector<uint32_t> indices;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(make_error_code(error::TIMEOUT), getOutsGlobalIndices(indices));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(900));
+
+  m_daemon->delay = 0;
+  EXPECT_FALSE(getOutsGlobalIndices(indices));
+  EXPECT_EQ(std::vector<uint32_t>({1, 2, 3}), indices);
+}
+
+TEST_F(NodeRpcProxyTest, blockQueriesHaveTheirOwnTimeout) {
+  m_daemon->delay = 400;
+  m_proxy.rpcTimeout(100);
+  ASSERT_FALSE(initProxy());
+
+  EXPECT_FALSE(queryBlocks());
+
+  m_proxy.blocksRpcTimeout(100);
+  EXPECT_EQ(make_error_code(error::TIMEOUT), queryBlocks());
+}
+
+TEST_F(NodeRpcProxyTest, blockQueriesFallBackToLiteFormatOnOlderDaemon) {
+  m_daemon->compactBlocksSupported = false;
+  ASSERT_FALSE(initProxy());
+
+  EXPECT_FALSE(queryBlocks());
+  EXPECT_EQ(1, m_daemon->liteQueries);
+
+  m_daemon->compactBlocksSupported = true;
+  EXPECT_FALSE(queryBlocks());
+  EXPECT_EQ(0, m_daemon->compactQueries);
+  EXPECT_EQ(2, m_daemon->liteQueries);
+}
+
+TEST_F(NodeRpcProxyTest, droppedConnectionDoesNotDisableCompactBlocks) {
+  m_daemon->compactQueriesToDrop = 1;
+  ASSERT_FALSE(initProxy());
+
+  EXPECT_EQ(make_error_code(error::NETWORK_ERROR), queryBlocks());
+  EXPECT_FALSE(queryBlocks());
+  EXPECT_EQ(2, m_daemon->compactQueries);
+  EXPECT_EQ(0, m_daemon->liteQueries);
+}
+
+TEST_F(NodeRpcProxyTest, connectionIsReportedLostWhenDaemonGoesAway) {
+  ConnectionObserver observer;
+  m_proxy.connectionCount(2);
+  m_proxy.addObserver(&observer);
+  ASSERT_FALSE(initProxy());
+
+  std::vector<uint32_t> indices;
+  ASSERT_FALSE(getOutsGlobalIndices(indices));
+  EXPECT_TRUE(observer.connected);
+
+  stopDaemon();
+
+  EXPECT_TRUE(getOutsGlobalIndices(indices));
+  EXPECT_FALSE(observer.connected);
+  EXPECT_EQ(make_error_code(error::CONNECT_ERROR), getOutsGlobalIndices(indices));
+  EXPECT_FALSE(observer.connected);
+
+  m_proxy.removeObserver(&observer);
+}
+
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crypto/Crypto.h"
+
+using namespace Crypto;
+
+namespace {
+
+const std::string SEED = "random generator test seed";
+
+std::vector<uint8_t> generate(size_t size) {
+  std::vector<uint8_t> bytes(size);
+  generate_random_bytes(bytes.size(), bytes.data());
+  return bytes;
+}
+
+std::vector<uint8_t> generateSeeded(const std::string& seed, size_t size) {
+  seed_random(seed.data(), seed.size());
+  return generate(size);
+}
+
+}
+
+TEST(Random, sameSeedGivesSameOutput) {
+  std::vector<uint8_t> first = generateSeeded(SEED, 1000);
+  EXPECT_EQ(first, generateSeeded(SEED, 1000));
+  EXPECT_NE(first, generateSeeded(SEED + '.', 1000));
+}
+
+TEST(Random, outputDoesNotDependOnRequestSizes) {
+  std::vector<uint8_t> whole = generateSeeded(SEED, 1000);
+
+  // requests smaller than, equal to and larger than the bytes one permutation yields
+  seed_random(SEED.data(), SEED.size());
+  std::vector<uint8_t> pieces;
+  const size_t sizes[] = { 1, 7, 32, 64, 136, 200 };
+  for (size_t i = 0; pieces.size() < whole.size(); ++i) {
+    size_t size = std::min(sizes[i % 6], whole.size() - pieces.size());
+    std::vector<uint8_t> piece = generate(size);
+    pieces.insert(pieces.end(), piece.begin(), piece.end());
+  }
+
+  EXPECT_EQ(whole, pieces);
+}
+
+TEST(Random, systemEntropyIsMixedInAfterReseedInterval) {
+  std::vector<uint8_t> first = generateSeeded(SEED, RANDOM_RESEED_INTERVAL);
+  std::vector<uint8_t> firstAfterReseed = generate(64);
+
+  std::vector<uint8_t> second = generateSeeded(SEED, RANDOM_RESEED_INTERVAL);
+  std::vector<uint8_t> secondAfterReseed = generate(64);
+
+  EXPECT_EQ(first, second);
+  EXPECT_NE(firstAfterReseed, secondAfterReseed);
+}
+
+TEST(Random, seedOnlyAffectsCallingThread) {
+  seed_random(SEED.data(), SEED.size());
+
+  std::vector<uint8_t> otherThread;
+  std::thread([&otherThread] { otherThread = generate(1000); }).join();
+
+  std::vector<uint8_t> thisThread = generate(1000);
+  EXPECT_EQ(generateSeeded(SEED, 1000), thisThread);
+  EXPECT_NE(thisThread, otherThread);
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "ICoreStub.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "Rpc/RpcNotifier.h"
+#include "System/Dispatcher.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const std::chrono::milliseconds WAIT_TIMEOUT(5000);
+
+// blocks of a competing branch differ by their nonce
+Block createBlock(uint32_t index, uint32_t branch = 0) {
+  Block block;
+  block.majorVersion = 1;
+  block.timestamp = index;
+  block.nonce = branch;
+  block.baseTransaction.version = 1;
+  block.baseTransaction.unlockTime = index + 10;
+  block.baseTransaction.inputs.push_back(BaseInput{ index });
+  return block;
+}
+
+Transaction createTransaction(uint64_t unlockTime) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = unlockTime;
+  return transaction;
+}
+
+std::vector<Crypto::Hash> sorted(std::vector<Crypto::Hash> hashes) {
+  std::sort(hashes.begin(), hashes.end(), [](const Crypto::Hash& a, const Crypto::Hash& b) {
+    return std::lexicographical_compare(std::begin(a.data), std::end(a.data), std::begin(b.data), std::end(b.data));
+  });
+  return hashes;
+}
+
+}
+
+class RpcNotifierTest : public ::testing::Test {
+public:
+  RpcNotifierTest() : notifier(dispatcher, core) {
+  }
+
+protected:
+  // the notifier only tracks the blocks it has seen, so the chain grows after it started
+  void SetUp() override {
+    addBlock(createBlock(0));
+
+    std::vector<RpcEvent> events;
+    ASSERT_TRUE(notifier.waitForEvents(0, WAIT_TIMEOUT, events, version));
+    EXPECT_TRUE(events.empty());
+    EXPECT_NE(0, version);
+
+    for (uint32_t i = 1; i < 4; ++i) {
+      addBlock(createBlock(i));
+    }
+
+    ASSERT_EQ(3, waitForEvents().size());
+  }
+
+  Crypto::Hash addBlock(const Block& block) {
+    core.addBlock(block);
+    return getBlockHash(block);
+  }
+
+  // returns the events after the last version seen and moves on to the new one
+  std::vector<RpcEvent> waitForEvents(bool expectComplete = true) {
+    std::vector<RpcEvent> events;
+    uint64_t newVersion;
+    EXPECT_EQ(expectComplete, notifier.waitForEvents(version, WAIT_TIMEOUT, events, newVersion));
+    EXPECT_LT(version, newVersion);
+    version = newVersion;
+    return events;
+  }
+
+  System::Dispatcher dispatcher;
+  ICoreStub core;
+  RpcNotifier notifier;
+  uint64_t version = 0;
+};
+
+TEST_F(RpcNotifierTest, newBlocksIncreaseVersion) {
+  Crypto::Hash hash4 = addBlock(createBlock(4));
+  uint64_t lastVersion = version;
+  auto events = waitForEvents();
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(RpcEvent::NEW_BLOCK, events[0].type);
+  EXPECT_EQ(4, events[0].height);
+  EXPECT_EQ(hash4, events[0].hash);
+  EXPECT_EQ(lastVersion + 1, events[0].version);
+
+  Crypto::Hash hash5 = addBlock(createBlock(5));
+  Crypto::Hash hash6 = addBlock(createBlock(6));
+  events = waitForEvents();
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(hash5, events[0].hash);
+  EXPECT_EQ(hash6, events[1].hash);
+  EXPECT_LT(events[0].version, events[1].version);
+  EXPECT_EQ(events[1].version, version);
+}
+
+TEST_F(RpcNotifierTest, logNotReachingKnownVersionIsIncomplete) {
+  for (uint32_t i = 4; i < 4 + RpcNotifier::MAX_EVENTS + 1; ++i) {
+    addBlock(createBlock(i));
+  }
+
+  auto events = waitForEvents(false);
+  ASSERT_EQ(static_cast<size_t>(RpcNotifier::MAX_EVENTS), events.size());
+  EXPECT_EQ(5, events.front().height);
+  EXPECT_EQ(version, events.back().version);
+
+  // a client that caught up gets complete results again
+  addBlock(createBlock(4 + RpcNotifier::MAX_EVENTS + 1));
+  EXPECT_EQ(1, waitForEvents().size());
+}
+
+TEST_F(RpcNotifierTest, reorganizationReportsReplacedBlocks) {
+  core.popBlocks(2);
+  Crypto::Hash hash2 = addBlock(createBlock(2, 1));
+  Crypto::Hash hash3 = addBlock(createBlock(3, 1));
+  Crypto::Hash hash4 = addBlock(createBlock(4, 1));
+
+  auto events = waitForEvents();
+  ASSERT_EQ(4, events.size());
+  EXPECT_EQ(RpcEvent::REORGANIZATION, events[0].type);
+  EXPECT_EQ(2, events[0].height);
+  EXPECT_EQ(hash2, events[0].hash);
+  EXPECT_EQ(RpcEvent::NEW_BLOCK, events[1].type);
+  EXPECT_EQ(hash2, events[1].hash);
+  EXPECT_EQ(hash3, events[2].hash);
+  EXPECT_EQ(hash4, events[3].hash);
+}
+
+TEST_F(RpcNotifierTest, reorganizationToShorterChainReportsNewTop) {
+  Crypto::Hash hash1 = core.getBlockIdByHeight(1);
+  core.popBlocks(2);
+
+  auto events = waitForEvents();
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(RpcEvent::REORGANIZATION, events[0].type);
+  EXPECT_EQ(1, events[0].height);
+  EXPECT_EQ(hash1, events[0].hash);
+
+  Crypto::Hash hash2 = addBlock(createBlock(2, 1));
+  events = waitForEvents();
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(RpcEvent::NEW_BLOCK, events[0].type);
+  EXPECT_EQ(2, events[0].height);
+  EXPECT_EQ(hash2, events[0].hash);
+}
+
+TEST_F(RpcNotifierTest, poolChangesAreReportedAsDeltas) {
+  Transaction tx1 = createTransaction(1);
+  Transaction tx2 = createTransaction(2);
+  core.addPoolTransaction(tx1);
+  core.addPoolTransaction(tx2);
+
+  auto events = waitForEvents();
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(RpcEvent::POOL_CHANGED, events[0].type);
+  EXPECT_EQ(3, events[0].height);
+  EXPECT_EQ(core.getBlockIdByHeight(3), events[0].hash);
+  EXPECT_EQ(sorted({ getObjectHash(tx1), getObjectHash(tx2) }), sorted(events[0].addedTransactions));
+  EXPECT_TRUE(events[0].removedTransactions.empty());
+
+  core.removePoolTransaction(getObjectHash(tx1));
+  events = waitForEvents();
+  ASSERT_EQ(1, events.size());
+  EXPECT_TRUE(events[0].addedTransactions.empty());
+  EXPECT_EQ(std::vector<Crypto::Hash>({ getObjectHash(tx1) }), events[0].removedTransactions);
+}
+
+TEST_F(RpcNotifierTest, waitEndsAtTimeoutWithoutEvents) {
+  std::vector<RpcEvent> events;
+  uint64_t newVersion;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(notifier.waitForEvents(version, std::chrono::milliseconds(200), events, newVersion));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_TRUE(events.empty());
+  EXPECT_EQ(version, newVersion);
+  EXPECT_GE(elapsed, std::chrono::milliseconds(200));
+  // the waiters are woken up by a tick once a second to check their timeouts
+  EXPECT_LT(elapsed, std::chrono::milliseconds(2500));
+}
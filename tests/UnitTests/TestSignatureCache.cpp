@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "CryptoNoteCore/SignatureCache.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+Crypto::Hash makeDigest(uint8_t seed) {
+  Crypto::Hash digest = {};
+  digest.data[0] = seed;
+  return digest;
+}
+
+}
+
+TEST(SignatureCache, containsInsertedDigests) {
+  SignatureCache cache(4);
+  cache.insert(makeDigest(1));
+  cache.insert(makeDigest(2));
+
+  EXPECT_TRUE(cache.contains(makeDigest(1)));
+  EXPECT_TRUE(cache.contains(makeDigest(2)));
+  EXPECT_FALSE(cache.contains(makeDigest(3)));
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(SignatureCache, evictsOldestDigestWhenFull) {
+  SignatureCache cache(3);
+  for (uint8_t i = 1; i <= 5; ++i) {
+    cache.insert(makeDigest(i));
+  }
+
+  EXPECT_EQ(3, cache.size());
+  EXPECT_FALSE(cache.contains(makeDigest(1)));
+  EXPECT_FALSE(cache.contains(makeDigest(2)));
+  EXPECT_TRUE(cache.contains(makeDigest(3)));
+  EXPECT_TRUE(cache.contains(makeDigest(4)));
+  EXPECT_TRUE(cache.contains(makeDigest(5)));
+}
+
+TEST(SignatureCache, repeatedInsertDoesNotRefreshDigest) {
+  SignatureCache cache(2);
+  cache.insert(makeDigest(1));
+  cache.insert(makeDigest(2));
+  cache.insert(makeDigest(1));
+  EXPECT_EQ(2, cache.size());
+
+  cache.insert(makeDigest(3));
+
+  EXPECT_FALSE(cache.contains(makeDigest(1)));
+  EXPECT_TRUE(cache.contains(makeDigest(2)));
+  EXPECT_TRUE(cache.contains(makeDigest(3)));
+}
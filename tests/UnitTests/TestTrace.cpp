@@ -0,0 +1,114 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "Common/JsonValue.h"
+#include "Common/StringTools.h"
+#include "Common/Trace.h"
+#include "crypto/hash.h"
+
+using namespace Tracing;
+
+namespace {
+
+Event makeEvent(const char* name, int64_t startMicroseconds) {
+  std::chrono::steady_clock::time_point start{std::chrono::microseconds(startMicroseconds)};
+  return { name, Crypto::Hash(), false, 7, start, std::chrono::microseconds(3) };
+}
+
+}
+
+TEST(Trace, recorderKeepsEventsInOrder) {
+  Recorder recorder(4);
+  recorder.record(makeEvent("a", 1));
+  recorder.record(makeEvent("b", 2));
+
+  auto events = recorder.events();
+  ASSERT_EQ(2, events.size());
+  ASSERT_STREQ("a", events[0].name);
+  ASSERT_STREQ("b", events[1].name);
+}
+
+TEST(Trace, recorderOverwritesOldestEvents) {
+  Recorder recorder(3);
+  const char* names[] = { "a", "b", "c", "d", "e" };
+  for (int i = 0; i < 5; ++i) {
+    recorder.record(makeEvent(names[i], i));
+  }
+
+  auto events = recorder.events();
+  ASSERT_EQ(3, events.size());
+  ASSERT_STREQ("c", events[0].name);
+  ASSERT_STREQ("d", events[1].name);
+  ASSERT_STREQ("e", events[2].name);
+}
+
+TEST(Trace, chromeTraceHasCompleteEvents) {
+  Recorder recorder(4);
+  Crypto::Hash id = Crypto::Hash();
+  id.data[0] = 0xab;
+  Event event = makeEvent("pushBlock", 1500);
+  event.id = id;
+  event.hasId = true;
+  recorder.record(std::move(event));
+  recorder.record(makeEvent("storeBlock", 1501));
+
+  Common::JsonValue trace = Common::JsonValue::fromString(recorder.toChromeTrace());
+  const Common::JsonValue& events = trace("traceEvents");
+  ASSERT_EQ(2, events.size());
+  ASSERT_EQ("pushBlock", events[0]("name").getString());
+  ASSERT_EQ("X", events[0]("ph").getString());
+  ASSERT_EQ(7, events[0]("tid").getInteger());
+  ASSERT_DOUBLE_EQ(1500, events[0]("ts").getReal());
+  ASSERT_DOUBLE_EQ(3, events[0]("dur").getReal());
+  ASSERT_EQ(Common::podToHex(id), events[0]("args")("id").getString());
+  ASSERT_FALSE(events[1].contains("args"));
+}
+
+TEST(Trace, spanRecordsOnDestruction) {
+  Crypto::Hash id = Crypto::Hash();
+  id.data[31] = 1;
+  size_t before = recorder().events().size();
+  setEnabled(true);
+  {
+    Span span("TraceTest", id);
+  }
+
+  setEnabled(false);
+  auto events = recorder().events();
+  ASSERT_EQ(before + 1, events.size());
+  ASSERT_STREQ("TraceTest", events.back().name);
+  ASSERT_TRUE(events.back().hasId);
+  ASSERT_EQ(id, events.back().id);
+}
+
+TEST(Trace, spansAreNotRecordedWhileDisabled) {
+  ASSERT_FALSE(isEnabled());
+  size_t before = recorder().events().size();
+  {
+    Span span("TraceTest");
+    // a span records whether tracing was on when it started
+    setEnabled(true);
+  }
+
+  setEnabled(false);
+  ASSERT_EQ(before, recorder().events().size());
+}
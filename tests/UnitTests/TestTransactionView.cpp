@@ -0,0 +1,177 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionView.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+Crypto::Hash makeHash(uint8_t seed) {
+  Crypto::Hash hash;
+  std::fill(std::begin(hash.data), std::end(hash.data), seed);
+  return hash;
+}
+
+Crypto::PublicKey makeKey(uint8_t seed) {
+  Crypto::PublicKey key;
+  std::fill(std::begin(key.data), std::end(key.data), seed);
+  return key;
+}
+
+Transaction makeCoinbase(uint32_t height) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = height + 60;
+  transaction.inputs.push_back(BaseInput{ height });
+  transaction.outputs.push_back(TransactionOutput{ 7000000, KeyOutput{ makeKey(1) } });
+  transaction.extra = { 1, 2, 3, 4 };
+  return transaction;
+}
+
+Transaction makeTransaction() {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = 300;
+
+  KeyInput keyInput;
+  keyInput.amount = 1000;
+  keyInput.outputIndexes = { 5, 170000, 2 };
+  std::fill(std::begin(keyInput.keyImage.data), std::end(keyInput.keyImage.data), 9);
+  transaction.inputs.push_back(keyInput);
+  transaction.inputs.push_back(MultiSignatureInput{ 200, 2, 11 });
+
+  MultiSignatureOutput multisignatureOutput;
+  multisignatureOutput.keys = { makeKey(3), makeKey(4), makeKey(5) };
+  multisignatureOutput.requiredSignatureCount = 2;
+  transaction.outputs.push_back(TransactionOutput{ 900, KeyOutput{ makeKey(6) } });
+  transaction.outputs.push_back(TransactionOutput{ 100, multisignatureOutput });
+  transaction.extra = { 1, 8, 8, 8 };
+
+  transaction.signatures.resize(2);
+  for (size_t i = 0; i < 3; ++i) {
+    Crypto::Signature signature;
+    std::fill(reinterpret_cast<uint8_t*>(&signature), reinterpret_cast<uint8_t*>(&signature + 1), 20 + i);
+    transaction.signatures[0].push_back(signature);
+  }
+
+  transaction.signatures[1].resize(2);
+  return transaction;
+}
+
+}
+
+TEST(TransactionView, parsesTransactionInPlace) {
+  Transaction transaction = makeTransaction();
+  BinaryArray blob = toBinaryArray(transaction);
+
+  TransactionView view;
+  ASSERT_TRUE(view.parse(blob));
+  EXPECT_EQ(1, view.version());
+  EXPECT_EQ(300, view.unlockTime());
+  EXPECT_TRUE(view.hasSignatures());
+  EXPECT_EQ(getObjectHash(transaction), view.hash());
+  EXPECT_EQ(getObjectHash(static_cast<const TransactionPrefix&>(transaction)), view.prefixHash());
+  EXPECT_EQ(transaction.extra, BinaryArray(view.extra().getData(), view.extra().getData() + view.extra().getSize()));
+
+  ASSERT_EQ(2, view.inputs().size());
+  const TransactionView::Input& keyInput = view.inputs()[0];
+  EXPECT_EQ(TransactionView::KEY_INPUT, keyInput.type);
+  EXPECT_EQ(1000, keyInput.amount);
+  EXPECT_EQ(boost::get<KeyInput>(transaction.inputs[0]).keyImage, *keyInput.keyImage);
+  std::vector<uint32_t> outputIndexes;
+  TransactionView::getOutputIndexes(keyInput, outputIndexes);
+  EXPECT_EQ(boost::get<KeyInput>(transaction.inputs[0]).outputIndexes, outputIndexes);
+  ASSERT_EQ(3, keyInput.signatureCount);
+  EXPECT_EQ(0, memcmp(&transaction.signatures[0][2], &keyInput.signatures[2], sizeof(Crypto::Signature)));
+
+  const TransactionView::Input& multisignatureInput = view.inputs()[1];
+  EXPECT_EQ(TransactionView::MULTISIGNATURE_INPUT, multisignatureInput.type);
+  EXPECT_EQ(200, multisignatureInput.amount);
+  EXPECT_EQ(2, multisignatureInput.signatureCount);
+  EXPECT_EQ(11, multisignatureInput.outputIndex);
+
+  ASSERT_EQ(2, view.outputs().size());
+  EXPECT_EQ(TransactionView::KEY_OUTPUT, view.outputs()[0].type);
+  EXPECT_EQ(900, view.outputs()[0].amount);
+  EXPECT_EQ(makeKey(6), view.outputs()[0].keys[0]);
+  EXPECT_EQ(TransactionView::MULTISIGNATURE_OUTPUT, view.outputs()[1].type);
+  ASSERT_EQ(3, view.outputs()[1].keyCount);
+  EXPECT_EQ(makeKey(5), view.outputs()[1].keys[2]);
+  EXPECT_EQ(2, view.outputs()[1].requiredSignatureCount);
+}
+
+TEST(TransactionView, rejectsWhatDeserializationRejects) {
+  BinaryArray blob = toBinaryArray(makeTransaction());
+  TransactionView view;
+  Transaction transaction;
+
+  for (size_t size = 0; size < blob.size(); ++size) {
+    BinaryArray truncated(blob.begin(), blob.begin() + size);
+    EXPECT_FALSE(view.parse(truncated));
+    EXPECT_FALSE(fromBinaryArray(transaction, truncated));
+  }
+
+  BinaryArray extended = blob;
+  extended.push_back(0);
+  EXPECT_FALSE(view.parse(extended));
+
+  // every byte changed, the view accepts exactly the blobs full deserialization accepts
+  for (size_t i = 0; i < blob.size(); ++i) {
+    for (uint8_t delta : { 1, 0x80 }) {
+      BinaryArray changed = blob;
+      changed[i] += delta;
+      EXPECT_EQ(fromBinaryArray(transaction, changed), view.parse(changed)) << "byte " << i;
+    }
+  }
+}
+
+TEST(TransactionView, parsesBlock) {
+  Block block;
+  block.majorVersion = BLOCK_MAJOR_VERSION_4;
+  block.minorVersion = 0;
+  block.timestamp = 1600000000;
+  block.previousBlockHash = makeHash(7);
+  block.nonce = 0x12345678;
+  block.baseTransaction = makeCoinbase(100);
+  block.transactionHashes = { makeHash(1), makeHash(2) };
+  BinaryArray blob = toBinaryArray(block);
+
+  BlockView view;
+  ASSERT_TRUE(view.parse(blob));
+  EXPECT_EQ(BLOCK_MAJOR_VERSION_4, view.majorVersion());
+  EXPECT_EQ(1600000000, view.timestamp());
+  EXPECT_EQ(makeHash(7), view.previousBlockHash());
+  EXPECT_EQ(0x12345678, view.nonce());
+  EXPECT_FALSE(view.baseTransaction().hasSignatures());
+  EXPECT_EQ(100, view.baseTransaction().inputs()[0].blockIndex);
+  ASSERT_EQ(2, view.transactionCount());
+  EXPECT_EQ(makeHash(2), view.transactionHashes()[1]);
+  EXPECT_EQ(getBlockHash(block), view.hash());
+
+  blob.pop_back();
+  EXPECT_FALSE(view.parse(blob));
+}
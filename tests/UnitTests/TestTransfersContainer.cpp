@@ -875,6 +875,20 @@ TEST_F(TransfersContainer_detach, transactionDetachAfterAdvance) {
   ASSERT_EQ(0, container.balance(ITransfersContainer::IncludeAllUnlocked));
 }
 
+TEST_F(TransfersContainer_detach, detachReportsTransfersLockedAgain) {
+  addTransaction(TEST_BLOCK_HEIGHT);
+  container.advanceHeight(TEST_BLOCK_HEIGHT + TEST_TRANSACTION_SPENDABLE_AGE * 2);
+
+  bool transfersLocked = true;
+  container.detach(TEST_BLOCK_HEIGHT + TEST_TRANSACTION_SPENDABLE_AGE + 1, &transfersLocked);
+  ASSERT_FALSE(transfersLocked);
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllUnlocked));
+
+  container.detach(TEST_BLOCK_HEIGHT + TEST_TRANSACTION_SPENDABLE_AGE, &transfersLocked);
+  ASSERT_TRUE(transfersLocked);
+  ASSERT_EQ(0, container.balance(ITransfersContainer::IncludeAllUnlocked));
+}
+
 
 //---------------------------------------------------------------------------
 // TransfersContainer_advanceHeight
@@ -906,6 +920,58 @@ TEST_F(TransfersContainer_advanceHeight, advanceUnlocksTransaction) {
   ASSERT_EQ(TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllUnlocked));
 }
 
+TEST_F(TransfersContainer_advanceHeight, advanceUnlocksTransactionLockedByHeight) {
+  container.detach(TEST_BLOCK_HEIGHT);
+
+  TestTransactionBuilder tx;
+  tx.setUnlockTime(TEST_CONTAINER_CURRENT_HEIGHT);
+  tx.addTestInput(TEST_OUTPUT_AMOUNT + 1);
+  auto outInfo = tx.addTestKeyOutput(TEST_OUTPUT_AMOUNT, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX, account);
+  ASSERT_TRUE(container.addTransaction(blockInfo(TEST_BLOCK_HEIGHT), *tx.build(), { outInfo }));
+
+  auto unlockHeight = TEST_CONTAINER_CURRENT_HEIGHT - currency.lockedTxAllowedDeltaBlocks();
+  container.advanceHeight(static_cast<uint32_t>(unlockHeight - 1));
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllLocked));
+  ASSERT_EQ(0, container.balance(ITransfersContainer::IncludeAllUnlocked));
+
+  container.advanceHeight(static_cast<uint32_t>(unlockHeight));
+  ASSERT_EQ(0, container.balance(ITransfersContainer::IncludeAllLocked));
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllUnlocked));
+}
+
+TEST_F(TransfersContainer_advanceHeight, balanceMatchesOutputsAfterSpendingAndDetach) {
+  container.detach(TEST_BLOCK_HEIGHT);
+  auto tx = addTransaction(TEST_BLOCK_HEIGHT, 2 * TEST_OUTPUT_AMOUNT);
+  container.advanceHeight(TEST_BLOCK_HEIGHT + TEST_TRANSACTION_SPENDABLE_AGE);
+  addSpendingTransaction(tx->getTransactionHash(), TEST_BLOCK_HEIGHT + 1, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX + 1);
+
+  auto checkBalance = [this](uint32_t flags) {
+    std::vector<TransactionOutputInformation> outputs;
+    container.getOutputs(outputs, flags);
+    uint64_t amount = 0;
+    for (const auto& output : outputs) {
+      amount += output.amount;
+    }
+    ASSERT_EQ(amount, container.balance(flags));
+  };
+
+  for (uint32_t height : { TEST_BLOCK_HEIGHT + 1, TEST_BLOCK_HEIGHT + 2, TEST_BLOCK_HEIGHT + 10 }) {
+    container.advanceHeight(height);
+    checkBalance(ITransfersContainer::IncludeAllLocked);
+    checkBalance(ITransfersContainer::IncludeAllUnlocked);
+  }
+
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllUnlocked));
+
+  container.detach(TEST_BLOCK_HEIGHT + 1);
+  checkBalance(ITransfersContainer::IncludeAllLocked);
+  checkBalance(ITransfersContainer::IncludeAllUnlocked);
+  ASSERT_EQ(2 * TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllLocked));
+
+  container.advanceHeight(TEST_BLOCK_HEIGHT + TEST_TRANSACTION_SPENDABLE_AGE);
+  ASSERT_EQ(2 * TEST_OUTPUT_AMOUNT, container.balance(ITransfersContainer::IncludeAllUnlocked));
+}
+
 
 //---------------------------------------------------------------------------
 // TransfersContainer_balance
@@ -0,0 +1,266 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "ICoreStub.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteCore/ViewKeyScanner.h"
+#include "Logging/FileLogger.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+struct TestAccount {
+  AccountPublicAddress address;
+  Crypto::SecretKey viewSecretKey;
+};
+
+TestAccount generateAccount() {
+  TestAccount account;
+  KeyPair spendKeys = generateKeyPair();
+  KeyPair viewKeys = generateKeyPair();
+  account.address.spendPublicKey = spendKeys.publicKey;
+  account.address.viewPublicKey = viewKeys.publicKey;
+  account.viewSecretKey = viewKeys.secretKey;
+  return account;
+}
+
+// another spend key under the same view key, as the addresses of one wallet container
+TestAccount generateAccount(const TestAccount& viewKeyOwner) {
+  TestAccount account = viewKeyOwner;
+  account.address.spendPublicKey = generateKeyPair().publicKey;
+  return account;
+}
+
+void addOutputs(Transaction& transaction, const std::vector<std::pair<TestAccount, uint64_t>>& destinations) {
+  KeyPair transactionKeys = generateKeyPair();
+  addTransactionPublicKeyToExtra(transaction.extra, transactionKeys.publicKey);
+  for (size_t i = 0; i < destinations.size(); ++i) {
+    const AccountPublicAddress& address = destinations[i].first.address;
+    Crypto::KeyDerivation derivation;
+    Crypto::generateKeyDerivation(address.viewPublicKey, transactionKeys.secretKey, derivation);
+    KeyOutput output;
+    Crypto::derivePublicKey(derivation, i, address.spendPublicKey, output.key);
+    transaction.outputs.push_back(TransactionOutput{ destinations[i].second, output });
+  }
+}
+
+Transaction createTransaction(const std::vector<std::pair<TestAccount, uint64_t>>& destinations) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = 0;
+
+  KeyInput input;
+  input.amount = 1000;
+  input.outputIndexes = { 1 };
+  Crypto::PublicKey keyImage = generateKeyPair().publicKey;
+  std::copy(std::begin(keyImage.data), std::end(keyImage.data), std::begin(input.keyImage.data));
+  transaction.inputs.push_back(input);
+  transaction.signatures.resize(1, std::vector<Crypto::Signature>(1));
+
+  addOutputs(transaction, destinations);
+  return transaction;
+}
+
+Transaction createCoinbase(uint32_t index, const TestAccount& miner) {
+  Transaction transaction;
+  transaction.version = 1;
+  transaction.unlockTime = index + 10;
+  transaction.inputs.push_back(BaseInput{ index });
+  addOutputs(transaction, { { miner, 50 } });
+  return transaction;
+}
+
+void addBlock(ICoreStub& core, uint32_t index, const TestAccount& miner,
+              const std::vector<Transaction>& transactions) {
+  Block block;
+  block.majorVersion = 1;
+  block.timestamp = index;
+  block.baseTransaction = createCoinbase(index, miner);
+  core.addTransaction(block.baseTransaction);
+  for (const auto& transaction : transactions) {
+    core.addTransaction(transaction);
+    block.transactionHashes.push_back(getObjectHash(transaction));
+  }
+
+  core.addBlock(block);
+}
+
+bool waitForScan(ViewKeyScanner& scanner, const TestAccount& account, uint32_t index) {
+  for (size_t i = 0; i < 500; ++i) {
+    std::vector<ViewKeyScannerOutput> outputs;
+    uint32_t scannedIndex;
+    if (scanner.getOutputs(account.address, account.viewSecretKey, 0, outputs, scannedIndex) &&
+        scannedIndex >= index) {
+      return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  return false;
+}
+
+std::vector<ViewKeyScannerOutput> getOutputs(ViewKeyScanner& scanner, const TestAccount& account,
+                                             uint32_t startIndex = 0) {
+  std::vector<ViewKeyScannerOutput> outputs;
+  uint32_t scannedIndex;
+  EXPECT_TRUE(scanner.getOutputs(account.address, account.viewSecretKey, startIndex, outputs, scannedIndex));
+  return outputs;
+}
+
+}
+
+class ViewKeyScannerTest : public ::testing::Test {
+public:
+  ViewKeyScannerTest() :
+    alice(generateAccount()),
+    bob(generateAccount(alice)),
+    carol(generateAccount()),
+    dave(generateAccount()) {
+  }
+
+protected:
+  ICoreStub core;
+  Logging::FileLogger logger;
+  TestAccount alice;
+  TestAccount bob;
+  TestAccount carol;
+  TestAccount dave;
+};
+
+TEST_F(ViewKeyScannerTest, findsOutputsOfAllRegisteredAccounts) {
+  Transaction first = createTransaction({ { dave, 5 }, { bob, 7 }, { alice, 9 } });
+  Transaction second = createTransaction({ { carol, 11 } });
+  addBlock(core, 0, alice, {});
+  addBlock(core, 1, carol, { first });
+  addBlock(core, 2, dave, { second });
+  core.set_outputs_gindexs({ 100, 101, 102 }, true);
+
+  ViewKeyScanner scanner(core, logger, 2, 1);
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(alice.address, alice.viewSecretKey, 0));
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(bob.address, bob.viewSecretKey, 0));
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(carol.address, carol.viewSecretKey, 2));
+  ASSERT_TRUE(waitForScan(scanner, alice, 3));
+  ASSERT_TRUE(waitForScan(scanner, bob, 3));
+  ASSERT_TRUE(waitForScan(scanner, carol, 3));
+
+  auto aliceOutputs = getOutputs(scanner, alice);
+  ASSERT_EQ(2, aliceOutputs.size());
+  EXPECT_EQ(0, aliceOutputs[0].blockIndex);
+  EXPECT_EQ(50, aliceOutputs[0].amount);
+  EXPECT_EQ(1, aliceOutputs[1].blockIndex);
+  EXPECT_EQ(getObjectHash(first), aliceOutputs[1].transactionHash);
+  EXPECT_EQ(getTransactionPublicKeyFromExtra(first.extra), aliceOutputs[1].transactionPublicKey);
+  EXPECT_EQ(2, aliceOutputs[1].outputInTransaction);
+  EXPECT_EQ(102, aliceOutputs[1].globalOutputIndex);
+  EXPECT_EQ(9, aliceOutputs[1].amount);
+  EXPECT_EQ(boost::get<KeyOutput>(first.outputs[2].target).key, aliceOutputs[1].outputKey);
+
+  auto bobOutputs = getOutputs(scanner, bob);
+  ASSERT_EQ(1, bobOutputs.size());
+  EXPECT_EQ(1, bobOutputs[0].outputInTransaction);
+  EXPECT_EQ(7, bobOutputs[0].amount);
+
+  // the coinbase of block 1 is older than the account
+  auto carolOutputs = getOutputs(scanner, carol);
+  ASSERT_EQ(1, carolOutputs.size());
+  EXPECT_EQ(2, carolOutputs[0].blockIndex);
+  EXPECT_EQ(11, carolOutputs[0].amount);
+
+  EXPECT_EQ(1, getOutputs(scanner, alice, 1).size());
+  EXPECT_TRUE(getOutputs(scanner, alice, 2).empty());
+}
+
+TEST_F(ViewKeyScannerTest, accountsAreIdentifiedByTheirViewKey) {
+  addBlock(core, 0, alice, {});
+
+  ViewKeyScanner scanner(core, logger, 1);
+  EXPECT_EQ(ViewKeyScanner::AddResult::WrongViewKey, scanner.addAccount(alice.address, carol.viewSecretKey, 0));
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(alice.address, alice.viewSecretKey, 0));
+  EXPECT_EQ(ViewKeyScanner::AddResult::AlreadyRegistered, scanner.addAccount(alice.address, alice.viewSecretKey, 0));
+  ASSERT_TRUE(waitForScan(scanner, alice, 1));
+
+  std::vector<ViewKeyScannerOutput> outputs;
+  uint32_t scannedIndex;
+  EXPECT_FALSE(scanner.getOutputs(alice.address, carol.viewSecretKey, 0, outputs, scannedIndex));
+  EXPECT_FALSE(scanner.removeAccount(alice.address, carol.viewSecretKey));
+  EXPECT_TRUE(scanner.removeAccount(alice.address, alice.viewSecretKey));
+  EXPECT_FALSE(scanner.getOutputs(alice.address, alice.viewSecretKey, 0, outputs, scannedIndex));
+}
+
+TEST_F(ViewKeyScannerTest, accountCountIsLimited) {
+  addBlock(core, 0, alice, {});
+
+  ViewKeyScanner scanner(core, logger, 1, ViewKeyScanner::DEFAULT_BATCH_SIZE, 2);
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(alice.address, alice.viewSecretKey, 0));
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(bob.address, bob.viewSecretKey, 0));
+  EXPECT_EQ(ViewKeyScanner::AddResult::TooManyAccounts, scanner.addAccount(carol.address, carol.viewSecretKey, 0));
+
+  ASSERT_TRUE(scanner.removeAccount(bob.address, bob.viewSecretKey));
+  EXPECT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(carol.address, carol.viewSecretKey, 0));
+}
+
+TEST_F(ViewKeyScannerTest, startIsLimitedToScanDepth) {
+  for (uint32_t i = 0; i < 6; ++i) {
+    addBlock(core, i, alice, {});
+  }
+
+  ViewKeyScanner scanner(core, logger, 1, ViewKeyScanner::DEFAULT_BATCH_SIZE, 10, 2);
+  EXPECT_EQ(ViewKeyScanner::AddResult::StartTooFarBehind, scanner.addAccount(alice.address, alice.viewSecretKey, 2));
+  EXPECT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(alice.address, alice.viewSecretKey, 3));
+  // accounts starting in the future wait for their first block
+  EXPECT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(carol.address, carol.viewSecretKey, 100));
+}
+
+TEST_F(ViewKeyScannerTest, outputsOfDetachedBlocksAreDropped) {
+  Transaction detached = createTransaction({ { alice, 9 } });
+  addBlock(core, 0, dave, {});
+  addBlock(core, 1, alice, { detached });
+  addBlock(core, 2, alice, {});
+  core.set_outputs_gindexs({ 100 }, true);
+
+  ViewKeyScanner scanner(core, logger, 1, 1);
+  ASSERT_EQ(ViewKeyScanner::AddResult::Added, scanner.addAccount(alice.address, alice.viewSecretKey, 0));
+  ASSERT_TRUE(waitForScan(scanner, alice, 3));
+  ASSERT_EQ(3, getOutputs(scanner, alice).size());
+
+  // the new branch is one block longer, so the scan has to pass the old top to catch up
+  Transaction attached = createTransaction({ { alice, 4 } });
+  core.popBlocks(1);
+  addBlock(core, 1, dave, { attached });
+  addBlock(core, 2, dave, {});
+  addBlock(core, 3, dave, {});
+  ASSERT_TRUE(waitForScan(scanner, alice, 4));
+
+  auto outputs = getOutputs(scanner, alice);
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(1, outputs[0].blockIndex);
+  EXPECT_EQ(getObjectHash(attached), outputs[0].transactionHash);
+  EXPECT_EQ(4, outputs[0].amount);
+}
@@ -264,6 +264,10 @@ void WalletApi::cleanUpWalletFiles() const {
   if (boost::filesystem::exists(BOB_WALLET_BACKUP_PATH)) {
     boost::filesystem::remove(BOB_WALLET_BACKUP_PATH);
   }
+
+  boost::system::error_code ignore;
+  boost::filesystem::remove(ALICE_WALLET_PATH + ".journal", ignore);
+  boost::filesystem::remove(BOB_WALLET_PATH + ".journal", ignore);
 }
 
 void WalletApi::setMinerTo(CryptoNote::WalletGreen& wallet) {
@@ -1237,8 +1241,91 @@ TEST_F(WalletApi, loadAll) {
   wait(100); //ObserverManager bug workaround
 }
 
+TEST_F(WalletApi, loadAllAppliesJournal) {
+  alice.save(WalletSaveLevel::SAVE_ALL);
+
+  fillWalletWithDetailsCache();
+  node.waitForAsyncContexts();
+  waitForWalletEvent(alice, CryptoNote::SYNC_COMPLETED, std::chrono::seconds(5));
+  alice.save(WalletSaveLevel::SAVE_ALL, "extra");
+
+  boost::filesystem::copy(ALICE_WALLET_PATH, BOB_WALLET_PATH);
+  boost::filesystem::copy(ALICE_WALLET_PATH + ".journal", BOB_WALLET_PATH + ".journal");
+
+  WalletGreen bob(dispatcher, currency, node, logger);
+  std::string extra;
+  bob.load(BOB_WALLET_PATH, "pass", extra);
+
+  ASSERT_EQ("extra", extra);
+  compareWalletsAddresses(alice, bob);
+  compareWalletsActualBalance(alice, bob);
+  compareWalletsPendingBalance(alice, bob);
+  compareWalletsTransactionTransfers(alice, bob, true);
+
+  bob.shutdown();
+  wait(100);
+}
+
+TEST_F(WalletApi, loadAllAppliesJournalEntriesCarryingChangesOnly) {
+  alice.save(WalletSaveLevel::SAVE_ALL);
+
+  fillWalletWithDetailsCache();
+  node.waitForAsyncContexts();
+  waitForWalletEvent(alice, CryptoNote::SYNC_COMPLETED, std::chrono::seconds(5));
+  alice.save(WalletSaveLevel::SAVE_ALL, "extra");
+
+  // the next entries keep the extra and carry the changed balances and the delayed transaction
+  generateAndUnlockMoney();
+  alice.save(WalletSaveLevel::SAVE_ALL, "extra");
+  makeTransaction({ aliceAddress }, RANDOM_ADDRESS, SENT, FEE);
+  alice.save(WalletSaveLevel::SAVE_ALL, "extra");
+
+  boost::filesystem::copy(ALICE_WALLET_PATH, BOB_WALLET_PATH);
+  boost::filesystem::copy(ALICE_WALLET_PATH + ".journal", BOB_WALLET_PATH + ".journal");
+
+  WalletGreen bob(dispatcher, currency, node, logger);
+  std::string extra;
+  bob.load(BOB_WALLET_PATH, "pass", extra);
+
+  ASSERT_EQ("extra", extra);
+  compareWalletsAddresses(alice, bob);
+  compareWalletsActualBalance(alice, bob);
+  compareWalletsPendingBalance(alice, bob);
+  compareWalletsTransactionTransfers(alice, bob, true);
+  ASSERT_EQ(1, bob.getDelayedTransactionIds().size());
+  ASSERT_EQ(alice.getDelayedTransactionIds(), bob.getDelayedTransactionIds());
+
+  bob.shutdown();
+  wait(100);
+}
+
+TEST_F(WalletApi, loadIgnoresJournalOfOtherContainerCache) {
+  alice.save(WalletSaveLevel::SAVE_ALL);
+
+  fillWalletWithDetailsCache();
+  node.waitForAsyncContexts();
+  waitForWalletEvent(alice, CryptoNote::SYNC_COMPLETED, std::chrono::seconds(5));
+  alice.save(WalletSaveLevel::SAVE_ALL);
+  boost::filesystem::copy(ALICE_WALLET_PATH + ".journal", BOB_WALLET_PATH + ".journal");
+
+  alice.save(WalletSaveLevel::SAVE_KEYS_ONLY);
+  boost::filesystem::copy(ALICE_WALLET_PATH, BOB_WALLET_PATH);
+
+  WalletGreen bob(dispatcher, currency, node, logger);
+  bob.load(BOB_WALLET_PATH, "pass");
+
+  ASSERT_EQ(0, bob.getTransactionCount());
+
+  bob.shutdown();
+  wait(100);
+}
+
 TEST_F(WalletApi, loadKeysOnly) {
   fillWalletWithDetailsCache();
+  // Bob sees alice's last transactions when he synchronizes with the node, alice has to see them
+  // too before the wallets are compared. Saving doesn't restart her synchronization.
+  node.updateObservers();
+  waitForWalletEvent(alice, CryptoNote::SYNC_COMPLETED, std::chrono::seconds(5));
 
   alice.save(WalletSaveLevel::SAVE_KEYS_ONLY);
 
@@ -1266,6 +1353,10 @@ TEST_F(WalletApi, loadKeysOnly) {
 
 TEST_F(WalletApi, loadKeysAndTransactions) {
   fillWalletWithDetailsCache();
+  // Bob sees alice's last transactions when he synchronizes with the node, alice has to see them
+  // too before the wallets are compared. Saving doesn't restart her synchronization.
+  node.updateObservers();
+  waitForWalletEvent(alice, CryptoNote::SYNC_COMPLETED, std::chrono::seconds(5));
 
   alice.save(WalletSaveLevel::SAVE_KEYS_AND_TRANSACTIONS);
 
@@ -1661,6 +1752,83 @@ TEST_F(WalletApi, detachBlockchain) {
   ASSERT_EQ(0, alice.getPendingBalance());
 }
 
+TEST_F(WalletApi, outputsLockedUntilTimestampBecomeSpendable) {
+  generateAndUnlockMoney();
+
+  CryptoNote::WalletGreen bob(dispatcher, currency, node, logger, TRANSACTION_SOFTLOCK_TIME);
+  bob.initialize(BOB_WALLET_PATH, "pass2");
+  bob.createAddress();
+
+  // unlocks a few seconds after the soft lock is over
+  uint64_t unlockTimestamp = static_cast<uint64_t>(time(nullptr)) + currency.lockedTxAllowedDeltaSeconds() + 3;
+  ASSERT_GE(unlockTimestamp, currency.maxBlockHeight());
+  sendMoney(bob.getAddress(0), SENT + FEE, FEE, 0, "", unlockTimestamp);
+  generator.generateEmptyBlocks(TRANSACTION_SOFTLOCK_TIME);
+  node.updateObservers();
+  waitForValue<size_t>(bob, generator.getBlockchain().size(), [&bob] { return bob.getBlockCount(); });
+  ASSERT_EQ(0, bob.getActualBalance());
+
+  while (static_cast<uint64_t>(time(nullptr)) + currency.lockedTxAllowedDeltaSeconds() <= unlockTimestamp) {
+    wait(100);
+  }
+
+  generator.generateEmptyBlocks(1);
+  node.updateObservers();
+  waitForActualBalance(bob, SENT + FEE);
+
+  ASSERT_NO_THROW(sendMoney(bob, RANDOM_ADDRESS, SENT, FEE));
+
+  bob.shutdown();
+  wait(100);
+}
+
+TEST_F(WalletApi, outputsLockedAgainByDetachBecomeSpendable) {
+  generateBlockReward();
+  generator.generateEmptyBlocks(currency.minedMoneyUnlockWindow());
+  generateBlockReward();
+  node.updateObservers();
+  waitForValue<size_t>(alice, generator.getBlockchain().size(), [this] { return alice.getBlockCount(); });
+  uint64_t unlockedAmount = alice.getActualBalance();
+  ASSERT_GT(unlockedAmount, 0);
+
+  // the second reward goes away, the first one is soft locked again
+  node.startAlternativeChain(6);
+  generator.generateEmptyBlocks(1);
+  node.updateObservers();
+  waitForValue<size_t>(alice, generator.getBlockchain().size(), [this] { return alice.getBlockCount(); });
+  ASSERT_EQ(0, alice.getActualBalance());
+  ASSERT_ANY_THROW(sendMoney(RANDOM_ADDRESS, SENT, FEE));
+
+  generator.generateEmptyBlocks(currency.minedMoneyUnlockWindow());
+  node.updateObservers();
+  waitForActualBalance(unlockedAmount);
+
+  ASSERT_NO_THROW(sendMoney(RANDOM_ADDRESS, SENT, FEE));
+}
+
+TEST_F(WalletApi, outputsLockedAgainWithoutDeletedTransactionsBecomeSpendable) {
+  generateBlockReward();
+  generator.generateEmptyBlocks(currency.minedMoneyUnlockWindow() + 1);
+  node.updateObservers();
+  waitForValue<size_t>(alice, generator.getBlockchain().size(), [this] { return alice.getBlockCount(); });
+  uint64_t unlockedAmount = alice.getActualBalance();
+  ASSERT_GT(unlockedAmount, 0);
+
+  // only empty blocks go away, the reward is soft locked again
+  node.startAlternativeChain(6);
+  generator.generateEmptyBlocks(1);
+  node.updateObservers();
+  waitForValue<size_t>(alice, generator.getBlockchain().size(), [this] { return alice.getBlockCount(); });
+  ASSERT_EQ(0, alice.getActualBalance());
+  ASSERT_ANY_THROW(sendMoney(RANDOM_ADDRESS, SENT, FEE));
+
+  generator.generateEmptyBlocks(currency.minedMoneyUnlockWindow());
+  node.updateObservers();
+  waitForActualBalance(unlockedAmount);
+
+  ASSERT_NO_THROW(sendMoney(RANDOM_ADDRESS, SENT, FEE));
+}
+
 TEST_F(WalletApi, deleteAddresses) {
   fillWalletWithDetailsCache();
   alice.createAddress();
@@ -2555,6 +2723,24 @@ TEST_F(WalletApi, fusionManagerEstimateCountsOnlySourceAddressOutputs) {
   ASSERT_GE(estimate1.totalOutputCount, estimate1.fusionReadyCount);
 }
 
+TEST_F(WalletApi, fusionManagerEstimateIsTheSameAfterLoad) {
+  generateFusionOutputsAndUnlock(alice, node, currency, FUSION_THRESHOLD);
+  auto expectedResult = alice.estimate(FUSION_THRESHOLD);
+  ASSERT_GT(expectedResult.fusionReadyCount, 0);
+
+  alice.save();
+  boost::filesystem::copy(ALICE_WALLET_PATH, BOB_WALLET_PATH);
+
+  WalletGreen bob(dispatcher, currency, node, logger, TRANSACTION_SOFTLOCK_TIME);
+  bob.load(BOB_WALLET_PATH, "pass");
+
+  ASSERT_EQ(expectedResult, bob.estimate(FUSION_THRESHOLD));
+  ASSERT_EQ(expectedResult, bob.estimate(FUSION_THRESHOLD, { bob.getAddress(0) }));
+
+  bob.shutdown();
+  wait(100);
+}
+
 TEST_F(WalletApi, fusionManagerEstimateThrowsIfSourceAddresIsNotAValidAddress) {
   ASSERT_EQ(1, alice.getAddressCount());
 
@@ -0,0 +1,213 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "gtest/gtest.h"
+
+#include "crypto/Crypto.h"
+#include "Wallet/WalletJournal.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const std::string JOURNAL_PATH = "test.wallet.journal";
+
+std::string makeData(size_t size, uint64_t seed)
+{
+    std::string data(size, '\0');
+    for (auto &c : data) {
+        seed = seed * 6364136223846793005 + 1442695040888963407;
+        c = static_cast<char>(seed >> 56);
+    }
+
+    return data;
+}
+
+std::string toString(const BinaryArray &data)
+{
+    return std::string(data.begin(), data.end());
+}
+
+class WalletJournalTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        boost::filesystem::remove(JOURNAL_PATH);
+        Crypto::cn_context context;
+        Crypto::generate_chacha8_key(context, "pass", key);
+        baseIv = Crypto::rand<Crypto::chacha8_iv>();
+    }
+
+    void TearDown() override
+    {
+        boost::filesystem::remove(JOURNAL_PATH);
+    }
+
+protected:
+    Crypto::chacha8_key key;
+    Crypto::chacha8_iv baseIv;
+};
+
+} // namespace
+
+TEST_F(WalletJournalTest, openReturnsAppendedChunks)
+{
+    WalletJournal journal;
+    journal.create(JOURNAL_PATH, baseIv);
+    journal.append(key, "first");
+    journal.append(key, "second");
+    journal.close();
+
+    std::vector<BinaryArray> chunks;
+    ASSERT_TRUE(journal.open(JOURNAL_PATH, baseIv, key, chunks));
+    ASSERT_EQ(2, chunks.size());
+    ASSERT_EQ("first", toString(chunks[0]));
+    ASSERT_EQ("second", toString(chunks[1]));
+    ASSERT_FALSE(journal.empty());
+}
+
+TEST_F(WalletJournalTest, openFailsForOtherBase)
+{
+    WalletJournal journal;
+    journal.create(JOURNAL_PATH, baseIv);
+    journal.append(key, "first");
+    journal.close();
+
+    std::vector<BinaryArray> chunks;
+    ASSERT_FALSE(journal.open(JOURNAL_PATH, Crypto::rand<Crypto::chacha8_iv>(), key, chunks));
+    ASSERT_FALSE(journal.isOpened());
+}
+
+TEST_F(WalletJournalTest, openFailsIfJournalDoesNotExist)
+{
+    WalletJournal journal;
+    std::vector<BinaryArray> chunks;
+    ASSERT_FALSE(journal.open(JOURNAL_PATH, baseIv, key, chunks));
+}
+
+TEST_F(WalletJournalTest, openDropsTornChunk)
+{
+    WalletJournal journal;
+    journal.create(JOURNAL_PATH, baseIv);
+    journal.append(key, "first");
+    uint64_t validSize = journal.size();
+    journal.append(key, makeData(1000, 1));
+    journal.close();
+
+    boost::filesystem::resize_file(JOURNAL_PATH, validSize + 100);
+
+    std::vector<BinaryArray> chunks;
+    ASSERT_TRUE(journal.open(JOURNAL_PATH, baseIv, key, chunks));
+    ASSERT_EQ(1, chunks.size());
+    ASSERT_EQ(validSize, journal.size());
+    ASSERT_EQ(validSize, boost::filesystem::file_size(JOURNAL_PATH));
+
+    journal.append(key, "third");
+    journal.close();
+
+    chunks.clear();
+    ASSERT_TRUE(journal.open(JOURNAL_PATH, baseIv, key, chunks));
+    ASSERT_EQ(2, chunks.size());
+    ASSERT_EQ("third", toString(chunks[1]));
+}
+
+TEST_F(WalletJournalTest, createDiscardsPreviousChunks)
+{
+    WalletJournal journal;
+    journal.create(JOURNAL_PATH, baseIv);
+    journal.append(key, "first");
+    journal.create(JOURNAL_PATH, baseIv);
+    journal.close();
+
+    std::vector<BinaryArray> chunks;
+    ASSERT_TRUE(journal.open(JOURNAL_PATH, baseIv, key, chunks));
+    ASSERT_TRUE(chunks.empty());
+    ASSERT_TRUE(journal.empty());
+}
+
+TEST(WalletChunkStore, decodeRestoresEncodedData)
+{
+    std::string base = makeData(300 * 1024, 1);
+    std::string data = base.substr(0, 100 * 1024) + "inserted" + base.substr(100 * 1024);
+
+    WalletChunkStore writer;
+    writer.add(base);
+    std::vector<Crypto::Hash> newChunks;
+    std::string encoded = writer.encode(data, newChunks);
+
+    WalletChunkStore reader;
+    reader.addDecoded(base);
+    ASSERT_EQ(data, reader.decode(encoded));
+}
+
+TEST(WalletChunkStore, encodeCarriesOnlyChangedChunks)
+{
+    std::string base = makeData(1024 * 1024, 2);
+    std::string data = base;
+    data[512 * 1024] ^= 1;
+    data += makeData(1024, 3);
+
+    WalletChunkStore store;
+    store.add(base);
+
+    std::vector<Crypto::Hash> newChunks;
+    ASSERT_LT(store.encode(data, newChunks).size(), 256 * 1024);
+    ASSERT_FALSE(newChunks.empty());
+    store.commit(newChunks);
+    ASSERT_LT(store.encode(data, newChunks).size(), 4 * 1024);
+    ASSERT_TRUE(newChunks.empty());
+}
+
+TEST(WalletChunkStore, encodeCarriesChunksOfUncommittedRecordsAgain)
+{
+    std::string base = makeData(300 * 1024, 5);
+    std::string data = base.substr(0, 100 * 1024) + "inserted" + base.substr(100 * 1024);
+
+    WalletChunkStore writer;
+    writer.add(base);
+    std::vector<Crypto::Hash> newChunks;
+    writer.encode(data, newChunks);
+    // the record wasn't written, the next one can't refer to its chunks
+    std::string encoded = writer.encode(data, newChunks);
+
+    WalletChunkStore reader;
+    reader.addDecoded(base);
+    ASSERT_EQ(data, reader.decode(encoded));
+}
+
+TEST(WalletChunkStore, decodeThrowsOnUnknownChunk)
+{
+    std::string base = makeData(100 * 1024, 4);
+
+    WalletChunkStore writer;
+    writer.add(base);
+    std::vector<Crypto::Hash> newChunks;
+    std::string encoded = writer.encode(base, newChunks);
+
+    WalletChunkStore reader;
+    ASSERT_ANY_THROW(reader.decode(encoded));
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2018-2020, The Qwertycoin Group.
+// Copyright (c) 2020-2021, Societatis.io
+//
+// This file is part of Societatis.
+//
+// Societatis is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Societatis is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Societatis.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Wallet/WalletTransfers.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+WalletTransfer makeTransfer(int64_t amount)
+{
+    WalletTransfer transfer;
+    transfer.type = WalletTransferType::USUAL;
+    transfer.address = "address";
+    transfer.amount = amount;
+
+    return transfer;
+}
+
+std::vector<int64_t> amounts(const WalletTransfers &transfers, size_t transactionId)
+{
+    std::vector<int64_t> result;
+    auto range = transfers.getTransfers(transactionId);
+    for (auto it = range.first; it != range.second; ++it) {
+        result.push_back(it->amount);
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST(WalletTransfers, unknownTransactionHasNoTransfers)
+{
+    WalletTransfers transfers;
+
+    auto range = transfers.getTransfers(10);
+    ASSERT_EQ(range.first, range.second);
+    ASSERT_TRUE(transfers.empty());
+}
+
+TEST(WalletTransfers, transfersAreGroupedByTransaction)
+{
+    WalletTransfers transfers;
+
+    transfers.push_back(1, makeTransfer(10));
+    transfers.push_back(0, makeTransfer(1));
+    transfers.push_back(1, makeTransfer(11));
+    transfers.push_back(0, makeTransfer(2));
+    transfers.push_back(1, makeTransfer(12));
+
+    ASSERT_EQ(5, transfers.size());
+    ASSERT_EQ(2, transfers.transactionCount());
+    ASSERT_EQ(std::vector<int64_t>({ 1, 2 }), amounts(transfers, 0));
+    ASSERT_EQ(std::vector<int64_t>({ 10, 11, 12 }), amounts(transfers, 1));
+}
+
+TEST(WalletTransfers, forEachVisitsTransfersInTransactionOrder)
+{
+    WalletTransfers transfers;
+
+    transfers.push_back(2, makeTransfer(20));
+    transfers.push_back(0, makeTransfer(1));
+    transfers.push_back(2, makeTransfer(21));
+
+    std::vector<std::pair<size_t, int64_t>> visited;
+    transfers.forEach([&visited](size_t transactionId, const WalletTransfer &transfer) {
+        visited.emplace_back(transactionId, transfer.amount);
+    });
+
+    std::vector<std::pair<size_t, int64_t>> expected{ { 0, 1 }, { 2, 20 }, { 2, 21 } };
+    ASSERT_EQ(expected, visited);
+}
+
+TEST(WalletTransfers, eraseReturnsNextTransferOfTransaction)
+{
+    WalletTransfers transfers;
+
+    transfers.push_back(0, makeTransfer(1));
+    transfers.push_back(0, makeTransfer(2));
+    transfers.push_back(0, makeTransfer(3));
+    transfers.push_back(1, makeTransfer(10));
+
+    auto range = transfers.getTransfers(0);
+    auto it = transfers.erase(0, std::next(range.first));
+
+    ASSERT_EQ(3, it->amount);
+    ASSERT_EQ(3, transfers.size());
+    ASSERT_EQ(std::vector<int64_t>({ 1, 3 }), amounts(transfers, 0));
+    ASSERT_EQ(std::vector<int64_t>({ 10 }), amounts(transfers, 1));
+}
+
+TEST(WalletTransfers, transfersSurviveCompaction)
+{
+    WalletTransfers transfers;
+
+    const size_t transactionCount = 100;
+    for (int64_t round = 0; round < 50; ++round) {
+        for (size_t id = 0; id < transactionCount; ++id) {
+            transfers.push_back(id, makeTransfer(round));
+        }
+    }
+
+    ASSERT_EQ(50 * transactionCount, transfers.size());
+    for (size_t id = 0; id < transactionCount; ++id) {
+        auto result = amounts(transfers, id);
+        ASSERT_EQ(50, result.size());
+        for (int64_t round = 0; round < 50; ++round) {
+            ASSERT_EQ(round, result[round]);
+        }
+    }
+}
+
+TEST(WalletTransfers, clearRemovesEverything)
+{
+    WalletTransfers transfers;
+
+    transfers.push_back(0, makeTransfer(1));
+    transfers.push_back(3, makeTransfer(2));
+    transfers.clear();
+
+    ASSERT_TRUE(transfers.empty());
+    ASSERT_EQ(0, transfers.transactionCount());
+}
@@ -47,6 +47,15 @@ class TransactionValidator : public CryptoNote::ITransactionValidator {
     return true;
   }
 
+  virtual bool resolveTransactionInputs(const CryptoNote::Transaction& tx, ResolvedTransactionInputs& inputs) override {
+    inputs.checkSignatures = false;
+    return true;
+  }
+
+  virtual bool checkTransactionSignatures(const CryptoNote::Transaction& tx, const ResolvedTransactionInputs& inputs) override {
+    return true;
+  }
+
   virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) override {
     return false;
   }
@@ -258,6 +267,74 @@ TEST_F(tx_pool, take_tx)
   ASSERT_EQ(tx, txOut);
 };
 
+TEST_F(tx_pool, extra_info_is_kept_with_transaction)
+{
+  TxTestBase test(1);
+  Transaction tx;
+
+  test.construct(test.m_currency.minimumFee(), 1, tx);
+
+  auto txhash = getObjectHash(tx);
+  TransactionExtraInfo extraInfo;
+  ASSERT_FALSE(test.pool.getTransactionExtraInfo(txhash, extraInfo));
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(test.pool.add_tx(tx, tvc, false));
+
+  ASSERT_TRUE(test.pool.getTransactionExtraInfo(txhash, extraInfo));
+  ASSERT_TRUE(extraInfo.hasPublicKey);
+  ASSERT_EQ(getTransactionPublicKeyFromExtra(tx.extra), extraInfo.publicKey);
+
+  Transaction txOut;
+  size_t blobSize;
+  uint64_t fee = 0;
+  ASSERT_TRUE(test.pool.take_tx(txhash, txOut, blobSize, fee));
+  ASSERT_FALSE(test.pool.getTransactionExtraInfo(txhash, extraInfo));
+};
+
+TEST_F(tx_pool, changes_since_version)
+{
+  TxTestBase test(1);
+  Transaction tx;
+  test.construct(test.m_currency.minimumFee(), 1, tx);
+  auto txhash = getObjectHash(tx);
+
+  Crypto::Hash tailId = NULL_HASH;
+  tailId.data[0] = 1;
+  std::vector<Crypto::Hash> added;
+  std::vector<Crypto::Hash> deleted;
+
+  // the first query binds the change log to the chain tail
+  ASSERT_FALSE(test.pool.get_changes_since(test.pool.get_version(), tailId, added, deleted));
+  uint64_t version = test.pool.get_version();
+  ASSERT_TRUE(test.pool.get_changes_since(version, tailId, added, deleted));
+  ASSERT_TRUE(added.empty());
+  ASSERT_TRUE(deleted.empty());
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(test.pool.add_tx(tx, tvc, false));
+
+  ASSERT_TRUE(test.pool.get_changes_since(version, tailId, added, deleted));
+  ASSERT_EQ(std::vector<Crypto::Hash>{txhash}, added);
+  ASSERT_TRUE(deleted.empty());
+  version = test.pool.get_version();
+
+  Transaction txOut;
+  size_t blobSize;
+  uint64_t fee = 0;
+  ASSERT_TRUE(test.pool.take_tx(txhash, txOut, blobSize, fee));
+
+  ASSERT_TRUE(test.pool.get_changes_since(version, tailId, added, deleted));
+  ASSERT_TRUE(added.empty());
+  ASSERT_EQ(std::vector<Crypto::Hash>{txhash}, deleted);
+
+  // versions from the future or another chain tail need a full difference
+  ASSERT_FALSE(test.pool.get_changes_since(test.pool.get_version() + 1, tailId, added, deleted));
+  Crypto::Hash otherTailId = tailId;
+  otherTailId.data[1] = 1;
+  ASSERT_FALSE(test.pool.get_changes_since(test.pool.get_version(), otherTailId, added, deleted));
+}
+
 
 TEST_F(tx_pool, double_spend_tx)
 {
@@ -825,3 +902,35 @@ TEST_F(TxPool_FillBlockTemplate, TxPoolContinuesToAddOrdinaryTransactionsUpTo125
     TEST_MAX_TX_COUNT_PER_BLOCK - fusionTxCount,
     fusionTxCount));
 }
+
+namespace {
+
+Transaction createTransactionWithKeyImages(const std::vector<uint8_t>& keyImageSeeds) {
+  Transaction tx;
+  for (auto seed : keyImageSeeds) {
+    KeyInput input;
+    input.amount = 1;
+    std::fill(std::begin(input.keyImage.data), std::end(input.keyImage.data), seed);
+    tx.inputs.push_back(input);
+  }
+
+  return tx;
+}
+
+}
+
+TEST(KeyImageReservations, conflictingTransactionIsRejectedUntilRelease) {
+  KeyImageReservations reservations;
+  auto first = createTransactionWithKeyImages({ 1, 2 });
+  auto conflicting = createTransactionWithKeyImages({ 3, 2 });
+  auto independent = createTransactionWithKeyImages({ 3, 4 });
+
+  ASSERT_TRUE(reservations.reserve(first));
+  ASSERT_FALSE(reservations.reserve(conflicting));
+  // a rejected reservation doesn't keep any of its key images
+  ASSERT_TRUE(reservations.reserve(independent));
+
+  reservations.release(first);
+  reservations.release(independent);
+  ASSERT_TRUE(reservations.reserve(conflicting));
+}